@@ -5,12 +5,37 @@
 #include <string>
 #include "obse64_common/Types.h"
 
+// Element types, tracked for values imported from JSON so they can be written back out unchanged
+// Anything without an entry is a string
+enum {
+	kArrayElem_String = 0,
+	kArrayElem_Number,		// the number as written in the source
+	kArrayElem_Bool,		// "1" or "0"
+	kArrayElem_Null,		// empty string
+	kArrayElem_Array,		// ID of a nested array
+};
+
 // Simple array storage for OBSE arrays
 // In a full OBSE implementation, this would be more sophisticated
 struct OBSEArray {
 	std::vector<std::string> lines;
 	std::map<std::string, std::string> stringMap;
 	std::map<u32, std::string> intMap;
+
+	std::vector<u8> lineTypes;				// parallel to lines, may be shorter
+	std::map<std::string, u8> keyTypes;		// stringMap entries that aren't strings
+	bool isMap = false;						// came from a JSON object, exported as one even when empty
+
+	u8 GetLineType(u32 idx) const
+	{
+		return idx < lineTypes.size() ? lineTypes[idx] : kArrayElem_String;
+	}
+
+	u8 GetKeyType(const std::string& key) const
+	{
+		auto it = keyTypes.find(key);
+		return it != keyTypes.end() ? it->second : kArrayElem_String;
+	}
 };
 
 // Global array storage
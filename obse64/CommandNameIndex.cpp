@@ -0,0 +1,98 @@
+#include "CommandNameIndex.h"
+#include "GameScript.h"
+#include <cctype>
+#include <cstring>
+
+// case insensitive FNV-1a, to match the _stricmp comparison
+static u32 HashCommandName(const char * name)
+{
+	u32 hash = 2166136261U;
+
+	for (; *name; name++)
+	{
+		hash ^= u8(tolower(u8(*name)));
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+static const char * EntryName(const CommandInfo * cmd, bool isShortName)
+{
+	return isShortName ? cmd->shortName : cmd->name;
+}
+
+void CommandNameIndex::build(const Table * tables, size_t numTables)
+{
+	size_t numNames = 0;
+
+	for (size_t i = 0; i < numTables; i++)
+		numNames += tables[i].count * 2;
+
+	size_t capacity = 16;
+	while (capacity < numNames * 2)
+		capacity <<= 1;
+
+	Entry empty = { 0, 0, nullptr };
+	m_entries.assign(capacity, empty);
+	m_size = 0;
+
+	// all long names first, a short name never hides another command's long name
+	for (u32 isShortName = 0; isShortName < 2; isShortName++)
+		for (size_t i = 0; i < numTables; i++)
+			for (size_t j = 0; j < tables[i].count; j++)
+				insert(&tables[i].commands[j], isShortName != 0);
+}
+
+bool CommandNameIndex::insert(const CommandInfo * cmd, bool isShortName)
+{
+	const char * name = EntryName(cmd, isShortName);
+
+	// padding commands have empty names, most commands have no short name
+	if (!name || !*name)
+		return false;
+
+	u32 hash = HashCommandName(name);
+
+	if (find(name, hash))
+		return false;	// first one wins
+
+	size_t mask = m_entries.size() - 1;
+	size_t slot = hash & mask;
+
+	while (m_entries[slot].cmd)
+		slot = (slot + 1) & mask;
+
+	m_entries[slot].hash = hash;
+	m_entries[slot].isShortName = isShortName;
+	m_entries[slot].cmd = cmd;
+
+	m_size++;
+
+	return true;
+}
+
+const CommandNameIndex::Entry * CommandNameIndex::find(const char * name, u32 hash) const
+{
+	size_t mask = m_entries.size() - 1;
+
+	for (size_t slot = hash & mask; m_entries[slot].cmd; slot = (slot + 1) & mask)
+	{
+		const Entry & entry = m_entries[slot];
+
+		if ((entry.hash == hash) && !_stricmp(EntryName(entry.cmd, entry.isShortName != 0), name))
+			return &entry;
+	}
+
+	return nullptr;
+}
+
+const CommandInfo * CommandNameIndex::lookup(const char * name) const
+{
+	if (m_entries.empty() || !name)
+		return nullptr;
+
+	const Entry * entry = find(name, HashCommandName(name));
+
+	return entry ? entry->cmd : nullptr;
+}
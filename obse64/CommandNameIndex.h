@@ -0,0 +1,43 @@
+#pragma once
+
+#include "obse64_common/Types.h"
+#include <vector>
+
+struct CommandInfo;
+
+// case insensitive name to command lookup over one or more command tables
+//
+// open addressing on a FNV hash of the lowercased name, the full hash is kept in each slot so a probe
+// only compares strings when it's likely to match. long names win over short names, then earlier tables
+// win over later ones. the tables must not move or change names after build()
+
+class CommandNameIndex
+{
+public:
+	struct Table
+	{
+		const CommandInfo	* commands;
+		size_t				count;
+	};
+
+	void	build(const Table * tables, size_t numTables);
+
+	// long or short name, null if not found
+	const CommandInfo *	lookup(const char * name) const;
+
+	size_t	size() const { return m_size; }
+
+private:
+	struct Entry
+	{
+		u32		hash;
+		u32		isShortName;
+		const CommandInfo	* cmd;	// null = empty slot
+	};
+
+	bool	insert(const CommandInfo * cmd, bool isShortName);
+	const Entry *	find(const char * name, u32 hash) const;
+
+	std::vector <Entry>	m_entries;	// power of two size, at most half full
+	size_t				m_size = 0;
+};
@@ -58,19 +58,11 @@ static CommandInfo kTestArgCommand =
 
 void ImportConsoleCommand(const char * name)
 {
-	for(u32 i = 0; i < kScript_NumConsoleCommands; i++)
-	{
-		auto & cmd = g_firstConsoleCommand[i];
-
-		if(!_stricmp(name, cmd.name))
-		{
-			AddScriptCommand(cmd);
+	const CommandInfo * cmd = LookupConsoleCommandByName(name);
+	if(!cmd)
+		HALT("couldn't find console cmd");
 
-			return;
-		}
-	}
-
-	HALT("couldn't find console cmd");
+	AddScriptCommand(*cmd);
 }
 
 static bool Cmd_GetOBSEVersion_Execute(COMMAND_ARGS)
@@ -101,6 +93,7 @@ static CommandInfo kCommandInfo_GetOBSEVersion =
 
 #define ADD(n) extern CommandInfo kCommandInfo_##n; AddScriptCommand(kCommandInfo_##n)
 #define ADD_RET(n, r) extern CommandInfo kCommandInfo_##n; AddScriptCommand(kCommandInfo_##n, r)
+#define ADD_PURE(n) extern CommandInfo kCommandInfo_##n; AddScriptCommand(kCommandInfo_##n, kRetnType_Default, kCmdFlag_Pure)
 
 void AddScriptCommands()
 {
@@ -127,35 +120,35 @@ void AddScriptCommands()
 	ADD_RET(GetActiveSpell, kRetnType_Form);
 	ADD_RET(SetActiveSpell, kRetnType_Form);
 	ADD(SquareRoot);
-	ADD(Sin);
-	ADD(Cos);
-	ADD(Tan);
-	ADD(ASin);
-	ADD(ACos);
-	ADD(ATan);
-	ADD(Log);
-	ADD(Exp);
+	ADD_PURE(Sin);
+	ADD_PURE(Cos);
+	ADD_PURE(Tan);
+	ADD_PURE(ASin);
+	ADD_PURE(ACos);
+	ADD_PURE(ATan);
+	ADD_PURE(Log);
+	ADD_PURE(Exp);
 	ADD(GetParentCell);
-	ADD(Log10);
+	ADD_PURE(Log10);
 	ADD(Floor);
 	ADD(Ceil);
 	ADD(Abs);
 	ADD(Rand);
-	ADD(Pow);
-	ADD(ATan2);
-	ADD(Sinh);
-	ADD(Cosh);
-	ADD(Tanh);
-	ADD(dSin);
-	ADD(dCos);
-	ADD(dTan);
-	ADD(dASin);
-	ADD(dACos);
-	ADD(dATan);
-	ADD(dATan2);
-	ADD(dSinh);
-	ADD(dCosh);
-	ADD(dTanh);
+	ADD_PURE(Pow);
+	ADD_PURE(ATan2);
+	ADD_PURE(Sinh);
+	ADD_PURE(Cosh);
+	ADD_PURE(Tanh);
+	ADD_PURE(dSin);
+	ADD_PURE(dCos);
+	ADD_PURE(dTan);
+	ADD_PURE(dASin);
+	ADD_PURE(dACos);
+	ADD_PURE(dATan);
+	ADD_PURE(dATan2);
+	ADD_PURE(dSinh);
+	ADD_PURE(dCosh);
+	ADD_PURE(dTanh);
 	ADD_RET(GetInventoryObject, kRetnType_Form);
 	ADD_RET(GetEquippedObject, kRetnType_Form);
 	ADD(IsKeyPressed2);
@@ -195,4 +188,22 @@ void AddScriptCommands()
 	ImportConsoleCommand("WaterReflectionColor");
 	ImportConsoleCommand("SetGamma");
 	ImportConsoleCommand("SetHDRParam");
+
+	// added since the first release, appended so no opcodes move
+	ADD(VarlaBeginFile);
+	ADD(VarlaCommitFile);
+	ADD(VarlaAbortFile);
+	ADD(SetLogRotation);
+	ADD(ReadFromLogHistory);
+	ADD(ar_ExportJSON);
+	ADD(ar_ImportJSON);
+	ADD(ar_ToJSON);
+	ADD(ar_FromJSON);
+	ADD(KVSet);
+	ADD(KVGet);
+	ADD(KVHas);
+	ADD(KVDelete);
+	ADD(KVKeys);
+	ADD(KVCompact);
+	ADD(ProfileCommands);
 }
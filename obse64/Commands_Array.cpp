@@ -2,6 +2,7 @@
 #include "ArrayTypes.h"
 #include "GameConsole.h"
 #include "GameScript.h"
+#include "ScriptArgs.h"
 #include <vector>
 #include <map>
 #include <string>
@@ -14,10 +15,10 @@
 bool Cmd_ar_Size_Execute(COMMAND_ARGS)
 {
 	// In OBSE, array variables are passed as special parameters
-	// For this simplified implementation, we expect the array ID as a double
-	double arrayID = 0;
+	// For this simplified implementation, we expect the array ID as a float
+	float arrayID = 0;
 
-	if (ExtractArgs(EXTRACT_ARGS, &arrayID))
+	if (ExtractArgsFast(EXTRACT_ARGS, &arrayID))
 	{
 		u32 id = (u32)arrayID;
 		auto it = g_arrayStorage.find(id);
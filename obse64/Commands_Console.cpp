@@ -1,5 +1,7 @@
 #include "GameConsole.h"
 #include "GameScript.h"
+#include "FormatString.h"
+#include "Hooks_Script.h"
 
 /* Print formatted string to Oblivion console
  * syntax: PrintToConsole fmtstring num1 num2 ...
@@ -7,6 +9,7 @@
  *
  * Prints a formatted string to the Oblivion console, similar to how printf() works.
  * -Format notation is the same as MessageBox, so you can use %#.#f %g %e %%
+ * -%z prints the string variable whose ID is passed, %n prints the name of the form whose ID is passed
  * -While this function technically accepts floats, you can use %g to print integers.  Again, how this works
  *  is probably similar to how MessageBox works (ie. same range limitations).
  * -The string can be up to 511 characters long, not including the null byte.
@@ -19,7 +22,12 @@ bool Cmd_PrintToConsole_Execute(COMMAND_ARGS)
 
 	if (ExtractArgs(EXTRACT_ARGS, &fmtstring, &f0, &f1, &f2, &f3, &f4, &f5, &f6, &f7, &f8))
 	{
-		Console_Print(fmtstring, f0, f1, f2, f3, f4, f5, f6, f7, f8);
+		const float args[] = { f0, f1, f2, f3, f4, f5, f6, f7, f8 };
+		char buffer[BUFSIZ * 2];
+
+		FormatScriptString(fmtstring, args, 9, buffer, sizeof(buffer));
+
+		Console_Print("%s", buffer);
 	}
 
 	return true;
@@ -48,3 +56,74 @@ CommandInfo kCommandInfo_PrintToConsole =
 	10, kParams_StringFormat,
 	Cmd_PrintToConsole_Execute
 };
+
+/* Profile script commands
+ * syntax: ProfileCommands [mode]
+ * shortname: pcmd
+ *
+ * Counts calls and time spent in each script command.
+ * -1 (the default) clears the counters and starts profiling
+ * -0 stops profiling and writes the report
+ * -2 writes the report and keeps profiling
+ * The report goes to OBSE\CommandProfile.txt, ranked by total and mean cost. The most expensive
+ * commands are also printed to the console, along with the result cache hit rate of pure commands.
+ * Returns 1 if it worked.
+ */
+bool Cmd_ProfileCommands_Execute(COMMAND_ARGS)
+{
+	u32 mode = 1;
+
+	*result = 0;
+
+	if (!ExtractArgs(EXTRACT_ARGS, &mode))
+		return true;
+
+	switch (mode)
+	{
+		case 0:
+			if (IsCommandProfilingEnabled())
+			{
+				EnableCommandProfiling(false);
+
+				if (WriteCommandProfile(10))
+					*result = 1;
+			}
+			else
+			{
+				Console_Print("command profiling isn't running");
+			}
+			break;
+
+		case 1:
+			ResetCommandProfile();
+
+			if (EnableCommandProfiling(true))
+			{
+				Console_Print("command profiling started");
+				*result = 1;
+			}
+			break;
+
+		case 2:
+			if (WriteCommandProfile(10))
+				*result = 1;
+			break;
+	}
+
+	return true;
+}
+
+static ParamInfo kParams_ProfileCommands[1] =
+{
+	{"mode", kParamType_Integer, 1}
+};
+
+CommandInfo kCommandInfo_ProfileCommands =
+{
+	"ProfileCommands", "pcmd",
+	0,
+	"Profile script command execution",
+	0,
+	1, kParams_ProfileCommands,
+	Cmd_ProfileCommands_Execute
+};
@@ -2,27 +2,88 @@
 #include "ArrayTypes.h"
 #include "GameConsole.h"
 #include "GameScript.h"
+#include "StringVar.h"
+#include "FormatString.h"
 #include "obse64_common/Log.h"
+#include "obse64_common/FileStream.h"
+#include "obse64_common/BlockCompression.h"
+#include "obse64_common/BufferStream.h"
+#include "obse64_common/Json.h"
+#include "obse64_common/KeyValueStore.h"
 #include <fstream>
 #include <string>
 #include <vector>
 #include <map>
+#include <algorithm>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
 #include <shlobj.h>
 
+// Rotation limits set with SetLogRotation, 0 = no limit
+struct LogRotationPolicy {
+	u64 maxBytes;
+	u64 maxLines;
+	u32 maxGenerations;	// old generations kept as name.1.log (newest) .. name.N.log (oldest)
+	bool compressOld;	// old generations are rewritten as compressed blocks (name.N.log.oblz)
+
+	LogRotationPolicy() : maxBytes(0), maxLines(0), maxGenerations(0), compressOld(false) {}
+
+	bool IsEnabled() const { return maxBytes || maxLines; }
+};
+
 // Log management structures
 struct LogFile {
 	std::string name;
-	std::string fullPath;
+	std::string basePath;	// directory + name, without extension
+	std::string extension;
+	std::string fullPath;	// basePath + extension, the current generation
 	std::unique_ptr<std::ofstream> writeStream;
 	int mode; // 0 = read, 1 = write/append
 	bool isOpen;
+	bool compressed;		// written as compressed blocks instead of through writeStream
+	std::string pending;	// compressed mode: lines not yet written out as a block
+	u64 pendingSince;		// GetTickCount64 when the first pending line was added
+	std::string tail;		// compressed mode: text of the last block written, while it's still being added to
+	u64 tailOffset;			// where that block starts in the file
+	u64 tailEnd;			// and where it ends, the file's length if nothing else has written to it since
+
+	LogRotationPolicy rotation;
+	u64 bytesWritten;		// size of the current generation's text: on disk for plain logs, decompressed for compressed ones
+	u64 linesWritten;		// lines written to the current generation since it was registered or rotated
+
+	LogFile() : mode(0), isOpen(false), compressed(false), pendingSince(0), tailOffset(0), tailEnd(0), writeStream(nullptr), bytesWritten(0), linesWritten(0) {}
+};
 
-	LogFile() : mode(0), isOpen(false), writeStream(nullptr) {}
+// Compressed logs write out buffered lines once this much is buffered, or once the oldest buffered line is this old
+// The age is also checked every frame, so as long as the game thread is running, a crash loses the lines from
+// about the last 2 seconds. A crash in the middle of rewriting the last block (see WriteCompressedLog) can also
+// lose the up to 16 KB already in it
+enum
+{
+	kCompressedLogFlushBytes = 16 * 1024,
+	kCompressedLogFlushMS = 2000,
 };
 
 // Global state for log management
 static std::map<std::string, LogFile> g_registeredLogs;
 
+// Pending export opened with VarlaBeginFile
+// Writes are collected in memory and land on disk in a single write on commit
+struct FileTransaction {
+	std::string fullPath;
+	std::string buffer;
+	bool append;
+	bool compress;
+
+	FileTransaction() : append(false), compress(false) {}
+};
+
+// keyed by TransactionKey, so every way of naming the same file finds its transaction
+static std::map<std::string, FileTransaction> g_fileTransactions;
+
 // Array storage (defined in ArrayTypes.h, implemented here)
 std::map<u32, OBSEArray> g_arrayStorage;
 u32 g_nextArrayID = 1;
@@ -40,6 +101,439 @@ static std::string GetLogDirectory()
 	return "";
 }
 
+// The full path resolved and case folded: "Export.txt", "EXPORT.TXT" and "sub\\..\\export.txt" are one file
+static std::string TransactionKey(const std::string& fullPath)
+{
+	char canonical[MAX_PATH];
+	DWORD len = GetFullPathNameA(fullPath.c_str(), sizeof(canonical), canonical, NULL);
+
+	std::string key = (len && len < sizeof(canonical)) ? std::string(canonical, len) : fullPath;
+	std::transform(key.begin(), key.end(), key.begin(), [](char c) { return (char)tolower((unsigned char)c); });
+
+	return key;
+}
+
+// Appends one compressed block to a file, starting a new compressed stream if the file is empty
+// blockOffset and blockEnd receive where the block was written
+static bool AppendCompressedBlock(const std::string& path, const void* data, size_t len, u64* blockOffset = nullptr, u64* blockEnd = nullptr)
+{
+	FileStream file;
+	if (!file.append(path.c_str()))
+		return false;
+
+	BlockCompressedWriter writer(&file);
+
+	if (!file.length())
+		writer.writeHeader();
+
+	if (blockOffset)
+		*blockOffset = file.offset();
+
+	writer.writeBlock(data, len);
+
+	if (blockEnd)
+		*blockEnd = file.offset();
+
+	return true;
+}
+
+// Replaces the block from blockOffset to blockEnd, which has to be the last one in the file
+// Fails without writing anything if the file doesn't end there any more
+static bool ReplaceLastCompressedBlock(const std::string& path, u64 blockOffset, u64* blockEnd, const void* data, size_t len)
+{
+	FileStream file;
+	if (!file.modify(path.c_str()) || file.length() != *blockEnd)
+		return false;
+
+	file.seek(blockOffset);
+
+	BlockCompressedWriter writer(&file);
+	writer.writeBlock(data, len);
+
+	// the new block can be stored smaller than the one it replaces
+	if (!file.truncate(file.offset()))
+		return false;
+
+	*blockEnd = file.offset();
+
+	return true;
+}
+
+// Reads a whole file as text, transparently decompressing files written in compressed mode
+static bool ReadFileText(const std::string& path, std::string* out)
+{
+	FileStream file;
+	if (!file.open(path.c_str()))
+		return false;
+
+	if (BlockCompressedReader::isCompressed(&file))
+	{
+		BlockCompressedReader reader;
+		return reader.attach(&file) && reader.readAll(out);
+	}
+
+	size_t offset = out->size();
+	out->resize(offset + size_t(file.length()));
+	if (file.length())
+		file.read(&(*out)[offset], file.length());
+
+	return true;
+}
+
+// Splits text in to lines the same way std::getline does, dropping the \r of CRLF line endings
+static void SplitLines(const std::string& text, std::vector<std::string>& lines)
+{
+	size_t start = 0;
+
+	while (start < text.size())
+	{
+		size_t end = text.find('\n', start);
+		if (end == std::string::npos)
+			end = text.size();
+
+		size_t lineEnd = end;
+		if (lineEnd > start && text[lineEnd - 1] == '\r')
+			lineEnd--;
+
+		lines.push_back(text.substr(start, lineEnd - start));
+
+		start = end + 1;
+	}
+}
+
+// Writes out buffered lines of a compressed log
+// Until the last block written holds kCompressedLogFlushBytes it's rewritten with the new lines added, so a log
+// that's only written to now and then still ends up in full blocks instead of one block per flush
+static bool WriteCompressedLog(LogFile& log)
+{
+	bool written = false;
+
+	if (!log.tail.empty() && log.tail.size() + log.pending.size() <= kCompressedLogFlushBytes)
+	{
+		std::string text = log.tail + log.pending;
+
+		if (ReplaceLastCompressedBlock(log.fullPath, log.tailOffset, &log.tailEnd, text.data(), text.size()))
+		{
+			log.tail.swap(text);
+			written = true;
+		}
+	}
+
+	if (!written)
+	{
+		written = AppendCompressedBlock(log.fullPath, log.pending.data(), log.pending.size(), &log.tailOffset, &log.tailEnd);
+		log.tail = written ? log.pending : std::string();
+	}
+
+	log.pending.clear();
+
+	return written;
+}
+
+static void FlushCompressedLog(LogFile& log)
+{
+	if (log.pending.empty())
+		return;
+
+	if (!WriteCompressedLog(log))
+		Console_Print("Failed to write compressed log file: %s", log.fullPath.c_str());
+}
+
+// Lines still buffered when the process exits would otherwise be lost
+static void FlushCompressedLogsAtExit()
+{
+	for (auto& pair : g_registeredLogs)
+	{
+		LogFile& log = pair.second;
+
+		if (log.compressed && !log.pending.empty() && !WriteCompressedLog(log))
+			_ERROR("failed to write compressed log file at exit: %s", log.fullPath.c_str());
+	}
+}
+
+void FlushCompressedLogs()
+{
+	u64 now = GetTickCount64();
+
+	for (auto& pair : g_registeredLogs)
+	{
+		LogFile& log = pair.second;
+
+		if (log.compressed && !log.pending.empty() && now - log.pendingSince >= kCompressedLogFlushMS)
+			FlushCompressedLog(log);
+	}
+}
+
+static void CloseLog(LogFile& log, bool flush)
+{
+	if (log.compressed)
+		FlushCompressedLog(log);
+
+	if (log.writeStream && log.writeStream->is_open())
+	{
+		if (flush)
+			log.writeStream->flush();
+		log.writeStream->close();
+	}
+}
+
+// ===== LOG ROTATION =====
+// The game thread only closes the current generation and renames it to a staging file.
+// Shifting the older generations and compressing them happens on a worker thread.
+
+static std::string GenerationPath(const std::string& basePath, const std::string& extension, u32 generation, bool compressed)
+{
+	std::string path = basePath + "." + std::to_string(generation) + extension;
+
+	// compressed logs already carry the .oblz extension
+	if (compressed && extension.find(".oblz") == std::string::npos)
+		path += ".oblz";
+
+	return path;
+}
+
+static bool FileExists(const std::string& path)
+{
+	return GetFileAttributesA(path.c_str()) != INVALID_FILE_ATTRIBUTES;
+}
+
+// Existing path of a generation, in either form
+static std::string FindGeneration(const std::string& basePath, const std::string& extension, u32 generation)
+{
+	std::string path = GenerationPath(basePath, extension, generation, false);
+	if (FileExists(path))
+		return path;
+
+	path = GenerationPath(basePath, extension, generation, true);
+	if (FileExists(path))
+		return path;
+
+	return "";
+}
+
+class LogRotator
+{
+public:
+	struct Job {
+		std::string basePath;
+		std::string extension;
+		std::string stagingPath;
+		u32 maxGenerations;
+		bool compressOld;
+	};
+
+	void Enqueue(const Job& job)
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+
+		// the thread is never joined, it lives until the process exits
+		if (!m_started)
+		{
+			std::thread(&LogRotator::Run, this).detach();
+			m_started = true;
+		}
+
+		m_jobs.push_back(job);
+
+		m_wake.notify_one();
+	}
+
+	// Appends the lines of every rotated generation of a log, oldest first, including ones still waiting to be
+	// rotated. Only blocks while the worker renames files, never while it compresses
+	void ReadHistory(const std::string& basePath, const std::string& extension, std::vector<std::string>& lines)
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+
+		// generations may be left over from an earlier session with a higher limit, so probe until one is missing
+		u32 numGenerations = 0;
+		while (!FindGeneration(basePath, extension, numGenerations + 1).empty())
+			numGenerations++;
+
+		for (u32 generation = numGenerations; generation >= 1; generation--)
+			ReadLines(FindGeneration(basePath, extension, generation), lines);
+
+		// newer than generation 1, in the order they were rotated
+		for (const Job& job : m_jobs)
+		{
+			if (job.basePath == basePath && job.extension == extension && job.maxGenerations)
+				ReadLines(job.stagingPath, lines);
+		}
+	}
+
+private:
+	static void ReadLines(const std::string& path, std::vector<std::string>& lines)
+	{
+		std::string text;
+		if (ReadFileText(path, &text))
+			SplitLines(text, lines);
+	}
+
+	void Run()
+	{
+		for (;;)
+		{
+			Job job;
+
+			{
+				std::unique_lock<std::mutex> lock(m_lock);
+				m_wake.wait(lock, [this] { return !m_jobs.empty(); });
+
+				// stays queued until it's done, ReadHistory reads the staging file until then
+				job = m_jobs.front();
+			}
+
+			std::string compressedPath = Compress(job);
+
+			{
+				std::lock_guard<std::mutex> lock(m_lock);
+
+				Shift(job, compressedPath);
+				m_jobs.pop_front();
+			}
+		}
+	}
+
+	// Writes a compressed copy of the staging file if the generations are kept compressed, returns its path
+	// Slow, so the lock isn't held
+	static std::string Compress(const Job& job)
+	{
+		if (!job.maxGenerations || !job.compressOld)
+			return "";
+
+		FileStream staging;
+		if (!staging.open(job.stagingPath.c_str()) || BlockCompressedReader::isCompressed(&staging))
+			return "";
+
+		staging.close();
+
+		std::string text;
+		std::string dst = job.stagingPath + ".oblz";
+
+		FileStream out;
+		if (!ReadFileText(job.stagingPath, &text) || !out.create(dst.c_str()))
+			return "";	// keep it uncompressed
+
+		BlockCompressedWriter writer(&out);
+		writer.writeHeader();
+		writer.write(text.data(), text.size());
+		writer.flush();
+
+		return dst;
+	}
+
+	// Only renames and deletes, done with the lock held so ReadHistory never sees a generation missing
+	static void Shift(const Job& job, const std::string& compressedPath)
+	{
+		if (!job.maxGenerations)
+		{
+			DeleteFileA(job.stagingPath.c_str());
+			return;
+		}
+
+		// drop the oldest, then shift everything up by one
+		std::string oldest = FindGeneration(job.basePath, job.extension, job.maxGenerations);
+		if (!oldest.empty())
+			DeleteFileA(oldest.c_str());
+
+		for (u32 generation = job.maxGenerations - 1; generation >= 1; generation--)
+		{
+			std::string src = FindGeneration(job.basePath, job.extension, generation);
+			if (src.empty())
+				continue;
+
+			bool srcCompressed = src.size() > 5 && src.compare(src.size() - 5, 5, ".oblz") == 0;
+			std::string dst = GenerationPath(job.basePath, job.extension, generation + 1, srcCompressed);
+
+			MoveFileExA(src.c_str(), dst.c_str(), MOVEFILE_REPLACE_EXISTING);
+		}
+
+		if (!compressedPath.empty())
+		{
+			std::string dst = GenerationPath(job.basePath, job.extension, 1, true);
+
+			if (MoveFileExA(compressedPath.c_str(), dst.c_str(), MOVEFILE_REPLACE_EXISTING))
+			{
+				DeleteFileA(job.stagingPath.c_str());
+				return;
+			}
+
+			DeleteFileA(compressedPath.c_str());
+
+			// fall through and keep it uncompressed
+		}
+
+		bool stagingCompressed = false;
+		{
+			FileStream staging;
+			stagingCompressed = staging.open(job.stagingPath.c_str()) && BlockCompressedReader::isCompressed(&staging);
+		}
+
+		std::string dst = GenerationPath(job.basePath, job.extension, 1, stagingCompressed);
+		MoveFileExA(job.stagingPath.c_str(), dst.c_str(), MOVEFILE_REPLACE_EXISTING);
+	}
+
+	std::mutex m_lock;
+	std::condition_variable m_wake;
+	std::deque<Job> m_jobs;		// the front one is being rotated
+	bool m_started = false;
+};
+
+// never destroyed, the worker thread may still be using it during process exit
+static LogRotator& g_logRotator = *new LogRotator;
+
+// staging names have to stay unique while the worker gets to them, even if a log is re-registered
+// the process id keeps them apart from anything left behind by an earlier session that didn't finish rotating
+static std::atomic<u32> g_rotationSerial(0);
+
+static void OpenLogForWriting(LogFile& log)
+{
+	log.writeStream = std::make_unique<std::ofstream>(log.fullPath, std::ios::out | std::ios::app);
+}
+
+// Moves the current generation out of the way and starts a new one
+static void RotateLog(LogFile& log)
+{
+	CloseLog(log, true);
+
+	LogRotator::Job job;
+	job.basePath = log.basePath;
+	job.extension = log.extension;
+	job.stagingPath = log.basePath + ".rotating" + std::to_string(GetCurrentProcessId()) + "." + std::to_string(g_rotationSerial++) + log.extension;
+	job.maxGenerations = log.rotation.maxGenerations;
+	job.compressOld = log.rotation.compressOld;
+
+	// a rename is cheap enough to do here, everything else happens on the worker
+	// never replace an existing staging file, it could still be queued
+	if (MoveFileExA(log.fullPath.c_str(), job.stagingPath.c_str(), 0))
+		g_logRotator.Enqueue(job);
+	else
+		Console_Print("Failed to rotate log file: %s", log.fullPath.c_str());
+
+	log.bytesWritten = 0;
+	log.linesWritten = 0;
+	log.tail.clear();
+
+	if (!log.compressed)
+		OpenLogForWriting(log);
+}
+
+// lineBytes is what the line added to the text, see LogFile::bytesWritten
+static void CheckLogRotation(LogFile& log, size_t lineBytes)
+{
+	log.bytesWritten += lineBytes;
+	log.linesWritten++;
+
+	const LogRotationPolicy& policy = log.rotation;
+	if (!policy.IsEnabled())
+		return;
+
+	if ((policy.maxBytes && log.bytesWritten >= policy.maxBytes) ||
+		(policy.maxLines && log.linesWritten >= policy.maxLines))
+	{
+		RotateLog(log);
+	}
+}
+
 /* PrintC - Print formatted string to console and to registered log file (if any)
  * syntax: PrintC fmtstring [num1] [num2] ...
  * shortname: printc
@@ -54,8 +548,10 @@ bool Cmd_PrintC_Execute(COMMAND_ARGS)
 	if (ExtractArgs(EXTRACT_ARGS, &fmtstring, &f0, &f1, &f2, &f3, &f4, &f5, &f6, &f7, &f8))
 	{
 		// Format the string
+		const float args[] = { f0, f1, f2, f3, f4, f5, f6, f7, f8 };
 		char buffer[BUFSIZ * 2];
-		sprintf_s(buffer, sizeof(buffer), fmtstring, f0, f1, f2, f3, f4, f5, f6, f7, f8);
+
+		FormatScriptString(fmtstring, args, 9, buffer, sizeof(buffer));
 
 		// Print to console
 		Console_Print("%s", buffer);
@@ -72,12 +568,31 @@ bool Cmd_PrintC_Execute(COMMAND_ARGS)
 				(log.writeStream != nullptr),
 				(log.writeStream && log.writeStream->is_open()));
 
-			if (log.isOpen && log.mode == 1 && log.writeStream && log.writeStream->is_open())
+			if (log.isOpen && log.mode == 1 && log.compressed)
+			{
+				u64 now = GetTickCount64();
+
+				if (log.pending.empty())
+					log.pendingSince = now;
+
+				log.pending += buffer;
+				log.pending += '\n';
+
+				if (log.pending.size() >= kCompressedLogFlushBytes || now - log.pendingSince >= kCompressedLogFlushMS)
+					FlushCompressedLog(log);
+
+				logsWritten++;
+				CheckLogRotation(log, strlen(buffer) + 1);
+			}
+			else if (log.isOpen && log.mode == 1 && log.writeStream && log.writeStream->is_open())
 			{
 				*log.writeStream << buffer << std::endl;
 				log.writeStream->flush();
 				logsWritten++;
 				Console_Print("[DEBUG: Successfully wrote to log '%s']", log.name.c_str());
+
+				// the stream is in text mode, endl is written as \r\n
+				CheckLogRotation(log, strlen(buffer) + 2);
 			}
 		}
 
@@ -96,17 +611,21 @@ bool Cmd_PrintC_Execute(COMMAND_ARGS)
 }
 
 /* RegisterLog - Register a log file for reading or writing
- * syntax: RegisterLog "logname" mode
+ * syntax: RegisterLog "logname" mode [compress]
  *
  * Registers a log file. Mode: 0 = read, 1 = write/append
  * Log files are created in My Documents\My Games\Oblivion\
+ * compress: store the log as compressed blocks in logname.log.oblz instead of logname.log
+ *           lines are buffered and written out within 2 seconds, on UnregisterLog, and when the game exits
+ *           the last block is rewritten as lines are added until it holds 16 KB
  */
 bool Cmd_RegisterLog_Execute(COMMAND_ARGS)
 {
 	char logName[256];
 	u32 mode = 0;
+	u32 compress = 0;
 
-	if (ExtractArgs(EXTRACT_ARGS, &logName, &mode))
+	if (ExtractArgs(EXTRACT_ARGS, &logName, &mode, &compress))
 	{
 		std::string logDir = GetLogDirectory();
 		if (logDir.empty())
@@ -115,29 +634,62 @@ bool Cmd_RegisterLog_Execute(COMMAND_ARGS)
 			return true;
 		}
 
-		std::string fullPath = logDir + std::string(logName) + ".log";
+		std::string basePath = logDir + std::string(logName);
+		std::string extension = compress ? ".log.oblz" : ".log";
+		std::string fullPath = basePath + extension;
 
 		// Check if already registered
 		auto it = g_registeredLogs.find(logName);
 		if (it != g_registeredLogs.end())
 		{
 			// Close existing log
-			if (it->second.writeStream && it->second.writeStream->is_open())
-				it->second.writeStream->close();
+			CloseLog(it->second, false);
 			g_registeredLogs.erase(it);
 		}
 
 		// Register new log
 		LogFile& log = g_registeredLogs[logName];
 		log.name = logName;
+		log.basePath = basePath;
+		log.extension = extension;
 		log.fullPath = fullPath;
 		log.mode = mode;
 		log.isOpen = true;
+		log.compressed = compress != 0;
+
+		if (log.compressed)
+		{
+			static bool s_exitFlushRegistered = false;
+			if (!s_exitFlushRegistered)
+			{
+				atexit(FlushCompressedLogsAtExit);
+				s_exitFlushRegistered = true;
+			}
+		}
+
+		// continuing an existing file, count what's already in it the same way PrintC counts lines
+		{
+			FileStream existing;
+			if (existing.open(fullPath.c_str()))
+			{
+				BlockCompressedReader reader;
+
+				if (!log.compressed)
+					log.bytesWritten = existing.length();
+				else if (reader.attach(&existing))
+					log.bytesWritten = reader.rawLength();
+			}
+		}
 
-		if (mode == 1) // Write mode
+		if (mode == 1 && log.compressed)
+		{
+			// blocks are appended on demand, nothing to keep open
+			Console_Print("RegisterLog: Registered '%s' at %s (compressed)", logName, fullPath.c_str());
+		}
+		else if (mode == 1) // Write mode
 		{
 			// Open in append mode
-			log.writeStream = std::make_unique<std::ofstream>(fullPath, std::ios::out | std::ios::app);
+			OpenLogForWriting(log);
 			if (!log.writeStream->is_open())
 			{
 				Console_Print("RegisterLog: Failed to open log file for writing: %s", fullPath.c_str());
@@ -178,24 +730,22 @@ bool Cmd_ReadFromLog_Execute(COMMAND_ARGS)
 		LogFile& log = it->second;
 
 		// Read the file
-		std::ifstream file(log.fullPath);
-		if (!file.is_open())
+		std::string text;
+		if (!ReadFileText(log.fullPath, &text) && log.pending.empty())
 		{
 			Console_Print("ReadFromLog: Failed to open log file: %s", log.fullPath.c_str());
 			*result = 0;
 			return true;
 		}
 
+		// lines of a compressed log that haven't been written out yet
+		text += log.pending;
+
 		// Create array and read lines
 		u32 arrayID = g_nextArrayID++;
 		OBSEArray& arr = g_arrayStorage[arrayID];
 
-		std::string line;
-		while (std::getline(file, line))
-		{
-			arr.lines.push_back(line);
-		}
-		file.close();
+		SplitLines(text, arr.lines);
 
 		#if _DEBUG
 		Console_Print("ReadFromLog: Read %d lines from '%s'", (int)arr.lines.size(), logName);
@@ -228,12 +778,7 @@ bool Cmd_UnregisterLog_Execute(COMMAND_ARGS)
 		auto it = g_registeredLogs.find(logName);
 		if (it != g_registeredLogs.end())
 		{
-			if (it->second.writeStream && it->second.writeStream->is_open())
-			{
-				if (flush)
-					it->second.writeStream->flush();
-				it->second.writeStream->close();
-			}
+			CloseLog(it->second, flush != 0);
 			g_registeredLogs.erase(it);
 
 			#if _DEBUG
@@ -245,34 +790,126 @@ bool Cmd_UnregisterLog_Execute(COMMAND_ARGS)
 	return true;
 }
 
-// Parameter definitions
-static ParamInfo kParams_PrintC[10] =
+/* SetLogRotation - Set rotation limits for a registered log
+ * syntax: SetLogRotation "logname" maxBytes maxLines maxGenerations [compressOld]
+ *
+ * When the current log reaches maxBytes or maxLines (0 = no limit) it is moved to logname.1.log,
+ * older generations move up by one, and anything past maxGenerations is deleted
+ * maxBytes counts the log's text before compression, so it means the same for compressed logs
+ * compressOld: store old generations as compressed blocks (logname.N.log.oblz)
+ * Only the rename of the current file happens on the game thread, the rest is done in the background
+ * The limits last until the log is unregistered
+ */
+bool Cmd_SetLogRotation_Execute(COMMAND_ARGS)
 {
-	{"string", kParamType_String, 0},
-	{"float", kParamType_Float, 1},
-	{"float", kParamType_Float, 1},
-	{"float", kParamType_Float, 1},
-	{"float", kParamType_Float, 1},
-	{"float", kParamType_Float, 1},
-	{"float", kParamType_Float, 1},
-	{"float", kParamType_Float, 1},
-	{"float", kParamType_Float, 1},
-	{"float", kParamType_Float, 1}
-};
+	char logName[256];
+	u32 maxBytes = 0;
+	u32 maxLines = 0;
+	u32 maxGenerations = 0;
+	u32 compressOld = 0;
 
-static ParamInfo kParams_RegisterLog[2] =
-{
-	{"logName", kParamType_String, 0},
-	{"mode", kParamType_Integer, 0}
-};
+	*result = 0;
 
-static ParamInfo kParams_ReadFromLog[1] =
-{
-	{"logName", kParamType_String, 0}
-};
+	if (ExtractArgs(EXTRACT_ARGS, &logName, &maxBytes, &maxLines, &maxGenerations, &compressOld))
+	{
+		auto it = g_registeredLogs.find(logName);
+		if (it == g_registeredLogs.end())
+		{
+			Console_Print("SetLogRotation: Log '%s' not registered", logName);
+			return true;
+		}
 
-static ParamInfo kParams_UnregisterLog[3] =
-{
+		LogRotationPolicy& policy = it->second.rotation;
+		policy.maxBytes = maxBytes;
+		policy.maxLines = maxLines;
+		policy.maxGenerations = maxGenerations;
+		policy.compressOld = compressOld != 0;
+
+		*result = 1;
+	}
+
+	return true;
+}
+
+/* ReadFromLogHistory - Read all generations of a registered log
+ * syntax: let array = ReadFromLogHistory "logname"
+ *
+ * Like ReadFromLog, but starts with the oldest rotated generation and ends with the current one
+ * Doesn't wait for rotations still running in the background, generations not moved in to place yet are read
+ * from where they are
+ */
+bool Cmd_ReadFromLogHistory_Execute(COMMAND_ARGS)
+{
+	char logName[256];
+
+	*result = 0;
+
+	if (ExtractArgs(EXTRACT_ARGS, &logName))
+	{
+		auto it = g_registeredLogs.find(logName);
+		if (it == g_registeredLogs.end())
+		{
+			Console_Print("ReadFromLogHistory: Log '%s' not registered", logName);
+			return true;
+		}
+
+		LogFile& log = it->second;
+
+		u32 arrayID = g_nextArrayID++;
+		OBSEArray& arr = g_arrayStorage[arrayID];
+
+		g_logRotator.ReadHistory(log.basePath, log.extension, arr.lines);
+
+		std::string text;
+		ReadFileText(log.fullPath, &text);
+		text += log.pending;
+
+		SplitLines(text, arr.lines);
+
+		*result = arrayID;
+	}
+
+	return true;
+}
+
+// Parameter definitions
+static ParamInfo kParams_PrintC[10] =
+{
+	{"string", kParamType_String, 0},
+	{"float", kParamType_Float, 1},
+	{"float", kParamType_Float, 1},
+	{"float", kParamType_Float, 1},
+	{"float", kParamType_Float, 1},
+	{"float", kParamType_Float, 1},
+	{"float", kParamType_Float, 1},
+	{"float", kParamType_Float, 1},
+	{"float", kParamType_Float, 1},
+	{"float", kParamType_Float, 1}
+};
+
+static ParamInfo kParams_RegisterLog[3] =
+{
+	{"logName", kParamType_String, 0},
+	{"mode", kParamType_Integer, 0},
+	{"compress", kParamType_Integer, 1}
+};
+
+static ParamInfo kParams_ReadFromLog[1] =
+{
+	{"logName", kParamType_String, 0}
+};
+
+static ParamInfo kParams_SetLogRotation[5] =
+{
+	{"logName", kParamType_String, 0},
+	{"maxBytes", kParamType_Integer, 0},
+	{"maxLines", kParamType_Integer, 0},
+	{"maxGenerations", kParamType_Integer, 0},
+	{"compressOld", kParamType_Integer, 1}
+};
+
+static ParamInfo kParams_UnregisterLog[3] =
+{
 	{"logName", kParamType_String, 0},
 	{"flush", kParamType_Integer, 1},
 	{"saveIndex", kParamType_Integer, 1}
@@ -295,7 +932,7 @@ CommandInfo kCommandInfo_RegisterLog =
 	0,
 	"Register a log file for reading or writing",
 	0,
-	2, kParams_RegisterLog,
+	3, kParams_RegisterLog,
 	Cmd_RegisterLog_Execute
 };
 
@@ -319,6 +956,26 @@ CommandInfo kCommandInfo_UnregisterLog =
 	Cmd_UnregisterLog_Execute
 };
 
+CommandInfo kCommandInfo_SetLogRotation =
+{
+	"SetLogRotation", "",
+	0,
+	"Set size/line limits and number of kept generations for a registered log",
+	0,
+	5, kParams_SetLogRotation,
+	Cmd_SetLogRotation_Execute
+};
+
+CommandInfo kCommandInfo_ReadFromLogHistory =
+{
+	"ReadFromLogHistory", "",
+	0,
+	"Read all lines from every generation of a registered log, oldest first",
+	0,
+	1, kParams_ReadFromLog,
+	Cmd_ReadFromLogHistory_Execute
+};
+
 // ===== VARLA MODULE IMPLEMENTATION =====
 // For Oblivion Remastered - Simple file I/O without register/unregister
 
@@ -328,6 +985,7 @@ CommandInfo kCommandInfo_UnregisterLog =
  * Writes or appends content to a file in My Documents\My Games\Oblivion\
  * Automatically creates the file if it doesn't exist
  * Appends a newline after the content
+ * If a transaction is open on the file (VarlaBeginFile), the line is buffered instead
  */
 bool Cmd_VarlaWriteToFile_Execute(COMMAND_ARGS)
 {
@@ -345,6 +1003,30 @@ bool Cmd_VarlaWriteToFile_Execute(COMMAND_ARGS)
 
 		std::string fullPath = logDir + std::string(fileName);
 
+		// Inside a transaction, buffer the line until VarlaCommitFile
+		auto transaction = g_fileTransactions.find(TransactionKey(fullPath));
+		if (transaction != g_fileTransactions.end())
+		{
+			transaction->second.buffer += content;
+			transaction->second.buffer += '\n';
+			return true;
+		}
+
+		// Files written compressed (VarlaBeginFile ... compress) get the line as a new block
+		bool isCompressed = false;
+		{
+			FileStream existing;
+			isCompressed = existing.open(fullPath.c_str()) && BlockCompressedReader::isCompressed(&existing);
+		}
+
+		if (isCompressed)
+		{
+			std::string line = std::string(content) + '\n';
+			if (!AppendCompressedBlock(fullPath, line.data(), line.size()))
+				Console_Print("VarlaWriteToFile: Failed to open file: %s", fullPath.c_str());
+			return true;
+		}
+
 		// Open file in append mode
 		std::ofstream file(fullPath, std::ios::out | std::ios::app);
 		if (!file.is_open())
@@ -369,6 +1051,7 @@ bool Cmd_VarlaWriteToFile_Execute(COMMAND_ARGS)
  * syntax: let array = VarlaReadFromFile "filename"
  *
  * Reads all lines from a file in My Documents\My Games\Oblivion\
+ * Compressed files are decompressed transparently
  * Returns an array that can be accessed with ar_Size and indexed with []
  * Returns 0 if the file doesn't exist or can't be opened
  */
@@ -389,8 +1072,8 @@ bool Cmd_VarlaReadFromFile_Execute(COMMAND_ARGS)
 		std::string fullPath = logDir + std::string(fileName);
 
 		// Try to open the file
-		std::ifstream file(fullPath);
-		if (!file.is_open())
+		std::string text;
+		if (!ReadFileText(fullPath, &text))
 		{
 			Console_Print("VarlaReadFromFile: Failed to open file: %s", fullPath.c_str());
 			*result = 0;
@@ -401,12 +1084,7 @@ bool Cmd_VarlaReadFromFile_Execute(COMMAND_ARGS)
 		u32 arrayID = g_nextArrayID++;
 		OBSEArray& arr = g_arrayStorage[arrayID];
 
-		std::string line;
-		while (std::getline(file, line))
-		{
-			arr.lines.push_back(line);
-		}
-		file.close();
+		SplitLines(text, arr.lines);
 
 		#if _DEBUG
 		Console_Print("VarlaReadFromFile: Read %d lines from '%s'", (int)arr.lines.size(), fileName);
@@ -419,6 +1097,131 @@ bool Cmd_VarlaReadFromFile_Execute(COMMAND_ARGS)
 	return true;
 }
 
+/* VarlaBeginFile - Start a transaction on a file
+ * syntax: VarlaBeginFile "filename" [append] [compress]
+ *
+ * Subsequent VarlaWriteToFile calls on the same file are buffered in memory, however the name is spelled
+ * Nothing touches the file until VarlaCommitFile, so a crash or reload mid-export leaves the old file intact
+ * append: keep the existing contents and add the buffered lines after them (default 0 = replace the file)
+ * compress: write the file as compressed blocks, VarlaReadFromFile reads it back transparently
+ * Calling this again on a file with an open transaction discards the pending writes
+ */
+bool Cmd_VarlaBeginFile_Execute(COMMAND_ARGS)
+{
+	char fileName[256];
+	u32 append = 0;
+	u32 compress = 0;
+
+	*result = 0;
+
+	if (ExtractArgs(EXTRACT_ARGS, &fileName, &append, &compress))
+	{
+		std::string logDir = GetLogDirectory();
+		if (logDir.empty())
+		{
+			Console_Print("VarlaBeginFile: Failed to get log directory");
+			return true;
+		}
+
+		std::string fullPath = logDir + std::string(fileName);
+
+		FileTransaction& transaction = g_fileTransactions[TransactionKey(fullPath)];
+		transaction.fullPath = fullPath;
+		transaction.buffer.clear();
+		transaction.append = append != 0;
+		transaction.compress = compress != 0;
+
+		*result = 1;
+	}
+
+	return true;
+}
+
+/* VarlaCommitFile - Write out a transaction started with VarlaBeginFile
+ * syntax: VarlaCommitFile "filename"
+ *
+ * The buffered lines are written to a temporary file with one write, flushed to disk,
+ * then renamed over the target file. Returns 1 on success, 0 on failure
+ * The transaction is closed either way
+ */
+bool Cmd_VarlaCommitFile_Execute(COMMAND_ARGS)
+{
+	char fileName[256];
+
+	*result = 0;
+
+	if (ExtractArgs(EXTRACT_ARGS, &fileName))
+	{
+		auto it = g_fileTransactions.find(TransactionKey(GetLogDirectory() + std::string(fileName)));
+		if (it == g_fileTransactions.end())
+		{
+			Console_Print("VarlaCommitFile: No transaction open on '%s'", fileName);
+			return true;
+		}
+
+		FileTransaction& transaction = it->second;
+
+		std::string data;
+
+		// existing contents are decoded and rewritten, so appending can also switch the file's format
+		if (transaction.append)
+			ReadFileText(transaction.fullPath, &data);
+
+		data += transaction.buffer;
+
+		if (transaction.compress)
+		{
+			size_t numBlocks = (data.size() / BlockCompressedWriter::kDefaultBlockSize) + 1;
+			std::vector<u8> compressed(12 + (numBlocks * (12 + 16)) + lzCompressBound(data.size()));
+
+			BufferStream stream;
+			stream.attach(compressed.data(), compressed.size());
+
+			{
+				BlockCompressedWriter writer(&stream);
+				writer.writeHeader();
+				writer.write(data.data(), data.size());
+			}
+
+			data.assign((const char*)compressed.data(), size_t(stream.offset()));
+		}
+
+		if (FileStream::replaceFile(transaction.fullPath.c_str(), data.data(), data.size()))
+		{
+			*result = 1;
+
+			#if _DEBUG
+			Console_Print("VarlaCommitFile: Wrote %d bytes to '%s'", (int)data.size(), fileName);
+			#endif
+		}
+		else
+		{
+			Console_Print("VarlaCommitFile: Failed to write file: %s", transaction.fullPath.c_str());
+		}
+
+		g_fileTransactions.erase(it);
+	}
+
+	return true;
+}
+
+/* VarlaAbortFile - Discard a transaction started with VarlaBeginFile
+ * syntax: VarlaAbortFile "filename"
+ *
+ * Drops all buffered lines, the file on disk is left untouched
+ */
+bool Cmd_VarlaAbortFile_Execute(COMMAND_ARGS)
+{
+	char fileName[256];
+
+	if (ExtractArgs(EXTRACT_ARGS, &fileName))
+	{
+		g_fileTransactions.erase(TransactionKey(GetLogDirectory() + std::string(fileName)));
+	}
+
+	return true;
+}
+
 // Parameter definitions for varla commands
 static ParamInfo kParams_VarlaWriteToFile[2] =
 {
@@ -431,6 +1234,13 @@ static ParamInfo kParams_VarlaReadFromFile[1] =
 	{"filename", kParamType_String, 0}
 };
 
+static ParamInfo kParams_VarlaBeginFile[3] =
+{
+	{"filename", kParamType_String, 0},
+	{"append", kParamType_Integer, 1},
+	{"compress", kParamType_Integer, 1}
+};
+
 // Command info structures for varla commands
 CommandInfo kCommandInfo_VarlaWriteToFile =
 {
@@ -451,3 +1261,705 @@ CommandInfo kCommandInfo_VarlaReadFromFile =
 	1, kParams_VarlaReadFromFile,
 	Cmd_VarlaReadFromFile_Execute
 };
+
+CommandInfo kCommandInfo_VarlaBeginFile =
+{
+	"VarlaBeginFile", "",
+	0,
+	"Start buffering writes to a file until VarlaCommitFile (Varla module for Oblivion Remastered)",
+	0,
+	3, kParams_VarlaBeginFile,
+	Cmd_VarlaBeginFile_Execute
+};
+
+CommandInfo kCommandInfo_VarlaCommitFile =
+{
+	"VarlaCommitFile", "",
+	0,
+	"Atomically write out buffered writes to a file (Varla module for Oblivion Remastered)",
+	0,
+	1, kParams_VarlaReadFromFile,
+	Cmd_VarlaCommitFile_Execute
+};
+
+CommandInfo kCommandInfo_VarlaAbortFile =
+{
+	"VarlaAbortFile", "",
+	0,
+	"Discard buffered writes to a file (Varla module for Oblivion Remastered)",
+	0,
+	1, kParams_VarlaReadFromFile,
+	Cmd_VarlaAbortFile_Execute
+};
+
+// ===== JSON IMPORT/EXPORT =====
+// JSON arrays become arrays (lines), objects become maps (stringMap), nested values become nested array IDs
+
+// Builds arrays while the reader walks the document
+class JsonArrayBuilder : public JsonHandler
+{
+public:
+	u32 GetRoot() const { return m_root; }
+	const char* GetError() const { return m_error; }
+
+	// drops everything built so far, used when the document turns out to be malformed
+	void Discard()
+	{
+		for (u32 id : m_created)
+			g_arrayStorage.erase(id);
+
+		m_created.clear();
+		m_root = 0;
+	}
+
+	bool onNull() override { return Add("", 0, kArrayElem_Null); }
+	bool onBool(bool value) override { return Add(value ? "1" : "0", 1, kArrayElem_Bool); }
+	bool onNumber(const char* text, size_t len, double value) override { return Add(text, len, kArrayElem_Number); }
+	bool onString(const char* str, size_t len) override { return Add(str, len, kArrayElem_String); }
+
+	bool onKey(const char* str, size_t len) override
+	{
+		m_key.assign(str, len);
+		return true;
+	}
+
+	bool onBeginObject() override { return Begin(true); }
+	bool onEndObject() override { m_open.pop_back(); return true; }
+	bool onBeginArray() override { return Begin(false); }
+	bool onEndArray() override { m_open.pop_back(); return true; }
+
+private:
+	bool Add(const char* str, size_t len, u8 type)
+	{
+		// arrays can't hold a bare value
+		if (m_open.empty())
+		{
+			m_error = "top level must be an object or array";
+			return false;
+		}
+
+		OBSEArray& arr = *m_open.back();
+
+		if (arr.isMap)
+		{
+			arr.stringMap[m_key].assign(str, len);
+
+			if (type != kArrayElem_String)
+				arr.keyTypes[m_key] = type;
+			else
+				arr.keyTypes.erase(m_key);
+		}
+		else
+		{
+			arr.lines.emplace_back(str, len);
+
+			if (type != kArrayElem_String)
+			{
+				arr.lineTypes.resize(arr.lines.size());
+				arr.lineTypes.back() = type;
+			}
+		}
+
+		return true;
+	}
+
+	bool Begin(bool isMap)
+	{
+		u32 arrayID = g_nextArrayID++;
+
+		if (!m_open.empty())
+		{
+			std::string idText = std::to_string(arrayID);
+			Add(idText.data(), idText.size(), kArrayElem_Array);
+		}
+		else
+		{
+			m_root = arrayID;
+		}
+
+		OBSEArray& arr = g_arrayStorage[arrayID];
+		arr.isMap = isMap;
+
+		m_created.push_back(arrayID);
+		m_open.push_back(&arr);
+
+		return true;
+	}
+
+	std::vector<OBSEArray*> m_open;		// g_arrayStorage is a map, so these stay valid
+	std::vector<u32> m_created;
+	std::string m_key;
+	u32 m_root = 0;
+	const char* m_error = nullptr;
+};
+
+static u32 ImportJSON(const std::string& text, const char* commandName)
+{
+	JsonArrayBuilder builder;
+	JsonReader reader;
+
+	if (!reader.parse(text.data(), text.size(), &builder))
+	{
+		builder.Discard();
+
+		Console_Print("%s: %s at line %d, column %d", commandName,
+			builder.GetError() ? builder.GetError() : reader.errorMessage(),
+			reader.errorLine(), reader.errorColumn());
+
+		return 0;
+	}
+
+	return builder.GetRoot();
+}
+
+static void WriteArrayElement(JsonWriter& writer, const std::string& value, u8 type, std::vector<u32>& path);
+
+static void WriteArrayJSON(JsonWriter& writer, u32 arrayID, std::vector<u32>& path)
+{
+	auto it = g_arrayStorage.find(arrayID);
+
+	// missing, or an array that contains itself
+	if (it == g_arrayStorage.end() || std::find(path.begin(), path.end(), arrayID) != path.end() || path.size() >= JsonReader::kMaxDepth)
+	{
+		writer.null();
+		return;
+	}
+
+	const OBSEArray& arr = it->second;
+
+	path.push_back(arrayID);
+
+	if (arr.isMap || !arr.stringMap.empty() || !arr.intMap.empty())
+	{
+		writer.beginObject();
+
+		for (auto& entry : arr.stringMap)
+		{
+			writer.key(entry.first);
+			WriteArrayElement(writer, entry.second, arr.GetKeyType(entry.first), path);
+		}
+
+		for (auto& entry : arr.intMap)
+		{
+			writer.key(std::to_string(entry.first));
+			writer.string(entry.second);
+		}
+
+		writer.endObject();
+	}
+	else
+	{
+		writer.beginArray();
+
+		for (u32 i = 0; i < arr.lines.size(); i++)
+			WriteArrayElement(writer, arr.lines[i], arr.GetLineType(i), path);
+
+		writer.endArray();
+	}
+
+	path.pop_back();
+}
+
+static void WriteArrayElement(JsonWriter& writer, const std::string& value, u8 type, std::vector<u32>& path)
+{
+	switch (type)
+	{
+		case kArrayElem_Number:
+			writer.numberText(value.data(), value.size());
+			break;
+
+		case kArrayElem_Bool:
+			writer.boolean(value == "1");
+			break;
+
+		case kArrayElem_Null:
+			writer.null();
+			break;
+
+		case kArrayElem_Array:
+			WriteArrayJSON(writer, strtoul(value.c_str(), nullptr, 10), path);
+			break;
+
+		default:
+			writer.string(value);
+			break;
+	}
+}
+
+static std::string ExportJSON(u32 arrayID, bool pretty)
+{
+	std::string json;
+	std::vector<u32> path;
+
+	JsonWriter writer(&json, pretty);
+	WriteArrayJSON(writer, arrayID, path);
+
+	if (pretty)
+		json += "\n";
+
+	return json;
+}
+
+/* ar_ExportJSON - Write an array to a JSON file
+ * syntax: ar_ExportJSON array "filename" [pretty]
+ *
+ * Writes to My Documents\My Games\Oblivion Remastered\, replacing the file atomically
+ * Arrays are written as JSON arrays, maps as JSON objects, nested arrays are followed
+ * Returns 1 on success
+ */
+bool Cmd_ar_ExportJSON_Execute(COMMAND_ARGS)
+{
+	float arrayID = 0;
+	char fileName[256];
+	u32 pretty = 0;
+
+	*result = 0;
+
+	if (ExtractArgs(EXTRACT_ARGS, &arrayID, &fileName, &pretty))
+	{
+		if (g_arrayStorage.find(u32(arrayID)) == g_arrayStorage.end())
+		{
+			Console_Print("ar_ExportJSON: Invalid array");
+			return true;
+		}
+
+		std::string logDir = GetLogDirectory();
+		if (logDir.empty())
+		{
+			Console_Print("ar_ExportJSON: Failed to get log directory");
+			return true;
+		}
+
+		std::string fullPath = logDir + std::string(fileName);
+		std::string json = ExportJSON(u32(arrayID), pretty != 0);
+
+		if (!FileStream::replaceFile(fullPath.c_str(), json.data(), json.size()))
+		{
+			Console_Print("ar_ExportJSON: Failed to write %s", fullPath.c_str());
+			return true;
+		}
+
+		*result = 1;
+	}
+
+	return true;
+}
+
+/* ar_ImportJSON - Read a JSON file in to an array
+ * syntax: let array = ar_ImportJSON "filename"
+ *
+ * The file must hold a JSON object or array; compressed files are read transparently
+ * Numbers, booleans (1/0) and null ("") are stored as strings, nested values as nested arrays
+ * Returns the array ID, or 0 if the file is missing or malformed
+ */
+bool Cmd_ar_ImportJSON_Execute(COMMAND_ARGS)
+{
+	char fileName[256];
+
+	*result = 0;
+
+	if (ExtractArgs(EXTRACT_ARGS, &fileName))
+	{
+		std::string logDir = GetLogDirectory();
+		if (logDir.empty())
+		{
+			Console_Print("ar_ImportJSON: Failed to get log directory");
+			return true;
+		}
+
+		std::string fullPath = logDir + std::string(fileName);
+		std::string text;
+
+		if (!ReadFileText(fullPath, &text))
+		{
+			Console_Print("ar_ImportJSON: Failed to open %s", fullPath.c_str());
+			return true;
+		}
+
+		*result = ImportJSON(text, "ar_ImportJSON");
+	}
+
+	return true;
+}
+
+/* ar_ToJSON - Convert an array to a JSON string
+ * syntax: let str = ar_ToJSON array
+ *
+ * Same format as ar_ExportJSON, compact
+ * String variables hold at most 16383 characters; longer JSON is an error (returns 0), use ar_ExportJSON instead
+ */
+bool Cmd_ar_ToJSON_Execute(COMMAND_ARGS)
+{
+	float arrayID = 0;
+
+	*result = 0;
+
+	if (ExtractArgs(EXTRACT_ARGS, &arrayID))
+	{
+		std::string json = ExportJSON(u32(arrayID), false);
+
+		if (json.size() >= kMaxStringVarLength)
+		{
+			Console_Print("ar_ToJSON: JSON is %u characters, string variables hold at most %u", u32(json.size()), kMaxStringVarLength - 1);
+			return true;
+		}
+
+		AssignToStringVar(const_cast<ParamInfo*>(paramInfo), (void*)scriptData, thisObj, containingObj, script, nullptr, result, opcodeOffsetPtr, json.c_str());
+	}
+
+	return true;
+}
+
+/* ar_FromJSON - Parse a JSON string in to an array
+ * syntax: let array = ar_FromJSON "json"
+ *
+ * Same conversion as ar_ImportJSON
+ * The string can be at most 16383 characters, same as a string variable; longer input is an error, use ar_ImportJSON instead
+ * Returns the array ID, or 0 if the string is malformed or too long
+ */
+bool Cmd_ar_FromJSON_Execute(COMMAND_ARGS)
+{
+	// one extra character so a string that filled the buffer can be told apart from one that fit
+	char json[kMaxStringVarLength + 1];
+
+	*result = 0;
+
+	if (ExtractArgs(EXTRACT_ARGS, &json))
+	{
+		if (strlen(json) >= kMaxStringVarLength)
+		{
+			Console_Print("ar_FromJSON: JSON is longer than %u characters", kMaxStringVarLength - 1);
+			return true;
+		}
+
+		*result = ImportJSON(json, "ar_FromJSON");
+	}
+
+	return true;
+}
+
+static ParamInfo kParams_ar_ExportJSON[3] =
+{
+	{"array", kParamType_Float, 0},
+	{"fileName", kParamType_String, 0},
+	{"pretty", kParamType_Integer, 1}
+};
+
+static ParamInfo kParams_ar_ToJSON[1] =
+{
+	{"array", kParamType_Float, 0}
+};
+
+static ParamInfo kParams_ar_FromJSON[1] =
+{
+	{"json", kParamType_String, 0}
+};
+
+CommandInfo kCommandInfo_ar_ExportJSON =
+{
+	"ar_ExportJSON", "",
+	0,
+	"Write an array to a JSON file",
+	0,
+	3, kParams_ar_ExportJSON,
+	Cmd_ar_ExportJSON_Execute
+};
+
+CommandInfo kCommandInfo_ar_ImportJSON =
+{
+	"ar_ImportJSON", "",
+	0,
+	"Read a JSON file in to an array",
+	0,
+	1, kParams_VarlaReadFromFile,
+	Cmd_ar_ImportJSON_Execute
+};
+
+CommandInfo kCommandInfo_ar_ToJSON =
+{
+	"ar_ToJSON", "",
+	0,
+	"Convert an array to a JSON string",
+	0,
+	1, kParams_ar_ToJSON,
+	Cmd_ar_ToJSON_Execute
+};
+
+CommandInfo kCommandInfo_ar_FromJSON =
+{
+	"ar_FromJSON", "",
+	0,
+	"Parse a JSON string in to an array",
+	0,
+	1, kParams_ar_FromJSON,
+	Cmd_ar_FromJSON_Execute
+};
+
+// ===== KEY/VALUE STORE =====
+// Persistent settings without rescanning a whole file on every read, see KeyValueStore
+
+// opened on first use and kept open, keyed by the filename passed from the script
+static std::map<std::string, std::unique_ptr<KeyValueStore>> g_kvStores;
+
+static KeyValueStore* GetKVStore(const char* fileName, const char* commandName)
+{
+	auto it = g_kvStores.find(fileName);
+	if (it != g_kvStores.end())
+		return it->second.get();
+
+	std::string logDir = GetLogDirectory();
+	if (logDir.empty())
+	{
+		Console_Print("%s: Failed to get log directory", commandName);
+		return nullptr;
+	}
+
+	std::string fullPath = logDir + std::string(fileName);
+
+	auto store = std::make_unique<KeyValueStore>();
+	if (!store->open(fullPath.c_str()))
+	{
+		Console_Print("%s: Failed to open %s", commandName, fullPath.c_str());
+		return nullptr;
+	}
+
+	KeyValueStore* result = store.get();
+	g_kvStores[fileName] = std::move(store);
+
+	return result;
+}
+
+/* KVSet - Store a value
+ * syntax: KVSet "filename" "key" "value"
+ *
+ * The store lives in My Documents\My Games\Oblivion Remastered\ and is created if it doesn't exist
+ * The value is on disk when the command returns
+ * Returns 1 on success
+ */
+bool Cmd_KVSet_Execute(COMMAND_ARGS)
+{
+	char fileName[256];
+	char key[256];
+	char value[BUFSIZ];
+
+	*result = 0;
+
+	if (ExtractArgs(EXTRACT_ARGS, &fileName, &key, &value))
+	{
+		KeyValueStore* store = GetKVStore(fileName, "KVSet");
+		if (!store)
+			return true;
+
+		if (store->set(key, value))
+			*result = 1;
+		else
+			Console_Print("KVSet: Failed to write to %s", fileName);
+	}
+
+	return true;
+}
+
+/* KVGet - Look up a value
+ * syntax: let str = KVGet "filename" "key"
+ *
+ * Returns an empty string if the key isn't set, use KVHas to tell the two apart
+ */
+bool Cmd_KVGet_Execute(COMMAND_ARGS)
+{
+	char fileName[256];
+	char key[256];
+
+	*result = 0;
+
+	if (ExtractArgs(EXTRACT_ARGS, &fileName, &key))
+	{
+		std::string value;
+
+		KeyValueStore* store = GetKVStore(fileName, "KVGet");
+		if (store)
+			store->get(key, &value);
+
+		AssignToStringVar(const_cast<ParamInfo*>(paramInfo), (void*)scriptData, thisObj, containingObj, script, nullptr, result, opcodeOffsetPtr, value.c_str());
+	}
+
+	return true;
+}
+
+/* KVHas - Check if a key is set
+ * syntax: let exists = KVHas "filename" "key"
+ */
+bool Cmd_KVHas_Execute(COMMAND_ARGS)
+{
+	char fileName[256];
+	char key[256];
+
+	*result = 0;
+
+	if (ExtractArgs(EXTRACT_ARGS, &fileName, &key))
+	{
+		KeyValueStore* store = GetKVStore(fileName, "KVHas");
+		if (store && store->has(key))
+			*result = 1;
+	}
+
+	return true;
+}
+
+/* KVDelete - Remove a key
+ * syntax: KVDelete "filename" "key"
+ *
+ * Returns 1 if the key existed
+ */
+bool Cmd_KVDelete_Execute(COMMAND_ARGS)
+{
+	char fileName[256];
+	char key[256];
+
+	*result = 0;
+
+	if (ExtractArgs(EXTRACT_ARGS, &fileName, &key))
+	{
+		KeyValueStore* store = GetKVStore(fileName, "KVDelete");
+		if (store && store->remove(key))
+			*result = 1;
+	}
+
+	return true;
+}
+
+/* KVKeys - List all keys
+ * syntax: let array = KVKeys "filename"
+ *
+ * Returns an array of keys in sorted order
+ */
+bool Cmd_KVKeys_Execute(COMMAND_ARGS)
+{
+	char fileName[256];
+
+	*result = 0;
+
+	if (ExtractArgs(EXTRACT_ARGS, &fileName))
+	{
+		KeyValueStore* store = GetKVStore(fileName, "KVKeys");
+		if (!store)
+			return true;
+
+		u32 arrayID = g_nextArrayID++;
+		OBSEArray& arr = g_arrayStorage[arrayID];
+
+		store->keys(&arr.lines);
+		std::sort(arr.lines.begin(), arr.lines.end());
+
+		*result = arrayID;
+	}
+
+	return true;
+}
+
+/* KVCompact - Rewrite a store without its overwritten and deleted values
+ * syntax: KVCompact "filename"
+ *
+ * Happens automatically once the stale data outweighs the live data, this forces it
+ * Returns 1 on success
+ */
+bool Cmd_KVCompact_Execute(COMMAND_ARGS)
+{
+	char fileName[256];
+
+	*result = 0;
+
+	if (ExtractArgs(EXTRACT_ARGS, &fileName))
+	{
+		KeyValueStore* store = GetKVStore(fileName, "KVCompact");
+		if (!store)
+			return true;
+
+		if (store->compact())
+		{
+			*result = 1;
+		}
+		else
+		{
+			Console_Print("KVCompact: Failed to compact %s", fileName);
+
+			// the store may have been closed, let the next command reopen it
+			if (!store->isOpen())
+				g_kvStores.erase(fileName);
+		}
+	}
+
+	return true;
+}
+
+static ParamInfo kParams_KVSet[3] =
+{
+	{"fileName", kParamType_String, 0},
+	{"key", kParamType_String, 0},
+	{"value", kParamType_String, 0}
+};
+
+static ParamInfo kParams_KVKey[2] =
+{
+	{"fileName", kParamType_String, 0},
+	{"key", kParamType_String, 0}
+};
+
+CommandInfo kCommandInfo_KVSet =
+{
+	"KVSet", "",
+	0,
+	"Store a value in a persistent key/value file",
+	0,
+	3, kParams_KVSet,
+	Cmd_KVSet_Execute
+};
+
+CommandInfo kCommandInfo_KVGet =
+{
+	"KVGet", "",
+	0,
+	"Look up a value in a persistent key/value file",
+	0,
+	2, kParams_KVKey,
+	Cmd_KVGet_Execute
+};
+
+CommandInfo kCommandInfo_KVHas =
+{
+	"KVHas", "",
+	0,
+	"Check if a key is set in a persistent key/value file",
+	0,
+	2, kParams_KVKey,
+	Cmd_KVHas_Execute
+};
+
+CommandInfo kCommandInfo_KVDelete =
+{
+	"KVDelete", "",
+	0,
+	"Remove a key from a persistent key/value file",
+	0,
+	2, kParams_KVKey,
+	Cmd_KVDelete_Execute
+};
+
+CommandInfo kCommandInfo_KVKeys =
+{
+	"KVKeys", "",
+	0,
+	"List the keys in a persistent key/value file",
+	0,
+	1, kParams_VarlaReadFromFile,
+	Cmd_KVKeys_Execute
+};
+
+CommandInfo kCommandInfo_KVCompact =
+{
+	"KVCompact", "",
+	0,
+	"Rewrite a persistent key/value file without stale values",
+	0,
+	1, kParams_VarlaReadFromFile,
+	Cmd_KVCompact_Execute
+};
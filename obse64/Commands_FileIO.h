@@ -2,12 +2,34 @@
 
 #include "GameScript.h"
 
+// called every frame on the game thread, writes out lines compressed logs have buffered for too long
+void FlushCompressedLogs();
+
 // Command info declarations
 extern CommandInfo kCommandInfo_PrintC;
 extern CommandInfo kCommandInfo_RegisterLog;
 extern CommandInfo kCommandInfo_ReadFromLog;
 extern CommandInfo kCommandInfo_UnregisterLog;
+extern CommandInfo kCommandInfo_SetLogRotation;
+extern CommandInfo kCommandInfo_ReadFromLogHistory;
 
 // Varla module commands (for Oblivion Remastered)
 extern CommandInfo kCommandInfo_VarlaWriteToFile;
 extern CommandInfo kCommandInfo_VarlaReadFromFile;
+extern CommandInfo kCommandInfo_VarlaBeginFile;
+extern CommandInfo kCommandInfo_VarlaCommitFile;
+extern CommandInfo kCommandInfo_VarlaAbortFile;
+
+// JSON import/export for arrays
+extern CommandInfo kCommandInfo_ar_ExportJSON;
+extern CommandInfo kCommandInfo_ar_ImportJSON;
+extern CommandInfo kCommandInfo_ar_ToJSON;
+extern CommandInfo kCommandInfo_ar_FromJSON;
+
+// Persistent key/value store
+extern CommandInfo kCommandInfo_KVSet;
+extern CommandInfo kCommandInfo_KVGet;
+extern CommandInfo kCommandInfo_KVHas;
+extern CommandInfo kCommandInfo_KVDelete;
+extern CommandInfo kCommandInfo_KVKeys;
+extern CommandInfo kCommandInfo_KVCompact;
@@ -1,5 +1,6 @@
 #include "GameScript.h"
 #include "ParamInfos.h"
+#include "ScriptArgs.h"
 #include <Windows.h>
 
 // the original version of the input commands was sketchy and would not work now with a modern input system
@@ -52,7 +53,7 @@ static bool Cmd_IsKeyPressed_Execute(COMMAND_ARGS)
 	*result = 0;
 	u32 keycode = 0;
 
-	if(!ExtractArgs(EXTRACT_ARGS, &keycode)) return true;
+	if(!ExtractArgsFast(EXTRACT_ARGS, &keycode)) return true;
 	if(GetAsyncKeyState(keycode) & 0x8000) *result = 1;
 
 	return true;
@@ -63,7 +64,7 @@ static bool Cmd_IsKeyPressed2_Execute(COMMAND_ARGS)
 	*result = 0;
 	u32 keycode = 0;
 
-	if(!ExtractArgs(EXTRACT_ARGS, &keycode)) return true;
+	if(!ExtractArgsFast(EXTRACT_ARGS, &keycode)) return true;
 
 	*result = g_InputHook.Get(keycode);
 
@@ -76,7 +77,7 @@ static bool InputHookFn(COMMAND_ARGS)
 	*result = 0;
 	u32 keycode = 0;
 
-	if(!ExtractArgs(EXTRACT_ARGS, &keycode)) return true;
+	if(!ExtractArgsFast(EXTRACT_ARGS, &keycode)) return true;
 
 	(g_InputHook.*Fn)(keycode);
 
@@ -1,21 +1,58 @@
 #include "GameScript.h"
 #include "ParamInfos.h"
+#include "ScriptArgs.h"
+#include "Hooks_Script.h"
+#include "ResultCache.h"
 #include "MersenneTwister.h"
+#include <cstring>
 
 static const float kPi = 3.1415926535897932384626433832795f;
 static const float kDegToRad = kPi / 180.0f;
 static const float kRadToDeg = 180.0f / kPi;
 
+// result cache keys, the raw bits of the arguments
+static u64 ArgBits(float arg)
+{
+	u32 bits;
+	memcpy(&bits, &arg, sizeof(bits));
+
+	return bits;
+}
+
+static u64 ArgBits(float arg1, float arg2)
+{
+	return (ArgBits(arg1) << 32) | ArgBits(arg2);
+}
+
+// commands added with kCmdFlag_Pure have a cache, the others always compute
+template <typename Compute>
+static double CachedResult(ResultCache * cache, u64 key, Compute compute)
+{
+	double value;
+
+	if(cache && cache->lookup(key, &value))
+		return value;
+
+	value = compute();
+
+	if(cache)
+		cache->store(key, value);
+
+	return value;
+}
+
 template <float (* Fn)(float)>
 bool UnaryMathFn(COMMAND_ARGS)
 {
 	*result = 0;
 
+	ResultCache * cache = GetResultCache(scriptData, opcodeOffsetPtr, UnaryMathFn <Fn>);
+
 	float arg = 0;
-	if(!ExtractArgs(EXTRACT_ARGS, &arg))
+	if(!ExtractArgsFast(EXTRACT_ARGS, &arg))
 		return true;
 
-	*result = Fn(arg);
+	*result = CachedResult(cache, ArgBits(arg), [arg] { return Fn(arg); });
 
 	return true;
 }
@@ -26,11 +63,13 @@ bool UnaryMathFn_DegToRad(COMMAND_ARGS)
 {
 	*result = 0;
 
+	ResultCache * cache = GetResultCache(scriptData, opcodeOffsetPtr, UnaryMathFn_DegToRad <Fn>);
+
 	float arg = 0;
-	if(!ExtractArgs(EXTRACT_ARGS, &arg))
+	if(!ExtractArgsFast(EXTRACT_ARGS, &arg))
 		return true;
 
-	*result = Fn(arg * kDegToRad);
+	*result = CachedResult(cache, ArgBits(arg), [arg] { return Fn(arg * kDegToRad); });
 
 	return true;
 }
@@ -41,11 +80,13 @@ bool UnaryMathFn_RadToDeg(COMMAND_ARGS)
 {
 	*result = 0;
 
+	ResultCache * cache = GetResultCache(scriptData, opcodeOffsetPtr, UnaryMathFn_RadToDeg <Fn>);
+
 	float arg = 0;
-	if(!ExtractArgs(EXTRACT_ARGS, &arg))
+	if(!ExtractArgsFast(EXTRACT_ARGS, &arg))
 		return true;
 
-	*result = Fn(arg) * kRadToDeg;
+	*result = CachedResult(cache, ArgBits(arg), [arg] { return Fn(arg) * kRadToDeg; });
 
 	return true;
 }
@@ -55,11 +96,13 @@ bool BinaryMathFn(COMMAND_ARGS)
 {
 	*result = 0;
 
+	ResultCache * cache = GetResultCache(scriptData, opcodeOffsetPtr, BinaryMathFn <Fn>);
+
 	float arg1 = 0, arg2 = 0;
-	if(!ExtractArgs(EXTRACT_ARGS, &arg1, &arg2))
+	if(!ExtractArgsFast(EXTRACT_ARGS, &arg1, &arg2))
 		return true;
 
-	*result = Fn(arg1, arg2);
+	*result = CachedResult(cache, ArgBits(arg1, arg2), [arg1, arg2] { return Fn(arg1, arg2); });
 
 	return true;
 }
@@ -69,11 +112,13 @@ bool BinaryMathFn_RadToDeg(COMMAND_ARGS)
 {
 	*result = 0;
 
+	ResultCache * cache = GetResultCache(scriptData, opcodeOffsetPtr, BinaryMathFn_RadToDeg <Fn>);
+
 	float arg1 = 0, arg2 = 0;
-	if(!ExtractArgs(EXTRACT_ARGS, &arg1, &arg2))
+	if(!ExtractArgsFast(EXTRACT_ARGS, &arg1, &arg2))
 		return true;
 
-	*result = Fn(arg1, arg2) * kRadToDeg;
+	*result = CachedResult(cache, ArgBits(arg1, arg2), [arg1, arg2] { return Fn(arg1, arg2) * kRadToDeg; });
 
 	return true;
 }
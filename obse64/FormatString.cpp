@@ -0,0 +1,337 @@
+#include "FormatString.h"
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+
+enum
+{
+	// scripts that build format strings on the fly would otherwise grow the cache forever
+	kMaxCachedFormats = 1024,
+
+	kMaxPrecision = 99,
+};
+
+static s64 ToInteger(float value)
+{
+	if (value != value)
+		return 0;
+
+	if (value <= -9.2e18f)
+		return INT64_MIN;
+
+	if (value >= 9.2e18f)
+		return INT64_MAX;
+
+	return s64(value);
+}
+
+CompiledFormat::CompiledFormat(const char * fmt)
+:m_source(fmt)
+{
+	const char * p = fmt;
+	const char * literalStart = p;
+	u32 nextArg = 0;
+
+	while (*p)
+	{
+		if (*p != '%')
+		{
+			p++;
+			continue;
+		}
+
+		AddLiteral(literalStart, p - literalStart);
+
+		const char * specStart = p++;
+
+		if (*p == '%')
+		{
+			AddLiteral("%", 1);
+
+			literalStart = ++p;
+			continue;
+		}
+
+		const char * flags = p;
+		while (*p && strchr("-+ #0", *p))
+			p++;
+
+		size_t flagsLen = p - flags;
+
+		const char * width = p;
+		while ((*p >= '0') && (*p <= '9'))
+			p++;
+
+		size_t widthLen = p - width;
+
+		s32 precision = -1;
+		bool unsupported = *p == '*';
+
+		if (*p == '.')
+		{
+			p++;
+			precision = 0;
+
+			unsupported |= *p == '*';
+
+			while ((*p >= '0') && (*p <= '9'))
+			{
+				if (precision < kMaxPrecision)
+					precision = precision * 10 + (*p - '0');
+
+				p++;
+			}
+		}
+
+		// length modifiers are dropped, the argument type follows from the conversion
+		// 'z' is left alone, it's the string variable conversion here
+		for (;;)
+		{
+			if ((*p == 'h') || (*p == 'l') || (*p == 'L'))
+				p++;
+			else if (*p == 'I')
+			{
+				p++;
+				while ((*p >= '0') && (*p <= '9'))
+					p++;
+			}
+			else
+				break;
+		}
+
+		char conversion = *p;
+		u8 type;
+
+		switch (conversion)
+		{
+			case 'd': case 'i':				type = kOp_Int; break;
+			case 'u': case 'x': case 'X': case 'o':	type = kOp_Unsigned; break;
+			case 'c':						type = kOp_Char; break;
+			case 'f': case 'F': case 'e': case 'E':
+			case 'g': case 'G': case 'a': case 'A':	type = kOp_Float; break;
+			case 'z':						type = kOp_StringVar; break;
+			case 'n':						type = kOp_FormName; break;
+			default:						unsupported = true; break;
+		}
+
+		if (unsupported)
+		{
+			if (*p)
+				p++;
+
+			AddLiteral(specStart, p - specStart);
+
+			literalStart = p;
+			continue;
+		}
+
+		p++;
+
+		Op op;
+		op.type = type;
+		op.conversion = conversion;
+		op.argIdx = u8(nextArg < 0xFF ? nextArg++ : 0xFF);
+		op.simple = !flagsLen && !widthLen;
+		op.precision = precision;
+
+		// rebuilt spec for snprintf, without length modifiers and with our own argument type
+		op.offset = u32(m_text.size());
+
+		m_text += '%';
+		m_text.append(flags, flagsLen);
+		m_text.append(width, widthLen);
+
+		if (precision >= 0)
+		{
+			m_text += '.';
+			m_text += std::to_string(precision);
+		}
+
+		m_text += ((type == kOp_StringVar) || (type == kOp_FormName)) ? 's' : conversion;
+
+		op.len = u32(m_text.size() - op.offset);
+		m_text += '\0';
+
+		m_ops.push_back(op);
+
+		literalStart = p;
+	}
+
+	AddLiteral(literalStart, p - literalStart);
+}
+
+void CompiledFormat::AddLiteral(const char * str, size_t len)
+{
+	if (!len)
+		return;
+
+	// extend the previous span if it's at the end of the text
+	if (!m_ops.empty())
+	{
+		Op & last = m_ops.back();
+
+		if ((last.type == kOp_Literal) && (last.offset + last.len == m_text.size()))
+		{
+			m_text.append(str, len);
+			last.len += u32(len);
+
+			return;
+		}
+	}
+
+	Op op = { 0 };
+	op.type = kOp_Literal;
+	op.offset = u32(m_text.size());
+	op.len = u32(len);
+
+	m_text.append(str, len);
+	m_ops.push_back(op);
+}
+
+u32 CompiledFormat::Format(char * buf, u32 bufLen, const float * args, u32 numArgs) const
+{
+	if (!bufLen)
+		return 0;
+
+	char * out = buf;
+	char * end = buf + bufLen - 1;	// leave room for the terminator
+
+	auto append = [&](const char * str, size_t len)
+	{
+		if (len > size_t(end - out))
+			len = end - out;
+
+		memcpy(out, str, len);
+		out += len;
+	};
+
+	// snprintf straight in to the output, it truncates and terminates on its own
+	auto print = [&](const Op & op, auto value)
+	{
+		int written = snprintf(out, (end - out) + 1, m_text.c_str() + op.offset, value);
+
+		if (written > 0)
+			out += (written < end - out) ? written : (end - out);
+	};
+
+	for (const Op & op : m_ops)
+	{
+		if (op.type == kOp_Literal)
+		{
+			append(m_text.data() + op.offset, op.len);
+			continue;
+		}
+
+		float arg = (op.argIdx < numArgs) ? args[op.argIdx] : 0;
+		char tmp[64];
+
+		switch (op.type)
+		{
+			case kOp_Int:
+				if (op.simple && (op.precision < 0))
+				{
+					auto result = std::to_chars(tmp, tmp + sizeof(tmp), s32(ToInteger(arg)));
+					append(tmp, result.ptr - tmp);
+				}
+				else
+				{
+					print(op, s32(ToInteger(arg)));
+				}
+				break;
+
+			case kOp_Unsigned:
+				if (op.simple && (op.precision < 0) && (op.conversion == 'u'))
+				{
+					auto result = std::to_chars(tmp, tmp + sizeof(tmp), u32(ToInteger(arg)));
+					append(tmp, result.ptr - tmp);
+				}
+				else
+				{
+					print(op, u32(ToInteger(arg)));
+				}
+				break;
+
+			case kOp_Char:
+				print(op, int(ToInteger(arg)));
+				break;
+
+			case kOp_Float:
+			{
+				std::chars_format floatFormat;
+				bool fast = op.simple;
+
+				switch (op.conversion)
+				{
+					case 'f':	floatFormat = std::chars_format::fixed; break;
+					case 'e':	floatFormat = std::chars_format::scientific; break;
+					case 'g':	floatFormat = std::chars_format::general; break;
+					default:	fast = false; break;
+				}
+
+				std::to_chars_result result;
+
+				// to_chars with a precision is defined to match printf, and doesn't parse a spec every time
+				// the float overload prints the same digits as the promoted double but is cheaper
+				if (fast)
+					result = std::to_chars(tmp, tmp + sizeof(tmp), arg, floatFormat, (op.precision < 0) ? 6 : op.precision);
+
+				if (fast && (result.ec == std::errc()))
+					append(tmp, result.ptr - tmp);
+				else
+					print(op, double(arg));
+			}
+			break;
+
+			case kOp_StringVar:
+			case kOp_FormName:
+			{
+				u32 id = u32(ToInteger(arg));
+				const char * str = (op.type == kOp_StringVar) ? GetStringVarText(id) : GetFormNameByID(id);
+
+				if (op.simple && (op.precision < 0))
+					append(str, strlen(str));
+				else
+					print(op, str);
+			}
+			break;
+		}
+	}
+
+	*out = 0;
+
+	return u32(out - buf);
+}
+
+static std::unordered_map <std::string_view, std::unique_ptr <CompiledFormat>> s_formatCache;
+
+const CompiledFormat & GetCompiledFormat(const char * fmt)
+{
+	auto iter = s_formatCache.find(std::string_view(fmt));
+	if (iter != s_formatCache.end())
+		return *iter->second;
+
+	if (s_formatCache.size() >= kMaxCachedFormats)
+		s_formatCache.clear();
+
+	// the key points in to the compiled format's own copy of the string
+	auto compiled = std::make_unique <CompiledFormat>(fmt);
+	std::string_view key = compiled->Source();
+
+	auto & entry = s_formatCache[key];
+	entry = std::move(compiled);
+
+	return *entry;
+}
+
+size_t GetCompiledFormatCacheSize()
+{
+	return s_formatCache.size();
+}
+
+u32 FormatScriptString(const char * fmt, const float * args, u32 numArgs, char * buf, u32 bufLen)
+{
+	return GetCompiledFormat(fmt).Format(buf, bufLen, args, numArgs);
+}
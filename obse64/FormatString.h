@@ -0,0 +1,70 @@
+#pragma once
+
+#include "obse64_common/Types.h"
+#include <string>
+#include <vector>
+
+// printf-style format strings for script commands (PrintToConsole, PrintC)
+//
+// each distinct format string is parsed once in to a list of ops and cached, later calls just run the ops
+// supported conversions:
+//	%d %i %u %x %X %o %c	argument converted to an integer
+//	%f %F %e %E %g %G %a %A	argument as a float
+//	%z						contents of the string variable with the ID passed as the argument
+//	%n						name of the form with the form ID passed as the argument
+//	%%						a literal %
+// flags, width and precision work as in printf. anything else (%s, %p, '*' width) is printed as is,
+// since scripts can only pass numbers
+
+class CompiledFormat
+{
+public:
+	explicit CompiledFormat(const char * fmt);
+
+	// always null terminates, output is truncated to fit. returns the length written
+	u32	Format(char * buf, u32 bufLen, const float * args, u32 numArgs) const;
+
+	const std::string &	Source() const { return m_source; }
+
+private:
+	enum
+	{
+		kOp_Literal = 0,
+		kOp_Int,
+		kOp_Unsigned,
+		kOp_Char,
+		kOp_Float,
+		kOp_StringVar,
+		kOp_FormName,
+	};
+
+	struct Op
+	{
+		u8	type;
+		u8	conversion;		// printf conversion character
+		u8	argIdx;
+		u8	simple;			// no flags or width, can skip snprintf
+		s32	precision;		// -1 = default
+		u32	offset;			// literal: in to m_text, otherwise the rebuilt spec for snprintf
+		u32	len;
+	};
+
+	void	AddLiteral(const char * str, size_t len);
+
+	std::string			m_source;
+	std::string			m_text;	// literal spans and null terminated conversion specs
+	std::vector <Op>	m_ops;
+};
+
+// cached, game thread only
+const CompiledFormat & GetCompiledFormat(const char * fmt);
+
+// number of formats in the cache, for tests
+size_t GetCompiledFormatCacheSize();
+
+u32 FormatScriptString(const char * fmt, const float * args, u32 numArgs, char * buf, u32 bufLen);
+
+// what %z and %n print for an ID. defined with the string variables and the forms, so the formatter doesn't
+// depend on the game itself
+const char * GetStringVarText(u32 id);	// "" if there's no such variable
+const char * GetFormNameByID(u32 id);
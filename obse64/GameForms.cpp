@@ -1,4 +1,5 @@
 #include "GameForms.h"
+#include "FormatString.h"
 #include "GameRTTI.h"
 #include "GameObjects.h"
 #include "GameExtraData.h"
@@ -110,6 +111,11 @@ const char * GetFullName(TESForm * baseForm)
 	return "<no name>";
 }
 
+const char * GetFormNameByID(UInt32 id)
+{
+	return GetFullName(LookupFormByID(id));
+}
+
 TESFullName * TESForm::GetFullName()
 {
 	TESForm * form = this;
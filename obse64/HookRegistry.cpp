@@ -0,0 +1,370 @@
+#include "HookRegistry.h"
+#include "obse64_common/BranchTrampoline.h"
+#include "obse64_common/SafeWrite.h"
+#include "obse64_common/Log.h"
+#include "obse64_common/Errors.h"
+#include "xbyak/xbyak.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+HookRegistry g_hookRegistry;
+
+enum
+{
+	kSlotSize = 16,	// jmp [rip+2], 2 bytes padding, target
+
+	kThunkBaseSize = 0x100,
+	kThunkHandlerSize = 0x60,	// the code for one handler is 0x44 bytes, the rest is under 0xC0
+};
+
+HookRegistry::HookRegistry()
+:m_nextID(1)
+{
+	//
+}
+
+HookRegistry::~HookRegistry()
+{
+	//
+}
+
+HookRegistry::Site * HookRegistry::findSite(uintptr_t src)
+{
+	for(Site & site : m_sites)
+		if(site.src == src)
+			return &site;
+
+	return nullptr;
+}
+
+HookRegistry::Site * HookRegistry::claimSite(uintptr_t src)
+{
+	Site * existing = findSite(src);
+	if(existing)
+		return existing;
+
+	const u8 * code = (const u8 *)src;
+	if(code[0] != 0xE8)
+	{
+		_ERROR_C(Hooks, "hook site %016I64X isn't a call (%02X)", src, code[0]);
+		return nullptr;
+	}
+
+	s32 displ;
+	memcpy(&displ, code + 1, sizeof(displ));
+
+	uintptr_t original = src + 5 + displ;
+
+	u8 * slot = (u8 *)g_branchTrampoline.allocate(kSlotSize);
+	if(!slot)
+	{
+		_ERROR_C(Hooks, "couldn't allocate trampoline for hook site %016I64X", src);
+		return nullptr;
+	}
+
+	ptrdiff_t slotDispl = uintptr_t(slot) - (src + 5);
+	if((slotDispl < INT_MIN) || (slotDispl > INT_MAX))
+	{
+		_ERROR_C(Hooks, "trampoline out of range of hook site %016I64X", src);
+		g_branchTrampoline.free(slot, kSlotSize);
+		return nullptr;
+	}
+
+	// jmp [rip+2], skipping the padding so the target is aligned and can be swapped atomically
+	const u8 jump[8] = { 0xFF, 0x25, 0x02, 0x00, 0x00, 0x00, 0xCC, 0xCC };
+	memcpy(slot, jump, sizeof(jump));
+
+	Site site;
+
+	site.src = src;
+	site.original = original;
+	site.replaced = false;
+	site.target = (volatile u64 *)(slot + sizeof(jump));
+
+	*site.target = original;
+
+	safeWrite32(src + 1, u32(s32(slotDispl)));
+
+	m_sites.push_back(site);
+
+	return &m_sites.back();
+}
+
+bool HookRegistry::claim(uintptr_t src, uintptr_t replacement)
+{
+	std::lock_guard <std::mutex> lock(m_lock);
+
+	Site * site = claimSite(src);
+	if(!site)
+		return false;
+
+	if(!replacement)
+		return true;
+
+	if(site->replaced)
+	{
+		_ERROR_C(Hooks, "hook site %016I64X already has a replacement", src);
+		return false;
+	}
+
+	site->original = replacement;
+	site->replaced = true;
+
+	return rebuild(*site);
+}
+
+u32 HookRegistry::add(PluginHandle owner, uintptr_t src, u32 type, s32 priority, uintptr_t handler)
+{
+	if(((type != kType_Pre) && (type != kType_Post)) || !handler)
+		return 0;
+
+	std::lock_guard <std::mutex> lock(m_lock);
+
+	Site * site = claimSite(src);
+	if(!site)
+		return 0;
+
+	// the id is used up even if this fails, it's also the index in m_handlers
+	u32 id = m_nextID++;
+
+	std::unique_ptr <Handler> entry = std::make_unique <Handler>();
+
+	entry->id = id;
+	entry->owner = owner;
+	entry->src = src;
+	entry->type = type;
+	entry->priority = priority;
+	entry->fn = handler;
+	entry->active = handler;
+	entry->removed = false;
+
+	m_handlers.push_back(std::move(entry));
+
+	if(!rebuild(*site))
+	{
+		m_handlers.back()->active = 0;
+		m_handlers.back()->removed = true;
+
+		return 0;
+	}
+
+	_MESSAGE_C(Hooks, "plugin %d added %s hook %d at %016I64X", owner, (type == kType_Pre) ? "pre" : "post", id, src);
+
+	return id;
+}
+
+HookRegistry::Handler * HookRegistry::findHandler(PluginHandle owner, u32 id)
+{
+	// ids are handed out in order and entries are never freed
+	if(!id || (id > m_handlers.size()))
+		return nullptr;
+
+	Handler * handler = m_handlers[id - 1].get();
+
+	if(handler->removed || (handler->owner != owner))
+		return nullptr;
+
+	return handler;
+}
+
+bool HookRegistry::setEnabled(PluginHandle owner, u32 id, bool enable)
+{
+	std::lock_guard <std::mutex> lock(m_lock);
+
+	Handler * handler = findHandler(owner, id);
+	if(!handler)
+		return false;
+
+	handler->active = enable ? handler->fn : 0;
+
+	return true;
+}
+
+bool HookRegistry::remove(PluginHandle owner, u32 id)
+{
+	std::lock_guard <std::mutex> lock(m_lock);
+
+	Handler * handler = findHandler(owner, id);
+	if(!handler)
+		return false;
+
+	handler->active = 0;
+	handler->removed = true;
+
+	Site * site = findSite(handler->src);
+	ASSERT(site);
+
+	// the entry is already disabled if this fails, so the old thunk skips it
+	rebuild(*site);
+
+	return true;
+}
+
+size_t HookRegistry::numSites()
+{
+	std::lock_guard <std::mutex> lock(m_lock);
+
+	return m_sites.size();
+}
+
+// frame layout, keeps rsp 16 byte aligned at each call
+enum
+{
+	kFrame_StackArgs = 0x20,	// copied from the caller for the callees, after their shadow space
+	kFrame_Args = 0x40,			// rcx rdx r8 r9
+	kFrame_FloatArgs = 0x60,	// low qwords of xmm0-3
+	kFrame_Result = 0xA0,		// rax xmm0
+	kFrameSize = 0xB8,
+
+	// frame, return address, caller's shadow space
+	kCallerStackArgs = kFrameSize + 0x08 + 0x20,
+};
+
+static void EmitLoadArgs(Xbyak::CodeGenerator & code)
+{
+	using namespace Xbyak::util;
+
+	code.mov(rcx, ptr[rsp + kFrame_Args + 0x00]);
+	code.mov(rdx, ptr[rsp + kFrame_Args + 0x08]);
+	code.mov(r8, ptr[rsp + kFrame_Args + 0x10]);
+	code.mov(r9, ptr[rsp + kFrame_Args + 0x18]);
+
+	code.movq(xmm0, ptr[rsp + kFrame_FloatArgs + 0x00]);
+	code.movq(xmm1, ptr[rsp + kFrame_FloatArgs + 0x08]);
+	code.movq(xmm2, ptr[rsp + kFrame_FloatArgs + 0x10]);
+	code.movq(xmm3, ptr[rsp + kFrame_FloatArgs + 0x18]);
+}
+
+// skipped when the entry's active pointer is null
+static void EmitHandlerCall(Xbyak::CodeGenerator & code, const volatile uintptr_t * active)
+{
+	using namespace Xbyak::util;
+
+	Xbyak::Label skip;
+
+	code.mov(rax, uintptr_t(active));
+	code.mov(rax, ptr[rax]);
+	code.test(rax, rax);
+	code.jz(skip, Xbyak::CodeGenerator::T_NEAR);
+
+	EmitLoadArgs(code);
+	code.call(rax);
+
+	code.L(skip);
+}
+
+// with no post handlers the original is jumped to instead of called, so it sees the caller's own stack arguments
+static void EmitThunk(Xbyak::CodeGenerator & code, uintptr_t original, const std::vector <const volatile uintptr_t *> & pre, const std::vector <const volatile uintptr_t *> & post)
+{
+	using namespace Xbyak::util;
+
+	code.sub(rsp, kFrameSize);
+
+	code.mov(ptr[rsp + kFrame_Args + 0x00], rcx);
+	code.mov(ptr[rsp + kFrame_Args + 0x08], rdx);
+	code.mov(ptr[rsp + kFrame_Args + 0x10], r8);
+	code.mov(ptr[rsp + kFrame_Args + 0x18], r9);
+
+	code.movq(ptr[rsp + kFrame_FloatArgs + 0x00], xmm0);
+	code.movq(ptr[rsp + kFrame_FloatArgs + 0x08], xmm1);
+	code.movq(ptr[rsp + kFrame_FloatArgs + 0x10], xmm2);
+	code.movq(ptr[rsp + kFrame_FloatArgs + 0x18], xmm3);
+
+	for(int i = 0; i < 4; i++)
+	{
+		code.mov(rax, ptr[rsp + kCallerStackArgs + i * 8]);
+		code.mov(ptr[rsp + kFrame_StackArgs + i * 8], rax);
+	}
+
+	for(auto active : pre)
+		EmitHandlerCall(code, active);
+
+	code.mov(rax, original);
+	EmitLoadArgs(code);
+
+	if(post.empty())
+	{
+		code.add(rsp, kFrameSize);
+		code.jmp(rax);
+
+		return;
+	}
+
+	code.call(rax);
+
+	code.mov(ptr[rsp + kFrame_Result + 0x00], rax);
+	code.movq(ptr[rsp + kFrame_Result + 0x08], xmm0);
+
+	for(auto active : post)
+		EmitHandlerCall(code, active);
+
+	code.mov(rax, ptr[rsp + kFrame_Result + 0x00]);
+	code.movq(xmm0, ptr[rsp + kFrame_Result + 0x08]);
+
+	code.add(rsp, kFrameSize);
+	code.ret();
+}
+
+bool HookRegistry::rebuild(Site & site)
+{
+	std::vector <Handler *> handlers;
+
+	for(auto & handler : m_handlers)
+		if((handler->src == site.src) && !handler->removed)
+			handlers.push_back(handler.get());
+
+	if(handlers.empty())
+	{
+		*site.target = site.original;
+
+		return true;
+	}
+
+	std::stable_sort(handlers.begin(), handlers.end(), [](const Handler * lhs, const Handler * rhs) { return lhs->priority < rhs->priority; });
+
+	std::vector <const volatile uintptr_t *> pre;
+	std::vector <const volatile uintptr_t *> post;
+
+	for(const Handler * handler : handlers)
+		((handler->type == kType_Pre) ? pre : post).push_back(&handler->active);
+
+	std::unique_ptr <Xbyak::CodeGenerator> code;
+
+	try
+	{
+		code = std::make_unique <Xbyak::CodeGenerator>(kThunkBaseSize + handlers.size() * kThunkHandlerSize);
+
+		EmitThunk(*code, site.original, pre, post);
+
+		code->readyRE();
+	}
+	catch(const Xbyak::Error & e)
+	{
+		_ERROR_C(Hooks, "couldn't build hook thunk for %016I64X: %s", site.src, e.what());
+
+		return false;
+	}
+
+	// aligned, so a thread entering the slot sees either the old thunk or the new one
+	*site.target = u64(code->getCode());
+
+	m_code.push_back(std::move(code));
+
+	return true;
+}
+
+u32 AddOBSECallHook(PluginHandle plugin, uintptr_t site, u32 type, s32 priority, void * handler)
+{
+	return g_hookRegistry.add(plugin, site, type, priority, uintptr_t(handler));
+}
+
+bool SetOBSEHookEnabled(PluginHandle plugin, u32 hook, bool enable)
+{
+	return g_hookRegistry.setEnabled(plugin, hook, enable);
+}
+
+bool RemoveOBSEHook(PluginHandle plugin, u32 hook)
+{
+	return g_hookRegistry.remove(plugin, hook);
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "obse64/PluginAPI.h"
+#include "obse64_common/Types.h"
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Xbyak
+{
+	class CodeGenerator;
+}
+
+// shares 5 byte call sites (E8 rel32) between OBSE and any number of plugins, instead of the last write5Call winning
+//
+// the first hook at a site points the call at a slot in the branch trampoline, that's the only time the game's code is
+// patched. the slot jumps to a generated thunk that calls the enabled pre handlers in priority order, then the original
+// target, then the post handlers. handlers take the same arguments as the original and return nothing, the caller gets
+// the original's return value. four register arguments (integer or float) and four on the stack are passed on
+//
+// enabling or disabling a handler only writes its entry in the handler table, the thunk tests it before each call.
+// adding or removing one builds a new thunk and swaps it in to the trampoline slot. old thunks and handler entries are
+// kept since another thread could still be in them. there's no unwind info for the thunks, so exceptions can't be thrown
+// through them
+class HookRegistry
+{
+public:
+	enum
+	{
+		kType_Pre = OBSEHookInterface::kType_Pre,
+		kType_Post = OBSEHookInterface::kType_Post,
+	};
+
+	HookRegistry();
+	~HookRegistry();
+
+	// takes over the call at src. replacement is called instead of the call's current target, for hooks that replace
+	// the call outright. only one replacement per site
+	bool	claim(uintptr_t src, uintptr_t replacement = 0);
+
+	// lower priorities run first, then the order they were added. returns an id, 0 on failure
+	u32		add(PluginHandle owner, uintptr_t src, u32 type, s32 priority, uintptr_t handler);
+
+	bool	setEnabled(PluginHandle owner, u32 id, bool enable);
+	bool	remove(PluginHandle owner, u32 id);
+
+	size_t	numSites();
+
+private:
+	struct Handler
+	{
+		u32			id;
+		PluginHandle	owner;
+		uintptr_t	src;
+		u32			type;
+		s32			priority;
+		uintptr_t	fn;
+
+		volatile uintptr_t	active;	// fn if enabled, read by the thunk
+		bool		removed;
+	};
+
+	struct Site
+	{
+		uintptr_t	src;
+		uintptr_t	original;
+		bool		replaced;
+
+		volatile u64	* target;	// where the trampoline slot jumps, 8 byte aligned
+	};
+
+	Site *		findSite(uintptr_t src);
+	Site *		claimSite(uintptr_t src);
+	Handler *	findHandler(PluginHandle owner, u32 id);
+	bool		rebuild(Site & site);
+
+	std::mutex	m_lock;
+
+	std::vector <Site>		m_sites;
+	std::vector <std::unique_ptr <Handler>>	m_handlers;	// never freed, see above
+	std::vector <std::unique_ptr <Xbyak::CodeGenerator>>	m_code;
+
+	u32		m_nextID;
+};
+
+extern HookRegistry	g_hookRegistry;
+
+// for OBSEHookInterface
+u32 AddOBSECallHook(PluginHandle plugin, uintptr_t site, u32 type, s32 priority, void * handler);
+bool SetOBSEHookEnabled(PluginHandle plugin, u32 hook, bool enable);
+bool RemoveOBSEHook(PluginHandle plugin, u32 hook);
@@ -1,6 +1,6 @@
 #include "Hooks_Data.h"
+#include "HookRegistry.h"
 #include "obse64_common/Relocation.h"
-#include "obse64_common/BranchTrampoline.h"
 #include "GameData.h"
 #include "PluginManager.h"
 
@@ -16,5 +16,5 @@ static void LoadingComplete()
 
 void Hooks_Data_Apply()
 {
-	g_branchTrampoline.write5Call(LoadingComplete_Hook.getUIntPtr(), uintptr_t(&LoadingComplete));
+	g_hookRegistry.claim(LoadingComplete_Hook.getUIntPtr(), uintptr_t(&LoadingComplete));
 }
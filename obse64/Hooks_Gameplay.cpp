@@ -1,5 +1,8 @@
 #include "Hooks_Gameplay.h"
-#include "obse64_common/BranchTrampoline.h"
+#include "HookRegistry.h"
+#include "Commands_FileIO.h"
+#include "PluginManager.h"
+#include "obse64_common/Log.h"
 #include "obse64_common/Relocation.h"
 
 RelocAddr <uintptr_t> OblivionThread_Target(0x065D2070 + 0x1208);
@@ -7,7 +10,11 @@ RelocAddr <uintptr_t> UnrealGameThread_Target(0x03907660 + 0x53);
 
 void OblivionThreadHook(const char * dbgStr)
 {
+	DebugLog::beginFrame();
 
+	PluginManager::deliverQueuedMessages();
+
+	FlushCompressedLogs();
 }
 
 void UnrealGameThreadHook()
@@ -18,8 +25,8 @@ void UnrealGameThreadHook()
 void Hooks_Gameplay_Apply()
 {
 	// replace call to stubbed debug logging function being passed "Oblivion Main loop"
-	g_branchTrampoline.write5Call(OblivionThread_Target.getUIntPtr(), uintptr_t(OblivionThreadHook));
+	g_hookRegistry.claim(OblivionThread_Target.getUIntPtr(), uintptr_t(OblivionThreadHook));
 
 	// replace call to stubbed hitch detection function
-	g_branchTrampoline.write5Call(UnrealGameThread_Target.getUIntPtr(), uintptr_t(UnrealGameThreadHook));
+	g_hookRegistry.claim(UnrealGameThread_Target.getUIntPtr(), uintptr_t(UnrealGameThreadHook));
 }
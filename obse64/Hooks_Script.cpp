@@ -2,15 +2,26 @@
 #include "obse64/GameConsole.h"
 #include "obse64/GameScript.h"
 #include "obse64/CommandTable.h"
-#include "obse64_common/SafeWrite.h"
+#include "obse64/CommandNameIndex.h"
+#include "obse64/ResultCache.h"
 #include "obse64_common/obse64_version.h"
 #include "obse64_common/BranchTrampoline.h"
+#include "obse64_common/CommandTablePatches.h"
+#include "obse64_common/PatchTransaction.h"
 #include "obse64_common/Relocation.h"
 #include "obse64_common/Log.h"
 #include "obse64_common/Errors.h"
+#include "obse64_common/FileStream.h"
+#include "obse64_common/Utilities.h"
 #include "xbyak/xbyak.h"
+#include <algorithm>
+#include <cstring>
+#include <intrin.h>
+#include <memory>
+#include <string>
 #include <vector>
 #include <map>
+#include <Windows.h>
 
 bool PadCommand_Execute(const ParamInfo * paramInfo,
 	const char * scriptData,
@@ -33,6 +44,12 @@ struct ParamTypeInfo
 	u8		pad6[2];	// 6
 };
 
+// the patch tables are shared with obse64_tools, which can't see the game types
+static_assert(sizeof(CommandInfo) == kCmdTable_EntrySize);
+static_assert(offsetof(CommandInfo, shortName) == kCmdTable_ShortNameOffset);
+static_assert(offsetof(CommandInfo, opcode) == kCmdTable_OpcodeOffset);
+static_assert(kScript_NumScriptCommands == kCmdTable_NumScriptCommands);
+
 // may need to patch/redirect this as well
 RelocPtr <ParamTypeInfo> g_paramTypeInfo(0x08FC42C0);
 
@@ -45,15 +62,10 @@ public:
 	// pad out to new opcode
 	void	Extend(u32 opcode);
 
-	struct PatchInfo
-	{
-		u32	ptr;
-		u32	offset;
-		u32	type;
-	};
+	typedef CmdTablePatch PatchInfo;
 
 	// copy to trampoline and apply code patches
-	void	Apply(const PatchInfo * start, const PatchInfo * end, const PatchInfo * len);
+	void	Apply(const PatchInfo * start, const PatchInfo * end, const PatchInfo * len, PatchTransaction * patches);
 
 	// number of commands registered (includes padding, vanilla, extended)
 	size_t		NumCommands() const { return m_commands.size(); }
@@ -61,12 +73,25 @@ public:
 	CommandInfo *	GetByIdx(u32 idx) { return &m_commands[idx]; }
 	CommandInfo *	GetByOpcode(u32 opcode) { return GetByIdx(opcode - m_baseOpcode); }
 
-	void	Add(const CommandInfo & cmd, CommandReturnType retnType = kRetnType_Default);
+	void	Add(const CommandInfo & cmd, CommandReturnType retnType = kRetnType_Default, u32 flags = 0);
+
+	// no more commands after this, pure commands get their result caches
+	void	Lock();
 
-	void	Lock() { m_locked = true; }
+	// null unless the opcode is a pure command and self is its execute function
+	ResultCache *	GetResultCache(u32 opcode, ExecuteFunction self);
 
 	void	Reserve(size_t len);
 
+	// profiling swaps each execute handler for a generated thunk that counts calls and cycles
+	// when it's off the original handlers are back in the table, so it costs nothing
+	bool	EnableProfiling(bool enable);
+	bool	IsProfiling() const { return m_profiling; }
+	void	ResetProfile();
+
+	// ranks commands by total and mean cost, prints the top few to the console
+	bool	WriteProfile(const char * path, u32 numConsoleLines);
+
 private:
 	enum
 	{
@@ -80,28 +105,57 @@ private:
 	struct CmdExtraInfo
 	{
 		CommandReturnType	retnType = kRetnType_Default;
+		bool				pure = false;
+
+		ResultCache			* resultCache = nullptr;
+		ExecuteFunction		resultOwner = nullptr;	// the handler the cache belongs to
 	};
 
-	void	Apply(const PatchInfo * patch, uintptr_t baseValue, int context);
+	// one per command, padded to a cache line so counters for different commands never share one
+	struct alignas(64) ProfileCounters
+	{
+		u64	calls;
+		u64	cycles;
+	};
+
+	void	Apply(const PatchInfo * patch, uintptr_t baseValue, int context, PatchTransaction * patches);
+
+	bool	BuildProfileThunks();
 
 	std::vector <CommandInfo>	m_commands;
 	std::vector <CmdExtraInfo>	m_cmdExtra;
+	std::vector <ResultCache>	m_resultCaches;	// allocated once by Lock
 	u32	m_baseOpcode;
 	bool m_locked = false;
 
 	// pointers in the trampoline to m_commands.begin() + key (bytes)
 	// so we can do "mov reg, [reg + imm32]" to fetch them
 	std::map <u8, void **>	m_trampolineAddresses[kContext_Num];
+
+	// built the first time profiling is enabled and kept, a command may still be running through its thunk
+	std::unique_ptr <Xbyak::CodeGenerator>	m_profileCode;
+	std::vector <ExecuteFunction>	m_profileOriginal;	// null if the command isn't profiled
+	std::vector <ExecuteFunction>	m_profileThunks;
+	std::vector <ProfileCounters>	m_profileCounters;
+	u64	m_profileStartTSC = 0;
+	u64	m_profileStartQPC = 0;
+	bool	m_profiling = false;
 };
 
 HookedCommandTable g_commandTable;
 
-void AddScriptCommand(const CommandInfo & cmd, CommandReturnType retnType)
+// console commands, built first so imports can use it while commands are still being added
+CommandNameIndex g_consoleCommandIndex;
+
+// everything, built once the command table is locked
+CommandNameIndex g_commandIndex;
+
+void AddScriptCommand(const CommandInfo & cmd, CommandReturnType retnType, u32 flags)
 {
-	g_commandTable.Add(cmd, retnType);
+	g_commandTable.Add(cmd, retnType, flags);
 }
 
-void HookedCommandTable::Add(const CommandInfo & cmd, CommandReturnType retnType)
+void HookedCommandTable::Add(const CommandInfo & cmd, CommandReturnType retnType, u32 flags)
 {
 	ASSERT(!m_locked);
 
@@ -114,10 +168,52 @@ void HookedCommandTable::Add(const CommandInfo & cmd, CommandReturnType retnType
 
 	CmdExtraInfo extra;
 	extra.retnType = retnType;
+	extra.pure = (flags & kCmdFlag_Pure) != 0;
 
 	m_cmdExtra.push_back(extra);
 }
 
+void HookedCommandTable::Lock()
+{
+	m_locked = true;
+
+	size_t numPure = 0;
+
+	for(const auto & extra : m_cmdExtra)
+		if(extra.pure)
+			numPure++;
+
+	m_resultCaches.resize(numPure);
+
+	auto cache = m_resultCaches.begin();
+
+	for(size_t i = 0; i < m_cmdExtra.size(); i++)
+	{
+		CmdExtraInfo & extra = m_cmdExtra[i];
+
+		if(extra.pure)
+		{
+			extra.resultCache = &*cache++;
+			extra.resultOwner = m_commands[i].execute;
+		}
+	}
+}
+
+ResultCache * HookedCommandTable::GetResultCache(u32 opcode, ExecuteFunction self)
+{
+	u32 idx = opcode - m_baseOpcode;
+	if(idx >= m_cmdExtra.size())
+		return nullptr;
+
+	const CmdExtraInfo & extra = m_cmdExtra[idx];
+
+	// the opcode comes from the script data, never hand out another command's results
+	if(!extra.resultCache || (extra.resultOwner != self))
+		return nullptr;
+
+	return extra.resultCache;
+}
+
 void HookedCommandTable::Reserve(size_t len)
 {
 	m_commands.reserve(len);
@@ -232,87 +328,20 @@ void HookedCommandTable::Extend(u32 opcode)
  *	
  */
 
-enum CmdTablePatchType
-{
-	kPatchType_End = 0,
-
-	// write two bytes
-	kPatchType_Data16,
-
-	// write four bytes
-	kPatchType_Data32,
-
-	// 7 byte "lea r64, offset32" instruction
-	// will be converted to a 7 byte "mov r64, offset32" instruction
-	// offset will be redirected to a pointer stored in the trampoline
-	// different values of the 'offset' struct field will add and reference additional pointers
-	kPatchType_LeaToLoadBase,
-
-	// used to clear offset (instruction not parsed)
-	// 8 byte "mov r9, offset[rbx + r9*8]" for example
-	// 7 byte "mov eax, offset[rax + rcx*8]" also for example
-	// or 
-	kPatchType_WriteOffset32,
-
-	// used when fetches of imagebase are used for multiple things
-	// but the extra things are unused/debug only
-	// must point at an 8 byte mov statement
-	// "mov rbx, offset32[rbx + rcx*8]" changed to
-	// "lea rbx, offset32; nop"
-	kPatchType_FixupStringFetch
-};
-
-HookedCommandTable::PatchInfo kCmdTableStartPatches[] =
-{
-	{ 0x069475D0 + 0x0D0D + 0, 0, kPatchType_LeaToLoadBase },	// 1
-
-	{ 0x0694AFD0 + 0x04C2 + 0, 0, kPatchType_LeaToLoadBase },	// 2
-
-	{ 0x06967F80 + 0x006C + 0, 0, kPatchType_LeaToLoadBase },	// 3
-
-	{ 0x06A0E020 + 0x009B + 0, 0, kPatchType_LeaToLoadBase },	// 4
-	
-	{ 0x06948B20 + 0x0066 + 0, offsetof(CommandInfo, shortName), kPatchType_LeaToLoadBase },	// 5
-	{ 0x06948B20 + 0x0122 + 0, offsetof(CommandInfo, opcode), kPatchType_LeaToLoadBase },		// 5
-	{ 0x06948B20 + 0x0129 + 3, 0, kPatchType_WriteOffset32 },									// 5
-
-	{ 0, 0, kPatchType_End }
-};
-
-HookedCommandTable::PatchInfo kCmdTableEndPatches[] =
-{
-	{ 0x06948B20 + 0x006D + 0, offsetof(CommandInfo, shortName) + sizeof(CommandInfo), kPatchType_LeaToLoadBase },	// 5
-
-	{ 0, 0, kPatchType_End }
-};
-
-HookedCommandTable::PatchInfo kCmdTableLenPatches[] =
-{
-	{ 0x069475D0 + 0x0CFC + 1, u32(-1), kPatchType_Data32 },	// 1
-
-	{ 0x0694AFD0 + 0x04AF + 2, u32(-1), kPatchType_Data32 },	// 2
-
-	{ 0x06A0E020 + 0x00A2 + 1, 0, kPatchType_Data32 },			// 4
-
-	{ 0x06A02BB0 + 0x008A + 2, 0x1000, kPatchType_Data32 },		// 6
-	{ 0x06A02BB0 + 0x01B9 + 2, 0x1000, kPatchType_Data32 },		// 6
-
-	{ 0, 0, kPatchType_End }
-};
-
-void HookedCommandTable::Apply(const PatchInfo * start, const PatchInfo * end, const PatchInfo * len)
+void HookedCommandTable::Apply(const PatchInfo * start, const PatchInfo * end, const PatchInfo * len, PatchTransaction * patches)
 {
 	for(const auto * iter = start; iter->type != kPatchType_End; ++iter)
-		Apply(iter, uintptr_t(&m_commands.front()), kContext_Start);
+		Apply(iter, uintptr_t(&m_commands.front()), kContext_Start, patches);
 
 	for(const auto * iter = end; iter->type != kPatchType_End; ++iter)
-		Apply(iter, uintptr_t(&m_commands.back()), kContext_End);
+		Apply(iter, uintptr_t(&m_commands.back()), kContext_End, patches);
 
 	for(const auto * iter = len; iter->type != kPatchType_End; ++iter)
-		Apply(iter, m_commands.size(), kContext_Len);
+		Apply(iter, m_commands.size(), kContext_Len, patches);
 }
 
-void HookedCommandTable::Apply(const PatchInfo * patch, uintptr_t baseValue, int context)
+// the code is only read here, everything is written when the transaction is committed
+void HookedCommandTable::Apply(const PatchInfo * patch, uintptr_t baseValue, int context, PatchTransaction * patches)
 {
 	uintptr_t rebasedPtr = RelocationManager::s_baseAddr + patch->ptr;
 
@@ -324,14 +353,14 @@ void HookedCommandTable::Apply(const PatchInfo * patch, uintptr_t baseValue, int
 		case kPatchType_Data16:
 		{
 			u16 newData = u16(baseValue + patch->offset);
-			safeWrite16(rebasedPtr, newData);
+			patches->write16(rebasedPtr, newData);
 		}
 		break;
 
 		case kPatchType_Data32:
 		{
 			u32 newData = u32(baseValue + patch->offset);
-			safeWrite32(rebasedPtr, newData);
+			patches->write32(rebasedPtr, newData);
 		}
 		break;
 
@@ -393,7 +422,7 @@ void HookedCommandTable::Apply(const PatchInfo * patch, uintptr_t baseValue, int
 			ASSERT(opcode == 0x8D);
 
 			// MOV r64, r/m64
-			safeWrite8(rebasedPtr + (rex ? 1 : 0), 0x8B);
+			patches->write8(rebasedPtr + (rex ? 1 : 0), 0x8B);
 
 			size_t displacementOffset = 2;
 			if(rex) displacementOffset++;
@@ -402,20 +431,335 @@ void HookedCommandTable::Apply(const PatchInfo * patch, uintptr_t baseValue, int
 			ptrdiff_t requiredDisplacement = uintptr_t(trampolineAddressIter.first->second) - nextInstrAddr;
 			ASSERT((requiredDisplacement >= INT_MIN) && (requiredDisplacement <= INT_MAX));
 
-			safeWrite32(rebasedPtr + displacementOffset, u32(requiredDisplacement));
+			patches->write32(rebasedPtr + displacementOffset, u32(requiredDisplacement));
 		}
 		break;
 
 		case kPatchType_WriteOffset32:
-			safeWrite32(rebasedPtr, patch->offset);
+			patches->write32(rebasedPtr, patch->offset);
 			break;
 
 		case kPatchType_FixupStringFetch:
-			_MESSAGE("FixupStringFetch");
+			_MESSAGE_C(Hooks, "FixupStringFetch");
 			break;
 	}
 }
 
+enum
+{
+	kProfileThunkSize = 0xA0,	// the code below is 0x82 bytes, plus alignment
+};
+
+// calls the original handler with the same arguments and adds its TSC cycles to the counters
+// the four stack arguments are copied down in to a new frame. there's no unwind info for the
+// thunk, so exceptions thrown through it won't unwind correctly. commands don't do that
+static void EmitProfileThunk(Xbyak::CodeGenerator & code, ExecuteFunction original, void * counters)
+{
+	using namespace Xbyak::util;
+
+	// keeps rsp 16 byte aligned at the call
+	const int kFrameSize = 0x48;
+	// frame, saved rbx and rsi, return address, caller's shadow space
+	const int kStackArgs = kFrameSize + 0x10 + 0x08 + 0x20;
+
+	code.push(rbx);
+	code.push(rsi);
+	code.sub(rsp, kFrameSize);
+
+	for(int i = 0; i < 4; i++)
+	{
+		code.mov(rax, ptr[rsp + kStackArgs + i * 8]);
+		code.mov(ptr[rsp + 0x20 + i * 8], rax);
+	}
+
+	// rdtsc writes edx:eax, keep the second argument
+	code.mov(rsi, rdx);
+	code.rdtsc();
+	code.shl(rdx, 32);
+	code.or_(rax, rdx);
+	code.mov(rbx, rax);
+	code.mov(rdx, rsi);
+
+	code.mov(rax, uintptr_t(original));
+	code.call(rax);
+	code.mov(rsi, rax);
+
+	code.rdtsc();
+	code.shl(rdx, 32);
+	code.or_(rax, rdx);
+	code.sub(rax, rbx);
+
+	code.mov(rcx, uintptr_t(counters));
+	code.inc(qword[rcx]);
+	code.add(qword[rcx + 8], rax);
+
+	code.mov(rax, rsi);
+	code.add(rsp, kFrameSize);
+	code.pop(rsi);
+	code.pop(rbx);
+	code.ret();
+}
+
+bool HookedCommandTable::BuildProfileThunks()
+{
+	ASSERT(m_locked);
+
+	size_t numCommands = m_commands.size();
+
+	m_profileOriginal.assign(numCommands, nullptr);
+	m_profileThunks.assign(numCommands, nullptr);
+	m_profileCounters.assign(numCommands, ProfileCounters());
+
+	size_t numThunks = 0;
+
+	for(size_t i = 0; i < numCommands; i++)
+	{
+		ExecuteFunction execute = m_commands[i].execute;
+
+		if(execute && (execute != PadCommand_Execute))
+		{
+			m_profileOriginal[i] = execute;
+			numThunks++;
+		}
+	}
+
+	try
+	{
+		m_profileCode = std::make_unique <Xbyak::CodeGenerator>(numThunks * kProfileThunkSize + 0x1000);
+
+		for(size_t i = 0; i < numCommands; i++)
+		{
+			if(!m_profileOriginal[i])
+				continue;
+
+			m_profileCode->align(16);
+			m_profileThunks[i] = (ExecuteFunction)m_profileCode->getCurr();
+
+			EmitProfileThunk(*m_profileCode, m_profileOriginal[i], &m_profileCounters[i]);
+		}
+
+		m_profileCode->readyRE();
+	}
+	catch(const Xbyak::Error & e)
+	{
+		_ERROR_C(Hooks, "couldn't build command profiling thunks: %s", e.what());
+
+		m_profileCode.reset();
+		m_profileOriginal.clear();
+		m_profileThunks.clear();
+		m_profileCounters.clear();
+
+		return false;
+	}
+
+	_MESSAGE_C(Hooks, "built %zu command profiling thunks (%zu bytes)", numThunks, m_profileCode->getSize());
+
+	return true;
+}
+
+bool HookedCommandTable::EnableProfiling(bool enable)
+{
+	if(enable == m_profiling)
+		return true;
+
+	if(enable && !m_profileCode)
+	{
+		if(!BuildProfileThunks())
+			return false;
+
+		ResetProfile();
+	}
+
+	for(size_t i = 0; i < m_profileOriginal.size(); i++)
+	{
+		if(!m_profileOriginal[i])
+			continue;
+
+		// something else replaced the handler, leave it alone
+		ExecuteFunction expected = enable ? m_profileOriginal[i] : m_profileThunks[i];
+		if(m_commands[i].execute != expected)
+			continue;
+
+		m_commands[i].execute = enable ? m_profileThunks[i] : m_profileOriginal[i];
+	}
+
+	m_profiling = enable;
+
+	return true;
+}
+
+void HookedCommandTable::ResetProfile()
+{
+	for(auto & counters : m_profileCounters)
+	{
+		counters.calls = 0;
+		counters.cycles = 0;
+	}
+
+	for(auto & cache : m_resultCaches)
+		cache.resetStats();
+
+	LARGE_INTEGER qpc;
+	QueryPerformanceCounter(&qpc);
+
+	m_profileStartTSC = __rdtsc();
+	m_profileStartQPC = qpc.QuadPart;
+}
+
+bool HookedCommandTable::WriteProfile(const char * path, u32 numConsoleLines)
+{
+	if(m_profileCounters.empty())
+		return false;
+
+	LARGE_INTEGER qpc, qpcFreq;
+	QueryPerformanceCounter(&qpc);
+	QueryPerformanceFrequency(&qpcFreq);
+
+	u64 elapsedCycles = __rdtsc() - m_profileStartTSC;
+	double elapsedSeconds = double(qpc.QuadPart - m_profileStartQPC) / double(qpcFreq.QuadPart);
+
+	// the TSC rate isn't exposed anywhere, measure it over the profiling window
+	double cyclesPerMS = (elapsedSeconds > 0) ? (elapsedCycles / elapsedSeconds) / 1000.0 : 0;
+
+	struct Entry
+	{
+		u32	idx;
+		u64	calls;
+		u64	cycles;
+		double	mean;
+	};
+
+	std::vector <Entry> entries;
+
+	for(u32 i = 0; i < m_profileCounters.size(); i++)
+	{
+		const ProfileCounters & counters = m_profileCounters[i];
+
+		if(counters.calls)
+			entries.push_back({ i, counters.calls, counters.cycles, double(counters.cycles) / counters.calls });
+	}
+
+	auto cmdName = [this](u32 idx)
+	{
+		const CommandInfo & cmd = m_commands[idx];
+
+		if(cmd.name && *cmd.name)
+			return cmd.name;
+
+		return (cmd.shortName && *cmd.shortName) ? cmd.shortName : "<unnamed>";
+	};
+
+	std::string report;
+	char line[512];
+
+	auto writeTable = [&](const char * title)
+	{
+		report += title;
+		report += "\n  rank  opcode        calls      total ms       mean us      total cycles   mean cycles  name\n";
+
+		for(u32 i = 0; i < entries.size(); i++)
+		{
+			const Entry & entry = entries[i];
+			double totalMS = cyclesPerMS ? entry.cycles / cyclesPerMS : 0;
+			double meanUS = cyclesPerMS ? entry.mean * 1000.0 / cyclesPerMS : 0;
+
+			sprintf_s(line, "%6u  %6X  %11llu  %12.3f  %12.3f  %16llu  %12.0f  %s\n",
+				i + 1, m_baseOpcode + entry.idx, entry.calls, totalMS, meanUS, entry.cycles, entry.mean, cmdName(entry.idx));
+			report += line;
+		}
+
+		report += "\n";
+	};
+
+	sprintf_s(line, "command profile: %.3f s, %.3f GHz TSC, %zu commands called\n\n",
+		elapsedSeconds, cyclesPerMS / 1000000.0, entries.size());
+	report += line;
+
+	std::sort(entries.begin(), entries.end(), [](const Entry & lhs, const Entry & rhs) { return lhs.mean > rhs.mean; });
+	writeTable("by mean cost");
+
+	// ranked by total last so the console lines come from that order
+	std::sort(entries.begin(), entries.end(), [](const Entry & lhs, const Entry & rhs) { return lhs.cycles > rhs.cycles; });
+	writeTable("by total cost");
+
+	u64 cacheHits = 0, cacheLookups = 0;
+
+	if(!m_resultCaches.empty())
+	{
+		report += "result caches\n  opcode         hits       misses   hit %  name\n";
+
+		for(u32 i = 0; i < m_cmdExtra.size(); i++)
+		{
+			const ResultCache * cache = m_cmdExtra[i].resultCache;
+			if(!cache)
+				continue;
+
+			u64 lookups = cache->hits() + cache->misses();
+
+			sprintf_s(line, "  %6X  %11llu  %11llu  %6.1f  %s\n",
+				m_baseOpcode + i, cache->hits(), cache->misses(), lookups ? cache->hits() * 100.0 / lookups : 0, cmdName(i));
+			report += line;
+
+			cacheHits += cache->hits();
+			cacheLookups += lookups;
+		}
+	}
+
+	bool result = FileStream::replaceFile(path, report.data(), report.size());
+	if(!result)
+		_WARNING_C(Hooks, "couldn't write command profile %s (%08X)", path, GetLastError());
+
+	for(u32 i = 0; (i < numConsoleLines) && (i < entries.size()); i++)
+	{
+		const Entry & entry = entries[i];
+
+		Console_Print("%2u %s: %llu calls, %.3f ms, %.2f us each",
+			i + 1, cmdName(entry.idx), entry.calls,
+			cyclesPerMS ? entry.cycles / cyclesPerMS : 0,
+			cyclesPerMS ? entry.mean * 1000.0 / cyclesPerMS : 0);
+	}
+
+	if(numConsoleLines && cacheLookups)
+		Console_Print("result caches: %.1f%% of %llu pure calls hit", cacheHits * 100.0 / cacheLookups, cacheLookups);
+
+	return result;
+}
+
+ResultCache * GetResultCache(const char * scriptData, const u32 * opcodeOffsetPtr, ExecuteFunction self)
+{
+	// u16 opcode, u16 length, then the arguments *opcodeOffsetPtr points at
+	u32 offset = *opcodeOffsetPtr;
+	if(offset < 4)
+		return nullptr;
+
+	u16 opcode;
+	memcpy(&opcode, scriptData + offset - 4, sizeof(opcode));
+
+	return g_commandTable.GetResultCache(opcode, self);
+}
+
+bool EnableCommandProfiling(bool enable)
+{
+	return g_commandTable.EnableProfiling(enable);
+}
+
+bool IsCommandProfilingEnabled()
+{
+	return g_commandTable.IsProfiling();
+}
+
+void ResetCommandProfile()
+{
+	g_commandTable.ResetProfile();
+}
+
+bool WriteCommandProfile(u32 numConsoleLines)
+{
+	std::string path = getRuntimeDirectory() + "OBSE\\CommandProfile.txt";
+
+	return g_commandTable.WriteProfile(path.c_str(), numConsoleLines);
+}
+
 bool IsScriptCmdParamAForm(u32 scriptCmdIdx, u32 paramTypeIdx)
 {
 	auto & cmdTable = g_commandTable;
@@ -469,6 +813,16 @@ u16 GetNumParameters(u32 cmdIdx)
 	return g_commandTable.GetByIdx(cmdIdx)->numParams;
 }
 
+const CommandInfo * LookupCommandByName(const char * name)
+{
+	return g_commandIndex.lookup(name);
+}
+
+const CommandInfo * LookupConsoleCommandByName(const char * name)
+{
+	return g_consoleCommandIndex.lookup(name);
+}
+
 RelocAddr <decltype(&IsScriptCmdParamAForm)> IsScriptCmdParamAForm_Original(0x06A49650);
 RelocAddr <decltype(&IsScriptCmdParamARefr)> IsScriptCmdParamARefr_Original(0x06A49600);
 RelocAddr <decltype(&GetCommandInfo)> GetCommandInfo_Original(0x06948CA0);
@@ -476,6 +830,9 @@ RelocAddr <decltype(&GetNumParameters)> GetNumParameters_Original(0x06A495E0);
 
 void Hooks_Script_Apply()
 {
+	CommandNameIndex::Table consoleCommands = { g_firstConsoleCommand.getPtr(), kScript_NumConsoleCommands };
+	g_consoleCommandIndex.build(&consoleCommands, 1);
+
 	g_commandTable.Init(kScript_ScriptOpBase, g_firstScriptCommand, kScript_NumScriptCommands);
 	g_commandTable.Extend(kScript_OBSEOpBase);
 
@@ -483,10 +840,30 @@ void Hooks_Script_Apply()
 
 	g_commandTable.Lock();
 
-	g_branchTrampoline.write6Branch(IsScriptCmdParamAForm_Original.getUIntPtr(), uintptr_t(IsScriptCmdParamAForm));
-	g_branchTrampoline.write6Branch(IsScriptCmdParamARefr_Original.getUIntPtr(), uintptr_t(IsScriptCmdParamARefr));
-	g_branchTrampoline.write6Branch(GetCommandInfo_Original.getUIntPtr(), uintptr_t(GetCommandInfo));
-	g_branchTrampoline.write6Branch(GetNumParameters_Original.getUIntPtr(), uintptr_t(GetNumParameters));
+	// script commands first, imported console commands resolve to their script opcode
+	CommandNameIndex::Table allCommands[] =
+	{
+		{ g_commandTable.GetByIdx(0), g_commandTable.NumCommands() },
+		consoleCommands,
+	};
+
+	g_commandIndex.build(allCommands, 2);
+
+	_MESSAGE_C(Hooks, "indexed %zu command names", g_commandIndex.size());
+
+	PatchTransaction patches;
+
+	g_branchTrampoline.write6Branch(IsScriptCmdParamAForm_Original.getUIntPtr(), uintptr_t(IsScriptCmdParamAForm), &patches);
+	g_branchTrampoline.write6Branch(IsScriptCmdParamARefr_Original.getUIntPtr(), uintptr_t(IsScriptCmdParamARefr), &patches);
+	g_branchTrampoline.write6Branch(GetCommandInfo_Original.getUIntPtr(), uintptr_t(GetCommandInfo), &patches);
+	g_branchTrampoline.write6Branch(GetNumParameters_Original.getUIntPtr(), uintptr_t(GetNumParameters), &patches);
+
+	g_commandTable.Apply(kCmdTableStartPatches, kCmdTableEndPatches, kCmdTableLenPatches, &patches);
+
+	size_t numWrites = patches.numPending();
+
+	if(!patches.commit())
+		_ERROR_C(Hooks, "couldn't write every command table patch");
 
-	g_commandTable.Apply(kCmdTableStartPatches, kCmdTableEndPatches, kCmdTableLenPatches);
+	_MESSAGE_C(Hooks, "command table patched, %zu writes to %zu pages", numWrites, patches.numPages());
 }
@@ -1,8 +1,9 @@
 #pragma once
 
+#include "obse64/GameScript.h"
 #include "obse64_common/Types.h"
 
-struct CommandInfo;
+class ResultCache;
 
 enum CommandReturnType : u8
 {
@@ -18,4 +19,32 @@ enum CommandReturnType : u8
 
 void Hooks_Script_Apply();
 
-void AddScriptCommand(const CommandInfo & cmd, CommandReturnType retnType = kRetnType_Default);
+enum
+{
+	// the result only depends on the arguments, repeated calls may be answered from a ResultCache
+	// only worth it where the work costs more than a cache lookup
+	kCmdFlag_Pure = 1 << 0,
+};
+
+void AddScriptCommand(const CommandInfo & cmd, CommandReturnType retnType = kRetnType_Default, u32 flags = 0);
+
+// cache for the command being executed if it was added with kCmdFlag_Pure, null otherwise
+// call before extracting arguments. self is the command's own execute function
+ResultCache * GetResultCache(const char * scriptData, const u32 * opcodeOffsetPtr, ExecuteFunction self);
+
+CommandInfo * GetCommandInfo(u32 opcode);
+
+// long or short name, case insensitive. script commands (vanilla, OBSE, plugins) are found before console commands
+// null until the command table has been locked
+const CommandInfo * LookupCommandByName(const char * name);
+
+// console commands only, available while commands are being added
+const CommandInfo * LookupConsoleCommandByName(const char * name);
+
+// per-opcode call counts and cycles for script commands, off by default
+bool EnableCommandProfiling(bool enable);
+bool IsCommandProfilingEnabled();
+void ResetCommandProfile();
+
+// writes OBSE\CommandProfile.txt, ranked by total and mean cost
+bool WriteCommandProfile(u32 numConsoleLines = 0);
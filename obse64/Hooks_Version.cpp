@@ -1,5 +1,5 @@
 #include "Hooks_Version.h"
-#include "obse64_common/BranchTrampoline.h"
+#include "HookRegistry.h"
 #include "obse64_common/Errors.h"
 #include "obse64_common/Relocation.h"
 #include "obse64_common/obse64_version.h"
@@ -21,5 +21,5 @@ void ShowVersion_Hook(void* a_unk, const wchar_t*, const wchar_t* a_ver, const w
 
 void Hooks_Version_Apply()
 {
-	g_branchTrampoline.write5Call(ShowVersion_Call.getUIntPtr(), (uintptr_t)ShowVersion_Hook);
+	g_hookRegistry.claim(ShowVersion_Call.getUIntPtr(), (uintptr_t)ShowVersion_Hook);
 }
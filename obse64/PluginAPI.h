@@ -1,10 +1,12 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 
 typedef std::uint32_t PluginHandle;	// treat this as an opaque type
 
 class BranchTrampoline;
+struct CommandInfo;
 
 struct PluginInfo
 {
@@ -28,6 +30,11 @@ enum
 	kInterface_Invalid = 0,
 	kInterface_Messaging,
 	kInterface_Trampoline,
+	kInterface_PluginStats,
+	kInterface_CommandTable,
+	kInterface_AddressLibrary,
+	kInterface_Signatures,
+	kInterface_Hooks,
 	kInterface_Max,
 };
 
@@ -85,6 +92,16 @@ struct OBSEInterface
  *	that case the receiver can pass the address of the string as an integer and require the receiver
  *	to cast it back to a char* on receipt.
  *
+ *	Version 2 adds RegisterListenerFiltered(), which works like RegisterListener() but only
+ *	forwards the listed message types to the handler. Other messages from that sender are skipped
+ *	without calling it. Calling it again for the same sender replaces the handler and the list.
+ *
+ *	Version 3 adds QueueDispatch(), which can be called from any thread and never blocks on the
+ *	listeners. The data is copied and the message is delivered on the Oblivion thread at the start
+ *	of its next frame, in the order messages were queued. With kQueue_Coalesce, a message replaces
+ *	any undelivered one with the same sender, receiver and type, so a value that changes often
+ *	only reaches listeners once per frame.
+ *
  *********************************************************************************************/
 
 struct OBSEMessagingInterface
@@ -99,7 +116,12 @@ struct OBSEMessagingInterface
 	typedef void (* EventCallback)(Message* msg);
 
 	enum {
-		kInterfaceVersion = 1
+		kInterfaceVersion = 3
+	};
+
+	// QueueDispatch flags
+	enum {
+		kQueue_Coalesce = 1 << 0,
 	};
 
 	// OBSE messages
@@ -113,19 +135,162 @@ struct OBSEMessagingInterface
 	std::uint32_t interfaceVersion;
 	bool	(* RegisterListener)(PluginHandle listener, const char* sender, EventCallback handler);
 	bool	(* Dispatch)(PluginHandle sender, std::uint32_t messageType, void * data, std::uint32_t dataLen, const char* receiver);
+
+	// version 2
+	// numMessageTypes 0 = receive every type, same as RegisterListener
+	bool	(* RegisterListenerFiltered)(PluginHandle listener, const char* sender, EventCallback handler, const std::uint32_t * messageTypes, std::uint32_t numMessageTypes);
+
+	// version 3
+	// returns false if the sender or receiver is unknown, otherwise the message will be delivered
+	bool	(* QueueDispatch)(PluginHandle sender, std::uint32_t messageType, const void * data, std::uint32_t dataLen, const char* receiver, std::uint32_t flags);
 };
 
+// allocations return null once a pool is out of space near the image or the plugin reaches its quota
+// (Plugins/TrampolineQuota in obse64.ini, KB per pool, default 1024)
 struct OBSETrampolineInterface
 {
 	enum
 	{
-		kInterfaceVersion = 1
+		kInterfaceVersion = 2
 	};
 
 	std::uint32_t interfaceVersion;
 
 	void * (* AllocateFromBranchPool)(PluginHandle plugin, size_t size);
 	void * (* AllocateFromLocalPool)(PluginHandle plugin, size_t size);
+
+	// version 2+, size has to be what was allocated
+	void (* FreeToBranchPool)(PluginHandle plugin, void * ptr, size_t size);
+	void (* FreeToLocalPool)(PluginHandle plugin, void * ptr, size_t size);
+};
+
+// startup cost of each plugin, for tools and diagnostics plugins
+// complete once kMessage_PostLoad has been sent, the same table is written to obse64.txt after kMessage_PostPostLoad
+struct OBSEPluginStatsInterface
+{
+	enum
+	{
+		kInterfaceVersion = 1
+	};
+
+	enum
+	{
+		kPhase_Scan = 0,	// reading the plugin dlls' version data
+		kPhase_Preload,
+		kPhase_Load,
+
+		kPhase_Num,
+	};
+
+	struct PluginStats
+	{
+		PluginHandle	handle;
+		const char		* name;
+
+		std::uint64_t	phaseMicroseconds[kPhase_Num];	// scan is 0 if the plugin was unchanged since the last launch
+
+		std::uint64_t	branchPoolBytes;	// held, allocations minus frees
+		std::uint64_t	localPoolBytes;
+
+		std::uint32_t	numSenders;		// plugins this one has registered to receive messages from
+		std::uint32_t	numListeners;	// plugins registered to receive messages from this one
+	};
+
+	std::uint32_t interfaceVersion;
+
+	// loaded plugins only
+	std::uint32_t	(* GetNumPlugins)(void);
+	bool			(* GetPluginStats)(std::uint32_t index, PluginStats * out);
+
+	// wall time of a whole phase, including plugins that failed to load
+	std::uint64_t	(* GetPhaseMicroseconds)(std::uint32_t phase);
+};
+
+// every script and console command, including ones added by plugins
+// set up after kMessage_PostPostLoad, the functions return null before that
+struct OBSECommandTableInterface
+{
+	enum
+	{
+		kInterfaceVersion = 1
+	};
+
+	std::uint32_t interfaceVersion;
+
+	// case insensitive, long or short name. a script command is found before a console command with the same name
+	const CommandInfo *	(* GetByName)(const char * name);
+	const CommandInfo *	(* GetByOpcode)(std::uint32_t opcode);
+};
+
+// the Address Library database, loaded once for every plugin
+// querying this returns null if the database for the running version of the game is missing or damaged
+//
+// to use RelocID from obse64_common:
+//	RelocationManager::s_idToOffset = addressLibrary->IDToOffset;
+struct OBSEAddressLibraryInterface
+{
+	enum
+	{
+		kInterfaceVersion = 1
+	};
+
+	std::uint32_t interfaceVersion;
+
+	// offset from the base address of the game, 0 if the id isn't in the database
+	std::uint64_t	(* IDToOffset)(std::uint64_t id);
+
+	std::uint32_t	(* GetNumIDs)(void);
+};
+
+// searches the game's code for byte patterns, for plugins using kAddressIndependence_Signatures
+// all of the patterns passed to one call are found in a single pass, so ask for everything at once
+// results are cached per build of the game, so later launches usually don't scan at all
+struct OBSESignatureInterface
+{
+	enum
+	{
+		kInterfaceVersion = 1
+	};
+
+	struct Result
+	{
+		std::uint64_t	rva;			// of the first match
+		std::uint32_t	numMatches;		// 0 if there isn't one
+	};
+
+	std::uint32_t interfaceVersion;
+
+	// patterns are hex bytes separated by spaces, ? or ?? for any byte: "48 8B 05 ?? ?? ?? ?? 48 85 C0"
+	// the code is searched as loaded, including any patches already applied
+	// returns false if a pattern couldn't be parsed, those have no matches
+	bool	(* FindPatterns)(const char * const * patterns, std::uint32_t numPatterns, Result * results);
+};
+
+// hooks on call instructions shared with OBSE and other plugins, use this instead of patching a call yourself
+// when a site could be interesting to anyone else. every enabled handler runs, nothing is overwritten
+struct OBSEHookInterface
+{
+	enum
+	{
+		kInterfaceVersion = 1
+	};
+
+	enum
+	{
+		kType_Pre = 0,		// before the function being called
+		kType_Post,			// after it, its return value is kept for the caller
+	};
+
+	std::uint32_t interfaceVersion;
+
+	// site is the address of a 5 byte call (E8 rel32). the handler takes the same arguments as the function being
+	// called, at most four in registers and four on the stack, and returns void. lower priorities run first
+	// returns an id for the other functions, 0 on failure
+	std::uint32_t	(* AddCallHook)(PluginHandle plugin, std::uintptr_t site, std::uint32_t type, std::int32_t priority, void * handler);
+
+	// cheap, nothing is patched or rebuilt
+	bool	(* SetHookEnabled)(PluginHandle plugin, std::uint32_t hook, bool enable);
+	bool	(* RemoveHook)(PluginHandle plugin, std::uint32_t hook);
 };
 
 typedef bool (* _OBSEPlugin_Load)(const OBSEInterface * obse);
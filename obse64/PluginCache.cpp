@@ -0,0 +1,246 @@
+#include "PluginCache.h"
+#include "obse64_common/BlockCompression.h"
+#include "obse64_common/FileStream.h"
+#include "obse64_common/Log.h"
+#include "obse64_common/PEImage.h"
+#include <cstring>
+#include <vector>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <cerrno>
+#endif
+
+enum
+{
+	kEntryFixedSize = PluginCache::kEntryHeaderSize + sizeof(OBSEPluginVersionData),
+
+	kMaxNameLen = 0x1000,
+};
+
+static u32 LastError()
+{
+#ifdef _WIN32
+	return GetLastError();
+#else
+	return errno;
+#endif
+}
+
+void ScanPluginImage(const void * data, size_t len, PluginScanResult * result)
+{
+	PEImage image;
+
+	if (!image.parse(data, len))
+	{
+		result->status = PluginCache::kStatus_BadImage;
+		return;
+	}
+
+	if (!image.is64())
+	{
+		result->status = PluginCache::kStatus_32Bit;
+		return;
+	}
+
+	u32 versionRVA = image.findExport("OBSEPlugin_Version");
+
+	// a forwarded version is in some other DLL, not this file
+	if (!versionRVA || image.isForwarded(versionRVA) || !image.read(versionRVA, &result->version, sizeof(result->version)))
+	{
+		memset(&result->version, 0, sizeof(result->version));
+
+		result->status = PluginCache::kStatus_NoVersion;
+		return;
+	}
+
+	result->status = PluginCache::kStatus_OK;
+	result->hasLoad = image.findExport("OBSEPlugin_Load") != 0;
+	result->hasPreload = image.findExport("OBSEPlugin_Preload") != 0;
+}
+
+PluginCache::PluginCache()
+:m_hits(0)
+,m_dirty(false)
+{
+	//
+}
+
+void PluginCache::load(const char * path)
+{
+	m_entries.clear();
+	m_hits = 0;
+	m_dirty = true;	// rewrite unless everything loads and matches
+
+	FileStream file;
+	if (!file.open(path))
+		return;
+
+	u64 fileLen = file.length();
+	if ((fileLen < kHeaderSize) || (fileLen > 0x1000000))
+		return;
+
+	std::vector <u8> data(fileLen);
+	if (file.read(data.data(), fileLen) != fileLen)
+		return;
+
+	u32 magic, numEntries;
+	u16 version, versionDataSize;
+
+	memcpy(&magic, data.data(), sizeof(magic));
+	memcpy(&version, data.data() + 4, sizeof(version));
+	memcpy(&versionDataSize, data.data() + 6, sizeof(versionDataSize));
+	memcpy(&numEntries, data.data() + 8, sizeof(numEntries));
+
+	if ((magic != kMagic) || (version != kVersion) || (versionDataSize != sizeof(OBSEPluginVersionData)))
+		return;
+
+	u64 offset = kHeaderSize;
+
+	for (u32 i = 0; i < numEntries; i++)
+	{
+		if (offset + kEntryFixedSize > fileLen)
+			break;
+
+		const u8 * src = data.data() + offset;
+
+		u32 checksum;
+		u16 nameLen;
+		Entry entry = { 0 };
+
+		memcpy(&checksum, src, sizeof(checksum));
+		memcpy(&nameLen, src + 4, sizeof(nameLen));
+		memcpy(&entry.size, src + 6, sizeof(entry.size));
+		memcpy(&entry.writeTime, src + 14, sizeof(entry.writeTime));
+
+		u64 entryLen = kEntryFixedSize + nameLen;
+
+		if ((offset + entryLen > fileLen) || (blockChecksum(src + 4, size_t(entryLen - 4)) != checksum))
+			break;
+
+		entry.result.status = src[22];
+		entry.result.hasLoad = src[23];
+		entry.result.hasPreload = src[24];
+		memcpy(&entry.result.version, src + kEntryHeaderSize, sizeof(entry.result.version));
+
+		if (entry.result.status >= kStatus_ReadError)
+			break;
+
+		m_entries[std::string((const char *)src + kEntryFixedSize, nameLen)] = entry;
+
+		offset += entryLen;
+	}
+
+	if ((offset != fileLen) || (m_entries.size() != numEntries))
+	{
+		_WARNING_C(Plugins, "plugin cache %s is damaged, rescanning everything", path);
+
+		m_entries.clear();
+		return;
+	}
+
+	m_dirty = false;
+}
+
+bool PluginCache::save(const char * path)
+{
+	// entries for plugins that have been removed don't need to stay around
+	for (auto & iter : m_entries)
+		if (!iter.second.used)
+			m_dirty = true;
+
+	if (!m_dirty)
+		return true;
+
+	std::vector <u8> data(kHeaderSize);
+
+	u32 magic = kMagic;
+	u16 version = kVersion;
+	u16 versionDataSize = sizeof(OBSEPluginVersionData);
+	u32 numEntries = 0;
+
+	for (auto & iter : m_entries)
+	{
+		const std::string & name = iter.first;
+		const Entry & entry = iter.second;
+
+		if (!entry.used || (name.size() > kMaxNameLen))
+			continue;
+
+		size_t start = data.size();
+		data.resize(start + kEntryFixedSize + name.size());
+
+		u8 * dst = data.data() + start;
+		u16 nameLen = u16(name.size());
+
+		memcpy(dst + 4, &nameLen, sizeof(nameLen));
+		memcpy(dst + 6, &entry.size, sizeof(entry.size));
+		memcpy(dst + 14, &entry.writeTime, sizeof(entry.writeTime));
+		dst[22] = entry.result.status;
+		dst[23] = entry.result.hasLoad;
+		dst[24] = entry.result.hasPreload;
+		memcpy(dst + kEntryHeaderSize, &entry.result.version, sizeof(entry.result.version));
+		memcpy(dst + kEntryFixedSize, name.data(), name.size());
+
+		u32 checksum = blockChecksum(dst + 4, kEntryFixedSize - 4 + name.size());
+		memcpy(dst, &checksum, sizeof(checksum));
+
+		numEntries++;
+	}
+
+	memcpy(data.data(), &magic, sizeof(magic));
+	memcpy(data.data() + 4, &version, sizeof(version));
+	memcpy(data.data() + 6, &versionDataSize, sizeof(versionDataSize));
+	memcpy(data.data() + 8, &numEntries, sizeof(numEntries));
+
+	if (!FileStream::replaceFile(path, data.data(), data.size()))
+	{
+		_WARNING_C(Plugins, "couldn't write plugin cache %s (%08X)", path, LastError());
+		return false;
+	}
+
+	m_dirty = false;
+
+	return true;
+}
+
+bool PluginCache::lookup(const std::string & name, u64 size, u64 writeTime, PluginScanResult * result)
+{
+	auto iter = m_entries.find(name);
+	if (iter == m_entries.end())
+		return false;
+
+	Entry & entry = iter->second;
+
+	if ((entry.size != size) || (entry.writeTime != writeTime))
+		return false;
+
+	entry.used = true;
+	*result = entry.result;
+
+	m_hits++;
+
+	return true;
+}
+
+void PluginCache::update(const std::string & name, u64 size, u64 writeTime, const PluginScanResult & result)
+{
+	if (result.status >= kStatus_ReadError)
+	{
+		// try again next time, and don't keep a stale entry around
+		if (m_entries.erase(name))
+			m_dirty = true;
+
+		return;
+	}
+
+	Entry & entry = m_entries[name];
+
+	entry.size = size;
+	entry.writeTime = writeTime;
+	entry.used = true;
+	entry.result = result;
+
+	m_dirty = true;
+}
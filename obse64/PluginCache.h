@@ -0,0 +1,81 @@
+#pragma once
+
+#include "obse64/PluginAPI.h"
+#include "obse64_common/Types.h"
+#include <string>
+#include <unordered_map>
+
+// what scanning a plugin dll found out about it
+struct PluginScanResult
+{
+	u8		status;		// PluginCache::kStatus_
+	u8		hasLoad;
+	u8		hasPreload;
+	u32		errorCode;	// only for kStatus_ReadError
+
+	OBSEPluginVersionData	version;
+};
+
+// reads the exports straight from a plugin dll's file data, the loader never has to map it. errorCode is left alone
+void ScanPluginImage(const void * data, size_t len, PluginScanResult * result);
+
+// remembers scan results between launches so unchanged plugin dlls don't have to be mapped and parsed again
+//
+// entries are keyed by file name and only used if the size and last write time from the directory listing
+// still match. compatibility is always checked again, it depends on the game version and address library
+//
+// file layout:
+//	header	u32 magic ('OBPC'), u16 version, u16 sizeof(OBSEPluginVersionData), u32 entry count
+//	entries	u32 checksum, u16 name length, u64 size, u64 write time, u8 status, u8 has load, u8 has preload,
+//			version data, name
+//	the checksum covers everything after it. the whole cache is thrown away if anything doesn't match
+
+class PluginCache
+{
+public:
+	enum
+	{
+		kMagic = 0x4350424F,	// "OBPC" on disk
+		kVersion = 1,
+
+		kHeaderSize = 12,
+		kEntryHeaderSize = 4 + 2 + 8 + 8 + 3,
+	};
+
+	enum
+	{
+		kStatus_OK = 0,
+		kStatus_BadImage,	// not a PE file
+		kStatus_32Bit,
+		kStatus_NoVersion,	// not an OBSE plugin
+		kStatus_ReadError,	// couldn't open or read the file, never cached
+	};
+
+	PluginCache();
+
+	// missing or invalid files just leave the cache empty
+	void	load(const char * path);
+
+	// writes the entries used by this launch, if anything changed
+	bool	save(const char * path);
+
+	bool	lookup(const std::string & name, u64 size, u64 writeTime, PluginScanResult * result);
+	void	update(const std::string & name, u64 size, u64 writeTime, const PluginScanResult & result);
+
+	u32		hits() const { return m_hits; }
+
+private:
+	struct Entry
+	{
+		u64		size;
+		u64		writeTime;
+		bool	used;
+
+		PluginScanResult	result;
+	};
+
+	std::unordered_map <std::string, Entry>	m_entries;
+
+	u32		m_hits;
+	bool	m_dirty;
+};
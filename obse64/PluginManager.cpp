@@ -1,11 +1,26 @@
 #include "PluginManager.h"
+#include "PluginCache.h"
+#include "PluginMessaging.h"
+#include "PluginStats.h"
+#include "SignatureCache.h"
+#include "HookRegistry.h"
+#include "Hooks_Script.h"
+#include "obse64_common/AddressLibrary.h"
 #include "obse64_common/DirectoryIterator.h"
-#include "obse64_common/FileStream.h"
+#include "obse64_common/MappedFile.h"
+#include "obse64_common/Parallel.h"
+#include "obse64_common/PEImage.h"
+#include "obse64_common/Relocation.h"
+#include "obse64_common/SignatureScanner.h"
 #include "obse64_common/Utilities.h"
 #include "obse64_common/obse64_version.h"
 #include "obse64_common/BranchTrampoline.h"
 #include "obse64_common/Log.h"
 #include "obse64_common/Errors.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
 
 PluginManager	g_pluginManager;
 
@@ -13,6 +28,11 @@ PluginManager::LoadedPlugin *	PluginManager::s_currentLoadingPlugin = nullptr;
 PluginHandle					PluginManager::s_currentPluginHandle = 0;
 u32								s_trampolineLog = 1;
 
+enum
+{
+	kDefaultTrampolineQuota = 1024,	// KB per plugin per pool, 0 for no limit
+};
+
 BranchTrampolineManager g_branchTrampolineManager(g_branchTrampoline);
 BranchTrampolineManager g_localTrampolineManager(g_localTrampoline);
 
@@ -35,7 +55,62 @@ static const OBSETrampolineInterface g_OBSETrampolineInterface =
 {
 	OBSETrampolineInterface::kInterfaceVersion,
 	AllocateFromOBSEBranchPool,
-	AllocateFromOBSELocalPool
+	AllocateFromOBSELocalPool,
+	FreeToOBSEBranchPool,
+	FreeToOBSELocalPool
+};
+
+static const OBSEPluginStatsInterface g_OBSEPluginStatsInterface =
+{
+	OBSEPluginStatsInterface::kInterfaceVersion,
+	PluginManager::getNumPluginStats,
+	PluginManager::getPluginStats,
+	PluginManager::getPhaseMicroseconds,
+};
+
+static const CommandInfo * GetCommandByOpcode(u32 opcode)
+{
+	return GetCommandInfo(opcode);
+}
+
+static const OBSECommandTableInterface g_OBSECommandTableInterface =
+{
+	OBSECommandTableInterface::kInterfaceVersion,
+	LookupCommandByName,
+	GetCommandByOpcode,
+};
+
+static AddressLibrary g_addressLibrary;
+
+static u64 AddressLibraryIDToOffset(u64 id)
+{
+	return g_addressLibrary.getOffset(id);
+}
+
+static u32 AddressLibraryNumIDs(void)
+{
+	return g_addressLibrary.size();
+}
+
+static const OBSEAddressLibraryInterface g_OBSEAddressLibraryInterface =
+{
+	OBSEAddressLibraryInterface::kInterfaceVersion,
+	AddressLibraryIDToOffset,
+	AddressLibraryNumIDs,
+};
+
+static const OBSESignatureInterface g_OBSESignatureInterface =
+{
+	OBSESignatureInterface::kInterfaceVersion,
+	PluginManager::findPatterns,
+};
+
+static const OBSEHookInterface g_OBSEHookInterface =
+{
+	OBSEHookInterface::kInterfaceVersion,
+	AddOBSECallHook,
+	SetOBSEHookEnabled,
+	RemoveOBSEHook,
 };
 
 static OBSEMessagingInterface g_OBSEMessagingInterface =
@@ -43,8 +118,34 @@ static OBSEMessagingInterface g_OBSEMessagingInterface =
 	OBSEMessagingInterface::kInterfaceVersion,
 	PluginManager::registerListener,
 	PluginManager::dispatchMessage,
+	PluginManager::registerListenerFiltered,
+	PluginManager::queueMessage,
 };
 
+static u64 GetTicks()
+{
+	LARGE_INTEGER	result;
+	QueryPerformanceCounter(&result);
+
+	return result.QuadPart;
+}
+
+static u64 TicksToMicroseconds(u64 ticks)
+{
+	static u64 s_frequency = 0;
+
+	if(!s_frequency)
+	{
+		LARGE_INTEGER	frequency;
+		QueryPerformanceFrequency(&frequency);
+
+		s_frequency = frequency.QuadPart;
+	}
+
+	// split to avoid overflowing the multiply
+	return (ticks / s_frequency) * 1000000 + (ticks % s_frequency) * 1000000 / s_frequency;
+}
+
 PluginManager::PluginManager()
 {
 	//
@@ -63,13 +164,22 @@ PluginManager::LoadedPlugin::LoadedPlugin()
 
 void PluginManager::init()
 {
+	// per plugin, in KB
+	u32 trampolineQuota = kDefaultTrampolineQuota;
+	getConfigOption_u32("Plugins", "TrampolineQuota", &trampolineQuota);
+
+	g_branchTrampolineManager.setQuota(size_t(trampolineQuota) * 1024);
+	g_localTrampolineManager.setQuota(size_t(trampolineQuota) * 1024);
+
 	if(findPluginDirectory())
 	{
-		_MESSAGE("plugin directory = %s", m_pluginDirectory.c_str());
+		_MESSAGE_C(Plugins, "plugin directory = %s", m_pluginDirectory.c_str());
 
 		// avoid realloc
 		m_plugins.reserve(5);
 
+		u64 scanStart = GetTicks();
+
 		__try
 		{
 			scanPlugins();
@@ -77,13 +187,17 @@ void PluginManager::init()
 		__except(EXCEPTION_EXECUTE_HANDLER)
 		{
 			// something very bad happened
-			_ERROR("exception occurred while loading plugins");
+			_ERROR_C(Plugins, "exception occurred while loading plugins");
 		}
+
+		m_phaseTime[OBSEPluginStatsInterface::kPhase_Scan] = GetTicks() - scanStart;
 	}
 }
 
 void PluginManager::installPlugins(u32 phase)
 {
+	u64 phaseStart = GetTicks();
+
 	for(size_t i = 0; i < m_plugins.size(); i++)
 	{
 		auto & plugin = m_plugins[i];
@@ -100,13 +214,16 @@ void PluginManager::installPlugins(u32 phase)
 				continue;
 		}
 
-		_MESSAGE("%sloading plugin \"%s\"", (phase == kPhase_Preload) ? "pre" : "", plugin.version.name);
+		_MESSAGE_C(Plugins, "%sloading plugin \"%s\"", (phase == kPhase_Preload) ? "pre" : "", plugin.version.name);
 
 		s_currentLoadingPlugin = &plugin;
 		s_currentPluginHandle = plugin.internalHandle;
 
 		std::string pluginPath = m_pluginDirectory + plugin.dllName;
 
+		// includes the dll's own initialization when it's loaded here
+		u64 loadStart = GetTicks();
+
 		if(!plugin.handle)
 		{
 			plugin.handle = (HMODULE)LoadLibrary(pluginPath.c_str());
@@ -125,6 +242,8 @@ void PluginManager::installPlugins(u32 phase)
 
 				loadStatus = safeCallLoadPlugin(&plugin, &g_OBSEInterface, phase);
 
+				plugin.loadTime[phase] = GetTicks() - loadStart;
+
 				if(!loadStatus)
 				{
 					success = true;
@@ -147,6 +266,7 @@ void PluginManager::installPlugins(u32 phase)
 
 			// and remove from plugins list
 			m_plugins.erase(m_plugins.begin() + i);
+			buildNameIndex();
 
 			// fix iterator
 			i--;
@@ -156,6 +276,9 @@ void PluginManager::installPlugins(u32 phase)
 
 	s_currentLoadingPlugin = nullptr;
 	s_currentPluginHandle = 0;
+
+	// stats phases start with the scan
+	m_phaseTime[phase + 1] = GetTicks() - phaseStart;
 }
 
 void PluginManager::loadComplete()
@@ -164,7 +287,7 @@ void PluginManager::loadComplete()
 	{
 		auto & plugin = m_plugins[i];
 
-		_MESSAGE("plugin %s (%08X %s %08X) %s (handle %d)",
+		_MESSAGE_C(Plugins, "plugin %s (%08X %s %08X) %s (handle %d)",
 			plugin.dllName.c_str(),
 			plugin.version.dataVersion,
 			plugin.version.name,
@@ -187,6 +310,11 @@ void PluginManager::loadComplete()
 	dispatchMessage(0, OBSEMessagingInterface::kMessage_PostLoad, nullptr, 0, nullptr);
 	// second post-load dispatch
 	dispatchMessage(0, OBSEMessagingInterface::kMessage_PostPostLoad, nullptr, 0, nullptr);
+
+	// most listeners are registered in response to the post load messages
+	reportPluginStats();
+
+	saveSignatureCache();
 }
 
 void PluginManager::deinit()
@@ -237,22 +365,22 @@ const char * PluginManager::pluginNameFromHandle(PluginHandle handle) const
 	return nullptr;
 }
 
+void PluginManager::buildNameIndex(void)
+{
+	std::vector <const char *>	names;
+
+	for(const LoadedPlugin & plugin : m_plugins)
+		names.push_back(plugin.version.name);
+
+	m_nameIndex.build(names);
+}
+
 PluginHandle PluginManager::lookupHandleFromName(const char * pluginName) const
 {
 	if(!_stricmp("OBSE", pluginName))
 		return 0;
 
-	u32	idx = 1;
-	for(LoadedPluginList::const_iterator iter = m_plugins.begin(); iter != m_plugins.end(); ++iter)
-	{
-		const LoadedPlugin * plugin = &(*iter);
-		if(!_stricmp(plugin->version.name, pluginName))
-		{
-			return idx;
-		}
-		idx++;
-	}
-	return kPluginHandle_Invalid;
+	return m_nameIndex.lookup(pluginName);
 }
 
 void * PluginManager::queryInterface(u32 id)
@@ -267,9 +395,25 @@ void * PluginManager::queryInterface(u32 id)
 	case kInterface_Trampoline:
 		result = (void *)&g_OBSETrampolineInterface;
 		break;
+	case kInterface_PluginStats:
+		result = (void *)&g_OBSEPluginStatsInterface;
+		break;
+	case kInterface_CommandTable:
+		result = (void *)&g_OBSECommandTableInterface;
+		break;
+	case kInterface_AddressLibrary:
+		if(!g_pluginManager.checkAddressLibrary())
+			result = (void *)&g_OBSEAddressLibraryInterface;
+		break;
+	case kInterface_Signatures:
+		result = (void *)&g_OBSESignatureInterface;
+		break;
+	case kInterface_Hooks:
+		result = (void *)&g_OBSEHookInterface;
+		break;
 
 	default:
-		_WARNING("unknown QueryInterface %08X", id);
+		_WARNING_C(Plugins, "unknown QueryInterface %08X", id);
 		break;
 	}
 
@@ -314,67 +458,164 @@ bool PluginManager::findPluginDirectory(void)
 	return result;
 }
 
+static void SafeScanPluginImage(const u8 * data, size_t len, PluginScanResult * result)
+{
+	__try
+	{
+		ScanPluginImage(data, len, result);
+	}
+	__except(EXCEPTION_EXECUTE_HANDLER)
+	{
+		// most likely a read error on the mapped file
+		result->status = PluginCache::kStatus_ReadError;
+		result->errorCode = GetExceptionCode();
+	}
+}
+
+static void ScanPluginFile(const char * path, PluginScanResult * result)
+{
+	MappedFile	file;
+
+	if(!file.open(path))
+	{
+		result->status = PluginCache::kStatus_ReadError;
+		result->errorCode = GetLastError();
+		return;
+	}
+
+	SafeScanPluginImage(file.data(), file.size(), result);
+}
+
 void PluginManager::scanPlugins(void)
 {
-	_MESSAGE("scanning plugin directory %s", m_pluginDirectory.c_str());
+	_MESSAGE_C(Plugins, "scanning plugin directory %s", m_pluginDirectory.c_str());
 
-	u32 handleIdx = 1;	// start at 1, 0 is reserved for internal use
+	struct PluginFile
+	{
+		std::string	name;
+		u64			size;
+		u64			writeTime;
+		bool		cached;
+	};
+
+	std::vector <PluginFile>	files;
 
 	for(DirectoryIterator iter(m_pluginDirectory.c_str(), "*.dll"); !iter.done(); iter.next())
 	{
-		std::string	pluginPath = iter.fullPath();
+		const WIN32_FIND_DATA * data = iter.get();
+
+		PluginFile	file;
+		file.name = data->cFileName;
+		file.size = (u64(data->nFileSizeHigh) << 32) | data->nFileSizeLow;
+		file.writeTime = (u64(data->ftLastWriteTime.dwHighDateTime) << 32) | data->ftLastWriteTime.dwLowDateTime;
+		file.cached = false;
+
+		files.push_back(file);
+	}
+
+	std::vector <PluginScanResult>	results(files.size());
+	std::vector <u64>				scanTimes(files.size(), 0);
+
+	// the directory listing already has the size and write time, so unchanged files aren't opened at all
+	u32 useCache = 1;
+	getConfigOption_u32("Plugins", "Cache", &useCache);
+
+	PluginCache	cache;
+	std::string	cachePath = getRuntimeDirectory() + "OBSE\\PluginCache.bin";
+
+	if(useCache)
+	{
+		cache.load(cachePath.c_str());
+
+		for(size_t i = 0; i < files.size(); i++)
+			files[i].cached = cache.lookup(files[i].name, files[i].size, files[i].writeTime, &results[i]);
+	}
+
+	std::vector <size_t>	toScan;
+
+	for(size_t i = 0; i < files.size(); i++)
+		if(!files[i].cached)
+			toScan.push_back(i);
+
+	// reading the files is independent per plugin, everything after that stays on this thread in directory order
+	parallelFor(toScan.size(), [&](size_t i)
+	{
+		size_t idx = toScan[i];
+
+		u64 scanStart = GetTicks();
+
+		ScanPluginFile((m_pluginDirectory + files[idx].name).c_str(), &results[idx]);
+
+		scanTimes[idx] = GetTicks() - scanStart;
+	});
+
+	if(useCache)
+	{
+		for(size_t idx : toScan)
+			cache.update(files[idx].name, files[idx].size, files[idx].writeTime, results[idx]);
+
+		cache.save(cachePath.c_str());
+
+		_MESSAGE_C(Plugins, "%d of %d plugins unchanged since the last scan", cache.hits(), u32(files.size()));
+	}
+
+	u32 handleIdx = 1;	// start at 1, 0 is reserved for internal use
+
+	for(size_t i = 0; i < files.size(); i++)
+	{
+		const PluginScanResult & result = results[i];
 
 		LoadedPlugin	plugin;
-		plugin.dllName = iter.get()->cFileName;
+		plugin.dllName = files[i].name;
+		plugin.scanTime = scanTimes[i];
 
-		_MESSAGE("checking plugin %s", plugin.dllName.c_str());
+		_MESSAGE_C(Plugins, "checking plugin %s", plugin.dllName.c_str());
 
-		HMODULE resourceHandle = (HMODULE)LoadLibraryEx(pluginPath.c_str(), nullptr, LOAD_LIBRARY_AS_IMAGE_RESOURCE);
-		if(resourceHandle)
+		switch(result.status)
 		{
-			if(is64BitDLL(resourceHandle))
-			{
-				auto * version = (const OBSEPluginVersionData *)getResourceLibraryProcAddress(resourceHandle, "OBSEPlugin_Version");
-				if(version)
-				{
-					plugin.version = *version;
-					sanitize(&plugin.version);
+			case PluginCache::kStatus_OK:
+				break;
 
-					auto * loadStatus = checkPluginCompatibility(plugin.version);
-					if(!loadStatus)
-					{
-						// compatible, add to list
+			case PluginCache::kStatus_BadImage:
+				logPluginLoadError(plugin, "couldn't load plugin", ERROR_BAD_EXE_FORMAT);
+				continue;
 
-						plugin.internalHandle = handleIdx;
-						handleIdx++;
+			case PluginCache::kStatus_32Bit:
+				logPluginLoadError(plugin, "32-bit plugins can never work");
+				continue;
 
-						plugin.hasLoad = getResourceLibraryProcAddress(resourceHandle, "OBSEPlugin_Load") != nullptr;
-						plugin.hasPreload = getResourceLibraryProcAddress(resourceHandle, "OBSEPlugin_Preload") != nullptr;
+			case PluginCache::kStatus_NoVersion:
+				logPluginLoadError(plugin, "no version data", 0, false);
+				continue;
 
-						m_plugins.push_back(plugin);
-					}
-					else
-					{
-						logPluginLoadError(plugin, loadStatus);
-					}
-				}
-				else
-				{
-					logPluginLoadError(plugin, "no version data", 0, false);
-				}
-			}
-			else
-			{
-				logPluginLoadError(plugin, "32-bit plugins can never work");
-			}
+			default:
+				logPluginLoadError(plugin, "couldn't load plugin", result.errorCode);
+				continue;
+		}
 
-			FreeLibrary(resourceHandle);
+		plugin.version = result.version;
+		sanitize(&plugin.version);
+
+		auto * loadStatus = checkPluginCompatibility(plugin.version);
+		if(!loadStatus)
+		{
+			// compatible, add to list
+
+			plugin.internalHandle = handleIdx;
+			handleIdx++;
+
+			plugin.hasLoad = result.hasLoad;
+			plugin.hasPreload = result.hasPreload;
+
+			m_plugins.push_back(plugin);
 		}
 		else
 		{
-			logPluginLoadError(plugin, "couldn't load plugin", GetLastError());
+			logPluginLoadError(plugin, loadStatus);
 		}
 	}
+
+	buildNameIndex();
 }
 
 const char * PluginManager::checkAddressLibrary(void)
@@ -398,8 +639,34 @@ const char * PluginManager::checkAddressLibrary(void)
 
 	std::string alPath = getRuntimeDirectory() + fileName;
 
-	FileStream versionLib;
-	if(!versionLib.open(alPath.c_str()))
+	// decoded once here, plugins look ids up through OBSEAddressLibraryInterface
+	bool loaded = g_addressLibrary.load(alPath.c_str());
+	if(loaded)
+	{
+		const u32 * version = g_addressLibrary.version();
+
+		if((version[0] != GET_EXE_VERSION_MAJOR(RUNTIME_VERSION)) ||
+			(version[1] != GET_EXE_VERSION_MINOR(RUNTIME_VERSION)) ||
+			(version[2] != GET_EXE_VERSION_BUILD(RUNTIME_VERSION)))
+		{
+			_WARNING_C(Plugins, "address library %s is for %d.%d.%d", alPath.c_str(), version[0], version[1], version[2]);
+
+			g_addressLibrary.clear();
+			loaded = false;
+		}
+	}
+	else
+	{
+		_WARNING_C(Plugins, "couldn't load address library %s", alPath.c_str());
+	}
+
+	if(loaded)
+	{
+		_MESSAGE_C(Plugins, "address library loaded, %d ids", g_addressLibrary.size());
+
+		RelocationManager::s_idToOffset = AddressLibraryIDToOffset;
+	}
+	else
 	{
 		m_oldAddressLibrary = true;
 		s_status = "disabled, address library needs to be updated";
@@ -576,7 +843,7 @@ void PluginManager::logPluginLoadError(const LoadedPlugin & pluginSrc, const cha
 	if(isError)
 		m_erroredPlugins.push_back(plugin);
 
-	_MESSAGE("plugin %s (%08X %s %08X) %s %d (handle %d)",
+	_MESSAGE_C(Plugins, "plugin %s (%08X %s %08X) %s %d (handle %d)",
 		plugin.dllName.c_str(),
 		plugin.version.dataVersion,
 		plugin.version.name,
@@ -690,27 +957,18 @@ void PluginManager::updateAddressLibraryPrompt()
 }
 
 // Plugin communication interface
-struct PluginListener {
-	PluginHandle	listener;
-	OBSEMessagingInterface::EventCallback	handleMessage;
-};
-
-typedef std::vector<std::vector<PluginListener> > PluginListeners;
 static PluginListeners s_pluginListeners;
 
-bool PluginManager::registerListener(PluginHandle listener, const char* sender, OBSEMessagingInterface::EventCallback handler)
+static bool RegisterPluginListener(PluginHandle listener, const char* sender, OBSEMessagingInterface::EventCallback handler, const u32 * messageTypes, u32 numMessageTypes, bool replace)
 {
 	// because this can be called while plugins are loading, gotta make sure number of plugins hasn't increased
 	u32 numPlugins = g_pluginManager.numPlugins() + 1;
-	if (s_pluginListeners.size() < numPlugins)
-	{
-		s_pluginListeners.resize(numPlugins + 5);	// add some extra room to avoid unnecessary re-alloc
-	}
+	s_pluginListeners.reserve(numPlugins);
 
-	_MESSAGE("registering plugin listener for %s at %u of %u", sender, listener, numPlugins);
+	_MESSAGE_C(Plugins, "registering plugin listener for %s at %u of %u (%u message types)", sender, listener, numPlugins, numMessageTypes);
 
 	// handle > num plugins = invalid
-	if (listener > g_pluginManager.numPlugins() || !handler) 
+	if (listener > g_pluginManager.numPlugins() || !handler || (numMessageTypes && !messageTypes))
 	{
 		return false;
 	}
@@ -723,75 +981,99 @@ bool PluginManager::registerListener(PluginHandle listener, const char* sender,
 		{
 			return false;
 		}
-		// is listener already registered?
-		for (std::vector<PluginListener>::iterator iter = s_pluginListeners[target].begin(); iter != s_pluginListeners[target].end(); ++iter)
-		{
-			if (iter->listener == listener)
-			{
-				return true;
-			}
-		}
-
-		// register new listener
-		PluginListener newListener;
-		newListener.handleMessage = handler;
-		newListener.listener = listener;
 
-		s_pluginListeners[target].push_back(newListener);
+		s_pluginListeners.add(target, listener, handler, messageTypes, numMessageTypes, replace);
 	}
 	else
 	{
 		// register listener to every loaded plugin
-		u32 idx = 0;
-		for(PluginListeners::iterator iter = s_pluginListeners.begin(); iter != s_pluginListeners.end(); ++iter)
+		for (u32 idx = 1; idx < s_pluginListeners.numSenders(); idx++)
 		{
 			// don't add the listener to its own list
-			if (idx && idx != listener)
+			if (idx != listener)
 			{
-				bool skipCurrentList = false;
-				for (std::vector<PluginListener>::iterator iterEx = iter->begin(); iterEx != iter->end(); ++iterEx)
-				{
-					// already registered with this plugin, skip it
-					if (iterEx->listener == listener)
-					{
-						skipCurrentList = true;
-						break;
-					}
-				}
-				if (skipCurrentList)
-				{
-					continue;
-				}
-				PluginListener newListener;
-				newListener.handleMessage = handler;
-				newListener.listener = listener;
-
-				iter->push_back(newListener);
+				s_pluginListeners.add(idx, listener, handler, messageTypes, numMessageTypes, replace);
 			}
-			idx++;
 		}
 	}
 
 	return true;
 }
 
+bool PluginManager::registerListener(PluginHandle listener, const char* sender, OBSEMessagingInterface::EventCallback handler)
+{
+	return RegisterPluginListener(listener, sender, handler, nullptr, 0, false);
+}
+
+bool PluginManager::registerListenerFiltered(PluginHandle listener, const char* sender, OBSEMessagingInterface::EventCallback handler, const u32 * messageTypes, u32 numMessageTypes)
+{
+	return RegisterPluginListener(listener, sender, handler, messageTypes, numMessageTypes, true);
+}
+
+// target kPluginHandle_Invalid = every listener
+static bool DeliverMessage(PluginHandle sender, PluginHandle target, u32 messageType, void * data, u32 dataLen)
+{
+	const char* senderName = g_pluginManager.pluginNameFromHandle(sender);
+	if (!senderName)
+		return false;
+
+	return s_pluginListeners.deliver(sender, senderName, target, messageType, data, dataLen);
+}
+
 bool PluginManager::dispatchMessage(PluginHandle sender, u32 messageType, void * data, u32 dataLen, const char* receiver)
 {
-	_MESSAGE("dispatch message (%d) to plugin listeners", messageType);
-	u32 numRespondents = 0;
+	// plugins can send a lot of these, only the script extender's own messages are worth logging
+	if (!sender)
+		_MESSAGE_C(Plugins, "dispatch message (%d) to plugin listeners", messageType);
+
 	PluginHandle target = kPluginHandle_Invalid;
 
-	if (!s_pluginListeners.size())	// no listeners yet registered
+	if (receiver)
 	{
-		_MESSAGE("no listeners registered");
-		return false;
+		target = g_pluginManager.lookupHandleFromName(receiver);
+		if (target == kPluginHandle_Invalid)
+			return false;
 	}
-	else if (sender >= s_pluginListeners.size())
+
+	return DeliverMessage(sender, target, messageType, data, dataLen);
+}
+
+// queued messages, pushed from any thread and delivered on the Oblivion thread
+// the queue is a lock-free stack, the consumer takes the whole thing at once and reverses it
+struct QueuedMessage {
+	QueuedMessage	* next;
+	PluginHandle	sender;
+	PluginHandle	target;
+	u32				type;
+	u32				dataLen;
+	u32				flags;
+
+	void * data() { return this + 1; }
+};
+
+static std::atomic <QueuedMessage *>	s_messageQueue { nullptr };
+
+struct CoalesceKey {
+	PluginHandle	sender;
+	PluginHandle	target;
+	u32				type;
+
+	bool operator==(const CoalesceKey & rhs) const { return (sender == rhs.sender) && (target == rhs.target) && (type == rhs.type); }
+};
+
+struct CoalesceKeyHash {
+	size_t operator()(const CoalesceKey & key) const { return (size_t(key.sender) * 0x9E3779B97F4A7C15ULL) ^ (size_t(key.target) << 32) ^ key.type; }
+};
+
+bool PluginManager::queueMessage(PluginHandle sender, u32 messageType, const void * data, u32 dataLen, const char* receiver, u32 flags)
+{
+	if (sender > g_pluginManager.numPlugins() || (dataLen && !data))
 	{
-		_MESSAGE("sender is not in the list");
 		return false;
 	}
 
+	PluginHandle target = kPluginHandle_Invalid;
+
 	if (receiver)
 	{
 		target = g_pluginManager.lookupHandleFromName(receiver);
@@ -799,62 +1081,329 @@ bool PluginManager::dispatchMessage(PluginHandle sender, u32 messageType, void *
 			return false;
 	}
 
-	const char* senderName = g_pluginManager.pluginNameFromHandle(sender);
-	if (!senderName)
+	// the sender's buffer only has to live until this returns
+	QueuedMessage * msg = (QueuedMessage *)malloc(sizeof(QueuedMessage) + dataLen);
+	if (!msg)
 		return false;
-	for (std::vector<PluginListener>::iterator iter = s_pluginListeners[sender].begin(); iter != s_pluginListeners[sender].end(); ++iter)
+
+	msg->sender = sender;
+	msg->target = target;
+	msg->type = messageType;
+	msg->dataLen = dataLen;
+	msg->flags = flags;
+
+	if (dataLen)
+		memcpy(msg->data(), data, dataLen);
+
+	msg->next = s_messageQueue.load(std::memory_order_relaxed);
+	while (!s_messageQueue.compare_exchange_weak(msg->next, msg, std::memory_order_release, std::memory_order_relaxed))
+		;
+
+	return true;
+}
+
+void PluginManager::deliverQueuedMessages()
+{
+	QueuedMessage * list = s_messageQueue.exchange(nullptr, std::memory_order_acquire);
+	if (!list)
+		return;
+
+	// game thread only, kept around so delivery doesn't allocate once they've grown
+	static std::vector <QueuedMessage *>	s_batch;
+	static std::unordered_map <CoalesceKey, size_t, CoalesceKeyHash>	s_newest;
+
+	s_batch.clear();
+
+	for (; list; list = list->next)
+		s_batch.push_back(list);
+
+	std::reverse(s_batch.begin(), s_batch.end());
+
+	bool coalesce = false;
+
+	for (size_t i = 0; i < s_batch.size(); i++)
 	{
-		OBSEMessagingInterface::Message msg;
-		msg.data = data;
-		msg.type = messageType;
-		msg.sender = senderName;
-		msg.dataLen = dataLen;
+		QueuedMessage * msg = s_batch[i];
 
-		if (target != kPluginHandle_Invalid)	// sending message to specific plugin
+		if (msg->flags & OBSEMessagingInterface::kQueue_Coalesce)
 		{
-			if (iter->listener == target)
-			{
-				iter->handleMessage(&msg);
-				return true;
-			}
+			CoalesceKey key = { msg->sender, msg->target, msg->type };
+
+			s_newest[key] = i;
+			coalesce = true;
 		}
-		else
+	}
+
+	for (size_t i = 0; i < s_batch.size(); i++)
+	{
+		QueuedMessage * msg = s_batch[i];
+
+		bool deliver = true;
+
+		// only the newest of each coalesced sender/receiver/type goes out, in its own position
+		if (coalesce && (msg->flags & OBSEMessagingInterface::kQueue_Coalesce))
 		{
-			_DMESSAGE("sending message type %u to plugin %u", messageType, iter->listener);
-			iter->handleMessage(&msg);
-			numRespondents++;
+			CoalesceKey key = { msg->sender, msg->target, msg->type };
+
+			deliver = s_newest[key] == i;
 		}
+
+		if (deliver)
+			DeliverMessage(msg->sender, msg->target, msg->type, msg->dataLen ? msg->data() : nullptr, msg->dataLen);
+
+		free(msg);
 	}
-	_DMESSAGE("dispatched message.");
-	return numRespondents ? true : false;
+
+	s_newest.clear();
 }
 
-inline void * BranchTrampolineManager::allocate(PluginHandle plugin, size_t size)
+u32 PluginManager::getNumPluginStats()
 {
-	auto mem = m_trampoline.allocate(size);
-	if (mem) {
-		std::lock_guard<decltype(m_lock)> locker(m_lock);
+	return u32(g_pluginManager.m_plugins.size());
+}
+
+bool PluginManager::getPluginStats(u32 index, OBSEPluginStatsInterface::PluginStats * out)
+{
+	const LoadedPluginList & plugins = g_pluginManager.m_plugins;
+
+	if((index >= plugins.size()) || !out)
+		return false;
+
+	const LoadedPlugin & plugin = plugins[index];
+
+	// listeners register with the handle the plugin was given, senders are looked up by name
+	PluginHandle handle = plugin.internalHandle;
+	PluginHandle senderHandle = index + 1;
+
+	out->handle = handle;
+	out->name = plugin.version.name;
+
+	out->phaseMicroseconds[OBSEPluginStatsInterface::kPhase_Scan] = TicksToMicroseconds(plugin.scanTime);
+	out->phaseMicroseconds[OBSEPluginStatsInterface::kPhase_Preload] = TicksToMicroseconds(plugin.loadTime[kPhase_Preload]);
+	out->phaseMicroseconds[OBSEPluginStatsInterface::kPhase_Load] = TicksToMicroseconds(plugin.loadTime[kPhase_Load]);
 
-		auto findIt = m_stats.find(plugin);
-		if (findIt != m_stats.end()) {
-			findIt->second += size;
+	out->branchPoolBytes = g_branchTrampolineManager.allocated(handle);
+	out->localPoolBytes = g_localTrampolineManager.allocated(handle);
+
+	CountPluginMessaging(s_pluginListeners, u32(plugins.size()), handle, senderHandle, out);
+
+	return true;
+}
+
+u64 PluginManager::getPhaseMicroseconds(u32 phase)
+{
+	if(phase >= OBSEPluginStatsInterface::kPhase_Num)
+		return 0;
+
+	return TicksToMicroseconds(g_pluginManager.m_phaseTime[phase]);
+}
+
+static std::mutex		s_signatureLock;
+static SignatureCache	s_signatureCache;
+static bool				s_signatureCacheLoaded = false;
+static bool				s_signatureCacheSaveNow = false;	// after plugin load, save as soon as anything changes
+static u32				s_codeRVA = 0;
+static u32				s_codeSize = 0;
+
+static std::string GetSignatureCachePath()
+{
+	return getRuntimeDirectory() + "OBSE\\SignatureCache.bin";
+}
+
+bool PluginManager::findPatterns(const char * const * patterns, u32 numPatterns, OBSESignatureInterface::Result * results)
+{
+	std::lock_guard <std::mutex> lock(s_signatureLock);
+
+	if(!s_signatureCacheLoaded)
+	{
+		// the headers of the loaded game are the same as on disk
+		PEImage image;
+		const u8 * fileData;
+		u32 fileSize;
+
+		if(!image.parse((const void *)RelocationManager::s_baseAddr, 0x1000) ||
+			!image.findCode(&s_codeRVA, &s_codeSize, &fileData, &fileSize))
+		{
+			_ERROR_C(Plugins, "couldn't find the game's code for signature scanning");
 		}
-		else {
-			auto insIt = m_stats.insert(std::make_pair(plugin, size));
-			ASSERT(insIt.second);   // insertion failed
+
+		s_signatureCache.load(GetSignatureCachePath().c_str(), image.headerHash());
+		s_signatureCacheLoaded = true;
+	}
+
+	SignatureScanner scanner;
+	std::vector <s32> scannerIndices(numPatterns);
+	bool allParsed = true;
+	bool allCached = true;
+
+	for(u32 i = 0; i < numPatterns; i++)
+	{
+		OBSESignatureInterface::Result & result = results[i];
+
+		result.rva = 0;
+		result.numMatches = 0;
+
+		s32 idx = scanner.add(patterns[i]);
+		scannerIndices[i] = idx;
+
+		if(idx < 0)
+		{
+			_WARNING_C(Plugins, "invalid signature \"%s\"", patterns[i]);
+
+			allParsed = false;
+			continue;
+		}
+
+		SignatureScanner::Result cached;
+		if(s_signatureCache.lookup(scanner.patternHash(idx), &cached))
+		{
+			result.rva = cached.offset;
+			result.numMatches = cached.numMatches;
+		}
+		else
+		{
+			allCached = false;
 		}
 	}
+
+	if(!allCached && s_codeSize)
+	{
+		u64 scanStart = GetTicks();
+
+		scanner.scan((const u8 *)(RelocationManager::s_baseAddr + s_codeRVA), s_codeSize, s_codeRVA);
+
+		_MESSAGE_C(Plugins, "signature scan, %d patterns %.3f ms", numPatterns, TicksToMicroseconds(GetTicks() - scanStart) / 1000.0);
+
+		for(u32 i = 0; i < numPatterns; i++)
+		{
+			s32 idx = scannerIndices[i];
+			if(idx < 0)
+				continue;
+
+			const SignatureScanner::Result & found = scanner.result(idx);
+
+			results[i].rva = found.offset;
+			results[i].numMatches = found.numMatches;
+
+			s_signatureCache.update(scanner.patternHash(idx), found);
+		}
+
+		if(s_signatureCacheSaveNow)
+			s_signatureCache.save(GetSignatureCachePath().c_str());
+	}
+
+	return allParsed;
+}
+
+void PluginManager::saveSignatureCache()
+{
+	std::lock_guard <std::mutex> lock(s_signatureLock);
+
+	if(s_signatureCacheLoaded)
+	{
+		_MESSAGE_C(Plugins, "%d signatures found in the cache", s_signatureCache.hits());
+
+		s_signatureCache.save(GetSignatureCachePath().c_str());
+	}
+
+	s_signatureCacheSaveNow = true;
+}
+
+void PluginManager::reportPluginStats()
+{
+	_MESSAGE_C(Plugins, "plugin startup: scan %.3f ms, preload %.3f ms, load %.3f ms",
+		getPhaseMicroseconds(OBSEPluginStatsInterface::kPhase_Scan) / 1000.0,
+		getPhaseMicroseconds(OBSEPluginStatsInterface::kPhase_Preload) / 1000.0,
+		getPhaseMicroseconds(OBSEPluginStatsInterface::kPhase_Load) / 1000.0);
+
+	if(m_plugins.empty())
+		return;
+
+	std::vector <OBSEPluginStatsInterface::PluginStats>	stats(m_plugins.size());
+
+	for(u32 i = 0; i < stats.size(); i++)
+		getPluginStats(i, &stats[i]);
+
+	SortPluginStats(stats);
+
+	_MESSAGE_C(Plugins, "%s", kPluginStatsHeader);
+
+	for(const auto & entry : stats)
+	{
+		char	row[512];
+
+		FormatPluginStats(entry, row, sizeof(row));
+		_MESSAGE_C(Plugins, "%s", row);
+	}
+}
+
+void * BranchTrampolineManager::allocate(PluginHandle plugin, size_t size)
+{
+	std::lock_guard<decltype(m_lock)> locker(m_lock);
+
+	auto & stats = m_stats[plugin];
+
+	if (m_quota && (stats.bytes + size > m_quota)) {
+		_ERROR_C(Plugins, "plugin %d trampoline quota exceeded (%lld bytes held, %lld requested, quota %lld)", plugin, stats.bytes, size, m_quota);
+		return nullptr;
+	}
+
+	auto mem = m_trampoline.allocate(size);
+	if (mem) {
+		stats.bytes += size;
+		stats.live[mem] = size;
+	}
 	else {
-		ASSERT(false);  // alloc failed
+		_ERROR_C(Plugins, "plugin %d trampoline alloc of %lld bytes failed, no space left near the image", plugin, size);
 	}
+
 	return mem;
 }
 
+void BranchTrampolineManager::free(PluginHandle plugin, void * ptr, size_t size)
+{
+	if (!ptr)
+		return;
+
+	std::lock_guard<decltype(m_lock)> locker(m_lock);
+
+	auto findIt = m_stats.find(plugin);
+	if (findIt == m_stats.end()) {
+		_ERROR_C(Plugins, "plugin %d freed trampoline memory %p without allocating any", plugin, ptr);
+		return;
+	}
+
+	auto & stats = findIt->second;
+
+	auto liveIt = stats.live.find(ptr);
+	if (liveIt == stats.live.end()) {
+		_ERROR_C(Plugins, "plugin %d freed trampoline memory %p it didn't allocate, or already freed", plugin, ptr);
+		return;
+	}
+
+	if (liveIt->second != size) {
+		_ERROR_C(Plugins, "plugin %d freed %lld bytes of trampoline memory %p, allocated %lld", plugin, size, ptr, liveIt->second);
+		return;
+	}
+
+	stats.live.erase(liveIt);
+	stats.bytes -= size;
+
+	m_trampoline.free(ptr, size);
+}
+
+size_t BranchTrampolineManager::allocated(PluginHandle plugin)
+{
+	std::lock_guard<decltype(m_lock)> locker(m_lock);
+
+	auto findIt = m_stats.find(plugin);
+	return (findIt != m_stats.end()) ? findIt->second.bytes : 0;
+}
 
 void * AllocateFromOBSEBranchPool(PluginHandle plugin, size_t size)
 {
 	if (s_trampolineLog) {
-		_DMESSAGE("plugin %d allocated %lld bytes from branch pool", plugin, size);
+		_DMESSAGE_C(Plugins, "plugin %d allocated %lld bytes from branch pool", plugin, size);
 	}
 	return g_branchTrampolineManager.allocate(plugin, size);
 }
@@ -862,7 +1411,23 @@ void * AllocateFromOBSEBranchPool(PluginHandle plugin, size_t size)
 void * AllocateFromOBSELocalPool(PluginHandle plugin, size_t size)
 {
 	if (s_trampolineLog) {
-		_DMESSAGE("plugin %d allocated %lld bytes from local pool", plugin, size);
+		_DMESSAGE_C(Plugins, "plugin %d allocated %lld bytes from local pool", plugin, size);
 	}
 	return g_localTrampolineManager.allocate(plugin, size);
 }
+
+void FreeToOBSEBranchPool(PluginHandle plugin, void * ptr, size_t size)
+{
+	if (s_trampolineLog) {
+		_DMESSAGE_C(Plugins, "plugin %d freed %lld bytes to branch pool", plugin, size);
+	}
+	g_branchTrampolineManager.free(plugin, ptr, size);
+}
+
+void FreeToOBSELocalPool(PluginHandle plugin, void * ptr, size_t size)
+{
+	if (s_trampolineLog) {
+		_DMESSAGE_C(Plugins, "plugin %d freed %lld bytes to local pool", plugin, size);
+	}
+	g_localTrampolineManager.free(plugin, ptr, size);
+}
@@ -6,6 +6,7 @@
 #include <unordered_map>
 
 #include "obse64/PluginAPI.h"
+#include "obse64/PluginMessaging.h"
 #include "obse64_common/Types.h"
 
 #include <Windows.h>
@@ -29,6 +30,9 @@ public:
 	void	loadComplete();
 	void	deinit();
 
+	// Oblivion thread, once per frame
+	static void	deliverQueuedMessages();
+
 	const PluginInfo *	infoByName(const char * name) const;
 	u32					numPlugins() const;
 
@@ -42,8 +46,16 @@ public:
 	static const PluginInfo *	getPluginInfo(const char* name);
 	static const char*			getSaveFolderName();
 
+	static u32		getNumPluginStats();
+	static bool		getPluginStats(u32 index, OBSEPluginStatsInterface::PluginStats * out);
+	static u64		getPhaseMicroseconds(u32 phase);
+
+	static bool		findPatterns(const char * const * patterns, u32 numPatterns, OBSESignatureInterface::Result * results);
+
 	static bool dispatchMessage(PluginHandle sender, u32 messageType, void * data, u32 dataLen, const char* receiver);
 	static bool	registerListener(PluginHandle listener, const char* sender, OBSEMessagingInterface::EventCallback handler);
+	static bool	queueMessage(PluginHandle sender, u32 messageType, const void * data, u32 dataLen, const char* receiver, u32 flags);
+	static bool	registerListenerFiltered(PluginHandle listener, const char* sender, OBSEMessagingInterface::EventCallback handler, const u32 * messageTypes, u32 numMessageTypes);
 
 private:
 	struct LoadedPlugin
@@ -65,11 +77,18 @@ private:
 
 		bool	hasLoad = false;
 		bool	hasPreload = false;
+
+		// QueryPerformanceCounter ticks
+		u64		scanTime = 0;
+		u64		loadTime[kPhase_Num] = { 0 };
 	};
 
 	bool	findPluginDirectory(void);
 	void	scanPlugins(void);
 
+	// rebuilt whenever m_plugins changes, lookups don't allocate
+	void	buildNameIndex(void);
+
 	const char *	safeCallLoadPlugin(LoadedPlugin * plugin, const OBSEInterface * obse64, u32 phase);
 
 	void			sanitize(OBSEPluginVersionData * version);
@@ -78,6 +97,8 @@ private:
 
 	void			logPluginLoadError(const LoadedPlugin & plugin, const char * errStr, u32 errCode = 0, bool isError = true);
 	void			reportPluginErrors();
+	void			reportPluginStats();
+	void			saveSignatureCache();
 	void			updateAddressLibraryPrompt();
 
 	typedef std::vector <LoadedPlugin>	LoadedPluginList;
@@ -87,8 +108,12 @@ private:
 
 	LoadedPluginList	m_erroredPlugins;
 
+	PluginNameIndex		m_nameIndex;
+
 	bool				m_oldAddressLibrary = false;
 
+	u64					m_phaseTime[OBSEPluginStatsInterface::kPhase_Num] = { 0 };	// QueryPerformanceCounter ticks
+
 	static LoadedPlugin		* s_currentLoadingPlugin;
 	static PluginHandle		s_currentPluginHandle;
 };
@@ -100,12 +125,29 @@ public:
 		m_trampoline(trampoline)
 	{}
 
+	// null if the pool is out of space or the plugin would go over its quota
 	void* allocate(PluginHandle plugin, size_t size);
 
+	// ptr and size have to match an allocation the same plugin made, anything else is logged and ignored
+	void free(PluginHandle plugin, void * ptr, size_t size);
+
+	// bytes handed out to a plugin and not freed
+	size_t	allocated(PluginHandle plugin);
+
+	// most bytes each plugin can hold, 0 for no limit
+	void	setQuota(size_t quota)	{ m_quota = quota; }
+
 private:
 	BranchTrampoline& m_trampoline;
 	std::mutex m_lock;
-	std::unordered_map<PluginHandle, size_t> m_stats;
+	struct PluginAllocations
+	{
+		size_t bytes = 0;
+		std::unordered_map<void *, size_t> live;	// ptr -> size passed to allocate
+	};
+
+	std::unordered_map<PluginHandle, PluginAllocations> m_stats;
+	size_t m_quota = 0;
 };
 
 extern BranchTrampolineManager g_branchTrampolineManager;
@@ -113,5 +155,7 @@ extern BranchTrampolineManager g_localTrampolineManager;
 
 void * AllocateFromOBSEBranchPool(PluginHandle plugin, size_t size);
 void * AllocateFromOBSELocalPool(PluginHandle plugin, size_t size);
+void FreeToOBSEBranchPool(PluginHandle plugin, void * ptr, size_t size);
+void FreeToOBSELocalPool(PluginHandle plugin, void * ptr, size_t size);
 
 extern PluginManager	g_pluginManager;
@@ -0,0 +1,176 @@
+#include "PluginMessaging.h"
+#include <cctype>
+
+bool PluginListeners::Listener::wants(u32 messageType) const
+{
+	if(messageTypes.empty())
+		return true;
+
+	for(u32 type : messageTypes)
+		if(type == messageType)
+			return true;
+
+	return false;
+}
+
+void PluginListeners::reserve(u32 numSenders)
+{
+	if(m_senders.size() < numSenders)
+		m_senders.resize(numSenders + 5);
+}
+
+void PluginListeners::add(PluginHandle sender, PluginHandle listener, OBSEMessagingInterface::EventCallback handler, const u32 * messageTypes, u32 numMessageTypes, bool replace)
+{
+	reserve(sender + 1);
+
+	Sender & entries = m_senders[sender];
+
+	if(entries.slots.size() <= listener)
+		entries.slots.resize(listener + 1, 0);
+
+	u32 slot = entries.slots[listener];
+	Listener * entry;
+
+	if(slot)
+	{
+		if(!replace)
+			return;
+
+		entry = &entries.listeners[slot - 1];
+	}
+	else
+	{
+		entries.listeners.emplace_back();
+		entries.slots[listener] = u32(entries.listeners.size());
+
+		entry = &entries.listeners.back();
+	}
+
+	entry->listener = listener;
+	entry->handleMessage = handler;
+	entry->messageTypes.assign(messageTypes, messageTypes + numMessageTypes);
+}
+
+bool PluginListeners::deliver(PluginHandle sender, const char * senderName, PluginHandle target, u32 messageType, void * data, u32 dataLen)
+{
+	if(sender >= m_senders.size())	// no listeners registered for this sender yet
+		return false;
+
+	OBSEMessagingInterface::Message msg;
+
+	// handlers may register more listeners while this is running, so nothing is held across the calls
+	if(target != kPluginHandle_Invalid)	// sending message to specific plugin
+	{
+		const Sender & entries = m_senders[sender];
+
+		if((target >= entries.slots.size()) || !entries.slots[target])
+			return false;
+
+		const Listener & listener = entries.listeners[entries.slots[target] - 1];
+		if(!listener.wants(messageType))
+			return false;
+
+		msg.data = data;
+		msg.type = messageType;
+		msg.sender = senderName;
+		msg.dataLen = dataLen;
+
+		listener.handleMessage(&msg);
+		return true;
+	}
+
+	u32 numRespondents = 0;
+
+	for(size_t i = 0; i < m_senders[sender].listeners.size(); i++)
+	{
+		const Listener & listener = m_senders[sender].listeners[i];
+
+		if(!listener.wants(messageType))
+			continue;
+
+		// fresh copy each time, handlers are allowed to modify it
+		msg.data = data;
+		msg.type = messageType;
+		msg.sender = senderName;
+		msg.dataLen = dataLen;
+
+		OBSEMessagingInterface::EventCallback handleMessage = listener.handleMessage;
+		handleMessage(&msg);
+
+		numRespondents++;
+	}
+
+	return numRespondents ? true : false;
+}
+
+bool PluginListeners::isListening(PluginHandle sender, PluginHandle listener) const
+{
+	if(sender >= m_senders.size())
+		return false;
+
+	const Sender & entries = m_senders[sender];
+
+	return (listener < entries.slots.size()) && entries.slots[listener];
+}
+
+u32 PluginListeners::numListeners(PluginHandle sender) const
+{
+	return (sender < m_senders.size()) ? u32(m_senders[sender].listeners.size()) : 0;
+}
+
+// case insensitive FNV-1a, to match the _stricmp comparison
+static u32 HashPluginName(const char * name)
+{
+	u32 hash = 2166136261U;
+
+	for(; *name; name++)
+	{
+		hash ^= u8(tolower(u8(*name)));
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+void PluginNameIndex::build(const std::vector <const char *> & names)
+{
+	size_t size = 16;
+	while(size < names.size() * 2)
+		size <<= 1;
+
+	Entry empty = { 0, kPluginHandle_Invalid, nullptr };
+	m_entries.assign(size, empty);
+
+	for(size_t i = 0; i < names.size(); i++)
+	{
+		u32 hash = HashPluginName(names[i]);
+
+		// entries are added in list order, so duplicate names still resolve to the first plugin
+		size_t slot = hash & (size - 1);
+		while(m_entries[slot].handle != kPluginHandle_Invalid)
+			slot = (slot + 1) & (size - 1);
+
+		m_entries[slot].hash = hash;
+		m_entries[slot].handle = PluginHandle(i + 1);
+		m_entries[slot].name = names[i];
+	}
+}
+
+PluginHandle PluginNameIndex::lookup(const char * name) const
+{
+	if(m_entries.empty())
+		return kPluginHandle_Invalid;
+
+	u32 hash = HashPluginName(name);
+	size_t mask = m_entries.size() - 1;
+
+	for(size_t slot = hash & mask; m_entries[slot].handle != kPluginHandle_Invalid; slot = (slot + 1) & mask)
+	{
+		const Entry & entry = m_entries[slot];
+
+		if((entry.hash == hash) && !_stricmp(entry.name, name))
+			return entry.handle;
+	}
+
+	return kPluginHandle_Invalid;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "obse64/PluginAPI.h"
+#include "obse64_common/Types.h"
+#include <vector>
+
+// who listens to each plugin's messages, indexed by the sender's handle. 0 is OBSE itself
+//
+// each sender keeps its listeners in registration order and a table from listener handle to entry, so a
+// targeted message doesn't search and a broadcast only visits the plugins that asked for it. listeners
+// can filter by message type. handlers may register more listeners while a message is delivered
+
+class PluginListeners
+{
+public:
+	// room for senders below numSenders, plus a few spare for plugins registering while others load
+	void	reserve(u32 numSenders);
+	u32		numSenders() const	{ return u32(m_senders.size()); }
+
+	// numMessageTypes 0 = every type
+	// replace: update the handler and filter of an existing registration instead of keeping the old one
+	void	add(PluginHandle sender, PluginHandle listener, OBSEMessagingInterface::EventCallback handler, const u32 * messageTypes, u32 numMessageTypes, bool replace);
+
+	// target kPluginHandle_Invalid = every listener. false if nobody took it
+	bool	deliver(PluginHandle sender, const char * senderName, PluginHandle target, u32 messageType, void * data, u32 dataLen);
+
+	bool	isListening(PluginHandle sender, PluginHandle listener) const;
+	u32		numListeners(PluginHandle sender) const;
+
+private:
+	struct Listener
+	{
+		PluginHandle	listener;
+		OBSEMessagingInterface::EventCallback	handleMessage;
+		std::vector <u32>	messageTypes;	// empty = every type
+
+		bool	wants(u32 messageType) const;
+	};
+
+	struct Sender
+	{
+		std::vector <Listener>	listeners;
+		std::vector <u32>		slots;	// listener handle -> index in to listeners + 1, 0 = not registered
+	};
+
+	std::vector <Sender>	m_senders;
+};
+
+// case insensitive plugin name to handle lookup, open addressing on a FNV hash
+//
+// names[i] gets handle i + 1. duplicate names resolve to the first plugin. the names have to stay valid
+// until the next build
+
+class PluginNameIndex
+{
+public:
+	void			build(const std::vector <const char *> & names);
+
+	// kPluginHandle_Invalid if it isn't there
+	PluginHandle	lookup(const char * name) const;
+
+private:
+	struct Entry
+	{
+		u32				hash;
+		PluginHandle	handle;	// kPluginHandle_Invalid = empty
+		const char		* name;
+	};
+
+	std::vector <Entry>	m_entries;	// power of two size, at most half full
+};
@@ -0,0 +1,46 @@
+#include "PluginStats.h"
+#include "PluginMessaging.h"
+#include <algorithm>
+
+const char * const kPluginStatsHeader = "handle  scan ms  preload ms    load ms  branch  local  senders  listeners  name";
+
+void CountPluginMessaging(const PluginListeners & listeners, u32 numPlugins, PluginHandle handle, PluginHandle senderHandle, PluginStats * out)
+{
+	out->numSenders = 0;
+
+	// the listener table has spare entries past the loaded plugins
+	for(u32 i = 0; i <= numPlugins; i++)
+		if(listeners.isListening(i, handle))
+			out->numSenders++;
+
+	out->numListeners = listeners.numListeners(senderHandle);
+}
+
+static u64 TotalTime(const PluginStats & entry)
+{
+	u64 result = 0;
+
+	for(u64 time : entry.phaseMicroseconds)
+		result += time;
+
+	return result;
+}
+
+void SortPluginStats(std::vector <PluginStats> & stats)
+{
+	std::stable_sort(stats.begin(), stats.end(), [](const PluginStats & lhs, const PluginStats & rhs) { return TotalTime(lhs) > TotalTime(rhs); });
+}
+
+void FormatPluginStats(const PluginStats & entry, char * dst, size_t dstLen)
+{
+	sprintf_s(dst, dstLen, "%6u %8.3f %11.3f %10.3f %7llu %6llu %8u %10u  %s",
+		entry.handle,
+		entry.phaseMicroseconds[OBSEPluginStatsInterface::kPhase_Scan] / 1000.0,
+		entry.phaseMicroseconds[OBSEPluginStatsInterface::kPhase_Preload] / 1000.0,
+		entry.phaseMicroseconds[OBSEPluginStatsInterface::kPhase_Load] / 1000.0,
+		(unsigned long long)entry.branchPoolBytes,
+		(unsigned long long)entry.localPoolBytes,
+		entry.numSenders,
+		entry.numListeners,
+		entry.name ? entry.name : "");
+}
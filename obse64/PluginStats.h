@@ -0,0 +1,23 @@
+#pragma once
+
+#include "obse64/PluginAPI.h"
+#include "obse64_common/Types.h"
+#include <vector>
+
+class PluginListeners;
+
+// the startup table PluginManager writes to obse64.txt, kept apart from the loader so the tools can check it
+
+typedef OBSEPluginStatsInterface::PluginStats	PluginStats;
+
+// numSenders and numListeners for one plugin. listeners register with the handle the plugin was given (handle),
+// messages are sent from its place in the load order (senderHandle, index + 1)
+void	CountPluginMessaging(const PluginListeners & listeners, u32 numPlugins, PluginHandle handle, PluginHandle senderHandle, PluginStats * out);
+
+// slowest first by the total of every phase, ties stay in load order
+void	SortPluginStats(std::vector <PluginStats> & stats);
+
+// one row of the table, lined up with kPluginStatsHeader
+void	FormatPluginStats(const PluginStats & entry, char * dst, size_t dstLen);
+
+extern const char * const	kPluginStatsHeader;
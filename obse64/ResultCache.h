@@ -0,0 +1,85 @@
+#pragma once
+
+#include "obse64_common/Types.h"
+
+// direct mapped cache of a pure command's results, keyed on the raw bits of its arguments
+// one per command flagged kCmdFlag_Pure, only used from the thread running scripts
+
+class ResultCache
+{
+public:
+	enum
+	{
+		kIndexBits = 6,
+		kNumEntries = 1 << kIndexBits,
+	};
+
+	ResultCache()
+	{
+		clear();
+	}
+
+	bool	lookup(u64 key, double * result)
+	{
+		const Entry & entry = m_entries[slot(key)];
+
+		if(entry.valid && (entry.key == key))
+		{
+			m_hits++;
+			*result = entry.value;
+
+			return true;
+		}
+
+		m_misses++;
+
+		return false;
+	}
+
+	void	store(u64 key, double value)
+	{
+		Entry & entry = m_entries[slot(key)];
+
+		entry.key = key;
+		entry.value = value;
+		entry.valid = true;
+	}
+
+	void	clear()
+	{
+		for(Entry & entry : m_entries)
+			entry.valid = false;
+
+		resetStats();
+	}
+
+	void	resetStats()
+	{
+		m_hits = 0;
+		m_misses = 0;
+	}
+
+	u64		hits() const	{ return m_hits; }
+	u64		misses() const	{ return m_misses; }
+
+private:
+	struct Entry
+	{
+		u64		key;
+		double	value;
+		bool	valid;
+	};
+
+	// float arguments differ mostly in the high bits of each half, mix everything in to the top bits
+	static u32	slot(u64 key)
+	{
+		key ^= key >> 29;
+		key *= 0xBF58476D1CE4E5B9ULL;
+
+		return u32(key >> (64 - kIndexBits));
+	}
+
+	Entry	m_entries[kNumEntries];
+	u64		m_hits;
+	u64		m_misses;
+};
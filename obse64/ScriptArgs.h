@@ -0,0 +1,154 @@
+#pragma once
+
+#include "GameScript.h"
+#include <cstring>
+
+// fast path for ExtractArgs with the common fixed signatures
+//	u32			kParamType_Integer
+//	float		kParamType_Float
+//	char[N]		kParamType_String
+//
+// arguments compiled as literals are read straight from the script data. anything else (local variables,
+// globals, references, a literal that would need a lossy conversion, a string that doesn't fit) goes through
+// the game's ExtractArgs, so the results are always what the game would have produced
+//
+// script data at *opcodeOffsetPtr: u16 number of arguments, then each argument
+//	numeric	u8 type, 'n' = u32 literal, 'z' = double literal, anything else is a variable
+//	string	u16 length, chars (not terminated)
+
+namespace ScriptArgs
+{
+	enum
+	{
+		kArg_Int = 'n',
+		kArg_Double = 'z',
+	};
+
+	template <typename T>
+	inline T read(const u8 * src)
+	{
+		T result;
+		memcpy(&result, src, sizeof(result));
+		return result;
+	}
+
+	// each returns false to fall back to ExtractArgs
+
+	inline bool decode(const u8 *& data, const ParamInfo & info, u32 * out)
+	{
+		if(info.typeID != kParamType_Integer)
+			return false;
+
+		if(data[0] == kArg_Int)
+		{
+			*out = read <u32>(data + 1);
+			data += 1 + 4;
+
+			return true;
+		}
+
+		if(data[0] == kArg_Double)
+		{
+			// only where every way of truncating agrees
+			double value = read <double>(data + 1);
+			if(!(value >= 0) || (value >= 2147483648.0))
+				return false;
+
+			*out = u32(value);
+			data += 1 + 8;
+
+			return true;
+		}
+
+		return false;
+	}
+
+	inline bool decode(const u8 *& data, const ParamInfo & info, float * out)
+	{
+		if(info.typeID != kParamType_Float)
+			return false;
+
+		if(data[0] == kArg_Double)
+		{
+			*out = float(read <double>(data + 1));
+			data += 1 + 8;
+
+			return true;
+		}
+
+		if(data[0] == kArg_Int)
+		{
+			// signed and unsigned agree
+			u32 value = read <u32>(data + 1);
+			if(value >= 0x80000000)
+				return false;
+
+			*out = float(value);
+			data += 1 + 4;
+
+			return true;
+		}
+
+		return false;
+	}
+
+	template <size_t N>
+	inline bool decode(const u8 *& data, const ParamInfo & info, char (* out)[N])
+	{
+		if(info.typeID != kParamType_String)
+			return false;
+
+		u16 len = read <u16>(data);
+		if(len >= N)
+			return false;
+
+		memcpy(*out, data + 2, len);
+		(*out)[len] = 0;
+
+		data += 2 + len;
+
+		return true;
+	}
+
+	inline bool decodeArgs(const u8 *& data, const ParamInfo * paramInfo, u32 numArgs, u32 idx)
+	{
+		return true;
+	}
+
+	template <typename T, typename... Rest>
+	inline bool decodeArgs(const u8 *& data, const ParamInfo * paramInfo, u32 numArgs, u32 idx, T * out, Rest *... rest)
+	{
+		if(idx < numArgs)
+		{
+			if(!decode(data, paramInfo[idx], out))
+				return false;
+		}
+		else if(!paramInfo[idx].isOptional)
+		{
+			return false;	// let the game report it
+		}
+
+		return decodeArgs(data, paramInfo, numArgs, idx + 1, rest...);
+	}
+}
+
+// drop-in replacement for ExtractArgs, call with EXTRACT_ARGS
+template <typename... Args>
+bool ExtractArgsFast(const ParamInfo * paramInfo, const char * scriptData, u32 * opcodeOffsetPtr,
+	TESObjectREFR * thisObj, TESObjectREFR * containingObj, Script * script, ScriptLocals * locals, Args *... args)
+{
+	const u8 * start = (const u8 *)scriptData + *opcodeOffsetPtr;
+	const u8 * data = start + 2;
+
+	u16 numArgs = ScriptArgs::read <u16>(start);
+
+	if((numArgs <= sizeof...(Args)) && ScriptArgs::decodeArgs(data, paramInfo, numArgs, 0, args...))
+	{
+		// consumed the same way the game does
+		*opcodeOffsetPtr += u32(data - start);
+
+		return true;
+	}
+
+	return ExtractArgs(paramInfo, scriptData, opcodeOffsetPtr, thisObj, containingObj, script, locals, args...);
+}
@@ -0,0 +1,152 @@
+#include "SignatureCache.h"
+#include "obse64_common/BlockCompression.h"
+#include "obse64_common/FileStream.h"
+#include "obse64_common/Log.h"
+#include <cstring>
+#include <vector>
+#include <Windows.h>
+
+SignatureCache::SignatureCache()
+:m_imageHash(0)
+,m_hits(0)
+,m_dirty(false)
+{
+	//
+}
+
+void SignatureCache::load(const char * path, u64 imageHash)
+{
+	m_entries.clear();
+	m_imageHash = imageHash;
+	m_hits = 0;
+	m_dirty = false;
+
+	FileStream file;
+	if (!file.open(path))
+		return;
+
+	u64 fileLen = file.length();
+	if ((fileLen < kHeaderSize) || (fileLen > kHeaderSize + kMaxEntries * kEntrySize))
+		return;
+
+	std::vector <u8> data(fileLen);
+	if (file.read(data.data(), fileLen) != fileLen)
+		return;
+
+	u32 magic, numEntries, checksum;
+	u16 version, entrySize;
+	u64 fileImageHash;
+
+	memcpy(&magic, data.data(), sizeof(magic));
+	memcpy(&version, data.data() + 4, sizeof(version));
+	memcpy(&entrySize, data.data() + 6, sizeof(entrySize));
+	memcpy(&fileImageHash, data.data() + 8, sizeof(fileImageHash));
+	memcpy(&numEntries, data.data() + 16, sizeof(numEntries));
+	memcpy(&checksum, data.data() + 20, sizeof(checksum));
+
+	if ((magic != kMagic) || (version != kVersion) || (entrySize != kEntrySize))
+		return;
+
+	// a different build of the game, everything has to be found again
+	if (fileImageHash != imageHash)
+	{
+		m_dirty = true;
+		return;
+	}
+
+	if ((fileLen != kHeaderSize + u64(numEntries) * kEntrySize) ||
+		(blockChecksum(data.data() + kHeaderSize, size_t(fileLen - kHeaderSize)) != checksum))
+	{
+		_WARNING_C(Plugins, "signature cache %s is damaged, discarding it", path);
+
+		m_dirty = true;
+		return;
+	}
+
+	for (u32 i = 0; i < numEntries; i++)
+	{
+		const u8 * src = data.data() + kHeaderSize + i * kEntrySize;
+
+		u64 patternHash;
+		SignatureScanner::Result result;
+
+		memcpy(&patternHash, src, sizeof(patternHash));
+		memcpy(&result.offset, src + 8, sizeof(result.offset));
+		memcpy(&result.numMatches, src + 16, sizeof(result.numMatches));
+
+		m_entries[patternHash] = result;
+	}
+}
+
+bool SignatureCache::save(const char * path)
+{
+	if (!m_dirty)
+		return true;
+
+	u32 magic = kMagic;
+	u16 version = kVersion;
+	u16 entrySize = kEntrySize;
+	u32 numEntries = u32(m_entries.size());
+
+	std::vector <u8> data(kHeaderSize + numEntries * kEntrySize);
+	u8 * dst = data.data() + kHeaderSize;
+
+	for (auto & iter : m_entries)
+	{
+		memcpy(dst, &iter.first, sizeof(iter.first));
+		memcpy(dst + 8, &iter.second.offset, sizeof(iter.second.offset));
+		memcpy(dst + 16, &iter.second.numMatches, sizeof(iter.second.numMatches));
+
+		dst += kEntrySize;
+	}
+
+	u32 checksum = blockChecksum(data.data() + kHeaderSize, data.size() - kHeaderSize);
+
+	memcpy(data.data(), &magic, sizeof(magic));
+	memcpy(data.data() + 4, &version, sizeof(version));
+	memcpy(data.data() + 6, &entrySize, sizeof(entrySize));
+	memcpy(data.data() + 8, &m_imageHash, sizeof(m_imageHash));
+	memcpy(data.data() + 16, &numEntries, sizeof(numEntries));
+	memcpy(data.data() + 20, &checksum, sizeof(checksum));
+
+	if (!FileStream::replaceFile(path, data.data(), data.size()))
+	{
+		_WARNING_C(Plugins, "couldn't write signature cache %s (%08X)", path, GetLastError());
+		return false;
+	}
+
+	m_dirty = false;
+
+	return true;
+}
+
+bool SignatureCache::lookup(u64 patternHash, SignatureScanner::Result * result)
+{
+	auto iter = m_entries.find(patternHash);
+	if (iter == m_entries.end())
+		return false;
+
+	*result = iter->second;
+
+	m_hits++;
+
+	return true;
+}
+
+void SignatureCache::update(u64 patternHash, const SignatureScanner::Result & result)
+{
+	auto iter = m_entries.find(patternHash);
+
+	if (iter != m_entries.end())
+	{
+		if ((iter->second.offset == result.offset) && (iter->second.numMatches == result.numMatches))
+			return;
+	}
+	else if (m_entries.size() >= kMaxEntries)
+	{
+		return;
+	}
+
+	m_entries[patternHash] = result;
+	m_dirty = true;
+}
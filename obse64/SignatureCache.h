@@ -0,0 +1,50 @@
+#pragma once
+
+#include "obse64_common/SignatureScanner.h"
+#include "obse64_common/Types.h"
+#include <unordered_map>
+
+// remembers signature scan results between launches, so plugins' patterns aren't searched for every time
+//
+// results belong to one build of the game, identified by PEImage::headerHash. the whole cache is thrown
+// away when that changes, or if anything in the file doesn't match
+//
+// file layout:
+//	header	u32 magic ('OBSC'), u16 version, u16 entry size, u64 image hash, u32 entry count, u32 checksum
+//	entries	u64 pattern hash, u64 rva of the first match, u32 number of matches
+//	the checksum covers all of the entries
+
+class SignatureCache
+{
+public:
+	enum
+	{
+		kMagic = 0x4353424F,	// "OBSC" on disk
+		kVersion = 1,
+
+		kHeaderSize = 24,
+		kEntrySize = 8 + 8 + 4,
+
+		kMaxEntries = 0x10000,
+	};
+
+	SignatureCache();
+
+	// missing, invalid, or out of date files just leave the cache empty
+	void	load(const char * path, u64 imageHash);
+
+	// only if anything changed
+	bool	save(const char * path);
+
+	bool	lookup(u64 patternHash, SignatureScanner::Result * result);
+	void	update(u64 patternHash, const SignatureScanner::Result & result);
+
+	u32		hits() const { return m_hits; }
+
+private:
+	std::unordered_map <u64, SignatureScanner::Result>	m_entries;
+
+	u64		m_imageHash;
+	u32		m_hits;
+	bool	m_dirty;
+};
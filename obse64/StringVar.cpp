@@ -1,4 +1,5 @@
 #include "StringVar.h"
+#include "FormatString.h"
 #include "GameConsole.h"
 #include "GameForms.h"
 #include "GameScript.h"
@@ -320,6 +321,13 @@ void StringVarMap::Clean()		// clean up any temporary vars
 
 StringVarMap g_StringMap;
 
+const char * GetStringVarText(UInt32 id)
+{
+	StringVar * var = g_StringMap.Get(id);
+
+	return var ? std::get<0>(var->GetCString()) : "";
+}
+
 // Simplified AssignToStringVar for OBSE64
 // Removed dependency on ExpressionEvaluator and ExtractSetStatementVar
 bool AssignToStringVar(ParamInfo * paramInfo, void * arg1, TESObjectREFR * thisObj, TESObjectREFR* contObj, Script * scriptObj, ScriptEventList * eventList, double * result, UInt32 * opcodeOffsetPtr, const char* newValue)
@@ -330,8 +338,7 @@ bool AssignToStringVar(ParamInfo * paramInfo, void * arg1, TESObjectREFR * thisO
 	StringVar* strVar = NULL;
 
 	UInt32 len = (newValue) ? strlen(newValue) : 0;
-	const UInt32 kMaxMessageLength = 0x4000;
-	if (!newValue || len >= kMaxMessageLength)		//if null pointer or too long, assign an empty string
+	if (!newValue || len >= kMaxStringVarLength)		//if null pointer or too long, assign an empty string
 		newValue = "";
 
 	// Simplified: For now, always create new string vars
@@ -64,6 +64,9 @@ struct ParamInfo;
 class TESObjectREFR;
 struct ScriptEventList;
 
+// AssignToStringVar assigns an empty string instead of anything this long or longer
+const UInt32 kMaxStringVarLength = 0x4000;
+
 bool AssignToStringVar(ParamInfo * paramInfo, void * arg1, TESObjectREFR * thisObj, TESObjectREFR* contObj, Script * scriptObj, ScriptEventList * eventList, double * result, UInt32 * opcodeOffsetPtr, const char* newValue);
 
 namespace PluginAPI
@@ -49,6 +49,23 @@ extern "C" {
 		AddScriptCommand(kCommandInfo_ar_Size);
 		AddScriptCommand(kCommandInfo_ar_Construct);
 
+		// added since the first release, registered after the original commands
+		AddScriptCommand(kCommandInfo_VarlaBeginFile);
+		AddScriptCommand(kCommandInfo_VarlaCommitFile);
+		AddScriptCommand(kCommandInfo_VarlaAbortFile);
+		AddScriptCommand(kCommandInfo_SetLogRotation);
+		AddScriptCommand(kCommandInfo_ReadFromLogHistory);
+		AddScriptCommand(kCommandInfo_ar_ExportJSON);
+		AddScriptCommand(kCommandInfo_ar_ImportJSON);
+		AddScriptCommand(kCommandInfo_ar_ToJSON);
+		AddScriptCommand(kCommandInfo_ar_FromJSON);
+		AddScriptCommand(kCommandInfo_KVSet);
+		AddScriptCommand(kCommandInfo_KVGet);
+		AddScriptCommand(kCommandInfo_KVHas);
+		AddScriptCommand(kCommandInfo_KVDelete);
+		AddScriptCommand(kCommandInfo_KVKeys);
+		AddScriptCommand(kCommandInfo_KVCompact);
+
 		return true;
 	}
 }
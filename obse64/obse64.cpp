@@ -54,6 +54,13 @@ void installBaseHooks(void)
 {
 	DebugLog::openRelative(CSIDL_MYDOCUMENTS, "\\My Games\\" SAVE_FOLDER_NAME "\\OBSE\\Logs\\obse64.txt");
 
+	// [Debug] BinaryLog=1 records messages unformatted, render them with "obse64_tools decode obse64.bin"
+	u32 binaryLog = 0;
+	if(getConfigOption_u32("Debug", "BinaryLog", &binaryLog) && binaryLog)
+		DebugLog::openBinaryRelative(CSIDL_MYDOCUMENTS, "\\My Games\\" SAVE_FOLDER_NAME "\\OBSE\\Logs\\obse64.bin");
+
+	DebugLog::readConfig();
+
 	HANDLE exe = GetModuleHandle(nullptr);
 
 	// fetch functions to hook
@@ -0,0 +1,207 @@
+#include "AddressLibrary.h"
+#include "obse64_common/MappedFile.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	// bounds checked little endian reads, sticks on failure
+	class Reader
+	{
+	public:
+		Reader(const u8 * data, size_t len)
+			:m_cur(data), m_end(data + len), m_ok(true) { }
+
+		template <typename T>
+		T read()
+		{
+			T result = 0;
+
+			if(size_t(m_end - m_cur) < sizeof(T))
+			{
+				m_ok = false;
+				m_cur = m_end;
+			}
+			else
+			{
+				memcpy(&result, m_cur, sizeof(T));
+				m_cur += sizeof(T);
+			}
+
+			return result;
+		}
+
+		void skip(size_t len)
+		{
+			if(size_t(m_end - m_cur) < len)
+			{
+				m_ok = false;
+				m_cur = m_end;
+			}
+			else
+			{
+				m_cur += len;
+			}
+		}
+
+		bool	ok() const	{ return m_ok; }
+
+	private:
+		const u8	* m_cur;
+		const u8	* m_end;
+		bool		m_ok;
+	};
+
+	enum
+	{
+		kMaxNameLen = 0x1000,
+		kMaxEntries = 0x4000000,
+
+		// dense arrays up to this many slots per entry are always used
+		kMaxDenseRatio = 4,
+		kMinDenseSize = 0x10000,
+	};
+
+	inline u64 decodeValue(Reader & src, u32 type, u64 prev)
+	{
+		switch(type)
+		{
+			case 0: return src.read <u64>();
+			case 1: return prev + 1;
+			case 2: return prev + src.read <u8>();
+			case 3: return prev - src.read <u8>();
+			case 4: return prev + src.read <u16>();
+			case 5: return prev - src.read <u16>();
+			case 6: return src.read <u16>();
+			default: return src.read <u32>();
+		}
+	}
+}
+
+AddressLibrary::AddressLibrary()
+:m_numEntries(0)
+{
+	memset(m_version, 0, sizeof(m_version));
+}
+
+bool AddressLibrary::load(const char * path)
+{
+	clear();
+
+	// only needed while decoding
+	MappedFile file;
+	if(!file.open(path))
+		return false;
+
+	return parse(file.data(), file.size());
+}
+
+bool AddressLibrary::parse(const void * data, size_t len)
+{
+	clear();
+
+	Reader src((const u8 *)data, len);
+
+	s32 format = src.read <s32>();
+	if((format != 1) && (format != 2))
+		return false;
+
+	u32 version[4];
+	for(u32 i = 0; i < 4; i++)
+		version[i] = src.read <u32>();
+
+	s32 nameLen = src.read <s32>();
+	if((nameLen < 0) || (nameLen > kMaxNameLen))
+		return false;
+
+	src.skip(nameLen);
+
+	s32 pointerSize = src.read <s32>();
+	s32 numEntries = src.read <s32>();
+
+	if(!src.ok() || (pointerSize <= 0) || (numEntries < 0) || (numEntries > kMaxEntries))
+		return false;
+
+	std::vector <Entry> entries(numEntries);
+
+	u64 prevID = 0;
+	u64 prevOffset = 0;
+	u64 maxID = 0;
+	u64 maxOffset = 0;
+
+	for(Entry & entry : entries)
+	{
+		u8 type = src.read <u8>();
+		u32 idType = type & 0xF;
+		u32 offsetType = type >> 4;
+
+		if((idType > 7) || !src.ok())
+			return false;
+
+		u64 id = decodeValue(src, idType, prevID);
+
+		u64 offset;
+		if(offsetType & 8)
+			offset = decodeValue(src, offsetType & 7, prevOffset / pointerSize) * pointerSize;
+		else
+			offset = decodeValue(src, offsetType, prevOffset);
+
+		entry.id = id;
+		entry.offset = offset;
+
+		maxID = std::max(maxID, id);
+		maxOffset = std::max(maxOffset, offset);
+
+		prevID = id;
+		prevOffset = offset;
+	}
+
+	if(!src.ok())
+		return false;
+
+	if((maxOffset <= 0xFFFFFFFF) && (maxID < std::max <u64>(u64(numEntries) * kMaxDenseRatio, kMinDenseSize)))
+	{
+		m_dense.assign(size_t(maxID + 1), 0);
+
+		// a repeated id keeps the last offset
+		for(const Entry & entry : entries)
+			m_dense[size_t(entry.id)] = u32(entry.offset);
+	}
+	else
+	{
+		std::stable_sort(entries.begin(), entries.end());
+
+		for(const Entry & entry : entries)
+		{
+			if(!m_sparse.empty() && (m_sparse.back().id == entry.id))
+				m_sparse.back() = entry;
+			else
+				m_sparse.push_back(entry);
+		}
+	}
+
+	m_numEntries = numEntries;
+	memcpy(m_version, version, sizeof(m_version));
+
+	return true;
+}
+
+void AddressLibrary::clear()
+{
+	std::vector <u32>().swap(m_dense);
+	std::vector <Entry>().swap(m_sparse);
+
+	m_numEntries = 0;
+	memset(m_version, 0, sizeof(m_version));
+}
+
+u64 AddressLibrary::getSparseOffset(u64 id) const
+{
+	Entry key = { id, 0 };
+
+	auto iter = std::lower_bound(m_sparse.begin(), m_sparse.end(), key);
+	if((iter == m_sparse.end()) || (iter->id != id))
+		return 0;
+
+	return iter->offset;
+}
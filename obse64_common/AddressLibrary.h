@@ -0,0 +1,62 @@
+#pragma once
+
+#include "obse64_common/Types.h"
+#include <vector>
+
+// reads an Address Library database (versionlib-*.bin), maps stable ids to offsets from the game's base address
+//
+// the whole table is decoded once and lookups don't touch the file again. ids are dense in practice, so they
+// index an array directly. a database with very sparse ids falls back to a sorted array and a binary search
+//
+// file layout, everything little endian:
+//	header	s32 format (1 or 2), s32 game version[4], s32 name length, name (not terminated),
+//			s32 pointer size, s32 entry count
+//	entries	u8 type, then the id and offset encoded as described by the type
+//		low nibble, id relative to the previous id
+//			0 u64, 1 +1, 2 +u8, 3 -u8, 4 +u16, 5 -u16, 6 u16, 7 u32
+//		high nibble, offset relative to the previous offset, same encodings in the low three bits
+//			8 set: the offset is stored divided by the pointer size, and so is the previous offset it's relative to
+
+class AddressLibrary
+{
+public:
+	AddressLibrary();
+
+	// replaces anything already loaded. false if the file can't be read or is damaged, leaving the library empty
+	bool	load(const char * path);
+	bool	parse(const void * data, size_t len);
+
+	void	clear();
+
+	// 0 if the id isn't in the database
+	u64		getOffset(u64 id) const
+	{
+		if(id < m_dense.size())
+			return m_dense[id];
+
+		return m_sparse.empty() ? 0 : getSparseOffset(id);
+	}
+
+	bool	empty() const	{ return !m_numEntries; }
+	u32		size() const	{ return m_numEntries; }
+
+	// as stored in the header, major minor build sub
+	const u32 *	version() const	{ return m_version; }
+
+private:
+	struct Entry
+	{
+		u64	id;
+		u64	offset;
+
+		bool operator<(const Entry & rhs) const	{ return id < rhs.id; }
+	};
+
+	u64		getSparseOffset(u64 id) const;
+
+	std::vector <u32>	m_dense;	// indexed by id, 0 = missing
+	std::vector <Entry>	m_sparse;	// sorted by id, only if the ids are too spread out for m_dense
+
+	u32		m_numEntries;
+	u32		m_version[4];
+};
@@ -0,0 +1,475 @@
+#include "BinaryLog.h"
+#include <cstdio>
+#include <cstring>
+#include <cwchar>
+
+// wide strings are recorded as UTF-16, that's wchar_t on Windows. elsewhere (the offline tools) each unit is widened
+
+enum
+{
+	// formats needing more than this much space just for their fixed size arguments are recorded as text
+	kMaxFixedArgSize = 4096,
+
+	kNullString = 0xFFFF,
+	kMaxStringLen = 0xFFFE,
+};
+
+u32 BinaryLogFormat::minPackedSize(u8 type, u8 numStars)
+{
+	u32 result = numStars * sizeof(s32);
+
+	switch (type)
+	{
+		case kArg_Int32:	result += sizeof(s32); break;
+		case kArg_Int64:
+		case kArg_Double:
+		case kArg_Pointer:	result += sizeof(u64); break;
+		default:			result += sizeof(u16); break;	// strings, just the length
+	}
+
+	return result;
+}
+
+BinaryLogFormat::BinaryLogFormat(const char * fmt)
+:m_source(fmt)
+,m_tailOffset(0)
+,m_supported(true)
+{
+	const char * base = m_source.c_str();
+	const char * p = base;
+	const char * literalStart = p;
+
+	while (*p)
+	{
+		if (*p != '%')
+		{
+			p++;
+			continue;
+		}
+
+		Conversion conv = { 0 };
+		conv.literalOffset = u32(literalStart - base);
+		conv.literalLen = u32(p - literalStart);
+		conv.precision = -1;
+
+		const char * specStart = p++;
+
+		if (*p == '%')
+		{
+			p++;
+		}
+		else
+		{
+			while (*p && strchr("-+ #0", *p))
+				p++;
+
+			if (*p == '*')
+			{
+				conv.numStars++;
+				p++;
+			}
+			else
+			{
+				while ((*p >= '0') && (*p <= '9'))
+					p++;
+			}
+
+			if (*p == '.')
+			{
+				p++;
+
+				if (*p == '*')
+				{
+					conv.numStars++;
+					conv.starPrecision = 1;
+					p++;
+				}
+				else
+				{
+					conv.precision = 0;
+
+					while ((*p >= '0') && (*p <= '9'))
+					{
+						if (conv.precision < 0x10000)
+							conv.precision = conv.precision * 10 + (*p - '0');
+
+						p++;
+					}
+				}
+			}
+
+			// 'l' is 32 bits here, as is 'h' after promotion
+			bool is64 = false;
+			bool wide = false;
+
+			for (;;)
+			{
+				if ((*p == 'h') || (*p == 'L'))
+					p++;
+				else if ((*p == 'l') || (*p == 'w'))
+				{
+					wide = true;
+					p++;
+
+					if (*p == 'l')
+					{
+						is64 = true;
+						p++;
+					}
+				}
+				else if ((*p == 'z') || (*p == 'j') || (*p == 't'))
+				{
+					is64 = true;
+					p++;
+				}
+				else if (*p == 'I')
+				{
+					p++;
+
+					if ((p[0] == '3') && (p[1] == '2'))
+						p += 2;
+					else if ((p[0] == '6') && (p[1] == '4'))
+					{
+						is64 = true;
+						p += 2;
+					}
+					else
+						is64 = true;	// size_t
+				}
+				else
+					break;
+			}
+
+			conv.hasValue = 1;
+
+			switch (*p)
+			{
+				case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+					conv.type = is64 ? kArg_Int64 : kArg_Int32;
+					break;
+
+				case 'c': case 'C':
+					conv.type = kArg_Int32;
+					break;
+
+				case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+					conv.type = kArg_Double;
+					break;
+
+				case 'p':
+					conv.type = kArg_Pointer;
+					break;
+
+				case 's':
+					conv.type = wide ? kArg_WideString : kArg_String;
+					break;
+
+				case 'S':
+					conv.type = kArg_WideString;
+					break;
+
+				default:
+					// %n, %Z, a truncated spec at the end of the string
+					m_supported = false;
+					return;
+			}
+
+			p++;
+		}
+
+		conv.specOffset = u32(m_specs.size());
+		m_specs.append(specStart, p - specStart);
+		m_specs += '\0';
+
+		m_conversions.push_back(conv);
+
+		literalStart = p;
+	}
+
+	m_tailOffset = u32(literalStart - base);
+
+	u32 tail = 0;
+
+	for (size_t i = m_conversions.size(); i > 0; i--)
+	{
+		Conversion & conv = m_conversions[i - 1];
+
+		conv.minTail = tail;
+
+		if (conv.hasValue)
+			tail += minPackedSize(conv.type, conv.numStars);
+	}
+
+	if (tail > kMaxFixedArgSize)
+		m_supported = false;
+}
+
+u32 BinaryLogFormat::pack(u8 * out, u32 outLen, va_list args) const
+{
+	u8 * dst = out;
+	u8 * end = out + outLen;
+
+	auto write = [&](const void * src, u32 len)
+	{
+		memcpy(dst, src, len);
+		dst += len;
+	};
+
+	for (const Conversion & conv : m_conversions)
+	{
+		if (!conv.hasValue)
+			continue;
+
+		if (u32(end - dst) < minPackedSize(conv.type, conv.numStars) + conv.minTail)
+			break;
+
+		s32 precision = conv.precision;
+
+		for (u32 i = 0; i < conv.numStars; i++)
+		{
+			s32 star = va_arg(args, s32);
+			write(&star, sizeof(star));
+
+			if (conv.starPrecision)
+				precision = star;
+		}
+
+		switch (conv.type)
+		{
+			case kArg_Int32:
+			{
+				s32 value = va_arg(args, s32);
+				write(&value, sizeof(value));
+			}
+			break;
+
+			case kArg_Int64:
+			{
+				s64 value = va_arg(args, s64);
+				write(&value, sizeof(value));
+			}
+			break;
+
+			case kArg_Double:
+			{
+				double value = va_arg(args, double);
+				write(&value, sizeof(value));
+			}
+			break;
+
+			case kArg_Pointer:
+			{
+				u64 value = u64(va_arg(args, void *));
+				write(&value, sizeof(value));
+			}
+			break;
+
+			case kArg_String:
+			case kArg_WideString:
+			{
+				bool wide = conv.type == kArg_WideString;
+				const void * str = wide ? (const void *)va_arg(args, const wchar_t *) : (const void *)va_arg(args, const char *);
+				size_t charSize = wide ? sizeof(u16) : sizeof(char);
+				u16 len = kNullString;
+
+				if (str)
+				{
+					// precision can be used with strings that aren't terminated, so don't read past it
+					size_t maxLen = (precision >= 0) ? size_t(precision) : size_t(kMaxStringLen);
+					size_t strLen = wide ? wcsnlen((const wchar_t *)str, maxLen) : strnlen((const char *)str, maxLen);
+
+					size_t avail = (end - dst - sizeof(len) - conv.minTail) / charSize;
+
+					if (strLen > avail)
+						strLen = avail;
+
+					len = u16(strLen);
+				}
+
+				write(&len, sizeof(len));
+
+				if (len == kNullString)
+					break;
+
+				if (!wide || (sizeof(wchar_t) == sizeof(u16)))
+				{
+					write(str, len * charSize);
+				}
+				else
+				{
+					for (u16 i = 0; i < len; i++)
+					{
+						u16 unit = u16(((const wchar_t *)str)[i]);
+						write(&unit, sizeof(unit));
+					}
+				}
+			}
+			break;
+		}
+	}
+
+	return u32(dst - out);
+}
+
+template <typename ... Args>
+static void appendFormatted(std::string * out, const char * spec, Args ... args)
+{
+	char buf[512];
+
+	int len = snprintf(buf, sizeof(buf), spec, args ...);
+	if (len < 0)
+		return;
+
+	if (len < int(sizeof(buf)))
+	{
+		out->append(buf, len);
+	}
+	else
+	{
+		size_t start = out->size();
+
+		out->resize(start + len + 1);
+		snprintf(&(*out)[start], len + 1, spec, args ...);
+		out->resize(start + len);
+	}
+}
+
+bool BinaryLogFormat::render(const u8 * data, u32 len, std::string * out) const
+{
+	const u8 * end = data + len;
+
+	auto read = [&](void * dst, size_t size)
+	{
+		if (size_t(end - data) < size)
+			return false;
+
+		memcpy(dst, data, size);
+		data += size;
+
+		return true;
+	};
+
+	std::string str;
+	std::wstring wstr;
+
+	for (const Conversion & conv : m_conversions)
+	{
+		out->append(m_source, conv.literalOffset, conv.literalLen);
+
+		const char * spec = m_specs.c_str() + conv.specOffset;
+
+		if (!conv.hasValue)
+		{
+			appendFormatted(out, spec);
+			continue;
+		}
+
+		s32 stars[2] = { 0 };
+
+		for (u32 i = 0; i < conv.numStars; i++)
+			if (!read(&stars[i], sizeof(stars[i])))
+				return false;
+
+		auto emit = [&](auto value)
+		{
+			if (conv.numStars == 0)
+				appendFormatted(out, spec, value);
+			else if (conv.numStars == 1)
+				appendFormatted(out, spec, stars[0], value);
+			else
+				appendFormatted(out, spec, stars[0], stars[1], value);
+		};
+
+		switch (conv.type)
+		{
+			case kArg_Int32:
+			{
+				s32 value;
+				if (!read(&value, sizeof(value)))
+					return false;
+
+				emit(value);
+			}
+			break;
+
+			case kArg_Int64:
+			{
+				s64 value;
+				if (!read(&value, sizeof(value)))
+					return false;
+
+				emit(value);
+			}
+			break;
+
+			case kArg_Double:
+			{
+				double value;
+				if (!read(&value, sizeof(value)))
+					return false;
+
+				emit(value);
+			}
+			break;
+
+			case kArg_Pointer:
+			{
+				u64 value;
+				if (!read(&value, sizeof(value)))
+					return false;
+
+				emit((void *)value);
+			}
+			break;
+
+			case kArg_String:
+			case kArg_WideString:
+			{
+				u16 strLen;
+				if (!read(&strLen, sizeof(strLen)))
+					return false;
+
+				bool wide = conv.type == kArg_WideString;
+
+				if (strLen == kNullString)
+				{
+					if (wide)
+						emit((const wchar_t *)nullptr);
+					else
+						emit((const char *)nullptr);
+
+					break;
+				}
+
+				if (wide)
+				{
+					wstr.resize(strLen);
+
+					for (u16 i = 0; i < strLen; i++)
+					{
+						u16 unit;
+						if (!read(&unit, sizeof(unit)))
+							return false;
+
+						wstr[i] = wchar_t(unit);
+					}
+
+					emit(wstr.c_str());
+				}
+				else
+				{
+					str.resize(strLen);
+					if (strLen && !read(&str[0], strLen))
+						return false;
+
+					emit(str.c_str());
+				}
+			}
+			break;
+		}
+	}
+
+	out->append(m_source, m_tailOffset, std::string::npos);
+
+	return data == end;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "obse64_common/Types.h"
+#include <cstdarg>
+#include <string>
+#include <vector>
+
+// binary debug log
+//
+// instead of formatting each message, the logger records which format string was used and the raw arguments
+// the text is rendered later by "obse64_tools decode", which parses the same format strings the same way
+//
+// file layout:
+//	header	u32 magic ('OBLB'), u16 version, u16 reserved, u64 TSC frequency, u64 TSC at open, u64 FILETIME at open
+//	records	u8 type, u8 level (low 4 bits) and channel, u16 total length, u32 format id, u64 TSC,
+//			u32 thread id, u32 frame, payload
+//		format	payload is the format string text, defines the id. always written before the first message using it
+//		message	payload is the packed arguments for the format
+//		text	payload is an already formatted message, for formats that can't be recorded unformatted
+//		frame	no payload, the game thread started the frame in the record header
+
+class BinaryLogFormat
+{
+public:
+	enum
+	{
+		kMagic = 0x424C424F,	// "OBLB" on disk
+		kVersion = 2,
+
+		kHeaderSize = 32,
+		kRecordHeaderSize = 24,
+	};
+
+	enum
+	{
+		kRecord_Format = 1,
+		kRecord_Message,
+		kRecord_Text,
+		kRecord_Frame,
+	};
+
+	explicit BinaryLogFormat(const char * fmt);
+
+	// false if the format uses something that can't be packed (%n, unknown conversions)
+	bool	isSupported() const { return m_supported; }
+
+	const std::string &	source() const { return m_source; }
+
+	// consumes the arguments, returns the packed length. strings are truncated to fit
+	u32		pack(u8 * out, u32 outLen, va_list args) const;
+
+	// renders packed arguments, returns false if they don't match the format
+	bool	render(const u8 * data, u32 len, std::string * out) const;
+
+private:
+	enum
+	{
+		kArg_Int32 = 0,
+		kArg_Int64,
+		kArg_Double,
+		kArg_Pointer,
+		kArg_String,		// u16 length (0xFFFF = null), chars
+		kArg_WideString,	// u16 length (0xFFFF = null), UTF-16 code units
+	};
+
+	struct Conversion
+	{
+		u32	literalOffset;	// text before the conversion, in to m_source
+		u32	literalLen;
+		u32	specOffset;		// null terminated copy of the spec, in to m_specs
+		u8	numStars;		// '*' width/precision, each an int argument before the value
+		u8	starPrecision;	// the last '*' is the precision
+		u8	type;
+		u8	hasValue;		// false for %%
+		s32	precision;		// -1 = none or '*'
+		u32	minTail;		// smallest packed size of the arguments after this one
+	};
+
+	static u32	minPackedSize(u8 type, u8 numStars);
+
+	std::string					m_source;
+	std::string					m_specs;
+	std::vector <Conversion>	m_conversions;
+	u32							m_tailOffset;	// text after the last conversion
+	bool						m_supported;
+};
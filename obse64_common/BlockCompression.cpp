@@ -0,0 +1,448 @@
+#include "BlockCompression.h"
+#include <algorithm>
+#include <cstring>
+
+enum
+{
+	kMinMatch = 4,
+	kMaxOffset = 0xFFFF,
+
+	// matches can't start in the last 12 bytes, the last 5 bytes are always literals
+	// keeps the decoder from needing extra bounds checks on the final sequence
+	kMatchStartLimit = 12,
+	kLastLiterals = 5,
+
+	kHashBits = 14,
+	kHashSize = 1 << kHashBits,
+};
+
+static inline u32 read32(const u8 * src)
+{
+	u32 result;
+	memcpy(&result, src, sizeof(result));
+	return result;
+}
+
+static inline u32 hashSequence(u32 sequence)
+{
+	return (sequence * 2654435761U) >> (32 - kHashBits);
+}
+
+// writes a 4-bit length overflow as a run of 255s and a remainder
+static inline u8 * writeLength(u8 * dst, size_t len)
+{
+	while (len >= 255)
+	{
+		*dst++ = 255;
+		len -= 255;
+	}
+
+	*dst++ = u8(len);
+
+	return dst;
+}
+
+static inline bool readLength(const u8 ** src, const u8 * srcEnd, size_t * len)
+{
+	const u8 * in = *src;
+	u8 data;
+
+	do
+	{
+		if (in >= srcEnd)
+			return false;
+
+		data = *in++;
+		*len += data;
+	} while (data == 255);
+
+	*src = in;
+
+	return true;
+}
+
+size_t lzCompressBound(size_t srcLen)
+{
+	return srcLen + (srcLen / 255) + 16;
+}
+
+size_t lzCompress(const void * srcBuf, size_t srcLen, void * dstBuf, size_t dstCap)
+{
+	const u8 * src = (const u8 *)srcBuf;
+	const u8 * srcEnd = src + srcLen;
+	const u8 * anchor = src;
+	const u8 * ip = src;
+
+	u8 * dst = (u8 *)dstBuf;
+	u8 * op = dst;
+	u8 * dstEnd = dst + dstCap;
+
+	if (srcLen > kMatchStartLimit)
+	{
+		std::vector <u32> hashTable(kHashSize, 0);
+
+		const u8 * matchStartLimit = srcEnd - kMatchStartLimit;
+		const u8 * matchEndLimit = srcEnd - kLastLiterals;
+
+		while (ip < matchStartLimit)
+		{
+			u32 sequence = read32(ip);
+			u32 hash = hashSequence(sequence);
+
+			const u8 * ref = src + hashTable[hash];
+			hashTable[hash] = u32(ip - src);
+
+			if ((ref >= ip) || (size_t(ip - ref) > kMaxOffset) || (read32(ref) != sequence))
+			{
+				ip++;
+				continue;
+			}
+
+			// extend backwards in to pending literals
+			while ((ip > anchor) && (ref > src) && (ip[-1] == ref[-1]))
+			{
+				ip--;
+				ref--;
+			}
+
+			const u8 * matchEnd = ip + kMinMatch;
+			const u8 * refEnd = ref + kMinMatch;
+
+			while ((matchEnd < matchEndLimit) && (*matchEnd == *refEnd))
+			{
+				matchEnd++;
+				refEnd++;
+			}
+
+			size_t literalLen = ip - anchor;
+			size_t matchLen = matchEnd - ip - kMinMatch;
+
+			// token + literal length + literals + offset + match length
+			size_t worstCase = 1 + (literalLen / 255) + 1 + literalLen + 2 + (matchLen / 255) + 1;
+			if (worstCase > size_t(dstEnd - op))
+				return 0;
+
+			u8 * token = op++;
+			*token = u8((std::min <size_t>(literalLen, 15) << 4) | std::min <size_t>(matchLen, 15));
+
+			if (literalLen >= 15)
+				op = writeLength(op, literalLen - 15);
+
+			memcpy(op, anchor, literalLen);
+			op += literalLen;
+
+			u16 offset = u16(ip - ref);
+			*op++ = u8(offset);
+			*op++ = u8(offset >> 8);
+
+			if (matchLen >= 15)
+				op = writeLength(op, matchLen - 15);
+
+			ip = matchEnd;
+			anchor = ip;
+
+			// seed the table from inside the match so runs keep chaining
+			if (ip - 2 >= src)
+				hashTable[hashSequence(read32(ip - 2))] = u32(ip - 2 - src);
+		}
+	}
+
+	// trailing literals, no match
+	size_t literalLen = srcEnd - anchor;
+
+	size_t worstCase = 1 + (literalLen / 255) + 1 + literalLen;
+	if (worstCase > size_t(dstEnd - op))
+		return 0;
+
+	*op++ = u8(std::min <size_t>(literalLen, 15) << 4);
+
+	if (literalLen >= 15)
+		op = writeLength(op, literalLen - 15);
+
+	// empty input has no source buffer to copy from
+	if (literalLen)
+		memcpy(op, anchor, literalLen);
+
+	op += literalLen;
+
+	return op - dst;
+}
+
+bool lzDecompress(const void * srcBuf, size_t srcLen, void * dstBuf, size_t dstLen)
+{
+	const u8 * ip = (const u8 *)srcBuf;
+	const u8 * srcEnd = ip + srcLen;
+
+	u8 * dst = (u8 *)dstBuf;
+	u8 * op = dst;
+	u8 * dstEnd = dst + dstLen;
+
+	while (ip < srcEnd)
+	{
+		u8 token = *ip++;
+
+		size_t literalLen = token >> 4;
+		if ((literalLen == 15) && !readLength(&ip, srcEnd, &literalLen))
+			return false;
+
+		if ((literalLen > size_t(srcEnd - ip)) || (literalLen > size_t(dstEnd - op)))
+			return false;
+
+		memcpy(op, ip, literalLen);
+		ip += literalLen;
+		op += literalLen;
+
+		// last sequence has no match
+		if (ip == srcEnd)
+			break;
+
+		if (srcEnd - ip < 2)
+			return false;
+
+		size_t offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+
+		if (!offset || (offset > size_t(op - dst)))
+			return false;
+
+		size_t matchLen = token & 0x0F;
+		if ((matchLen == 15) && !readLength(&ip, srcEnd, &matchLen))
+			return false;
+
+		matchLen += kMinMatch;
+
+		if (matchLen > size_t(dstEnd - op))
+			return false;
+
+		const u8 * ref = op - offset;
+
+		if (offset >= matchLen)
+		{
+			memcpy(op, ref, matchLen);
+			op += matchLen;
+		}
+		else
+		{
+			// overlapping copy repeats the pattern
+			while (matchLen--)
+				*op++ = *ref++;
+		}
+	}
+
+	return op == dstEnd;
+}
+
+u32 blockChecksum(const void * srcBuf, size_t len)
+{
+	// FNV-1a
+	const u8 * src = (const u8 *)srcBuf;
+	u32 hash = 2166136261U;
+
+	for (size_t i = 0; i < len; i++)
+	{
+		hash ^= src[i];
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+BlockCompressedWriter::BlockCompressedWriter(DataStream * dst, u32 blockSize)
+:m_dst(dst)
+,m_blockSize(blockSize)
+,m_rawBytes(0)
+,m_storedBytes(0)
+{
+	m_pending.reserve(blockSize);
+}
+
+BlockCompressedWriter::~BlockCompressedWriter()
+{
+	flush();
+}
+
+void BlockCompressedWriter::writeHeader()
+{
+	m_dst->w32(kMagic);
+	m_dst->w16(kVersion);
+	m_dst->w16(0);
+	m_dst->w32(m_blockSize);
+
+	m_storedBytes += 12;
+}
+
+void BlockCompressedWriter::write(const void * srcBuf, size_t len)
+{
+	const u8 * src = (const u8 *)srcBuf;
+
+	while (len)
+	{
+		size_t copyLen = std::min <size_t>(len, m_blockSize - m_pending.size());
+
+		m_pending.insert(m_pending.end(), src, src + copyLen);
+		src += copyLen;
+		len -= copyLen;
+
+		if (m_pending.size() >= m_blockSize)
+			flush();
+	}
+}
+
+void BlockCompressedWriter::flush()
+{
+	if (m_pending.empty())
+		return;
+
+	writeBlock(m_pending.data(), m_pending.size());
+
+	m_pending.clear();
+}
+
+void BlockCompressedWriter::writeBlock(const void * src, size_t len)
+{
+	m_scratch.resize(lzCompressBound(len));
+
+	size_t compressedLen = lzCompress(src, len, m_scratch.data(), m_scratch.size());
+
+	// no gain, store it
+	bool stored = !compressedLen || (compressedLen >= len);
+
+	u32 storedLen = stored ? u32(len) : u32(compressedLen);
+
+	m_dst->w32(u32(len));
+	m_dst->w32(storedLen);
+	m_dst->w32(blockChecksum(src, len));
+	m_dst->write(stored ? src : m_scratch.data(), storedLen);
+
+	m_rawBytes += len;
+	m_storedBytes += 12 + storedLen;
+}
+
+BlockCompressedReader::BlockCompressedReader()
+:m_src(nullptr)
+,m_rawLength(0)
+{
+	//
+}
+
+bool BlockCompressedReader::attach(DataStream * src)
+{
+	m_src = src;
+	m_blocks.clear();
+	m_rawLength = 0;
+
+	if (!isCompressed(src))
+		return false;
+
+	src->seek(0);
+
+	src->r32();	// magic
+	u16 version = src->r16();
+	src->r16();	// reserved
+	src->r32();	// block size
+
+	if (version != BlockCompressedWriter::kVersion)
+		return false;
+
+	u64 streamLen = src->length();
+	u64 offset = 12;
+
+	while (offset + 12 <= streamLen)
+	{
+		src->seek(offset);
+
+		BlockInfo info;
+
+		info.streamOffset = offset;
+		info.rawOffset = m_rawLength;
+		info.rawLen = src->r32();
+		info.storedLen = src->r32();
+		info.checksum = src->r32();
+
+		// a torn final block from a crash mid-write is ignored
+		if (offset + 12 + info.storedLen > streamLen)
+			break;
+
+		if (info.storedLen > info.rawLen)
+			break;
+
+		m_blocks.push_back(info);
+
+		m_rawLength += info.rawLen;
+		offset += 12 + info.storedLen;
+	}
+
+	return true;
+}
+
+u32 BlockCompressedReader::findBlock(u64 rawOffset) const
+{
+	auto iter = std::upper_bound(m_blocks.begin(), m_blocks.end(), rawOffset,
+		[](u64 offset, const BlockInfo & info) { return offset < info.rawOffset; });
+
+	if (iter == m_blocks.begin())
+		return 0;
+
+	return u32(iter - m_blocks.begin() - 1);
+}
+
+bool BlockCompressedReader::readBlock(u32 idx, std::vector <u8> * out)
+{
+	if (idx >= m_blocks.size())
+		return false;
+
+	const BlockInfo & info = m_blocks[idx];
+
+	m_src->seek(info.streamOffset + 12);
+
+	out->resize(info.rawLen);
+
+	if (info.storedLen == info.rawLen)
+	{
+		if (m_src->read(out->data(), info.rawLen) != info.rawLen)
+			return false;
+	}
+	else
+	{
+		m_scratch.resize(info.storedLen);
+
+		if (m_src->read(m_scratch.data(), info.storedLen) != info.storedLen)
+			return false;
+
+		if (!lzDecompress(m_scratch.data(), info.storedLen, out->data(), info.rawLen))
+			return false;
+	}
+
+	return blockChecksum(out->data(), info.rawLen) == info.checksum;
+}
+
+bool BlockCompressedReader::readAll(std::string * out)
+{
+	std::vector <u8> block;
+
+	out->reserve(out->size() + size_t(m_rawLength));
+
+	for (u32 i = 0; i < numBlocks(); i++)
+	{
+		if (!readBlock(i, &block))
+			return false;
+
+		out->append((const char *)block.data(), block.size());
+	}
+
+	return true;
+}
+
+bool BlockCompressedReader::isCompressed(DataStream * src)
+{
+	if (src->length() < 12)
+		return false;
+
+	u64 savedOffset = src->offset();
+
+	src->seek(0);
+	u32 magic = src->r32();
+	src->seek(savedOffset);
+
+	return magic == BlockCompressedWriter::kMagic;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "obse64_common/DataStream.h"
+#include <string>
+#include <vector>
+
+// small LZ77 codec (LZ4-style sequences) and a block framing format on top of it
+// self-contained so logs and exports can be compressed without an external library
+//
+// stream layout:
+//	header	u32 magic ('OBLZ'), u16 version, u16 reserved, u32 block size
+//	blocks	u32 raw length, u32 stored length, u32 checksum (of raw data), stored data
+//	if stored length == raw length the block was not compressible and is stored raw
+//
+// blocks are independent, so a stream can be appended to and any block can be decoded on its own
+
+// worst case output size for lzCompress
+size_t lzCompressBound(size_t srcLen);
+
+// returns the compressed length, or 0 if the output didn't fit in dstCap
+size_t lzCompress(const void * src, size_t srcLen, void * dst, size_t dstCap);
+
+// dstLen must be the exact decompressed length. returns false on malformed input
+bool lzDecompress(const void * src, size_t srcLen, void * dst, size_t dstLen);
+
+u32 blockChecksum(const void * src, size_t len);
+
+class BlockCompressedWriter
+{
+public:
+	enum
+	{
+		kMagic = 0x5A4C424F,	// "OBLZ" on disk
+		kVersion = 1,
+
+		kDefaultBlockSize = 64 * 1024,
+	};
+
+	BlockCompressedWriter(DataStream * dst, u32 blockSize = kDefaultBlockSize);
+	~BlockCompressedWriter();
+
+	// call once when starting a new stream, skip when appending to an existing one
+	void	writeHeader();
+
+	// buffered, full blocks are written as they fill up
+	void	write(const void * src, size_t len);
+
+	// write out the partially filled block
+	void	flush();
+
+	// compress and write one block directly, bypassing the buffer
+	void	writeBlock(const void * src, size_t len);
+
+	u64		rawBytes() const { return m_rawBytes; }
+	u64		storedBytes() const { return m_storedBytes; }
+
+private:
+	DataStream	* m_dst;
+	u32			m_blockSize;
+
+	std::vector <u8>	m_pending;
+	std::vector <u8>	m_scratch;
+
+	u64		m_rawBytes;
+	u64		m_storedBytes;
+};
+
+class BlockCompressedReader
+{
+public:
+	BlockCompressedReader();
+
+	// reads the header and walks the block headers to build the index, payloads are not touched
+	bool	attach(DataStream * src);
+
+	u32		numBlocks() const { return u32(m_blocks.size()); }
+	u64		rawLength() const { return m_rawLength; }
+
+	// offset of the first byte of a block in the decompressed stream
+	u64		blockRawOffset(u32 idx) const { return m_blocks[idx].rawOffset; }
+
+	// index of the block holding a decompressed stream offset
+	u32		findBlock(u64 rawOffset) const;
+
+	bool	readBlock(u32 idx, std::vector <u8> * out);
+
+	// decompress everything, appending to out
+	bool	readAll(std::string * out);
+
+	// checks for the stream header without consuming anything
+	static bool	isCompressed(DataStream * src);
+
+private:
+	struct BlockInfo
+	{
+		u64	streamOffset;	// of the block header
+		u64	rawOffset;
+		u32	rawLen;
+		u32	storedLen;
+		u32	checksum;
+	};
+
+	DataStream	* m_src;
+
+	std::vector <BlockInfo>	m_blocks;
+	std::vector <u8>		m_scratch;
+	u64						m_rawLength;
+};
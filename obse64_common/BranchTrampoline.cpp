@@ -1,7 +1,11 @@
 #include "BranchTrampoline.h"
 #include "SafeWrite.h"
+#include "PatchTransaction.h"
+#include "MemoryReservation.h"
 #include <climits>
+#ifdef _WIN32
 #include <Windows.h>
+#endif
 #include "obse64_common/Log.h"
 #include "obse64_common/Errors.h"
 
@@ -9,10 +13,6 @@ BranchTrampoline g_branchTrampoline;
 BranchTrampoline g_localTrampoline;
 
 BranchTrampoline::BranchTrampoline()
-	:m_base(nullptr)
-	, m_len(0)
-	, m_allocated(0)
-	, m_curAlloc(nullptr)
 {
 	//
 }
@@ -24,138 +24,98 @@ BranchTrampoline::~BranchTrampoline()
 
 bool BranchTrampoline::create(size_t len, void * module)
 {
+#ifdef _WIN32
 	if (!module) module = GetModuleHandle(NULL);
 
-	// search backwards from module base
+	// regions have to be in range of the whole image, not just its base
 	uintptr_t moduleBase = uintptr_t(module);
-	uintptr_t addr = moduleBase;
-	uintptr_t maxDisplacement = 0x80000000 - (1024 * 1024 * 128); // largest 32-bit displacement with 128MB scratch space
-	uintptr_t lowestOKAddress = (moduleBase >= maxDisplacement) ? moduleBase - maxDisplacement : 0;
-	addr--;
+	const IMAGE_DOS_HEADER * dosHeader = (const IMAGE_DOS_HEADER *)moduleBase;
+	const IMAGE_NT_HEADERS * ntHeader = (const IMAGE_NT_HEADERS *)(moduleBase + dosHeader->e_lfanew);
+	size_t moduleLen = ntHeader->OptionalHeader.SizeOfImage;
+#else
+	// no loaded PE image off Windows, only the tools build this. stay in range of this code instead
+	if (!module) module = (void *)&MemoryReservation::platform;
 
-	while (!m_base)
-	{
-		MEMORY_BASIC_INFORMATION info;
-
-		if (!VirtualQuery((void *)addr, &info, sizeof(info)))
-		{
-			_ERROR("VirtualQuery failed: %08X", GetLastError());
-			break;
-		}
-
-		if (info.State == MEM_FREE)
-		{
-			// free block, big enough?
-			if (info.RegionSize >= len)
-			{
-				// try to allocate it
-				addr = ((uintptr_t)info.BaseAddress) + info.RegionSize - len;
-
-				m_base = (void *)VirtualAlloc((void *)addr, len, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
-				if (m_base)
-				{
-					m_len = len;
-					m_allocated = 0;
-				}
-				else
-				{
-					_WARNING("trampoline alloc %016I64Xx%016I64X failed (%08X)", addr, len, GetLastError());
-				}
-			}
-		}
-
-		// move back and try again
-		if (!m_base)
-		{
-			addr = ((uintptr_t)info.BaseAddress) - 1;
-		}
+	uintptr_t moduleBase = uintptr_t(module);
+	size_t moduleLen = 0x1000;
+#endif
 
-		if (addr < lowestOKAddress)
-		{
-			_ERROR("couldn't allocate trampoline, no free space before image");
-			break;
-		}
+	if (!m_alloc.create(moduleBase, moduleLen, len, MemoryReservation::platform()))
+	{
+		_ERROR_C(Hooks, "couldn't allocate trampoline, no free space near image");
+		return false;
 	}
 
-	return m_base != nullptr;
+	return true;
 }
 
 void BranchTrampoline::destroy()
 {
-	if (m_base)
-	{
-		VirtualFree(m_base, 0, MEM_RELEASE);
-		m_base = nullptr;
-	}
+	m_alloc.destroy();
 }
 
 void BranchTrampoline::setBase(size_t len, void * base)
 {
-	ASSERT(!m_base);
-	m_base = base;
-	m_len = len;
-	m_allocated = 0;
-	m_curAlloc = nullptr;
+	m_alloc.setBase(base, len);
 }
 
 void * BranchTrampoline::startAlloc()
 {
-	ASSERT(m_base);
-	ASSERT(!m_curAlloc);
+	size_t oldRegions = m_alloc.numRegions();
 
-	m_curAlloc = ((u8 *)m_base) + m_allocated;
+	void * result = m_alloc.startAlloc();
+	noteGrowth(oldRegions);
 
-	return m_curAlloc;
+	return result;
 }
 
 void BranchTrampoline::endAlloc(const void * end)
 {
-	ASSERT(m_base);
-	ASSERT(m_curAlloc);
-
-	size_t len = uintptr_t(end) - uintptr_t(m_curAlloc);
-	ASSERT(len <= remain());
-
-	m_allocated += len;
-	m_curAlloc = nullptr;
+	m_alloc.endAlloc(end);
 }
 
 void * BranchTrampoline::allocate(size_t size)
 {
-	ASSERT(m_base);
-
-	void * result = nullptr;
+	size_t oldRegions = m_alloc.numRegions();
 
-	if (size <= remain())
-	{
-		result = ((u8 *)m_base) + m_allocated;
-		m_allocated += size;
-	}
+	void * result = m_alloc.allocate(size);
+	noteGrowth(oldRegions);
 
 	return result;
 }
 
-bool BranchTrampoline::write6Branch(uintptr_t src, uintptr_t dst)
+void BranchTrampoline::free(void * ptr, size_t size)
+{
+	m_alloc.free(ptr, size);
+}
+
+void BranchTrampoline::noteGrowth(size_t oldRegions)
+{
+	if (m_alloc.numRegions() != oldRegions)
+		_MESSAGE_C(Hooks, "trampoline grew to %zu regions, %zu bytes", m_alloc.numRegions(), m_alloc.reserved());
+}
+
+bool BranchTrampoline::write6Branch(uintptr_t src, uintptr_t dst, PatchTransaction * patches)
 {
-	return write6Branch_Internal(src, dst, 0x25);
+	return write6Branch_Internal(src, dst, 0x25, patches);
 }
 
-bool BranchTrampoline::write6Call(uintptr_t src, uintptr_t dst)
+bool BranchTrampoline::write6Call(uintptr_t src, uintptr_t dst, PatchTransaction * patches)
 {
-	return write6Branch_Internal(src, dst, 0x15);
+	return write6Branch_Internal(src, dst, 0x15, patches);
 }
 
-bool BranchTrampoline::write5Branch(uintptr_t src, uintptr_t dst)
+bool BranchTrampoline::write5Branch(uintptr_t src, uintptr_t dst, PatchTransaction * patches)
 {
-	return write5Branch_Internal(src, dst, 0xE9);
+	return write5Branch_Internal(src, dst, 0xE9, patches);
 }
 
-bool BranchTrampoline::write5Call(uintptr_t src, uintptr_t dst)
+bool BranchTrampoline::write5Call(uintptr_t src, uintptr_t dst, PatchTransaction * patches)
 {
-	return write5Branch_Internal(src, dst, 0xE8);
+	return write5Branch_Internal(src, dst, 0xE8, patches);
 }
 
-bool BranchTrampoline::write6Branch_Internal(uintptr_t src, uintptr_t dst, u8 op)
+bool BranchTrampoline::write6Branch_Internal(uintptr_t src, uintptr_t dst, u8 op, PatchTransaction * patches)
 {
 	bool result = false;
 
@@ -166,7 +126,7 @@ bool BranchTrampoline::write6Branch_Internal(uintptr_t src, uintptr_t dst, u8 op
 		uintptr_t	nextInstr = src + 6;
 		ptrdiff_t	trampolineDispl = trampolineAddr - nextInstr;
 
-		if ((trampolineDispl >= _I32_MIN) && (trampolineDispl <= _I32_MAX))
+		if ((trampolineDispl >= INT_MIN) && (trampolineDispl <= INT_MAX))
 		{
 			u8	code[6];
 
@@ -175,7 +135,10 @@ bool BranchTrampoline::write6Branch_Internal(uintptr_t src, uintptr_t dst, u8 op
 			code[1] = op;
 			*((s32 *)&code[2]) = (s32)trampolineDispl;
 
-			safeWriteBuf(src, code, sizeof(code));
+			if (patches)
+				patches->writeBuf(src, code, sizeof(code));
+			else
+				safeWriteBuf(src, code, sizeof(code));
 
 			*trampoline = dst;
 
@@ -189,7 +152,7 @@ bool BranchTrampoline::write6Branch_Internal(uintptr_t src, uintptr_t dst, u8 op
 	return result;
 }
 
-bool BranchTrampoline::write5Branch_Internal(uintptr_t src, uintptr_t dst, u8 op)
+bool BranchTrampoline::write5Branch_Internal(uintptr_t src, uintptr_t dst, u8 op, PatchTransaction * patches)
 {
 	bool result = false;
 
@@ -242,11 +205,14 @@ bool BranchTrampoline::write5Branch_Internal(uintptr_t src, uintptr_t dst, u8 op
 		ptrdiff_t	trampolineDispl = trampolineAddr - nextInstr;
 
 		// should never fail because we're branching in to the trampoline
-		ASSERT((trampolineDispl >= _I32_MIN) && (trampolineDispl <= _I32_MAX));
+		ASSERT((trampolineDispl >= INT_MIN) && (trampolineDispl <= INT_MAX));
 
 		hookCode.Init(trampolineDispl, op);
 
-		safeWriteBuf(src, &hookCode, sizeof(hookCode));
+		if (patches)
+			patches->writeBuf(src, &hookCode, sizeof(hookCode));
+		else
+			safeWriteBuf(src, &hookCode, sizeof(hookCode));
 
 		result = true;
 	}
@@ -1,6 +1,12 @@
 #pragma once
 
 #include "obse64_common/Types.h"
+#include "obse64_common/TrampolineAllocator.h"
+
+class PatchTransaction;
+
+// executable memory near a module for branch targets and generated code
+// grows by another region of the create length when it runs out, see TrampolineAllocator
 
 class BranchTrampoline
 {
@@ -18,28 +24,36 @@ public:
 
 	void * allocate(size_t size = sizeof(void *));
 
-	size_t remain() { return m_len - m_allocated; }
+	// size has to be what was passed to allocate
+	void free(void * ptr, size_t size = sizeof(void *));
+
+	// left in the current region, allocate may still succeed beyond this
+	size_t remain() { return m_alloc.remain(); }
+
+	size_t numRegions() const { return m_alloc.numRegions(); }
+	size_t reserved() const { return m_alloc.reserved(); }
+	size_t inUse() const { return m_alloc.inUse(); }
+
+	// pass a transaction to batch the write at src with others, the trampoline is filled in immediately
 
 	// takes 6 bytes of space at src, 8 bytes in trampoline
-	bool write6Branch(uintptr_t src, uintptr_t dst);
-	bool write6Call(uintptr_t src, uintptr_t dst);
+	bool write6Branch(uintptr_t src, uintptr_t dst, PatchTransaction * patches = nullptr);
+	bool write6Call(uintptr_t src, uintptr_t dst, PatchTransaction * patches = nullptr);
 
 	// takes 5 bytes of space at src, 14 bytes in trampoline
-	bool write5Branch(uintptr_t src, uintptr_t dst);
-	bool write5Call(uintptr_t src, uintptr_t dst);
+	bool write5Branch(uintptr_t src, uintptr_t dst, PatchTransaction * patches = nullptr);
+	bool write5Call(uintptr_t src, uintptr_t dst, PatchTransaction * patches = nullptr);
 
 private:
 	// takes 6 bytes of space at src, 8 bytes in trampoline
-	bool write6Branch_Internal(uintptr_t src, uintptr_t dst, u8 op);
+	bool write6Branch_Internal(uintptr_t src, uintptr_t dst, u8 op, PatchTransaction * patches);
 
 	// takes 5 bytes of space at src, 14 bytes in trampoline
-	bool write5Branch_Internal(uintptr_t src, uintptr_t dst, u8 op);
+	bool write5Branch_Internal(uintptr_t src, uintptr_t dst, u8 op, PatchTransaction * patches);
 
-	void	* m_base;
-	size_t	m_len;			// bytes
-	size_t	m_allocated;	// bytes
+	void	noteGrowth(size_t oldRegions);
 
-	void	* m_curAlloc;	// currently active StartAlloc base
+	TrampolineAllocator	m_alloc;
 };
 
 extern BranchTrampoline g_branchTrampoline;
@@ -0,0 +1,270 @@
+#include "CommandTablePatches.h"
+#include "obse64_common/PEImage.h"
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+const CmdTablePatch kCmdTableStartPatches[] =
+{
+	{ 0x069475D0 + 0x0D0D + 0, 0, kPatchType_LeaToLoadBase },	// 1
+
+	{ 0x0694AFD0 + 0x04C2 + 0, 0, kPatchType_LeaToLoadBase },	// 2
+
+	{ 0x06967F80 + 0x006C + 0, 0, kPatchType_LeaToLoadBase },	// 3
+
+	{ 0x06A0E020 + 0x009B + 0, 0, kPatchType_LeaToLoadBase },	// 4
+	
+	{ 0x06948B20 + 0x0066 + 0, kCmdTable_ShortNameOffset, kPatchType_LeaToLoadBase },	// 5
+	{ 0x06948B20 + 0x0122 + 0, kCmdTable_OpcodeOffset, kPatchType_LeaToLoadBase },		// 5
+	{ 0x06948B20 + 0x0129 + 3, 0, kPatchType_WriteOffset32 },							// 5
+
+	{ 0, 0, kPatchType_End }
+};
+
+const CmdTablePatch kCmdTableEndPatches[] =
+{
+	{ 0x06948B20 + 0x006D + 0, kCmdTable_ShortNameOffset + kCmdTable_EntrySize, kPatchType_LeaToLoadBase },	// 5
+
+	{ 0, 0, kPatchType_End }
+};
+
+const CmdTablePatch kCmdTableLenPatches[] =
+{
+	{ 0x069475D0 + 0x0CFC + 1, u32(-1), kPatchType_Data32 },	// 1
+
+	{ 0x0694AFD0 + 0x04AF + 2, u32(-1), kPatchType_Data32 },	// 2
+
+	{ 0x06A0E020 + 0x00A2 + 1, 0, kPatchType_Data32 },			// 4
+
+	{ 0x06A02BB0 + 0x008A + 2, 0x1000, kPatchType_Data32 },		// 6
+	{ 0x06A02BB0 + 0x01B9 + 2, 0x1000, kPatchType_Data32 },		// 6
+
+	{ 0, 0, kPatchType_End }
+};
+
+enum
+{
+	kSiteReadLen = 16,
+
+	kTableEnd = kCmdTable_ScriptCommandsRVA + kCmdTable_NumScriptCommands * kCmdTable_EntrySize,
+};
+
+static const char * kRegNames[16] =
+{
+	"rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+	"r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15",
+};
+
+static u32 readU32(const u8 * src)
+{
+	u32 result;
+	memcpy(&result, src, sizeof(result));
+	return result;
+}
+
+static std::string formatString(const char * fmt, ...)
+{
+	char buf[256];
+
+	va_list args;
+	va_start(args, fmt);
+	vsnprintf(buf, sizeof(buf), fmt, args);
+	va_end(args);
+
+	return buf;
+}
+
+static std::string describeTableAddress(u32 rva)
+{
+	u32 delta = rva - kCmdTable_ScriptCommandsRVA;
+
+	return formatString("table entry %u +%02X", delta / kCmdTable_EntrySize, delta % kCmdTable_EntrySize);
+}
+
+static bool checkLea(const u8 * code, const CmdTablePatch & patch, u32 list, std::string * detail)
+{
+	// same decoding as HookedCommandTable::Apply
+	u32 len = 0;
+	u8 rex = 0;
+
+	if ((code[len] & 0xF0) == 0x40)
+		rex = code[len++];
+
+	u8 opcode = code[len++];
+	u8 modrm = code[len++];
+
+	if (!(rex & 0x08) || (opcode != 0x8D))
+	{
+		*detail = formatString("expected lea r64, found %02X %02X %02X", code[0], code[1], code[2]);
+		return false;
+	}
+
+	// the patch rewrites a rip-relative disp32
+	if ((modrm & 0xC7) != 0x05)
+	{
+		*detail = formatString("lea isn't rip-relative (modrm %02X)", modrm);
+		return false;
+	}
+
+	if (list == kCmdTablePatchList_Len)
+	{
+		*detail = "lea is only supported for table addresses";
+		return false;
+	}
+
+	u32 target = patch.ptr + len + 4 + readU32(code + len);
+	u32 reg = ((modrm >> 3) & 7) | ((rex & 0x04) << 1);
+
+	// the image base, the table offset is then in the instructions using it (kPatchType_WriteOffset32)
+	if (!target)
+	{
+		*detail = formatString("lea %s, image base", kRegNames[reg]);
+		return list == kCmdTablePatchList_Start;
+	}
+
+	u32 expected = kCmdTable_ScriptCommandsRVA + patch.offset;
+
+	if (list == kCmdTablePatchList_End)
+		expected += (kCmdTable_NumScriptCommands - 1) * kCmdTable_EntrySize;
+
+	*detail = formatString("lea %s, %08X (%s)", kRegNames[reg], target, describeTableAddress(target).c_str());
+
+	if (target != expected)
+	{
+		*detail += formatString(", expected %08X", expected);
+		return false;
+	}
+
+	return true;
+}
+
+bool checkCmdTablePatchSite(const u8 * code, const CmdTablePatch & patch, u32 list, std::string * detail)
+{
+	switch (patch.type)
+	{
+		case kPatchType_Data16:
+		case kPatchType_Data32:
+		{
+			// the game's command count, adjusted the same way as the new one will be
+			u32 value = readU32(code);
+			u32 expected = kCmdTable_NumScriptCommands + patch.offset;
+
+			if (patch.type == kPatchType_Data16)
+			{
+				value &= 0xFFFF;
+				expected &= 0xFFFF;
+			}
+
+			*detail = formatString("imm%u %X", (patch.type == kPatchType_Data16) ? 16 : 32, value);
+
+			if (list != kCmdTablePatchList_Len)
+			{
+				*detail += ", only supported for the command count";
+				return false;
+			}
+
+			if (value != expected)
+			{
+				*detail += formatString(", expected %X", expected);
+				return false;
+			}
+
+			return true;
+		}
+
+		case kPatchType_LeaToLoadBase:
+			return checkLea(code, patch, list, detail);
+
+		case kPatchType_WriteOffset32:
+		{
+			// a disp32 relative to the image base, has to land in the table
+			u32 value = readU32(code);
+
+			*detail = formatString("disp32 %08X", value);
+
+			if ((value < kCmdTable_ScriptCommandsRVA) || (value >= kTableEnd))
+			{
+				*detail += ", not in the command table";
+				return false;
+			}
+
+			*detail += " (" + describeTableAddress(value) + ")";
+
+			return true;
+		}
+
+		case kPatchType_FixupStringFetch:
+		{
+			// mov r64, disp32[base + index*scale]
+			if (((code[0] & 0xF8) != 0x48) || (code[1] != 0x8B) || ((code[2] & 0xC7) != 0x84))
+			{
+				*detail = formatString("expected mov r64, [sib + disp32], found %02X %02X %02X", code[0], code[1], code[2]);
+				return false;
+			}
+
+			u32 value = readU32(code + 4);
+
+			*detail = formatString("mov disp32 %08X", value);
+
+			if ((value < kCmdTable_ScriptCommandsRVA) || (value >= kTableEnd))
+			{
+				*detail += ", not in the command table";
+				return false;
+			}
+
+			return true;
+		}
+	}
+
+	*detail = formatString("unknown patch type %u", patch.type);
+
+	return false;
+}
+
+u32 verifyCmdTablePatches(const PEImage & image, std::vector <CmdTablePatchResult> * results, bool stopOnFailure)
+{
+	const CmdTablePatch * lists[kCmdTablePatchList_Num] =
+	{
+		kCmdTableStartPatches,
+		kCmdTableEndPatches,
+		kCmdTableLenPatches,
+	};
+
+	u32 numFailed = 0;
+
+	results->clear();
+
+	for (u32 list = 0; list < kCmdTablePatchList_Num; list++)
+	{
+		for (const CmdTablePatch * patch = lists[list]; patch->type != kPatchType_End; ++patch)
+		{
+			CmdTablePatchResult result;
+			result.patch = patch;
+			result.list = list;
+
+			u8 code[kSiteReadLen];
+
+			if (image.read(patch->ptr, code, sizeof(code)))
+			{
+				result.ok = checkCmdTablePatchSite(code, *patch, list, &result.detail);
+			}
+			else
+			{
+				result.ok = false;
+				result.detail = "not in the image";
+			}
+
+			results->push_back(result);
+
+			if (!result.ok)
+			{
+				numFailed++;
+
+				if (stopOnFailure)
+					return numFailed;
+			}
+		}
+	}
+
+	return numFailed;
+}
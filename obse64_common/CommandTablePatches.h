@@ -0,0 +1,91 @@
+#pragma once
+
+#include "obse64_common/Types.h"
+#include <string>
+#include <vector>
+
+class PEImage;
+
+// code patches that point the game at obse64's copy of the script command table
+//
+// shared by obse64, which applies them, and "obse64_tools verify", which checks them against an unpatched exe
+// on disk before a new game build is tried. the game side static_asserts the layout constants below
+
+enum CmdTablePatchType
+{
+	kPatchType_End = 0,
+
+	// write two bytes
+	kPatchType_Data16,
+
+	// write four bytes
+	kPatchType_Data32,
+
+	// 7 byte "lea r64, offset32" instruction
+	// will be converted to a 7 byte "mov r64, offset32" instruction
+	// offset will be redirected to a pointer stored in the trampoline
+	// different values of the 'offset' struct field will add and reference additional pointers
+	kPatchType_LeaToLoadBase,
+
+	// used to clear offset (instruction not parsed)
+	// 8 byte "mov r9, offset[rbx + r9*8]" for example
+	// 7 byte "mov eax, offset[rax + rcx*8]" also for example
+	// or 
+	kPatchType_WriteOffset32,
+
+	// used when fetches of imagebase are used for multiple things
+	// but the extra things are unused/debug only
+	// must point at an 8 byte mov statement
+	// "mov rbx, offset32[rbx + rcx*8]" changed to
+	// "lea rbx, offset32; nop"
+	kPatchType_FixupStringFetch
+};
+
+struct CmdTablePatch
+{
+	u32	ptr;	// RVA
+	u32	offset;
+	u32	type;	// CmdTablePatchType
+};
+
+enum
+{
+	// the game's own table, g_firstScriptCommand
+	kCmdTable_ScriptCommandsRVA = 0x08FBA4A0,
+	kCmdTable_NumScriptCommands = 0x0172,
+
+	// CommandInfo
+	kCmdTable_EntrySize = 0x50,
+	kCmdTable_ShortNameOffset = 0x08,
+	kCmdTable_OpcodeOffset = 0x10,
+};
+
+// what each list's patches are relative to
+enum
+{
+	kCmdTablePatchList_Start = 0,	// first entry
+	kCmdTablePatchList_End,			// last entry
+	kCmdTablePatchList_Len,			// number of entries
+
+	kCmdTablePatchList_Num,
+};
+
+// each terminated by a kPatchType_End entry
+extern const CmdTablePatch kCmdTableStartPatches[];
+extern const CmdTablePatch kCmdTableEndPatches[];
+extern const CmdTablePatch kCmdTableLenPatches[];
+
+struct CmdTablePatchResult
+{
+	const CmdTablePatch	* patch;
+	u32			list;	// kCmdTablePatchList_
+	bool		ok;
+	std::string	detail;	// what was found at the site
+};
+
+// checks the unpatched code at one patch site. code is the bytes at patch.ptr, at least 16 of them
+bool	checkCmdTablePatchSite(const u8 * code, const CmdTablePatch & patch, u32 list, std::string * detail);
+
+// checks every patch site in an exe as it is on disk, returns the number of failures
+// with stopOnFailure, results end at the first failure
+u32		verifyCmdTablePatches(const PEImage & image, std::vector <CmdTablePatchResult> * results, bool stopOnFailure = false);
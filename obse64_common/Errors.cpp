@@ -2,11 +2,18 @@
 #include "Log.h"
 #include "Types.h"
 #include <cstdlib>
+
+#ifdef _MSC_VER
 #include <intrin.h>
+#endif
 
 [[noreturn]] static void IErrors_Halt(void)
 {
+#ifdef _MSC_VER
 	__ud2();
+#else
+	__builtin_trap();
+#endif
 }
 
 /**
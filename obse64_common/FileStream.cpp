@@ -1,6 +1,53 @@
 #include "FileStream.h"
+#include <atomic>
 #include <string>
+
+#ifdef _WIN32
+
 #include <direct.h>
+#include <io.h>
+#include <Windows.h>
+
+#else
+
+#include <cerrno>
+#include <cstdlib>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// MSVC CRT names, the offline tools also build elsewhere. there's no portable unlocked stdio
+#define _fseeki64_nolock	fseeko
+#define _ftelli64_nolock	ftello
+#define _fread_nolock		fread
+#define _fwrite_nolock		fwrite
+
+static int _wfopen_s(FILE ** file, const wchar_t * path, const wchar_t * mode)
+{
+	char	narrowPath[4096];
+	char	narrowMode[8];
+
+	*file = nullptr;
+
+	if ((wcstombs(narrowPath, path, sizeof(narrowPath)) >= sizeof(narrowPath)) ||
+		(wcstombs(narrowMode, mode, sizeof(narrowMode)) >= sizeof(narrowMode)))
+		return EINVAL;
+
+	return fopen_s(file, narrowPath, narrowMode);
+}
+
+static int _mkdir(const char * path)
+{
+	return mkdir(path, 0777);
+}
+
+static int _chsize_s(int fd, s64 len)
+{
+	return ftruncate(fd, len) ? errno : 0;
+}
+
+#define _fileno	fileno
+
+#endif
 
 FileStream::FileStream()
 : m_file(nullptr)
@@ -33,6 +80,27 @@ bool FileStream::create(const wchar_t * path)
 	return internalOpen(path, L"wb");
 }
 
+bool FileStream::append(const char * path)
+{
+	if (!internalOpen(path, "ab"))
+		return false;
+
+	// writes always go to the end in append mode
+	m_offset = m_len;
+
+	return true;
+}
+
+bool FileStream::update(const char * path)
+{
+	return internalOpen(path, "a+b");
+}
+
+bool FileStream::modify(const char * path)
+{
+	return internalOpen(path, "r+b");
+}
+
 void FileStream::close()
 {
 	if (m_file)
@@ -50,6 +118,17 @@ void FileStream::flush()
 	fflush(m_file);
 }
 
+bool FileStream::truncate(u64 len)
+{
+	// buffered writes would land after the cut otherwise
+	if (fflush(m_file) || _chsize_s(_fileno(m_file), len))
+		return false;
+
+	m_len = len;
+
+	return true;
+}
+
 u64 FileStream::seek(u64 offset)
 {
 	_fseeki64_nolock(m_file, offset, SEEK_SET);
@@ -73,6 +152,8 @@ u64 FileStream::write(const void * src, u64 len)
 	u64 bytesWritten = _fwrite_nolock(src, 1, len, m_file);
 
 	m_offset += bytesWritten;
+	if (m_offset > m_len)
+		m_len = m_offset;
 
 	return bytesWritten;
 }
@@ -114,7 +195,7 @@ void FileStream::makeDirs(const char * path)
 {
 	std::string fullPath = path;
 
-	for (uint i = 1; i < fullPath.size(); i++)
+	for (size_t i = 1; i < fullPath.size(); i++)
 	{
 		char data = fullPath[i];
 
@@ -124,3 +205,81 @@ void FileStream::makeDirs(const char * path)
 		}
 	}
 }
+
+// next to path, unique to the process and the call so concurrent replaces and other sessions' leftovers don't collide
+static std::string TempPath(const char * path, u32 processID)
+{
+	static std::atomic <u32> s_serial(0);
+
+	return std::string(path) + "." + std::to_string(processID) + "." + std::to_string(s_serial++) + ".tmp";
+}
+
+#ifdef _WIN32
+
+bool FileStream::replaceFile(const char * path, const void * data, u64 len)
+{
+	std::string tempPath = TempPath(path, GetCurrentProcessId());
+
+	HANDLE file = CreateFile(tempPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	bool result = true;
+
+	// WriteFile takes a 32-bit length
+	const u8 * src = (const u8 *)data;
+	while (result && len)
+	{
+		DWORD chunkLen = (len > 0x40000000) ? 0x40000000 : DWORD(len);
+		DWORD bytesWritten = 0;
+
+		if (WriteFile(file, src, chunkLen, &bytesWritten, nullptr) && (bytesWritten == chunkLen))
+		{
+			src += chunkLen;
+			len -= chunkLen;
+		}
+		else
+		{
+			result = false;
+		}
+	}
+
+	if (result)
+		result = FlushFileBuffers(file) != FALSE;
+
+	CloseHandle(file);
+
+	if (result)
+		result = MoveFileEx(tempPath.c_str(), path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != FALSE;
+
+	if (!result)
+		DeleteFile(tempPath.c_str());
+
+	return result;
+}
+
+#else
+
+bool FileStream::replaceFile(const char * path, const void * data, u64 len)
+{
+	std::string tempPath = TempPath(path, u32(getpid()));
+
+	FILE * file = fopen(tempPath.c_str(), "wb");
+	if (!file)
+		return false;
+
+	bool result = (fwrite(data, 1, len, file) == len) && !fflush(file) && !fsync(fileno(file));
+
+	if (fclose(file))
+		result = false;
+
+	if (result)
+		result = rename(tempPath.c_str(), path) == 0;
+
+	if (!result)
+		remove(tempPath.c_str());
+
+	return result;
+}
+
+#endif
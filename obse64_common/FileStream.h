@@ -13,10 +13,16 @@ public:
 	bool open(const wchar_t * path);
 	bool create(const char * path);
 	bool create(const wchar_t * path);
+	bool append(const char * path);
+	bool update(const char * path);	// read anywhere, writes always go to the end. creates the file if missing
+	bool modify(const char * path);	// read and write anywhere, the file has to exist
 	void close();
 
 	void flush();
 
+	// cuts the file off at len, the offset is left where it was
+	bool truncate(u64 len);
+
 	// DataStream interface
 	virtual u64 seek(u64 offset);
 
@@ -25,6 +31,11 @@ public:
 
 	static void makeDirs(const char * path);
 
+	// writes data to a temporary file next to path, flushes it to disk, then renames it over path
+	// readers see either the old contents or the new contents, never a partial file
+	// the temporary file has a unique name and is removed if anything fails
+	static bool replaceFile(const char * path, const void * data, u64 len);
+
 protected:
 	FILE	* m_file;
 
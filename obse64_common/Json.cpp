@@ -0,0 +1,721 @@
+#include "Json.h"
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static inline u32 lowestSetBit(u32 mask)
+{
+#ifdef _MSC_VER
+	unsigned long idx;
+	_BitScanForward(&idx, mask);
+	return idx;
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+static inline bool isWhitespace(char c)
+{
+	return (c == ' ') || (c == '\t') || (c == '\n') || (c == '\r');
+}
+
+// stops on a quote, a backslash or a control character, anything that ends the fast path through a string
+static inline bool isStringSpecial(char c)
+{
+	return (c == '"') || (c == '\\') || (u8(c) < 0x20);
+}
+
+static const char * skipWhitespace(const char * p, const char * end, bool simd)
+{
+	// compact documents rarely have any
+	if ((p < end) && !isWhitespace(*p))
+		return p;
+
+	const __m128i space = _mm_set1_epi8(' ');
+	const __m128i tab = _mm_set1_epi8('\t');
+	const __m128i lf = _mm_set1_epi8('\n');
+	const __m128i cr = _mm_set1_epi8('\r');
+
+	while (simd && (end - p >= 16))
+	{
+		__m128i data = _mm_loadu_si128((const __m128i *)p);
+
+		__m128i ws = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(data, space), _mm_cmpeq_epi8(data, tab)),
+			_mm_or_si128(_mm_cmpeq_epi8(data, lf), _mm_cmpeq_epi8(data, cr)));
+
+		u32 mask = ~u32(_mm_movemask_epi8(ws)) & 0xFFFF;
+		if (mask)
+			return p + lowestSetBit(mask);
+
+		p += 16;
+	}
+
+	while ((p < end) && isWhitespace(*p))
+		p++;
+
+	return p;
+}
+
+static const char * scanString(const char * p, const char * end, bool simd)
+{
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i backslash = _mm_set1_epi8('\\');
+	const __m128i controlMax = _mm_set1_epi8(0x1F);
+
+	while (simd && (end - p >= 16))
+	{
+		__m128i data = _mm_loadu_si128((const __m128i *)p);
+
+		// unsigned data <= 0x1F
+		__m128i control = _mm_cmpeq_epi8(_mm_min_epu8(data, controlMax), data);
+
+		__m128i special = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(data, quote), _mm_cmpeq_epi8(data, backslash)),
+			control);
+
+		u32 mask = _mm_movemask_epi8(special);
+		if (mask)
+			return p + lowestSetBit(mask);
+
+		p += 16;
+	}
+
+	while ((p < end) && !isStringSpecial(*p))
+		p++;
+
+	return p;
+}
+
+static bool parseHex4(const char * p, const char * end, u32 * out)
+{
+	if (end - p < 4)
+		return false;
+
+	u32 value = 0;
+
+	for (u32 i = 0; i < 4; i++)
+	{
+		char c = p[i];
+		u32 digit;
+
+		if ((c >= '0') && (c <= '9'))		digit = c - '0';
+		else if ((c >= 'a') && (c <= 'f'))	digit = c - 'a' + 10;
+		else if ((c >= 'A') && (c <= 'F'))	digit = c - 'A' + 10;
+		else return false;
+
+		value = (value << 4) | digit;
+	}
+
+	*out = value;
+
+	return true;
+}
+
+static void appendUTF8(std::string * out, u32 codepoint)
+{
+	if (codepoint < 0x80)
+	{
+		out->push_back(char(codepoint));
+	}
+	else if (codepoint < 0x800)
+	{
+		out->push_back(char(0xC0 | (codepoint >> 6)));
+		out->push_back(char(0x80 | (codepoint & 0x3F)));
+	}
+	else if (codepoint < 0x10000)
+	{
+		out->push_back(char(0xE0 | (codepoint >> 12)));
+		out->push_back(char(0x80 | ((codepoint >> 6) & 0x3F)));
+		out->push_back(char(0x80 | (codepoint & 0x3F)));
+	}
+	else
+	{
+		out->push_back(char(0xF0 | (codepoint >> 18)));
+		out->push_back(char(0x80 | ((codepoint >> 12) & 0x3F)));
+		out->push_back(char(0x80 | ((codepoint >> 6) & 0x3F)));
+		out->push_back(char(0x80 | (codepoint & 0x3F)));
+	}
+}
+
+JsonReader::JsonReader()
+:m_src(nullptr)
+,m_end(nullptr)
+,m_error(nullptr)
+,m_errorOffset(0)
+,m_errorLine(0)
+,m_errorColumn(0)
+,m_simd(true)
+{
+	//
+}
+
+bool JsonReader::fail(const char * pos, const char * message)
+{
+	m_error = message;
+	m_errorOffset = pos - m_src;
+
+	// only computed on failure, keeps line tracking out of the main loop
+	m_errorLine = 1;
+	m_errorColumn = 1;
+
+	for (const char * p = m_src; p < pos; p++)
+	{
+		if (*p == '\n')
+		{
+			m_errorLine++;
+			m_errorColumn = 1;
+		}
+		else
+		{
+			m_errorColumn++;
+		}
+	}
+
+	return false;
+}
+
+bool JsonReader::parseString(const char ** pos, const char ** str, size_t * len)
+{
+	const char * start = *pos + 1;	// skip the opening quote
+	const char * p = scanString(start, m_end, m_simd);
+
+	if (p >= m_end)
+		return fail(p, "unterminated string");
+
+	// no escapes, hand out the source directly
+	if (*p == '"')
+	{
+		*str = start;
+		*len = p - start;
+		*pos = p + 1;
+
+		return true;
+	}
+
+	m_scratch.assign(start, p);
+
+	for (;;)
+	{
+		if (p >= m_end)
+			return fail(p, "unterminated string");
+
+		char c = *p;
+
+		if (c == '"')
+			break;
+
+		if (u8(c) < 0x20)
+			return fail(p, "control character in string");
+
+		if (c != '\\')
+		{
+			const char * run = p;
+			p = scanString(p, m_end, m_simd);
+			m_scratch.append(run, p);
+
+			continue;
+		}
+
+		const char * escape = p++;
+
+		if (p >= m_end)
+			return fail(p, "unterminated string");
+
+		switch (*p++)
+		{
+			case '"':	m_scratch.push_back('"'); break;
+			case '\\':	m_scratch.push_back('\\'); break;
+			case '/':	m_scratch.push_back('/'); break;
+			case 'b':	m_scratch.push_back('\b'); break;
+			case 'f':	m_scratch.push_back('\f'); break;
+			case 'n':	m_scratch.push_back('\n'); break;
+			case 'r':	m_scratch.push_back('\r'); break;
+			case 't':	m_scratch.push_back('\t'); break;
+
+			case 'u':
+			{
+				u32 codepoint;
+				if (!parseHex4(p, m_end, &codepoint))
+					return fail(escape, "invalid unicode escape");
+
+				p += 4;
+
+				if ((codepoint >= 0xD800) && (codepoint <= 0xDBFF))
+				{
+					u32 low;
+					if ((m_end - p < 6) || (p[0] != '\\') || (p[1] != 'u') || !parseHex4(p + 2, m_end, &low) ||
+						(low < 0xDC00) || (low > 0xDFFF))
+						return fail(escape, "unpaired surrogate");
+
+					p += 6;
+
+					codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+				}
+				else if ((codepoint >= 0xDC00) && (codepoint <= 0xDFFF))
+				{
+					return fail(escape, "unpaired surrogate");
+				}
+
+				appendUTF8(&m_scratch, codepoint);
+			}
+			break;
+
+			default:
+				return fail(escape, "invalid escape");
+		}
+	}
+
+	*str = m_scratch.data();
+	*len = m_scratch.size();
+	*pos = p + 1;
+
+	return true;
+}
+
+bool JsonReader::parseNumber(const char ** pos, JsonHandler * handler)
+{
+	const char * start = *pos;
+	const char * p = start;
+
+	if ((p < m_end) && (*p == '-'))
+		p++;
+
+	if ((p < m_end) && (*p == '0'))
+	{
+		p++;
+	}
+	else if ((p < m_end) && (*p >= '1') && (*p <= '9'))
+	{
+		while ((p < m_end) && (*p >= '0') && (*p <= '9'))
+			p++;
+	}
+	else
+	{
+		return fail(p, "invalid number");
+	}
+
+	if ((p < m_end) && (*p == '.'))
+	{
+		p++;
+
+		const char * digits = p;
+		while ((p < m_end) && (*p >= '0') && (*p <= '9'))
+			p++;
+
+		if (p == digits)
+			return fail(p, "invalid number");
+	}
+
+	if ((p < m_end) && ((*p == 'e') || (*p == 'E')))
+	{
+		p++;
+
+		if ((p < m_end) && ((*p == '+') || (*p == '-')))
+			p++;
+
+		const char * digits = p;
+		while ((p < m_end) && (*p >= '0') && (*p <= '9'))
+			p++;
+
+		if (p == digits)
+			return fail(p, "invalid number");
+	}
+
+	double value = 0;
+
+	auto parsed = std::from_chars(start, p, value);
+	if (parsed.ec == std::errc::result_out_of_range)
+	{
+		// from_chars leaves value alone, let strtod pick between infinity and zero
+		std::string text(start, p);
+		value = strtod(text.c_str(), nullptr);
+	}
+
+	*pos = p;
+
+	if (!handler->onNumber(start, p - start, value))
+		return fail(start, "stopped by handler");
+
+	return true;
+}
+
+bool JsonReader::parseLiteral(const char ** pos, const char * literal, size_t literalLen)
+{
+	if ((size_t(m_end - *pos) < literalLen) || memcmp(*pos, literal, literalLen))
+		return fail(*pos, "invalid literal");
+
+	*pos += literalLen;
+
+	return true;
+}
+
+bool JsonReader::parse(const char * src, size_t len, JsonHandler * handler)
+{
+	m_src = src;
+	m_end = src + len;
+	m_stack.clear();
+	m_error = nullptr;
+
+	const char * pos = skipWhitespace(src, m_end, m_simd);
+
+	// skip a UTF-8 BOM
+	if ((m_end - pos >= 3) && !memcmp(pos, "\xEF\xBB\xBF", 3))
+		pos = skipWhitespace(pos + 3, m_end, m_simd);
+
+	bool expectValue = true;
+
+	for (;;)
+	{
+		if (expectValue)
+		{
+			if (pos >= m_end)
+				return fail(pos, "unexpected end of input");
+
+			const char * str;
+			size_t strLen;
+
+			expectValue = false;
+
+			switch (*pos)
+			{
+				case '{':
+				case '[':
+				{
+					bool isObject = *pos == '{';
+
+					if (m_stack.size() >= kMaxDepth)
+						return fail(pos, "nesting too deep");
+
+					if (!(isObject ? handler->onBeginObject() : handler->onBeginArray()))
+						return fail(pos, "stopped by handler");
+
+					pos = skipWhitespace(pos + 1, m_end, m_simd);
+
+					// empty container
+					if ((pos < m_end) && (*pos == (isObject ? '}' : ']')))
+					{
+						pos++;
+
+						if (!(isObject ? handler->onEndObject() : handler->onEndArray()))
+							return fail(pos, "stopped by handler");
+
+						break;
+					}
+
+					m_stack.push_back(isObject ? '{' : '[');
+
+					if (isObject)
+					{
+						if ((pos >= m_end) || (*pos != '"'))
+							return fail(pos, "expected string key");
+
+						if (!parseString(&pos, &str, &strLen))
+							return false;
+
+						if (!handler->onKey(str, strLen))
+							return fail(pos, "stopped by handler");
+
+						pos = skipWhitespace(pos, m_end, m_simd);
+
+						if ((pos >= m_end) || (*pos != ':'))
+							return fail(pos, "expected ':'");
+
+						pos = skipWhitespace(pos + 1, m_end, m_simd);
+					}
+
+					expectValue = true;
+				}
+				break;
+
+				case '"':
+					if (!parseString(&pos, &str, &strLen))
+						return false;
+
+					if (!handler->onString(str, strLen))
+						return fail(pos, "stopped by handler");
+					break;
+
+				case 't':
+					if (!parseLiteral(&pos, "true", 4))
+						return false;
+
+					if (!handler->onBool(true))
+						return fail(pos, "stopped by handler");
+					break;
+
+				case 'f':
+					if (!parseLiteral(&pos, "false", 5))
+						return false;
+
+					if (!handler->onBool(false))
+						return fail(pos, "stopped by handler");
+					break;
+
+				case 'n':
+					if (!parseLiteral(&pos, "null", 4))
+						return false;
+
+					if (!handler->onNull())
+						return fail(pos, "stopped by handler");
+					break;
+
+				default:
+					if ((*pos != '-') && ((*pos < '0') || (*pos > '9')))
+						return fail(pos, "unexpected character");
+
+					if (!parseNumber(&pos, handler))
+						return false;
+					break;
+			}
+
+			if (expectValue)
+				continue;
+		}
+
+		pos = skipWhitespace(pos, m_end, m_simd);
+
+		if (m_stack.empty())
+		{
+			if (pos != m_end)
+				return fail(pos, "unexpected data after the end of the document");
+
+			return true;
+		}
+
+		if (pos >= m_end)
+			return fail(pos, "unexpected end of input");
+
+		bool isObject = m_stack.back() == '{';
+
+		if (*pos == ',')
+		{
+			pos = skipWhitespace(pos + 1, m_end, m_simd);
+
+			if (isObject)
+			{
+				const char * str;
+				size_t strLen;
+
+				if ((pos >= m_end) || (*pos != '"'))
+					return fail(pos, "expected string key");
+
+				if (!parseString(&pos, &str, &strLen))
+					return false;
+
+				if (!handler->onKey(str, strLen))
+					return fail(pos, "stopped by handler");
+
+				pos = skipWhitespace(pos, m_end, m_simd);
+
+				if ((pos >= m_end) || (*pos != ':'))
+					return fail(pos, "expected ':'");
+
+				pos = skipWhitespace(pos + 1, m_end, m_simd);
+			}
+
+			expectValue = true;
+		}
+		else if (*pos == (isObject ? '}' : ']'))
+		{
+			pos++;
+			m_stack.pop_back();
+
+			if (!(isObject ? handler->onEndObject() : handler->onEndArray()))
+				return fail(pos, "stopped by handler");
+		}
+		else
+		{
+			return fail(pos, isObject ? "expected ',' or '}'" : "expected ',' or ']'");
+		}
+	}
+}
+
+JsonWriter::JsonWriter(std::string * out, bool pretty)
+:m_out(out)
+,m_pretty(pretty)
+,m_afterKey(false)
+{
+	//
+}
+
+void JsonWriter::newline()
+{
+	if (!m_pretty)
+		return;
+
+	m_out->push_back('\n');
+	m_out->append(m_hasElement.size(), '\t');
+}
+
+void JsonWriter::beginValue()
+{
+	// key() already wrote the separator
+	if (m_afterKey)
+	{
+		m_afterKey = false;
+		return;
+	}
+
+	if (m_hasElement.empty())
+		return;
+
+	if (m_hasElement.back())
+		m_out->push_back(',');
+
+	m_hasElement.back() = true;
+
+	newline();
+}
+
+void JsonWriter::beginObject()
+{
+	beginValue();
+
+	m_out->push_back('{');
+	m_hasElement.push_back(false);
+}
+
+void JsonWriter::endObject()
+{
+	bool hasElement = m_hasElement.back();
+	m_hasElement.pop_back();
+
+	if (hasElement)
+		newline();
+
+	m_out->push_back('}');
+}
+
+void JsonWriter::beginArray()
+{
+	beginValue();
+
+	m_out->push_back('[');
+	m_hasElement.push_back(false);
+}
+
+void JsonWriter::endArray()
+{
+	bool hasElement = m_hasElement.back();
+	m_hasElement.pop_back();
+
+	if (hasElement)
+		newline();
+
+	m_out->push_back(']');
+}
+
+void JsonWriter::key(const char * str, size_t len)
+{
+	beginValue();
+
+	writeEscaped(str, len);
+
+	m_out->push_back(':');
+	if (m_pretty)
+		m_out->push_back(' ');
+
+	m_afterKey = true;
+}
+
+void JsonWriter::string(const char * str, size_t len)
+{
+	beginValue();
+
+	writeEscaped(str, len);
+}
+
+void JsonWriter::number(double value)
+{
+	beginValue();
+
+	// no representation for these in JSON
+	if (!std::isfinite(value))
+	{
+		m_out->append("null");
+		return;
+	}
+
+	char buf[32];
+	std::to_chars_result written;
+
+	// integers are the common case for script values, keep them free of exponents
+	if ((value == std::floor(value)) && (std::fabs(value) < 1e15))
+		written = std::to_chars(buf, buf + sizeof(buf), s64(value));
+	else
+		written = std::to_chars(buf, buf + sizeof(buf), value);
+
+	m_out->append(buf, written.ptr);
+}
+
+void JsonWriter::boolean(bool value)
+{
+	beginValue();
+
+	m_out->append(value ? "true" : "false");
+}
+
+void JsonWriter::null()
+{
+	beginValue();
+
+	m_out->append("null");
+}
+
+void JsonWriter::numberText(const char * text, size_t len)
+{
+	beginValue();
+
+	m_out->append(text, len);
+}
+
+void JsonWriter::writeEscaped(const char * str, size_t len)
+{
+	static const char kHexDigits[] = "0123456789ABCDEF";
+
+	const char * p = str;
+	const char * end = str + len;
+
+	m_out->push_back('"');
+
+	while (p < end)
+	{
+		const char * run = p;
+		p = scanString(p, end, true);
+		m_out->append(run, p);
+
+		if (p >= end)
+			break;
+
+		char c = *p++;
+
+		switch (c)
+		{
+			case '"':	m_out->append("\\\""); break;
+			case '\\':	m_out->append("\\\\"); break;
+			case '\b':	m_out->append("\\b"); break;
+			case '\f':	m_out->append("\\f"); break;
+			case '\n':	m_out->append("\\n"); break;
+			case '\r':	m_out->append("\\r"); break;
+			case '\t':	m_out->append("\\t"); break;
+
+			default:
+			{
+				char escape[] = "\\u00XX";
+				escape[4] = kHexDigits[(u8(c) >> 4) & 0xF];
+				escape[5] = kHexDigits[u8(c) & 0xF];
+
+				m_out->append(escape, 6);
+			}
+			break;
+		}
+	}
+
+	m_out->push_back('"');
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "obse64_common/Types.h"
+#include <string>
+#include <vector>
+
+// single pass JSON reader and a matching writer
+//
+// the reader doesn't build a tree, it calls a handler for each value as it goes
+// strings without escapes are passed as pointers in to the source, so there are no allocations
+// unless something needs unescaping. whitespace and string bodies are skipped 16 bytes at a time
+
+class JsonHandler
+{
+public:
+	virtual ~JsonHandler() { }
+
+	// return false to stop parsing
+	virtual bool	onNull() = 0;
+	virtual bool	onBool(bool value) = 0;
+
+	// text is the number exactly as written, for callers that want to keep it lossless
+	virtual bool	onNumber(const char * text, size_t len, double value) = 0;
+
+	virtual bool	onString(const char * str, size_t len) = 0;
+	virtual bool	onKey(const char * str, size_t len) = 0;
+
+	virtual bool	onBeginObject() = 0;
+	virtual bool	onEndObject() = 0;
+	virtual bool	onBeginArray() = 0;
+	virtual bool	onEndArray() = 0;
+};
+
+class JsonReader
+{
+public:
+	enum
+	{
+		kMaxDepth = 512,
+	};
+
+	JsonReader();
+
+	bool	parse(const char * src, size_t len, JsonHandler * handler);
+
+	// valid after parse fails
+	const char *	errorMessage() const { return m_error; }
+	size_t			errorOffset() const { return m_errorOffset; }
+	u32				errorLine() const { return m_errorLine; }
+	u32				errorColumn() const { return m_errorColumn; }
+
+	// false skips whitespace and string bodies a byte at a time, to check and measure the SSE2 loops against
+	void	setSimd(bool simd) { m_simd = simd; }
+
+private:
+	bool	fail(const char * pos, const char * message);
+
+	bool	parseString(const char ** pos, const char ** str, size_t * len);
+	bool	parseNumber(const char ** pos, JsonHandler * handler);
+	bool	parseLiteral(const char ** pos, const char * literal, size_t literalLen);
+
+	const char	* m_src;
+	const char	* m_end;
+
+	std::string	m_scratch;	// unescaped strings
+	std::vector <u8>	m_stack;	// open containers, '{' or '['
+
+	const char	* m_error;
+	size_t		m_errorOffset;
+	u32			m_errorLine;
+	u32			m_errorColumn;
+
+	bool		m_simd;
+};
+
+class JsonWriter
+{
+public:
+	JsonWriter(std::string * out, bool pretty = false);
+
+	void	beginObject();
+	void	endObject();
+	void	beginArray();
+	void	endArray();
+
+	void	key(const char * str, size_t len);
+	void	key(const std::string & str) { key(str.data(), str.size()); }
+
+	void	string(const char * str, size_t len);
+	void	string(const std::string & str) { string(str.data(), str.size()); }
+	void	number(double value);
+	void	boolean(bool value);
+	void	null();
+
+	// writes pre-formatted number text as is, the caller is responsible for it being valid
+	void	numberText(const char * text, size_t len);
+
+private:
+	void	beginValue();
+	void	newline();
+	void	writeEscaped(const char * str, size_t len);
+
+	std::string	* m_out;
+	bool		m_pretty;
+	bool		m_afterKey;
+
+	// one entry per open container, true once it has an element
+	std::vector <bool>	m_hasElement;
+};
@@ -0,0 +1,327 @@
+#include "KeyValueStore.h"
+#include "obse64_common/BlockCompression.h"
+#include "obse64_common/Log.h"
+#include <cstring>
+
+static inline u64 recordSize(const std::string & key, u32 valueLen)
+{
+	return KeyValueStore::kRecordHeaderSize + key.size() + valueLen;
+}
+
+KeyValueStore::KeyValueStore()
+:m_liveBytes(0)
+,m_deadBytes(0)
+{
+	//
+}
+
+KeyValueStore::~KeyValueStore()
+{
+	close();
+}
+
+bool KeyValueStore::open(const char * path)
+{
+	return open(path, true);
+}
+
+bool KeyValueStore::open(const char * path, bool repair)
+{
+	close();
+
+	if (!m_file.update(path))
+		return false;
+
+	m_path = path;
+
+	bool torn = false;
+
+	if (!load(&torn))
+	{
+		_ERROR_C(FileIO, "KeyValueStore: %s is not a valid store", path);
+
+		close();
+		return false;
+	}
+
+	if (torn)
+	{
+		// records appended after the torn one would be unreachable, so it has to go first
+		if (!repair || !compact())
+		{
+			_ERROR_C(FileIO, "KeyValueStore: couldn't repair %s", path);
+
+			close();
+			return false;
+		}
+
+		_MESSAGE_C(FileIO, "KeyValueStore: discarded incomplete record at the end of %s", path);
+	}
+
+	return true;
+}
+
+void KeyValueStore::close()
+{
+	m_file.close();
+	m_path.clear();
+	m_index.clear();
+
+	m_liveBytes = 0;
+	m_deadBytes = 0;
+}
+
+bool KeyValueStore::load(bool * torn)
+{
+	u64 fileLen = m_file.length();
+
+	if (!fileLen)
+	{
+		u8 header[kHeaderSize] = { 0 };
+		u32 magic = kMagic;
+		u16 version = kVersion;
+
+		memcpy(header, &magic, sizeof(magic));
+		memcpy(header + 4, &version, sizeof(version));
+
+		m_file.seek(0);
+		m_file.write(header, sizeof(header));
+		m_file.flush();
+
+		return true;
+	}
+
+	// stores are small, replaying from memory is simpler than seeking record by record
+	std::vector <u8> data(fileLen);
+
+	m_file.seek(0);
+	if (m_file.read(data.data(), fileLen) != fileLen)
+		return false;
+
+	u32 magic;
+	u16 version;
+
+	if (fileLen < kHeaderSize)
+		return false;
+
+	memcpy(&magic, data.data(), sizeof(magic));
+	memcpy(&version, data.data() + 4, sizeof(version));
+
+	if ((magic != kMagic) || (version != kVersion))
+		return false;
+
+	u64 offset = kHeaderSize;
+
+	while (offset + kRecordHeaderSize <= fileLen)
+	{
+		const u8 * record = data.data() + offset;
+
+		u32 checksum, keyLen, valueLen;
+		u8 type = record[4];
+
+		memcpy(&checksum, record, sizeof(checksum));
+		memcpy(&keyLen, record + 5, sizeof(keyLen));
+		memcpy(&valueLen, record + 9, sizeof(valueLen));
+
+		u64 recordLen = u64(kRecordHeaderSize) + keyLen + valueLen;
+
+		if ((offset + recordLen > fileLen) || (blockChecksum(record + 4, size_t(recordLen - 4)) != checksum))
+			break;
+
+		std::string key((const char *)record + kRecordHeaderSize, keyLen);
+
+		auto iter = m_index.find(key);
+		if (iter != m_index.end())
+		{
+			u64 oldLen = recordSize(key, iter->second.valueLen);
+
+			m_liveBytes -= oldLen;
+			m_deadBytes += oldLen;
+		}
+
+		if (type == kRecord_Set)
+		{
+			Entry & entry = m_index[key];
+			entry.valueOffset = offset + kRecordHeaderSize + keyLen;
+			entry.valueLen = valueLen;
+
+			m_liveBytes += recordLen;
+		}
+		else
+		{
+			if (iter != m_index.end())
+				m_index.erase(iter);
+
+			m_deadBytes += recordLen;
+		}
+
+		offset += recordLen;
+	}
+
+	*torn = offset != fileLen;
+
+	return true;
+}
+
+void KeyValueStore::buildRecord(std::vector <u8> * out, u8 type, const std::string & key, const void * data, u32 len)
+{
+	size_t start = out->size();
+	u32 keyLen = u32(key.size());
+
+	out->resize(start + kRecordHeaderSize + keyLen + len);
+
+	u8 * record = out->data() + start;
+
+	record[4] = type;
+	memcpy(record + 5, &keyLen, sizeof(keyLen));
+	memcpy(record + 9, &len, sizeof(len));
+	memcpy(record + kRecordHeaderSize, key.data(), keyLen);
+	if (len)
+		memcpy(record + kRecordHeaderSize + keyLen, data, len);
+
+	u32 checksum = blockChecksum(record + 4, kRecordHeaderSize - 4 + keyLen + len);
+	memcpy(record, &checksum, sizeof(checksum));
+}
+
+bool KeyValueStore::appendRecord(u8 type, const std::string & key, const void * data, u32 len, u64 * valueOffset)
+{
+	std::vector <u8> record;
+	buildRecord(&record, type, key, data, len);
+
+	// also serves as the positioning call required between a read and a write on the same FILE
+	u64 offset = m_file.seek(m_file.length());
+
+	if (m_file.write(record.data(), record.size()) != record.size())
+		return false;
+
+	m_file.flush();
+
+	if (valueOffset)
+		*valueOffset = offset + kRecordHeaderSize + key.size();
+
+	return true;
+}
+
+bool KeyValueStore::get(const std::string & key, std::string * value)
+{
+	auto iter = m_index.find(key);
+	if (iter == m_index.end())
+		return false;
+
+	const Entry & entry = iter->second;
+
+	value->resize(entry.valueLen);
+
+	if (!entry.valueLen)
+		return true;
+
+	m_file.seek(entry.valueOffset);
+
+	return m_file.read(&(*value)[0], entry.valueLen) == entry.valueLen;
+}
+
+bool KeyValueStore::has(const std::string & key) const
+{
+	return m_index.find(key) != m_index.end();
+}
+
+bool KeyValueStore::set(const std::string & key, const void * data, u32 len)
+{
+	if (!isOpen())
+		return false;
+
+	u64 valueOffset;
+	if (!appendRecord(kRecord_Set, key, data, len, &valueOffset))
+		return false;
+
+	auto iter = m_index.find(key);
+	if (iter != m_index.end())
+	{
+		u64 oldLen = recordSize(key, iter->second.valueLen);
+
+		m_liveBytes -= oldLen;
+		m_deadBytes += oldLen;
+	}
+
+	Entry & entry = m_index[key];
+	entry.valueOffset = valueOffset;
+	entry.valueLen = len;
+
+	m_liveBytes += recordSize(key, len);
+
+	compactIfNeeded();
+
+	return true;
+}
+
+bool KeyValueStore::remove(const std::string & key)
+{
+	auto iter = m_index.find(key);
+	if (iter == m_index.end())
+		return false;
+
+	if (!appendRecord(kRecord_Delete, key, nullptr, 0, nullptr))
+		return false;
+
+	u64 oldLen = recordSize(key, iter->second.valueLen);
+
+	m_liveBytes -= oldLen;
+	m_deadBytes += oldLen + recordSize(key, 0);
+
+	m_index.erase(iter);
+
+	compactIfNeeded();
+
+	return true;
+}
+
+void KeyValueStore::keys(std::vector <std::string> * out) const
+{
+	out->reserve(out->size() + m_index.size());
+
+	for (auto & iter : m_index)
+		out->push_back(iter.first);
+}
+
+void KeyValueStore::compactIfNeeded()
+{
+	if ((m_deadBytes >= kCompactMinDeadBytes) && (m_deadBytes > m_liveBytes))
+		compact();
+}
+
+bool KeyValueStore::compact()
+{
+	if (!isOpen())
+		return false;
+
+	std::vector <u8> data(kHeaderSize, 0);
+	u32 magic = kMagic;
+	u16 version = kVersion;
+
+	memcpy(data.data(), &magic, sizeof(magic));
+	memcpy(data.data() + 4, &version, sizeof(version));
+
+	data.reserve(size_t(kHeaderSize + m_liveBytes));
+
+	std::string value;
+
+	for (auto & iter : m_index)
+	{
+		if (!get(iter.first, &value))
+			return false;
+
+		buildRecord(&data, kRecord_Set, iter.first, value.data(), u32(value.size()));
+	}
+
+	std::string path = m_path;
+
+	m_file.close();
+
+	// the old file is left alone if this fails, so reopening it below is always safe
+	bool result = FileStream::replaceFile(path.c_str(), data.data(), data.size());
+
+	if (!open(path.c_str(), false))
+		return false;
+
+	return result;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "obse64_common/FileStream.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// small persistent key/value store
+//
+// the file is an append-only log of set/delete records. opening it replays the log in to an in-memory
+// index of key -> value location, so lookups are a hash probe and one read instead of a file scan
+// superseded records are dropped by rewriting the file once they outweigh the live data
+//
+// file layout:
+//	header	u32 magic ('OBKV'), u16 version, u16 reserved
+//	records	u32 checksum, u8 type, u32 key length, u32 value length, key, value
+//	the checksum covers everything after it. a torn record at the end from a crash is discarded on open
+
+class KeyValueStore
+{
+public:
+	enum
+	{
+		kMagic = 0x564B424F,	// "OBKV" on disk
+		kVersion = 1,
+
+		kHeaderSize = 8,
+		kRecordHeaderSize = 13,
+
+		// dead records are only compacted away once they're at least this big and outweigh the live ones
+		kCompactMinDeadBytes = 64 * 1024,
+	};
+
+	KeyValueStore();
+	~KeyValueStore();
+
+	// creates the file if it doesn't exist
+	bool	open(const char * path);
+	void	close();
+
+	bool	isOpen() const { return !m_path.empty(); }
+
+	bool	get(const std::string & key, std::string * value);
+	bool	has(const std::string & key) const;
+
+	bool	set(const std::string & key, const void * data, u32 len);
+	bool	set(const std::string & key, const std::string & value) { return set(key, value.data(), u32(value.size())); }
+
+	// returns false if the key didn't exist
+	bool	remove(const std::string & key);
+
+	// unordered
+	void	keys(std::vector <std::string> * out) const;
+	u32		size() const { return u32(m_index.size()); }
+
+	// rewrites the file with only live records
+	bool	compact();
+
+	u64		liveBytes() const { return m_liveBytes; }
+	u64		deadBytes() const { return m_deadBytes; }
+
+private:
+	enum
+	{
+		kRecord_Set = 1,
+		kRecord_Delete,
+	};
+
+	struct Entry
+	{
+		u64	valueOffset;
+		u32	valueLen;
+	};
+
+	bool	open(const char * path, bool repair);
+	bool	load(bool * torn);
+	bool	appendRecord(u8 type, const std::string & key, const void * data, u32 len, u64 * valueOffset);
+	void	compactIfNeeded();
+
+	static void	buildRecord(std::vector <u8> * out, u8 type, const std::string & key, const void * data, u32 len);
+
+	FileStream	m_file;
+	std::string	m_path;
+
+	std::unordered_map <std::string, Entry>	m_index;
+
+	u64	m_liveBytes;	// records in the index
+	u64	m_deadBytes;	// superseded records and tombstones
+};
@@ -1,65 +1,538 @@
 #include "Log.h"
+#include "BinaryLog.h"
 #include "Errors.h"
 #include "FileStream.h"
+#include "LogRing.h"
+#include "Types.h"
+#include "Utilities.h"
+#include <atomic>
+#include <intrin.h>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
 #include <share.h>
 #include <shlobj.h>
 
 FILE * DebugLog::s_log = nullptr;
-DebugLog::LogLevel DebugLog::s_fileLevel = DebugLog::kLevel_DebugMessage;
+FILE * DebugLog::s_binaryLog = nullptr;
+DebugLog::LogLevel DebugLog::s_fileLevels[kChannel_Max] =
+{
+	kLevel_DebugMessage,	// General
+	kLevel_DebugMessage,	// Plugins
+	kLevel_DebugMessage,	// Script
+	kLevel_DebugMessage,	// Hooks
+	kLevel_DebugMessage,	// FileIO
+};
 DebugLog::LogLevel DebugLog::s_printLevel = DebugLog::kLevel_Message;
-char DebugLog::s_formatBuf[8192] = { 0 };
+DebugLog::LogLevel DebugLog::s_channelLevels[kChannel_Max] =
+{
+	kLevel_DebugMessage,
+	kLevel_DebugMessage,
+	kLevel_DebugMessage,
+	kLevel_DebugMessage,
+	kLevel_DebugMessage,
+};
+
+static const char * kChannelNames[DebugLog::kChannel_Max] =
+{
+	"General",
+	"Plugins",
+	"Script",
+	"Hooks",
+	"FileIO",
+};
+
+static const char * kLevelNames[] =
+{
+	"fatal",
+	"error",
+	"warning",
+	"message",
+	"verbose",
+	"debug",
+};
+
+// messages go through a LogRing, see LogRing.h
+// the background thread wakes up on a timer and writes whatever has built up in one go
+// it's only signalled early when the ring is filling up, so logging doesn't cost a context switch per line
+namespace
+{
+	enum
+	{
+		kMaxMessageLen = LogRing::kMaxMessageLen,
+
+		kFlag_File = LogRing::kFlag_File,
+		kFlag_Console = LogRing::kFlag_Console,
+		kFlag_Binary = LogRing::kFlag_Binary,
+
+		kDrainIntervalMS = 10,
+		kWakeBacklog = LogRing::kNumSlots / 4,
+
+		kFormatCacheSize = 256,	// per thread, must be a power of two
+	};
+
+	LogRing				s_ring;
+
+	HANDLE				s_wakeEvent = nullptr;
+	std::atomic <bool>	s_consumerIdle { false };
+
+	// binary log formats, keyed by the address of the format string
+	// only strings in a module's read only data are recorded this way, so the address can't be reused for different text
+	// (plugins are never unloaded)
+	struct LogFormat
+	{
+		LogFormat(const char * fmt, u32 _id)
+		:format(fmt), id(_id)
+		{
+			binary = format.isSupported() && (format.source().size() <= kMaxMessageLen - BinaryLogFormat::kRecordHeaderSize);
+		}
+
+		BinaryLogFormat	format;
+		u32				id;
+		bool			binary;	// false = formatted and recorded as text
+	};
+
+	struct FormatCacheEntry
+	{
+		const char		* fmt;
+		const LogFormat	* format;
+	};
+
+	std::mutex	s_formatLock;
+	std::unordered_map <const char *, LogFormat *>	s_formats;	// never freed, the per thread caches point in to it
+	u32			s_nextFormatID = 1;
+
+	thread_local FormatCacheEntry	s_formatCache[kFormatCacheSize];
+
+	bool IsConstantString(const void * str)
+	{
+		MEMORY_BASIC_INFORMATION	info;
+
+		if (!VirtualQuery(str, &info, sizeof(info)) || (info.Type != MEM_IMAGE))
+			return false;
+
+		DWORD protect = info.Protect & 0xFF;
+
+		return (protect == PAGE_READONLY) || (protect == PAGE_EXECUTE_READ) || (protect == PAGE_EXECUTE);
+	}
+
+	// the TSC is invariant on anything that can run the game, so it's converted with one frequency measured up front
+	std::once_flag		s_calibrateOnce;
+	u64					s_tscStart = 0;
+	u64					s_tscFrequency = 1;
+	double				s_secondsPerTick = 0;
+
+	bool				s_timestamps = false;
+	std::atomic <u32>	s_frame { 0 };
+
+	void CalibrateTimer()
+	{
+		std::call_once(s_calibrateOnce, []()
+		{
+			LARGE_INTEGER	qpcFrequency, qpcStart, qpcEnd;
+
+			QueryPerformanceFrequency(&qpcFrequency);
+
+			QueryPerformanceCounter(&qpcStart);
+			u64 tscStart = __rdtsc();
+
+			Sleep(20);
+
+			QueryPerformanceCounter(&qpcEnd);
+			u64 tscEnd = __rdtsc();
+
+			double elapsed = double(qpcEnd.QuadPart - qpcStart.QuadPart) / double(qpcFrequency.QuadPart);
+
+			s_tscStart = tscStart;
+			s_tscFrequency = u64(double(tscEnd - tscStart) / elapsed);
+			s_secondsPerTick = 1.0 / double(s_tscFrequency);
+		});
+	}
+
+	void WriteRecordHeader(u8 * record, u8 type, u8 level, u32 len, u32 formatID)
+	{
+		u16 len16 = u16(len);
+		u64 timer = __rdtsc();
+		u32 thread = GetCurrentThreadId();
+		u32 frame = s_frame.load(std::memory_order_relaxed);
+
+		record[0] = type;
+		record[1] = level;
+		memcpy(record + 2, &len16, sizeof(len16));
+		memcpy(record + 4, &formatID, sizeof(formatID));
+		memcpy(record + 8, &timer, sizeof(timer));
+		memcpy(record + 16, &thread, sizeof(thread));
+		memcpy(record + 20, &frame, sizeof(frame));
+	}
+
+	// returns null if the message has to be formatted up front
+	template <typename DrainFn>
+	const LogFormat * LookupFormat(const char * fmt, DrainFn helpDrain)
+	{
+		FormatCacheEntry & cached = s_formatCache[(uintptr_t(fmt) >> 3) & (kFormatCacheSize - 1)];
+
+		if (cached.fmt == fmt)
+			return cached.format;
+
+		if (!IsConstantString(fmt))
+			return nullptr;
+
+		std::lock_guard <std::mutex> lock(s_formatLock);
+
+		LogFormat *& format = s_formats[fmt];
+
+		if (!format)
+		{
+			format = new LogFormat(fmt, s_nextFormatID++);
+
+			if (format->binary)
+			{
+				// queued while holding the lock, so no other thread can use the id before it's defined
+				const std::string & text = format->format.source();
+
+				std::string record(BinaryLogFormat::kRecordHeaderSize, '\0');
+				WriteRecordHeader((u8 *)&record[0], BinaryLogFormat::kRecord_Format, 0, u32(record.size() + text.size()), format->id);
+				record += text;
+
+				s_ring.push(record.data(), u32(record.size()), kFlag_Binary, helpDrain);
+			}
+		}
+
+		cached.fmt = fmt;
+		cached.format = format;
+
+		return format;
+	}
+
+	void GetRelativePath(int folderID, const char * relPath, char * path, size_t pathLen)
+	{
+		HRESULT err = SHGetFolderPath(NULL, folderID | CSIDL_FLAG_CREATE, NULL, SHGFP_TYPE_CURRENT, path);
+		if(!SUCCEEDED(err))
+		{
+			_FATALERROR("Your virus scanner is blocking access to your My Documents folder. SHGetFolderPath %08X failed (result = %08X lasterr = %08X)", folderID, err, GetLastError());
+		}
+		ASSERT_CODE(SUCCEEDED(err), err);
+
+		strcat_s(path, pathLen, relPath);
+
+		FileStream::makeDirs(path);
+	}
+}
 
 void DebugLog::open(const char * path)
 {
 	s_log = _fsopen(path, "w", _SH_DENYWR);
+
+	startConsumer();
 }
 
 void DebugLog::openRelative(int folderID, const char * relPath)
 {
 	char	path[MAX_PATH];
 
-	HRESULT err = SHGetFolderPath(NULL, folderID | CSIDL_FLAG_CREATE, NULL, SHGFP_TYPE_CURRENT, path);
-	if(!SUCCEEDED(err))
+	GetRelativePath(folderID, relPath, path, sizeof(path));
+
+	open(path);
+}
+
+void DebugLog::openBinary(const char * path)
+{
+	FILE * file = _fsopen(path, "wb", _SH_DENYWR);
+	if(!file)
 	{
-		_FATALERROR("Your virus scanner is blocking access to your My Documents folder. SHGetFolderPath %08X failed (result = %08X lasterr = %08X)", folderID, err, GetLastError());
+		_ERROR("couldn't open binary log %s", path);
+		return;
 	}
-	ASSERT_CODE(SUCCEEDED(err), err);
 
-	strcat_s(path, sizeof(path), relPath);
+	CalibrateTimer();
 
-	FileStream::makeDirs(path);
+	u8	header[BinaryLogFormat::kHeaderSize] = { 0 };
 
-	open(path);
+	u32	magic = BinaryLogFormat::kMagic;
+	u16	version = BinaryLogFormat::kVersion;
+
+	FILETIME	now;
+	GetSystemTimeAsFileTime(&now);
+
+	memcpy(header, &magic, sizeof(magic));
+	memcpy(header + 4, &version, sizeof(version));
+	memcpy(header + 8, &s_tscFrequency, sizeof(s_tscFrequency));
+	memcpy(header + 16, &s_tscStart, sizeof(s_tscStart));
+	memcpy(header + 24, &now, sizeof(now));
+
+	fwrite(header, 1, sizeof(header), file);
+	fflush(file);
+
+	s_binaryLog = file;
+
+	startConsumer();
+
+	_MESSAGE("binary log = %s, only warnings and errors are written to this file from now on", path);
+}
+
+void DebugLog::openBinaryRelative(int folderID, const char * relPath)
+{
+	char	path[MAX_PATH];
+
+	GetRelativePath(folderID, relPath, path, sizeof(path));
+
+	openBinary(path);
+}
+
+void DebugLog::startConsumer()
+{
+	if (!s_wakeEvent)
+	{
+		s_wakeEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+
+		// never joined, it's killed with the process. anything still queued is written by the atexit flush
+		std::thread(consumerThread).detach();
+
+		atexit(flushAtExit);
+	}
+}
+
+void DebugLog::readConfig()
+{
+	auto readLevel = [](const char * key, LogLevel * level)
+	{
+		std::string	data = getConfigOption("Log", key);
+		if(data.empty())
+			return;
+
+		for(u32 i = 0; i < sizeof(kLevelNames) / sizeof(kLevelNames[0]); i++)
+		{
+			if(!_stricmp(data.c_str(), kLevelNames[i]) || ((data.size() == 1) && (data[0] == '0' + i)))
+			{
+				*level = LogLevel(i);
+				return;
+			}
+		}
+
+		_WARNING("obse.ini: unknown log level \"%s\" for %s", data.c_str(), key);
+	};
+
+	for(u32 i = 0; i < kChannel_Max; i++)
+		readLevel(kChannelNames[i], &s_fileLevels[i]);
+
+	readLevel("Console", &s_printLevel);
+
+	updateChannelLevels();
+
+	u32	timestamps = 0;
+	if(getConfigOption_u32("Log", "Timestamps", &timestamps) && timestamps)
+	{
+		CalibrateTimer();
+		s_timestamps = true;
+
+		_MESSAGE("log timestamps: [seconds thread frame], TSC frequency %llu", s_tscFrequency);
+	}
+
+	for(u32 i = 0; i < kChannel_Max; i++)
+		if(s_fileLevels[i] != kLevel_DebugMessage)
+			_MESSAGE("log channel %s: %s", kChannelNames[i], kLevelNames[s_fileLevels[i]]);
 }
 
-void DebugLog::log(LogLevel level, const char * fmt, va_list args)
+void DebugLog::updateChannelLevels()
 {
-	bool	toFile = (level <= s_fileLevel);
+	for(u32 i = 0; i < kChannel_Max; i++)
+		s_channelLevels[i] = (s_fileLevels[i] > s_printLevel) ? s_fileLevels[i] : s_printLevel;
+}
+
+const char * DebugLog::channelName(LogChannel channel)
+{
+	return (u32(channel) < kChannel_Max) ? kChannelNames[channel] : "?";
+}
+
+void DebugLog::message(LogChannel channel, LogLevel level, const char * fmt, ...)
+{
+	va_list	args;
+
+	va_start(args, fmt);
+	log(channel, level, fmt, args);
+	va_end(args);
+}
+
+void DebugLog::log(LogChannel channel, LogLevel level, const char * fmt, va_list args)
+{
+	bool	toFile = (level <= s_fileLevels[channel]);
 	bool	toConsole = (level <= s_printLevel);
 
-	static FILE * s_stdout = nullptr;
+	if(!toFile && !toConsole)
+		return;
+
+	if(toFile && s_binaryLog)
+	{
+		// the text log only keeps what's needed to notice a problem without decoding anything
+		toFile = (level <= kLevel_Warning);
+
+		if(toFile || toConsole)
+		{
+			va_list	binaryArgs;
+
+			va_copy(binaryArgs, args);
+			logBinary(channel, level, fmt, binaryArgs);
+			va_end(binaryArgs);
+		}
+		else
+		{
+			logBinary(channel, level, fmt, args);
+		}
+	}
 
 	if(toFile || toConsole)
 	{
-		vsprintf_s(s_formatBuf, sizeof(s_formatBuf), fmt, args);
-		strcat_s(s_formatBuf, sizeof(s_formatBuf), "\n");
+		// per thread so concurrent callers don't format over each other
+		thread_local char formatBuf[kMaxMessageLen];
+
+		int prefixLen = 0;
+
+		if(s_timestamps)
+		{
+			double seconds = double(s64(__rdtsc() - s_tscStart)) * s_secondsPerTick;
+
+			prefixLen = sprintf_s(formatBuf, sizeof(formatBuf), "[%11.6f %5u %6u] ",
+				seconds, GetCurrentThreadId(), s_frame.load(std::memory_order_relaxed));
+
+			if(prefixLen < 0)
+				prefixLen = 0;
+		}
+
+		int len = vsnprintf(formatBuf + prefixLen, sizeof(formatBuf) - prefixLen - 1, fmt, args);
+
+		if(len < 0)
+			len = 0;
+
+		len += prefixLen;
+
+		if(len > int(sizeof(formatBuf) - 2))
+			len = sizeof(formatBuf) - 2;
+
+		formatBuf[len++] = '\n';
+
+		u8 flags = (toFile ? kFlag_File : 0) | (toConsole ? kFlag_Console : 0);
+
+		s_ring.push(formatBuf, len, flags, []() { return drain(kDrain_Try); });
+	}
+
+	if(level == kLevel_FatalError)
+	{
+		// about to halt, get everything out now instead of trusting the background thread to get to it
+		drain(kDrain_Exit);
+		return;
 	}
 
-	if(toFile && s_log)
-		fputs(s_formatBuf, s_log);
+	// once per sleep, and only when the timer might not be soon enough
+	if((s_ring.backlog() >= kWakeBacklog) && s_consumerIdle.load(std::memory_order_relaxed) && s_consumerIdle.exchange(false))
+		SetEvent(s_wakeEvent);
+}
+
+void DebugLog::logBinary(LogChannel channel, LogLevel level, const char * fmt, va_list args)
+{
+	u8 levelAndChannel = u8(level | (channel << 4));
+
+	auto helpDrain = []() { return drain(kDrain_Try); };
+
+	thread_local u8 recordBuf[kMaxMessageLen];
+
+	const LogFormat * format = LookupFormat(fmt, helpDrain);
+
+	u8 * payload = recordBuf + BinaryLogFormat::kRecordHeaderSize;
+	u32 payloadLen = sizeof(recordBuf) - BinaryLogFormat::kRecordHeaderSize;
+
+	if(format && format->binary)
+	{
+		u32 len = BinaryLogFormat::kRecordHeaderSize + format->format.pack(payload, payloadLen, args);
+
+		WriteRecordHeader(recordBuf, BinaryLogFormat::kRecord_Message, levelAndChannel, len, format->id);
 
-	if(toConsole)
+		s_ring.push((const char *)recordBuf, len, kFlag_Binary, helpDrain);
+	}
+	else
 	{
-		if(!s_stdout)
-			s_stdout = stdout;
+		int textLen = vsnprintf((char *)payload, payloadLen, fmt, args);
+
+		if(textLen < 0)
+			textLen = 0;
+		else if(textLen > int(payloadLen - 1))
+			textLen = payloadLen - 1;
+
+		u32 len = BinaryLogFormat::kRecordHeaderSize + textLen;
 
-		if(s_stdout)
-			fputs(s_formatBuf, s_stdout);
+		WriteRecordHeader(recordBuf, BinaryLogFormat::kRecord_Text, levelAndChannel, len, 0);
+
+		s_ring.push((const char *)recordBuf, len, kFlag_Binary, helpDrain);
+	}
+}
+
+void DebugLog::beginFrame()
+{
+	s_frame.fetch_add(1, std::memory_order_relaxed);
+
+	// marks where the frame starts even if nothing is logged during it
+	if(s_binaryLog)
+	{
+		u8	record[BinaryLogFormat::kRecordHeaderSize];
+
+		WriteRecordHeader(record, BinaryLogFormat::kRecord_Frame, 0, sizeof(record), 0);
+
+		s_ring.push((const char *)record, sizeof(record), kFlag_Binary, []() { return drain(kDrain_Try); });
 	}
 }
 
 void DebugLog::flush()
 {
-	if(s_log)
-		fflush(s_log);
+	drain(kDrain_Wait);
+}
+
+void DebugLog::flushAtExit()
+{
+	drain(kDrain_Exit);
+}
+
+bool DebugLog::drain(DrainMode mode)
+{
+	static_assert((int(kDrain_Try) == LogRing::kDrain_Try) && (int(kDrain_Wait) == LogRing::kDrain_Wait) &&
+		(int(kDrain_Exit) == LogRing::kDrain_Exit), "DebugLog::DrainMode doesn't match LogRing");
+
+	return s_ring.drain(LogRing::DrainMode(mode), [](const std::string & fileBatch, const std::string & consoleBatch, const std::string & binaryBatch)
+	{
+		static FILE * s_stdout = nullptr;
+
+		if(!fileBatch.empty() && s_log)
+		{
+			fwrite(fileBatch.data(), 1, fileBatch.size(), s_log);
+			fflush(s_log);
+		}
+
+		if(!binaryBatch.empty() && s_binaryLog)
+		{
+			fwrite(binaryBatch.data(), 1, binaryBatch.size(), s_binaryLog);
+			fflush(s_binaryLog);
+		}
+
+		if(!consoleBatch.empty())
+		{
+			if(!s_stdout)
+				s_stdout = stdout;
+
+			if(s_stdout)
+				fwrite(consoleBatch.data(), 1, consoleBatch.size(), s_stdout);
+		}
+	});
+}
+
+void DebugLog::consumerThread()
+{
+	while(true)
+	{
+		drain(kDrain_Wait);
+
+		s_consumerIdle.store(true);
+
+		WaitForSingleObject(s_wakeEvent, kDrainIntervalMS);
+
+		s_consumerIdle.store(false);
+	}
 }
@@ -9,6 +9,11 @@ public:
 	static void open(const char * path);
 	static void openRelative(int folderID, const char * relPath);
 
+	// records messages going to the file unformatted, see BinaryLog.h. the text log keeps warnings and errors
+	// call after open
+	static void openBinary(const char * path);
+	static void openBinaryRelative(int folderID, const char * relPath);
+
 	enum LogLevel
 	{
 		kLevel_FatalError = 0,
@@ -19,69 +24,90 @@ public:
 		kLevel_DebugMessage
 	};
 
-	static void log(LogLevel level, const char * fmt, va_list args);
+	// each channel has its own file level, set in the [Log] section of obse.ini by channel name
+	enum LogChannel
+	{
+		kChannel_General = 0,
+		kChannel_Plugins,
+		kChannel_Script,
+		kChannel_Hooks,
+		kChannel_FileIO,
 
-	static void flush();
+		kChannel_Max
+	};
 
-private:
-	static FILE * s_log;
+	// reads channel levels from obse.ini, call after open
+	// [Log]
+	// Plugins=debug		fatal, error, warning, message, verbose, debug, or 0-5
+	// Console=message		level for messages printed to stdout, all channels
+	// Timestamps=1		prefix text log lines with [seconds thread frame]
+	static void readConfig();
 
-	static LogLevel s_fileLevel;
-	static LogLevel s_printLevel;
+	static const char * channelName(LogChannel channel);
 
-	static char s_formatBuf[8192];
-};
+	// checked by the logging macros before anything else is done
+	static bool isEnabled(LogChannel channel, LogLevel level) { return level <= s_channelLevels[channel]; }
 
-inline void _FATALERROR(const char * fmt, ...)
-{
-	va_list args;
+	// thread safe. messages are queued and written by a background thread
+	static void log(LogChannel channel, LogLevel level, const char * fmt, va_list args);
+	static void log(LogLevel level, const char * fmt, va_list args) { log(kChannel_General, level, fmt, args); }
 
-	va_start(args, fmt);
-	DebugLog::log(DebugLog::kLevel_FatalError, fmt, args);
-	va_end(args);
-}
+	static void message(LogChannel channel, LogLevel level, const char * fmt, ...);
 
-inline void _ERROR(const char * fmt, ...)
-{
-	va_list args;
+	// writes out everything queued so far, from the calling thread
+	static void flush();
 
-	va_start(args, fmt);
-	DebugLog::log(DebugLog::kLevel_Error, fmt, args);
-	va_end(args);
-}
+	// called once per game frame, from the game thread. the count is recorded with each message
+	static void beginFrame();
 
-inline void _WARNING(const char * fmt, ...)
-{
-	va_list args;
+private:
+	// same values as LogRing::DrainMode
+	enum DrainMode
+	{
+		kDrain_Try,		// give up if another thread is draining
+		kDrain_Wait,	// wait for it
+		kDrain_Exit,	// wait a while, then go ahead without the lock. only for process exit and fatal errors
+	};
 
-	va_start(args, fmt);
-	DebugLog::log(DebugLog::kLevel_Warning, fmt, args);
-	va_end(args);
-}
+	// returns false if another thread is already draining and mode is kDrain_Try
+	static bool drain(DrainMode mode);
+	static void flushAtExit();
+	static void consumerThread();
+	static void startConsumer();
 
-inline void _MESSAGE(const char * fmt, ...)
-{
-	va_list args;
+	static void logBinary(LogChannel channel, LogLevel level, const char * fmt, va_list args);
 
-	va_start(args, fmt);
-	DebugLog::log(DebugLog::kLevel_Message, fmt, args);
-	va_end(args);
-}
+	static void updateChannelLevels();
 
-inline void _VMESSAGE(const char * fmt, ...)
-{
-	va_list args;
+	static FILE * s_log;
+	static FILE * s_binaryLog;
 
-	va_start(args, fmt);
-	DebugLog::log(DebugLog::kLevel_VerboseMessage, fmt, args);
-	va_end(args);
-}
+	static LogLevel s_fileLevels[kChannel_Max];
+	static LogLevel s_printLevel;
 
-inline void _DMESSAGE(const char * fmt, ...)
-{
-	va_list args;
+	static LogLevel s_channelLevels[kChannel_Max];	// the more verbose of the channel's file level and the print level
+};
+
+// messages less important than this are compiled out, including evaluating their arguments
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL	5	// kLevel_DebugMessage
+#endif
+
+#define LOG_CHANNEL(channel, level, ...)																	\
+	((((level) <= LOG_COMPILE_LEVEL) && DebugLog::isEnabled(channel, level)) ?								\
+		DebugLog::message(channel, level, __VA_ARGS__) : (void)0)
+
+#define _FATALERROR(...)	LOG_CHANNEL(DebugLog::kChannel_General, DebugLog::kLevel_FatalError, __VA_ARGS__)
+#define _ERROR(...)			LOG_CHANNEL(DebugLog::kChannel_General, DebugLog::kLevel_Error, __VA_ARGS__)
+#define _WARNING(...)		LOG_CHANNEL(DebugLog::kChannel_General, DebugLog::kLevel_Warning, __VA_ARGS__)
+#define _MESSAGE(...)		LOG_CHANNEL(DebugLog::kChannel_General, DebugLog::kLevel_Message, __VA_ARGS__)
+#define _VMESSAGE(...)		LOG_CHANNEL(DebugLog::kChannel_General, DebugLog::kLevel_VerboseMessage, __VA_ARGS__)
+#define _DMESSAGE(...)		LOG_CHANNEL(DebugLog::kChannel_General, DebugLog::kLevel_DebugMessage, __VA_ARGS__)
+
+// channel is the name without the prefix, _DMESSAGE_C(Plugins, "...")
+#define _ERROR_C(channel, ...)		LOG_CHANNEL(DebugLog::kChannel_##channel, DebugLog::kLevel_Error, __VA_ARGS__)
+#define _WARNING_C(channel, ...)	LOG_CHANNEL(DebugLog::kChannel_##channel, DebugLog::kLevel_Warning, __VA_ARGS__)
+#define _MESSAGE_C(channel, ...)	LOG_CHANNEL(DebugLog::kChannel_##channel, DebugLog::kLevel_Message, __VA_ARGS__)
+#define _VMESSAGE_C(channel, ...)	LOG_CHANNEL(DebugLog::kChannel_##channel, DebugLog::kLevel_VerboseMessage, __VA_ARGS__)
+#define _DMESSAGE_C(channel, ...)	LOG_CHANNEL(DebugLog::kChannel_##channel, DebugLog::kLevel_DebugMessage, __VA_ARGS__)
 
-	va_start(args, fmt);
-	DebugLog::log(DebugLog::kLevel_DebugMessage, fmt, args);
-	va_end(args);
-}
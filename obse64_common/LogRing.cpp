@@ -0,0 +1,73 @@
+#include "LogRing.h"
+#include <chrono>
+
+LogRing::LogRing()
+{
+	for (u32 i = 0; i < kNumSlots; i++)
+		m_slots[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+bool LogRing::lockForDrain(DrainMode mode, std::unique_lock <std::mutex> * lock)
+{
+	switch (mode)
+	{
+		case kDrain_Try:
+			return lock->try_lock();
+
+		case kDrain_Wait:
+			lock->lock();
+			break;
+
+		case kDrain_Exit:
+			// a thread killed while draining (process exit) never releases the lock, so don't wait forever
+			for (u32 i = 0; (i < kForceDrainTimeoutMS) && !lock->try_lock(); i++)
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			break;
+	}
+
+	return true;
+}
+
+void LogRing::consume(std::string * fileBatch, std::string * consoleBatch, std::string * binaryBatch)
+{
+	u64 pos = m_readPos.load(std::memory_order_relaxed);
+
+	for (;;)
+	{
+		Slot & first = get(pos);
+
+		if (first.sequence.load(std::memory_order_acquire) != pos + 1)
+			break;
+
+		u32 numSlots = first.numSlots;
+		u8 flags = first.flags;
+
+		// the rest of the message may still be in progress
+		if (get(pos + numSlots - 1).sequence.load(std::memory_order_acquire) != pos + numSlots)
+			break;
+
+		for (u32 i = 0; i < numSlots; i++)
+		{
+			Slot & slot = get(pos + i);
+
+			// slots in the middle of a message can be published after the last one
+			while (slot.sequence.load(std::memory_order_acquire) != pos + i + 1)
+				std::this_thread::yield();
+
+			if (flags & kFlag_File)
+				fileBatch->append(slot.data, slot.len);
+
+			if (flags & kFlag_Console)
+				consoleBatch->append(slot.data, slot.len);
+
+			if (flags & kFlag_Binary)
+				binaryBatch->append(slot.data, slot.len);
+
+			slot.sequence.store(pos + i + kNumSlots, std::memory_order_release);
+		}
+
+		pos += numSlots;
+	}
+
+	m_readPos.store(pos, std::memory_order_relaxed);
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include "obse64_common/Types.h"
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// the queue behind DebugLog, kept apart from it so it builds and can be tested anywhere
+//
+// messages are queued in a fixed ring of slots shared by all threads
+// a producer reserves a run of slots with one atomic add, fills them and marks each one as published
+// one consumer at a time (the background thread, or whoever is flushing) writes them out in order
+// if the ring is full, producers help drain it instead of waiting on the background thread
+
+class LogRing
+{
+public:
+	enum
+	{
+		kMaxMessageLen = 8192,
+
+		kSlotDataSize = 244,
+		kNumSlots = 4096,	// must be a power of two
+
+		// which batches a message is written to
+		kFlag_File =	1 << 0,
+		kFlag_Console =	1 << 1,
+		kFlag_Binary =	1 << 2,
+
+		// how long an exit drain waits for the current consumer before going ahead anyway
+		kForceDrainTimeoutMS = 1000,
+	};
+
+	enum DrainMode
+	{
+		kDrain_Try,		// give up if another thread is draining
+		kDrain_Wait,	// wait for it
+		kDrain_Exit,	// wait a while, then go ahead without the lock. only for process exit and fatal errors
+	};
+
+	LogRing();
+
+	// len is at most kMaxMessageLen. helpDrain is called while waiting for a slot, and usually drains with
+	// kDrain_Try
+	template <typename DrainFn>
+	void	push(const char * msg, u32 len, u8 flags, DrainFn helpDrain);
+
+	// slots reserved but not yet written out, approximate
+	u64		backlog() const
+	{
+		return m_writePos.load(std::memory_order_relaxed) - m_readPos.load(std::memory_order_relaxed);
+	}
+
+	// takes the drain lock according to mode, moves everything published so far in to the batches, then
+	// calls write(fileBatch, consoleBatch, binaryBatch) still holding the lock so output stays in order
+	// returns false if mode is kDrain_Try and another thread is already draining
+	template <typename WriteFn>
+	bool	drain(DrainMode mode, WriteFn write);
+
+private:
+	struct Slot
+	{
+		std::atomic <u64>	sequence;	// == position while free, position + 1 once published
+		u16		len;
+		u8		flags;		// first slot of a message
+		u8		numSlots;	// first slot of a message
+		char	data[kSlotDataSize];
+	};
+
+	static_assert(sizeof(Slot) == 256, "LogRing::Slot should fill four cache lines exactly");
+	static_assert((kMaxMessageLen + kSlotDataSize - 1) / kSlotDataSize <= 0xFF, "LogRing::Slot::numSlots too small");
+
+	bool	lockForDrain(DrainMode mode, std::unique_lock <std::mutex> * lock);
+
+	// single consumer, call with the drain lock held
+	void	consume(std::string * fileBatch, std::string * consoleBatch, std::string * binaryBatch);
+
+	Slot &	get(u64 pos) { return m_slots[pos & (kNumSlots - 1)]; }
+
+	alignas(64) std::atomic <u64>	m_writePos { 0 };
+	alignas(64) std::atomic <u64>	m_readPos { 0 };
+
+	std::mutex	m_drainLock;
+
+	Slot	m_slots[kNumSlots];
+};
+
+template <typename DrainFn>
+void LogRing::push(const char * msg, u32 len, u8 flags, DrainFn helpDrain)
+{
+	u32 numSlots = (len + kSlotDataSize - 1) / kSlotDataSize;
+	u64 pos = m_writePos.fetch_add(numSlots, std::memory_order_relaxed);
+
+	for (u32 i = 0; i < numSlots; i++)
+	{
+		Slot & slot = get(pos + i);
+
+		// full, the slot's previous message hasn't been written out yet
+		// a drain can succeed without freeing this slot, if the message before it is still being written by
+		// a thread that isn't running, so yield whenever it's still taken rather than only when the drain failed
+		while (slot.sequence.load(std::memory_order_acquire) != pos + i)
+		{
+			helpDrain();
+
+			if (slot.sequence.load(std::memory_order_acquire) != pos + i)
+				std::this_thread::yield();
+		}
+
+		u32 chunkLen = (len > kSlotDataSize) ? kSlotDataSize : len;
+
+		memcpy(slot.data, msg, chunkLen);
+		slot.len = u16(chunkLen);
+		slot.flags = flags;
+		slot.numSlots = u8(numSlots - i);
+
+		msg += chunkLen;
+		len -= chunkLen;
+
+		slot.sequence.store(pos + i + 1, std::memory_order_release);
+	}
+}
+
+template <typename WriteFn>
+bool LogRing::drain(DrainMode mode, WriteFn write)
+{
+	std::unique_lock <std::mutex> lock(m_drainLock, std::defer_lock);
+
+	if (!lockForDrain(mode, &lock))
+		return false;
+
+	std::string fileBatch;
+	std::string consoleBatch;
+	std::string binaryBatch;
+
+	consume(&fileBatch, &consoleBatch, &binaryBatch);
+
+	write(fileBatch, consoleBatch, binaryBatch);
+
+	return true;
+}
@@ -0,0 +1,97 @@
+#include "Log.h"
+#include "Types.h"
+#include <mutex>
+
+// DebugLog for builds off Windows, which are only the offline tools and their tests
+// messages are formatted straight to stderr, there's no file, ring buffer or config
+
+FILE * DebugLog::s_log = nullptr;
+FILE * DebugLog::s_binaryLog = nullptr;
+DebugLog::LogLevel DebugLog::s_fileLevels[kChannel_Max] =
+{
+	kLevel_Warning,	// General
+	kLevel_Warning,	// Plugins
+	kLevel_Warning,	// Script
+	kLevel_Warning,	// Hooks
+	kLevel_Warning,	// FileIO
+};
+DebugLog::LogLevel DebugLog::s_printLevel = DebugLog::kLevel_Warning;
+DebugLog::LogLevel DebugLog::s_channelLevels[kChannel_Max] =
+{
+	kLevel_Warning,
+	kLevel_Warning,
+	kLevel_Warning,
+	kLevel_Warning,
+	kLevel_Warning,
+};
+
+static const char * kChannelNames[DebugLog::kChannel_Max] =
+{
+	"General",
+	"Plugins",
+	"Script",
+	"Hooks",
+	"FileIO",
+};
+
+static std::mutex s_printLock;
+
+void DebugLog::open(const char * path)
+{
+	//
+}
+
+void DebugLog::openRelative(int folderID, const char * relPath)
+{
+	//
+}
+
+void DebugLog::openBinary(const char * path)
+{
+	//
+}
+
+void DebugLog::openBinaryRelative(int folderID, const char * relPath)
+{
+	//
+}
+
+void DebugLog::readConfig()
+{
+	//
+}
+
+const char * DebugLog::channelName(LogChannel channel)
+{
+	return (u32(channel) < kChannel_Max) ? kChannelNames[channel] : "?";
+}
+
+void DebugLog::message(LogChannel channel, LogLevel level, const char * fmt, ...)
+{
+	va_list	args;
+
+	va_start(args, fmt);
+	log(channel, level, fmt, args);
+	va_end(args);
+}
+
+void DebugLog::log(LogChannel channel, LogLevel level, const char * fmt, va_list args)
+{
+	if(level > s_printLevel)
+		return;
+
+	std::lock_guard <std::mutex> lock(s_printLock);
+
+	vfprintf(stderr, fmt, args);
+	fputc('\n', stderr);
+}
+
+void DebugLog::flush()
+{
+	fflush(stderr);
+}
+
+void DebugLog::beginFrame()
+{
+	//
+}
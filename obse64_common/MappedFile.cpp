@@ -0,0 +1,160 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+
+MappedFile::MappedFile()
+:m_file(INVALID_HANDLE_VALUE)
+,m_mapping(nullptr)
+,m_data(nullptr)
+,m_size(0)
+{
+	//
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MappedFile::open(const char * path)
+{
+	close();
+
+	// keeps the error from the call that failed
+	auto fail = [this](DWORD err)
+	{
+		close();
+		SetLastError(err);
+
+		return false;
+	};
+
+	m_file = CreateFile(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (m_file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_file, &size))
+		return fail(GetLastError());
+
+	if (!size.QuadPart)
+		return fail(ERROR_FILE_INVALID);
+
+	m_mapping = CreateFileMapping(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!m_mapping)
+		return fail(GetLastError());
+
+	m_data = (const u8 *)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!m_data)
+		return fail(GetLastError());
+
+	m_size = size_t(size.QuadPart);
+
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (m_data)
+	{
+		UnmapViewOfFile(m_data);
+		m_data = nullptr;
+	}
+
+	if (m_mapping)
+	{
+		CloseHandle(m_mapping);
+		m_mapping = nullptr;
+	}
+
+	if (m_file != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_file);
+		m_file = INVALID_HANDLE_VALUE;
+	}
+
+	m_size = 0;
+}
+
+u32 MappedFile::lastError()
+{
+	return GetLastError();
+}
+
+#else
+
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile()
+:m_file(-1)
+,m_data(nullptr)
+,m_size(0)
+{
+	//
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MappedFile::open(const char * path)
+{
+	close();
+
+	auto fail = [this](int err)
+	{
+		close();
+		errno = err;
+
+		return false;
+	};
+
+	m_file = ::open(path, O_RDONLY);
+	if (m_file < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(m_file, &info))
+		return fail(errno);
+
+	if (!info.st_size)
+		return fail(EINVAL);
+
+	void * data = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, m_file, 0);
+	if (data == MAP_FAILED)
+		return fail(errno);
+
+	m_data = (const u8 *)data;
+	m_size = size_t(info.st_size);
+
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (m_data)
+	{
+		munmap((void *)m_data, m_size);
+		m_data = nullptr;
+	}
+
+	if (m_file >= 0)
+	{
+		::close(m_file);
+		m_file = -1;
+	}
+
+	m_size = 0;
+}
+
+u32 MappedFile::lastError()
+{
+	return u32(errno);
+}
+
+#endif
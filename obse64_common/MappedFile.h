@@ -0,0 +1,38 @@
+#pragma once
+
+#include "obse64_common/Types.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+// read only view of a whole file
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile & operator=(const MappedFile &) = delete;
+
+	// sets the last error (errno off Windows) on failure. empty files fail, there's nothing to map
+	bool	open(const char * path);
+	void	close();
+
+	// the error open failed with
+	static u32	lastError();
+
+	const u8 *	data() const	{ return m_data; }
+	size_t		size() const	{ return m_size; }
+
+private:
+#ifdef _WIN32
+	HANDLE		m_file;
+	HANDLE		m_mapping;
+#else
+	int			m_file;
+#endif
+	const u8	* m_data;
+	size_t		m_size;
+};
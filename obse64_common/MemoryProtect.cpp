@@ -0,0 +1,104 @@
+#include "MemoryProtect.h"
+
+#ifdef _WIN32
+
+#include <Windows.h>
+
+size_t memoryPageSize()
+{
+	static size_t s_pageSize = 0;
+
+	if (!s_pageSize)
+	{
+		SYSTEM_INFO	info;
+		GetSystemInfo(&info);
+
+		s_pageSize = info.dwPageSize;
+	}
+
+	return s_pageSize;
+}
+
+bool memoryUnprotect(uintptr_t addr, size_t len, u32 * oldProtect)
+{
+	DWORD	old;
+
+	if (!VirtualProtect((void *)addr, len, PAGE_EXECUTE_READWRITE, &old))
+		return false;
+
+	*oldProtect = old;
+
+	return true;
+}
+
+bool memoryProtect(uintptr_t addr, size_t len, u32 protect)
+{
+	DWORD	old;
+
+	return VirtualProtect((void *)addr, len, protect, &old) != 0;
+}
+
+#else
+
+#include <cstdio>
+#include <sys/mman.h>
+#include <unistd.h>
+
+size_t memoryPageSize()
+{
+	return size_t(sysconf(_SC_PAGESIZE));
+}
+
+// mprotect doesn't report the old protection, it has to come from the mappings list
+static bool queryProtect(uintptr_t addr, u32 * protect)
+{
+	FILE	* maps = fopen("/proc/self/maps", "r");
+	if (!maps)
+		return false;
+
+	bool	found = false;
+	char	line[512];
+
+	while (fgets(line, sizeof(line), maps))
+	{
+		unsigned long long	start, end;
+		char				perms[5];
+
+		if (sscanf(line, "%llx-%llx %4s", &start, &end, perms) != 3)
+			continue;
+
+		if ((addr >= start) && (addr < end))
+		{
+			*protect =
+				((perms[0] == 'r') ? PROT_READ : 0) |
+				((perms[1] == 'w') ? PROT_WRITE : 0) |
+				((perms[2] == 'x') ? PROT_EXEC : 0);
+
+			found = true;
+			break;
+		}
+	}
+
+	fclose(maps);
+
+	return found;
+}
+
+bool memoryUnprotect(uintptr_t addr, size_t len, u32 * oldProtect)
+{
+	uintptr_t	page = addr & ~uintptr_t(memoryPageSize() - 1);
+
+	if (!queryProtect(page, oldProtect))
+		return false;
+
+	return mprotect((void *)page, addr + len - page, PROT_READ | PROT_WRITE | PROT_EXEC) == 0;
+}
+
+bool memoryProtect(uintptr_t addr, size_t len, u32 protect)
+{
+	uintptr_t	page = addr & ~uintptr_t(memoryPageSize() - 1);
+
+	return mprotect((void *)page, addr + len - page, int(protect)) == 0;
+}
+
+#endif
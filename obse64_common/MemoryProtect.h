@@ -0,0 +1,17 @@
+#pragma once
+
+#include "obse64_common/Types.h"
+#include <cstdint>
+
+// page protection changes for patching code and read only data
+// VirtualProtect on Windows, mprotect elsewhere so patching can be tested off Windows
+//
+// protection values belong to the platform, they're only meant to be handed back to memoryProtect
+
+size_t	memoryPageSize();
+
+// makes the pages covering [addr, addr + len) readable, writable and executable
+// *oldProtect gets the previous protection of the first page
+bool	memoryUnprotect(uintptr_t addr, size_t len, u32 * oldProtect);
+
+bool	memoryProtect(uintptr_t addr, size_t len, u32 protect);
@@ -0,0 +1,153 @@
+#include "MemoryReservation.h"
+
+#ifdef _WIN32
+
+#include <Windows.h>
+#include "obse64_common/Log.h"
+
+class PlatformReservation : public MemoryReservation
+{
+public:
+	void * reserve(uintptr_t low, uintptr_t high, size_t len) override
+	{
+		// VirtualAlloc bases are rounded down to this
+		const uintptr_t granularity = 0x10000;
+
+		if (high <= low)
+			return nullptr;
+
+		uintptr_t addr = high - 1;
+
+		while (addr >= low)
+		{
+			MEMORY_BASIC_INFORMATION info;
+
+			if (!VirtualQuery((void *)addr, &info, sizeof(info)))
+			{
+				_ERROR_C(Hooks, "VirtualQuery failed: %08X", GetLastError());
+				break;
+			}
+
+			uintptr_t blockStart = uintptr_t(info.BaseAddress);
+			uintptr_t blockEnd = blockStart + info.RegionSize;
+
+			if (blockEnd > high)
+				blockEnd = high;
+
+			if ((info.State == MEM_FREE) && (blockEnd - blockStart >= len))
+			{
+				uintptr_t base = (blockEnd - len) & ~(granularity - 1);
+
+				if ((base >= blockStart) && (base >= low))
+				{
+					void * result = VirtualAlloc((void *)base, len, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+					if (result)
+						return result;
+
+					_WARNING_C(Hooks, "trampoline alloc %016I64Xx%016I64X failed (%08X)", base, len, GetLastError());
+				}
+			}
+
+			// move back and try again
+			if (!blockStart)
+				break;
+
+			addr = blockStart - 1;
+		}
+
+		return nullptr;
+	}
+
+	void release(void * base, size_t len) override
+	{
+		VirtualFree(base, 0, MEM_RELEASE);
+	}
+};
+
+#else
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include <sys/mman.h>
+#include <unistd.h>
+
+class PlatformReservation : public MemoryReservation
+{
+public:
+	void * reserve(uintptr_t low, uintptr_t high, size_t len) override
+	{
+		uintptr_t pageMask = ~uintptr_t(sysconf(_SC_PAGESIZE) - 1);
+
+		struct Mapping
+		{
+			uintptr_t	start;
+			uintptr_t	end;
+		};
+
+		std::vector <Mapping> mappings;
+
+		FILE * maps = fopen("/proc/self/maps", "r");
+		if (!maps)
+			return nullptr;
+
+		char line[512];
+		while (fgets(line, sizeof(line), maps))
+		{
+			unsigned long long start, end;
+			if (sscanf(line, "%llx-%llx", &start, &end) == 2)
+				mappings.push_back({ uintptr_t(start), uintptr_t(end) });
+		}
+
+		fclose(maps);
+
+		std::sort(mappings.begin(), mappings.end(), [](const Mapping & lhs, const Mapping & rhs) { return lhs.start < rhs.start; });
+
+		// gaps between the mappings, from the top down
+		for (size_t i = mappings.size() + 1; i-- > 0; )
+		{
+			uintptr_t gapStart = i ? mappings[i - 1].end : 0;
+			uintptr_t gapEnd = (i < mappings.size()) ? mappings[i].start : UINTPTR_MAX;
+
+			uintptr_t start = std::max(gapStart, low);
+			uintptr_t end = std::min(gapEnd, high);
+
+			if ((end > start) && (end - start >= len))
+			{
+				uintptr_t base = (end - len) & pageMask;
+
+				if (base >= start)
+				{
+					// only a hint without MAP_FIXED, which would replace anything already there
+					void * result = mmap((void *)base, len, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+					if (result == (void *)base)
+						return result;
+
+					if (result != MAP_FAILED)
+						munmap(result, len);
+				}
+			}
+
+			if (gapStart <= low)
+				break;
+		}
+
+		return nullptr;
+	}
+
+	void release(void * base, size_t len) override
+	{
+		munmap(base, len);
+	}
+};
+
+#endif
+
+MemoryReservation * MemoryReservation::platform()
+{
+	static PlatformReservation s_instance;
+
+	return &s_instance;
+}
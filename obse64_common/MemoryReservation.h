@@ -0,0 +1,20 @@
+#pragma once
+
+#include "obse64_common/Types.h"
+#include <cstdint>
+
+// reserves executable memory inside a range of addresses, for code that has to be reachable from a module
+// with 32 bit displacements. allocation logic takes one of these so it can be tested with a fake
+class MemoryReservation
+{
+public:
+	virtual ~MemoryReservation() { }
+
+	// len bytes of readable, writable, executable memory entirely inside [low, high), null if there's no room
+	// the search starts from the top of the range, so the result is as close to high as possible
+	virtual void *	reserve(uintptr_t low, uintptr_t high, size_t len) = 0;
+	virtual void	release(void * base, size_t len) = 0;
+
+	// VirtualQuery/VirtualAlloc on Windows, /proc/self/maps and mmap elsewhere
+	static MemoryReservation *	platform();
+};
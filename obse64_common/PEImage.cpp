@@ -0,0 +1,352 @@
+#include "PEImage.h"
+#include <cstring>
+
+enum
+{
+	kDOSHeaderSize = 0x40,
+	kDOSHeader_NewHeaderOffset = 0x3C,
+
+	kFileHeaderSize = 20,	// after the "PE\0\0" signature
+	kSectionHeaderSize = 40,
+	kExportDirectorySize = 40,
+
+	kOptionalMagic_PE32 = 0x10B,
+	kOptionalMagic_PE32Plus = 0x20B,
+
+	kDataDirectory_Export = 0,
+
+	kMaxSections = 96,	// the loader's limit
+
+	kOptional_SizeOfImage = 56,		// same in PE32 and PE32+
+	kOptional_CheckSum = 64,
+
+	kSection_Execute = 0x20000000,	// IMAGE_SCN_MEM_EXECUTE
+};
+
+template <typename T>
+static T readValue(const u8 * src)
+{
+	T result;
+	memcpy(&result, src, sizeof(result));
+	return result;
+}
+
+// FNV-1a
+static u64 hashBytes(u64 hash, const u8 * src, size_t len)
+{
+	for (size_t i = 0; i < len; i++)
+		hash = (hash ^ src[i]) * 0x100000001B3;
+
+	return hash;
+}
+
+PEImage::PEImage()
+:m_data(nullptr)
+,m_len(0)
+,m_machine(0)
+,m_headerSize(0)
+,m_exportRVA(0)
+,m_exportSize(0)
+,m_headerHash(0)
+{
+	//
+}
+
+bool PEImage::parse(const void * data, size_t len)
+{
+	m_data = (const u8 *)data;
+	m_len = len;
+	m_machine = 0;
+	m_headerSize = 0;
+	m_exportRVA = 0;
+	m_exportSize = 0;
+	m_headerHash = 0;
+	m_sections.clear();
+
+	if ((len < kDOSHeaderSize) || (m_data[0] != 'M') || (m_data[1] != 'Z'))
+		return false;
+
+	u64 ntOffset = readValue <u32>(m_data + kDOSHeader_NewHeaderOffset);
+
+	if ((ntOffset + 4 + kFileHeaderSize > len) || memcmp(m_data + ntOffset, "PE\0\0", 4))
+		return false;
+
+	const u8 * fileHeader = m_data + ntOffset + 4;
+
+	u16 numSections = readValue <u16>(fileHeader + 2);
+	u16 optionalSize = readValue <u16>(fileHeader + 16);
+
+	m_machine = readValue <u16>(fileHeader);
+
+	u64 optionalOffset = ntOffset + 4 + kFileHeaderSize;
+
+	if ((optionalOffset + optionalSize > len) || (optionalSize < 2) || (numSections > kMaxSections))
+		return false;
+
+	const u8 * optional = m_data + optionalOffset;
+
+	u16 magic = readValue <u16>(optional);
+	u32 headerSizeOffset, numDirectoriesOffset, directoriesOffset;
+
+	if (magic == kOptionalMagic_PE32)
+	{
+		headerSizeOffset = 60;
+		numDirectoriesOffset = 92;
+		directoriesOffset = 96;
+	}
+	else if (magic == kOptionalMagic_PE32Plus)
+	{
+		headerSizeOffset = 60;
+		numDirectoriesOffset = 108;
+		directoriesOffset = 112;
+	}
+	else
+	{
+		return false;
+	}
+
+	if (optionalSize < directoriesOffset)
+		return false;
+
+	// the loader rewrites ImageBase, so only the fields that describe the build
+	u64 hash = 0xCBF29CE484222325;
+	hash = hashBytes(hash, fileHeader, kFileHeaderSize);
+	hash = hashBytes(hash, optional + kOptional_SizeOfImage, 4);
+	hash = hashBytes(hash, optional + kOptional_CheckSum, 4);
+
+	m_headerSize = readValue <u32>(optional + headerSizeOffset);
+
+	u32 numDirectories = readValue <u32>(optional + numDirectoriesOffset);
+
+	if ((numDirectories > kDataDirectory_Export) && (directoriesOffset + (kDataDirectory_Export + 1) * 8 <= optionalSize))
+	{
+		const u8 * exportDirectory = optional + directoriesOffset + kDataDirectory_Export * 8;
+
+		m_exportRVA = readValue <u32>(exportDirectory);
+		m_exportSize = readValue <u32>(exportDirectory + 4);
+	}
+
+	u64 sectionOffset = optionalOffset + optionalSize;
+
+	if (sectionOffset + u64(numSections) * kSectionHeaderSize > len)
+		return false;
+
+	m_sections.reserve(numSections);
+	m_headerHash = hashBytes(hash, m_data + sectionOffset, numSections * kSectionHeaderSize);
+
+	for (u32 i = 0; i < numSections; i++)
+	{
+		const u8 * header = m_data + sectionOffset + i * kSectionHeaderSize;
+
+		Section section;
+		section.virtualSize = readValue <u32>(header + 8);
+		section.virtualAddress = readValue <u32>(header + 12);
+		section.rawSize = readValue <u32>(header + 16);
+		section.rawOffset = readValue <u32>(header + 20);
+		section.characteristics = readValue <u32>(header + 36);
+
+		m_sections.push_back(section);
+	}
+
+	return true;
+}
+
+const PEImage::Section * PEImage::findSection(u32 rva) const
+{
+	for (const Section & section : m_sections)
+	{
+		// VirtualSize can be zero in object-style images, the raw size is the extent then
+		u32 size = section.virtualSize ? section.virtualSize : section.rawSize;
+
+		if ((rva >= section.virtualAddress) && (rva - section.virtualAddress < size))
+			return &section;
+	}
+
+	return nullptr;
+}
+
+const u8 * PEImage::fileSpan(u32 rva, u64 * available) const
+{
+	u64 offset;
+
+	const Section * section = findSection(rva);
+
+	if (section)
+	{
+		u32 delta = rva - section->virtualAddress;
+
+		if (delta >= section->rawSize)
+			return nullptr;
+
+		offset = u64(section->rawOffset) + delta;
+		*available = section->rawSize - delta;
+	}
+	else if (rva < m_headerSize)
+	{
+		// headers are mapped at their file offsets
+		offset = rva;
+		*available = m_headerSize - rva;
+	}
+	else
+	{
+		return nullptr;
+	}
+
+	if (offset >= m_len)
+		return nullptr;
+
+	if (*available > m_len - offset)
+		*available = m_len - offset;
+
+	return m_data + offset;
+}
+
+const u8 * PEImage::filePointer(u32 rva, u32 len) const
+{
+	u64 available;
+	const u8 * result = fileSpan(rva, &available);
+
+	return (result && (len <= available)) ? result : nullptr;
+}
+
+const char * PEImage::fileString(u32 rva, u32 * len) const
+{
+	u64 available;
+	const u8 * start = fileSpan(rva, &available);
+
+	if (!start)
+		return nullptr;
+
+	const u8 * end = (const u8 *)memchr(start, 0, size_t(available));
+	if (!end)
+		return nullptr;	// not terminated
+
+	*len = u32(end - start);
+
+	return (const char *)start;
+}
+
+u32 PEImage::findExport(const char * name) const
+{
+	if (!m_exportRVA || (m_exportSize < kExportDirectorySize))
+		return 0;
+
+	const u8 * directory = filePointer(m_exportRVA, kExportDirectorySize);
+	if (!directory)
+		return 0;
+
+	u32 numFunctions = readValue <u32>(directory + 20);
+	u32 numNames = readValue <u32>(directory + 24);
+	u32 functionsRVA = readValue <u32>(directory + 28);
+	u32 namesRVA = readValue <u32>(directory + 32);
+	u32 ordinalsRVA = readValue <u32>(directory + 36);
+
+	// sane upper bounds before multiplying
+	if ((numNames > m_len / 4) || (numFunctions > m_len / 4))
+		return 0;
+
+	const u8 * names = filePointer(namesRVA, numNames * 4);
+	const u8 * ordinals = filePointer(ordinalsRVA, numNames * 2);
+	const u8 * functions = filePointer(functionsRVA, numFunctions * 4);
+
+	if (!names || !ordinals || !functions)
+		return 0;
+
+	size_t nameLen = strlen(name);
+
+	for (u32 i = 0; i < numNames; i++)
+	{
+		u32 exportNameLen;
+		const char * exportName = fileString(readValue <u32>(names + i * 4), &exportNameLen);
+
+		if (!exportName || (exportNameLen != nameLen) || memcmp(exportName, name, nameLen))
+			continue;
+
+		u16 ordinal = readValue <u16>(ordinals + i * 2);
+		if (ordinal >= numFunctions)
+			return 0;
+
+		return readValue <u32>(functions + ordinal * 4);
+	}
+
+	return 0;
+}
+
+bool PEImage::read(u32 rva, void * dst, u32 len) const
+{
+	u8 * out = (u8 *)dst;
+
+	while (len)
+	{
+		const Section * section = findSection(rva);
+		if (!section)
+		{
+			const u8 * src = filePointer(rva, len);
+			if (!src)
+				return false;
+
+			memcpy(out, src, len);
+			return true;
+		}
+
+		u32 delta = rva - section->virtualAddress;
+		u32 sectionSize = section->virtualSize ? section->virtualSize : section->rawSize;
+		u32 chunk = sectionSize - delta;
+
+		if (chunk > len)
+			chunk = len;
+
+		// the part on disk, then zero fill
+		u32 onDisk = (delta < section->rawSize) ? section->rawSize - delta : 0;
+
+		if (onDisk > chunk)
+			onDisk = chunk;
+
+		if (onDisk)
+		{
+			const u8 * src = filePointer(rva, onDisk);
+			if (!src)
+				return false;
+
+			memcpy(out, src, onDisk);
+		}
+
+		memset(out + onDisk, 0, chunk - onDisk);
+
+		out += chunk;
+		rva += chunk;
+		len -= chunk;
+	}
+
+	return true;
+}
+
+bool PEImage::findCode(u32 * rva, u32 * size, const u8 ** fileData, u32 * fileSize) const
+{
+	for (const Section & section : m_sections)
+	{
+		if (!(section.characteristics & kSection_Execute))
+			continue;
+
+		u32 virtualSize = section.virtualSize ? section.virtualSize : section.rawSize;
+		u64 rawSize = (section.rawSize < virtualSize) ? section.rawSize : virtualSize;
+
+		*rva = section.virtualAddress;
+		*size = virtualSize;
+		*fileData = nullptr;
+		*fileSize = 0;
+
+		if (section.rawOffset < m_len)
+		{
+			if (rawSize > m_len - section.rawOffset)
+				rawSize = m_len - section.rawOffset;
+
+			*fileData = m_data + section.rawOffset;
+			*fileSize = u32(rawSize);
+		}
+
+		return true;
+	}
+
+	return false;
+}
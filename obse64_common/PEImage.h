@@ -0,0 +1,74 @@
+#pragma once
+
+#include "obse64_common/Types.h"
+#include <vector>
+
+// reads headers and exports from a PE file as it is laid out on disk (not loaded by the OS)
+//
+// doesn't use the Windows headers, every offset is bounds checked, so it's safe on untrusted files
+// and works on any buffer, wherever it came from
+
+class PEImage
+{
+public:
+	enum
+	{
+		kMachine_I386 = 0x014C,
+		kMachine_AMD64 = 0x8664,
+	};
+
+	PEImage();
+
+	// data has to stay valid while the PEImage is used
+	bool	parse(const void * data, size_t len);
+
+	u16		machine() const { return m_machine; }
+	bool	is64() const { return m_machine == kMachine_AMD64; }
+
+	// RVA of a named export, 0 if there isn't one
+	u32		findExport(const char * name) const;
+
+	// an export RVA inside the export directory is a forwarder, a "dll.name" string instead of code or data
+	bool	isForwarded(u32 rva) const { return rva && (rva - m_exportRVA < m_exportSize); }
+
+	// copies from an RVA. the part of a section past its data on disk reads as zero, like it would once loaded
+	bool	read(u32 rva, void * dst, u32 len) const;
+
+	// the first executable section, its RVA and size once loaded, and the part of it that's on disk
+	// fileData is null if the section isn't in the parsed buffer. for the headers of a loaded image, parsed
+	// from its base address, only the RVA and size mean anything
+	bool	findCode(u32 * rva, u32 * size, const u8 ** fileData, u32 * fileSize) const;
+
+	// identifies a build of an executable from its headers, the same on disk and once loaded
+	u64		headerHash() const { return m_headerHash; }
+
+private:
+	struct Section
+	{
+		u32	virtualAddress;
+		u32	virtualSize;
+		u32	rawOffset;
+		u32	rawSize;
+		u32	characteristics;
+	};
+
+	const Section *	findSection(u32 rva) const;
+
+	// file data at an RVA and how much of it is contiguous on disk
+	const u8 *	fileSpan(u32 rva, u64 * available) const;
+
+	// null if the len bytes aren't all on disk
+	const u8 *	filePointer(u32 rva, u32 len) const;
+	const char *	fileString(u32 rva, u32 * len) const;
+
+	const u8	* m_data;
+	size_t		m_len;
+
+	u16			m_machine;
+	u32			m_headerSize;
+	u32			m_exportRVA;
+	u32			m_exportSize;
+	u64			m_headerHash;
+
+	std::vector <Section>	m_sections;
+};
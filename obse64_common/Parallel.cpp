@@ -0,0 +1,38 @@
+#include "Parallel.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+void parallelFor(size_t count, const std::function <void (size_t)> & fn, u32 maxThreads)
+{
+	if (!count)
+		return;
+
+	u32 numThreads = maxThreads ? maxThreads : std::thread::hardware_concurrency();
+
+	if (!numThreads)
+		numThreads = 1;
+
+	if (numThreads > count)
+		numThreads = u32(count);
+
+	std::atomic <size_t> next { 0 };
+
+	auto worker = [&]()
+	{
+		for (size_t i = next++; i < count; i = next++)
+			fn(i);
+	};
+
+	// the calling thread is one of the workers
+	std::vector <std::thread> threads;
+	threads.reserve(numThreads - 1);
+
+	for (u32 i = 1; i < numThreads; i++)
+		threads.emplace_back(worker);
+
+	worker();
+
+	for (auto & thread : threads)
+		thread.join();
+}
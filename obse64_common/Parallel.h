@@ -0,0 +1,8 @@
+#pragma once
+
+#include "obse64_common/Types.h"
+#include <functional>
+
+// calls fn(0) .. fn(count - 1) spread across worker threads, returns once they've all finished
+// indices are handed out one at a time, so uneven work balances itself. maxThreads 0 = one per core
+void parallelFor(size_t count, const std::function <void (size_t)> & fn, u32 maxThreads = 0);
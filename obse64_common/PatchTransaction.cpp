@@ -0,0 +1,110 @@
+#include "PatchTransaction.h"
+#include "obse64_common/MemoryProtect.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+PatchTransaction::PatchTransaction()
+:m_numPages(0)
+{
+	//
+}
+
+PatchTransaction::~PatchTransaction()
+{
+	commit();
+}
+
+void PatchTransaction::writeBuf(uintptr_t addr, const void * data, size_t len)
+{
+	if (!len)
+		return;
+
+	Write write = { addr, m_data.size(), len };
+
+	m_writes.push_back(write);
+	m_data.insert(m_data.end(), (const u8 *)data, (const u8 *)data + len);
+}
+
+bool PatchTransaction::writeJump(uintptr_t src, uintptr_t dst)
+{
+	return writeBranch(src, dst, 0xE9);
+}
+
+bool PatchTransaction::writeCall(uintptr_t src, uintptr_t dst)
+{
+	return writeBranch(src, dst, 0xE8);
+}
+
+bool PatchTransaction::writeBranch(uintptr_t src, uintptr_t dst, u8 op)
+{
+	ptrdiff_t delta = dst - (src + 5);
+	if ((delta < INT_MIN) || (delta > INT_MAX))
+		return false;
+
+	s32 displ = s32(delta);
+
+	u8 code[5];
+	code[0] = op;
+	memcpy(&code[1], &displ, sizeof(displ));
+
+	writeBuf(src, code, sizeof(code));
+
+	return true;
+}
+
+bool PatchTransaction::commit()
+{
+	m_numPages = 0;
+
+	if (m_writes.empty())
+		return true;
+
+	uintptr_t pageMask = ~uintptr_t(memoryPageSize() - 1);
+	size_t pageSize = memoryPageSize();
+
+	std::vector <uintptr_t> pages;
+
+	for (const Write & write : m_writes)
+		for (uintptr_t page = write.addr & pageMask; page < write.addr + write.len; page += pageSize)
+			pages.push_back(page);
+
+	std::sort(pages.begin(), pages.end());
+	pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+
+	// pages can have different protection, so each is changed and restored on its own
+	std::vector <u32> oldProtect(pages.size());
+	std::vector <u8> writable(pages.size());
+
+	bool result = true;
+
+	for (size_t i = 0; i < pages.size(); i++)
+	{
+		writable[i] = memoryUnprotect(pages[i], pageSize, &oldProtect[i]);
+		if (!writable[i])
+			result = false;
+	}
+
+	for (const Write & write : m_writes)
+	{
+		size_t first = std::lower_bound(pages.begin(), pages.end(), write.addr & pageMask) - pages.begin();
+		bool ok = true;
+
+		for (size_t i = first; (i < pages.size()) && (pages[i] < write.addr + write.len); i++)
+			ok &= writable[i] != 0;
+
+		if (ok)
+			memcpy((void *)write.addr, &m_data[write.dataOffset], write.len);
+	}
+
+	for (size_t i = 0; i < pages.size(); i++)
+		if (writable[i])
+			memoryProtect(pages[i], pageSize, oldProtect[i]);
+
+	m_numPages = pages.size();
+
+	m_writes.clear();
+	m_data.clear();
+
+	return result;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "obse64_common/Types.h"
+#include <cstdint>
+#include <vector>
+
+// collects patches and applies them with one protection change per page, instead of two per write
+//
+//	PatchTransaction patches;
+//	patches.write32(addr, value);
+//	patches.writeJump(src, dst);
+//	patches.commit();
+//
+// writes are applied in the order they were made, nothing is touched until commit. anything still
+// pending when the transaction is destroyed is committed then
+
+class PatchTransaction
+{
+public:
+	PatchTransaction();
+	~PatchTransaction();
+
+	PatchTransaction(const PatchTransaction &) = delete;
+	PatchTransaction & operator=(const PatchTransaction &) = delete;
+
+	void	writeBuf(uintptr_t addr, const void * data, size_t len);
+	void	write8(uintptr_t addr, u8 data)		{ writeBuf(addr, &data, sizeof(data)); }
+	void	write16(uintptr_t addr, u16 data)	{ writeBuf(addr, &data, sizeof(data)); }
+	void	write32(uintptr_t addr, u32 data)	{ writeBuf(addr, &data, sizeof(data)); }
+	void	write64(uintptr_t addr, u64 data)	{ writeBuf(addr, &data, sizeof(data)); }
+
+	// 5 bytes at src, false if dst is more than +/- 2GB away
+	bool	writeJump(uintptr_t src, uintptr_t dst);
+	bool	writeCall(uintptr_t src, uintptr_t dst);
+
+	// false if any page couldn't be made writable, the writes touching it are skipped
+	bool	commit();
+
+	size_t	numPending() const	{ return m_writes.size(); }
+
+	// pages changed by the last commit
+	size_t	numPages() const	{ return m_numPages; }
+
+private:
+	struct Write
+	{
+		uintptr_t	addr;
+		size_t		dataOffset;	// in m_data
+		size_t		len;
+	};
+
+	bool	writeBranch(uintptr_t src, uintptr_t dst, u8 op);
+
+	std::vector <Write>	m_writes;
+	std::vector <u8>	m_data;
+
+	size_t	m_numPages;
+};
@@ -1,5 +1,8 @@
 #include "Relocation.h"
+
+#ifdef _WIN32
 #include <Windows.h>
+#endif
 
 // the goal of this file is to support pointers in to a relocated binary with as little runtime overhead, code bloat, and hassle as possible
 // 
@@ -18,14 +21,22 @@
 // without forcing all pointers to be defined in a file with init_seg(lib). that is really ugly and doesn't seem like a good idea.
 
 // anything in this file will initialized after the crt but before any user code
+#ifdef _MSC_VER
 #pragma warning(disable: 4073)	// yes this is intentional
 #pragma init_seg(lib)
+#endif
 
 static RelocationManager s_relocMgr;
 
 uintptr_t RelocationManager::s_baseAddr = 0;
+std::uint64_t (* RelocationManager::s_idToOffset)(std::uint64_t id) = nullptr;
 
 RelocationManager::RelocationManager()
 {
+#ifdef _WIN32
 	s_baseAddr = reinterpret_cast<uintptr_t>(GetModuleHandle(NULL));
+#else
+	// the tools have no game to relocate against, addresses stay as they were given
+	s_baseAddr = 0;
+#endif
 }
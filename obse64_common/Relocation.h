@@ -8,6 +8,10 @@ public:
 	RelocationManager();
 
 	static uintptr_t	s_baseAddr;
+
+	// resolves Address Library ids for RelocID, returns 0 for unknown ids
+	// obse64 sets this once the database is loaded. plugins set it to OBSEAddressLibraryInterface::IDToOffset
+	static std::uint64_t	(* s_idToOffset)(std::uint64_t id);
 };
 
 // use this for addresses that represent pointers to a type T
@@ -89,3 +93,48 @@ private:
 	RelocAddr(RelocAddr & rhs) = delete;
 	RelocAddr & operator=(RelocAddr & rhs) = delete;
 };
+
+// use this for addresses looked up by Address Library id, otherwise like RelocAddr
+// resolved on first use, so these can be declared statically before the database is available
+// unknown ids, or using one before s_idToOffset is set, give null
+template <typename T>
+class RelocID
+{
+public:
+	RelocID(std::uint64_t id)
+		:m_id(id), m_addr(0)
+	{
+		//
+	}
+
+	operator T()
+	{
+		return reinterpret_cast <T>(getUIntPtr());
+	}
+
+	std::uint64_t getID() const
+	{
+		return m_id;
+	}
+
+	uintptr_t getUIntPtr()
+	{
+		if(!m_addr && RelocationManager::s_idToOffset)
+		{
+			std::uint64_t offset = RelocationManager::s_idToOffset(m_id);
+			if(offset)
+				m_addr = offset + RelocationManager::s_baseAddr;
+		}
+
+		return m_addr;
+	}
+
+private:
+	std::uint64_t	m_id;
+	uintptr_t			m_addr;
+
+	// hide
+	RelocID() = delete;
+	RelocID(RelocID & rhs) = delete;
+	RelocID & operator=(RelocID & rhs) = delete;
+};
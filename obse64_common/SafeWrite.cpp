@@ -1,14 +1,18 @@
 #include "SafeWrite.h"
-#include <Windows.h>
+#include <climits>
+#include <cstring>
 #include "obse64_common/Errors.h"
+#include "obse64_common/MemoryProtect.h"
 
 void safeWriteBuf(uintptr_t addr, void * data, size_t len)
 {
-	DWORD oldProtect;
+	u32 oldProtect;
+	bool unprotected = memoryUnprotect(addr, len, &oldProtect);
 
-	VirtualProtect((void *)addr, len, PAGE_EXECUTE_READWRITE, &oldProtect);
 	memcpy((void *)addr, data, len);
-	VirtualProtect((void *)addr, len, oldProtect, &oldProtect);
+
+	if(unprotected)
+		memoryProtect(addr, len, oldProtect);
 }
 
 void safeWrite8(uintptr_t addr, u8 data)
@@ -3,6 +3,7 @@
 #include <cstdint>
 #include "obse64_common/Types.h"
 
+// each of these changes protection twice, use PatchTransaction for more than a few writes
 void safeWriteBuf(uintptr_t addr, void * data, size_t len);
 void safeWrite8(uintptr_t addr, u8 data);
 void safeWrite16(uintptr_t addr, u16 data);
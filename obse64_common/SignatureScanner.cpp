@@ -0,0 +1,368 @@
+#include "SignatureScanner.h"
+#include <algorithm>
+#include <cstring>
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+enum
+{
+	kBlockSize = 16,
+
+	// rarity is estimated from this many bytes spread over the data
+	kSampleChunkSize = 0x1000,
+	kSampleNumChunks = 64,
+};
+
+static inline u32 lowestSetBit(u32 mask)
+{
+#ifdef _MSC_VER
+	unsigned long idx;
+	_BitScanForward(&idx, mask);
+	return idx;
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+static inline s32 hexDigit(char c)
+{
+	if ((c >= '0') && (c <= '9'))	return c - '0';
+	if ((c >= 'a') && (c <= 'f'))	return c - 'a' + 10;
+	if ((c >= 'A') && (c <= 'F'))	return c - 'A' + 10;
+
+	return -1;
+}
+
+// bucket bits for the byte at each position
+static inline __m128i lookupBuckets(__m128i data, __m128i lowTable, __m128i highTable)
+{
+	const __m128i nibbleMask = _mm_set1_epi8(0x0F);
+
+	__m128i low = _mm_and_si128(data, nibbleMask);
+	__m128i high = _mm_and_si128(_mm_srli_epi16(data, 4), nibbleMask);
+
+	return _mm_and_si128(_mm_shuffle_epi8(lowTable, low), _mm_shuffle_epi8(highTable, high));
+}
+
+SignatureScanner::SignatureScanner()
+:m_numCandidates(0)
+{
+	memset(m_lowNibble, 0, sizeof(m_lowNibble));
+	memset(m_highNibble, 0, sizeof(m_highNibble));
+	memset(m_pairAnchors, 0, sizeof(m_pairAnchors));
+	memset(m_byteAnchors, 0, sizeof(m_byteAnchors));
+}
+
+s32 SignatureScanner::add(const char * pattern)
+{
+	u8 bytes[kMaxPatternLen];
+	u8 masks[kMaxPatternLen];
+	u32 len = 0;
+	bool anyFixed = false;
+
+	const char * p = pattern;
+
+	while (true)
+	{
+		while ((*p == ' ') || (*p == '\t'))
+			p++;
+
+		if (!*p)
+			break;
+
+		if (len == kMaxPatternLen)
+			return -1;
+
+		if (p[0] == '?')
+		{
+			p += (p[1] == '?') ? 2 : 1;
+
+			bytes[len] = 0;
+			masks[len] = 0;
+		}
+		else
+		{
+			s32 high = hexDigit(p[0]);
+			s32 low = (high >= 0) ? hexDigit(p[1]) : -1;
+
+			if (low < 0)
+				return -1;
+
+			p += 2;
+
+			bytes[len] = u8((high << 4) | low);
+			masks[len] = 0xFF;
+			anyFixed = true;
+		}
+
+		// tokens have to be separated
+		if (*p && (*p != ' ') && (*p != '\t'))
+			return -1;
+
+		len++;
+	}
+
+	if (!anyFixed)
+		return -1;
+
+	Pattern entry = { 0 };
+	entry.start = u32(m_bytes.size());
+	entry.len = len;
+
+	// FNV-1a over the length and the bytes, wildcards hash the same however they were written
+	u64 hash = 0xCBF29CE484222325;
+	hash = (hash ^ len) * 0x100000001B3;
+
+	for (u32 i = 0; i < len; i++)
+	{
+		hash = (hash ^ masks[i]) * 0x100000001B3;
+		hash = (hash ^ bytes[i]) * 0x100000001B3;
+	}
+
+	entry.hash = hash;
+
+	m_bytes.insert(m_bytes.end(), bytes, bytes + len);
+	m_masks.insert(m_masks.end(), masks, masks + len);
+	m_patterns.push_back(entry);
+
+	return s32(m_patterns.size() - 1);
+}
+
+void SignatureScanner::clear()
+{
+	m_patterns.clear();
+	m_bytes.clear();
+	m_masks.clear();
+	m_anchors.clear();
+
+	m_numCandidates = 0;
+}
+
+void SignatureScanner::buildTables(const u8 * data, size_t len)
+{
+	u64 freq[256] = { 0 };
+	u64 total = 0;
+
+	if (len <= kSampleChunkSize * kSampleNumChunks)
+	{
+		for (size_t i = 0; i < len; i++)
+			freq[data[i]]++;
+
+		total = len;
+	}
+	else
+	{
+		size_t stride = len / kSampleNumChunks;
+
+		for (size_t chunk = 0; chunk < kSampleNumChunks; chunk++)
+		{
+			const u8 * src = data + chunk * stride;
+
+			for (size_t i = 0; i < kSampleChunkSize; i++)
+				freq[src[i]]++;
+		}
+
+		total = kSampleChunkSize * kSampleNumChunks;
+	}
+
+	m_anchors.resize(m_patterns.size());
+
+	for (size_t i = 0; i < m_patterns.size(); i++)
+	{
+		Pattern & pattern = m_patterns[i];
+		const u8 * bytes = &m_bytes[pattern.start];
+		const u8 * masks = &m_masks[pattern.start];
+
+		// a pair matches with about (f0 / total) * (f1 / total), a single byte with f0 / total
+		double bestScore = 0;
+		bool found = false;
+
+		for (u32 j = 0; j < pattern.len; j++)
+		{
+			if (!masks[j])
+				continue;
+
+			double score;
+			u32 anchorLen;
+
+			if ((j + 1 < pattern.len) && masks[j + 1])
+			{
+				score = double(freq[bytes[j]] + 1) * double(freq[bytes[j + 1]] + 1);
+				anchorLen = 2;
+			}
+			else
+			{
+				score = double(freq[bytes[j]] + 1) * double(total + 1);
+				anchorLen = 1;
+			}
+
+			if (!found || (score < bestScore))
+			{
+				bestScore = score;
+				pattern.anchorOffset = j;
+				pattern.anchorLen = anchorLen;
+				found = true;
+			}
+		}
+
+		u32 key = bytes[pattern.anchorOffset] | (pattern.anchorLen << 16);
+		if (pattern.anchorLen == 2)
+			key |= bytes[pattern.anchorOffset + 1] << 8;
+
+		m_anchors[i].key = key;
+		m_anchors[i].pattern = u32(i);
+	}
+
+	std::sort(m_anchors.begin(), m_anchors.end());
+
+	std::vector <u32> distinct;
+	for (const Anchor & anchor : m_anchors)
+		if (distinct.empty() || (distinct.back() != anchor.key))
+			distinct.push_back(anchor.key);
+
+	memset(m_lowNibble, 0, sizeof(m_lowNibble));
+	memset(m_highNibble, 0, sizeof(m_highNibble));
+	memset(m_pairAnchors, 0, sizeof(m_pairAnchors));
+	memset(m_byteAnchors, 0, sizeof(m_byteAnchors));
+
+	// similar anchors are grouped so they share nibbles, a bucket passes every combination of its anchors' nibbles
+	for (size_t i = 0; i < distinct.size(); i++)
+	{
+		u32 key = distinct[i];
+		u32 bucket = u32(i * kNumBuckets / distinct.size());
+		u8 bit = 1 << bucket;
+
+		u8 first = key & 0xFF;
+		m_lowNibble[0][first & 0xF] |= bit;
+		m_highNibble[0][first >> 4] |= bit;
+
+		if ((key >> 16) == 2)
+		{
+			u8 second = (key >> 8) & 0xFF;
+			m_lowNibble[1][second & 0xF] |= bit;
+			m_highNibble[1][second >> 4] |= bit;
+
+			u32 pair = key & 0xFFFF;
+			m_pairAnchors[pair >> 6] |= 1ull << (pair & 63);
+		}
+		else
+		{
+			m_byteAnchors[first >> 6] |= 1ull << (first & 63);
+
+			// anything can follow
+			for (u32 j = 0; j < 16; j++)
+			{
+				m_lowNibble[1][j] |= bit;
+				m_highNibble[1][j] |= bit;
+			}
+		}
+	}
+}
+
+void SignatureScanner::scan(const u8 * data, size_t len, u64 base)
+{
+	m_numCandidates = 0;
+
+	for (Pattern & pattern : m_patterns)
+	{
+		pattern.result.offset = 0;
+		pattern.result.numMatches = 0;
+	}
+
+	if (m_patterns.empty() || !len)
+		return;
+
+	buildTables(data, len);
+
+	const __m128i low0 = _mm_load_si128((const __m128i *)m_lowNibble[0]);
+	const __m128i high0 = _mm_load_si128((const __m128i *)m_highNibble[0]);
+	const __m128i low1 = _mm_load_si128((const __m128i *)m_lowNibble[1]);
+	const __m128i high1 = _mm_load_si128((const __m128i *)m_highNibble[1]);
+	const __m128i zero = _mm_setzero_si128();
+
+	// the last block is copied in to a padded buffer so the loads stay in bounds
+	alignas(16) u8 tail[kBlockSize * 2] = { 0 };
+
+	size_t pos = 0;
+
+	while (pos < len)
+	{
+		const u8 * src = data + pos;
+		u32 valid = 0xFFFF;
+
+		// the second anchor byte is one past each position
+		if (len - pos <= kBlockSize)
+		{
+			memcpy(tail, src, len - pos);
+			src = tail;
+			valid = (1 << (len - pos)) - 1;
+		}
+
+		__m128i first = _mm_loadu_si128((const __m128i *)src);
+		__m128i second = _mm_loadu_si128((const __m128i *)(src + 1));
+
+		__m128i hits = _mm_and_si128(lookupBuckets(first, low0, high0), lookupBuckets(second, low1, high1));
+
+		u32 mask = ~u32(_mm_movemask_epi8(_mm_cmpeq_epi8(hits, zero))) & valid;
+		while (mask)
+		{
+			size_t at = pos + lowestSetBit(mask);
+			mask &= mask - 1;
+
+			m_numCandidates++;
+
+			u32 first = data[at];
+
+			if (at + 1 < len)
+			{
+				u32 pair = first | (data[at + 1] << 8);
+
+				if (m_pairAnchors[pair >> 6] & (1ull << (pair & 63)))
+					checkAnchor(data, len, at, pair | (2 << 16), base);
+			}
+
+			if (m_byteAnchors[first >> 6] & (1ull << (first & 63)))
+				checkAnchor(data, len, at, first | (1 << 16), base);
+		}
+
+		pos += kBlockSize;
+	}
+}
+
+void SignatureScanner::checkAnchor(const u8 * data, size_t len, size_t pos, u32 key, u64 base)
+{
+	Anchor search = { key, 0 };
+
+	for (auto iter = std::lower_bound(m_anchors.begin(), m_anchors.end(), search); (iter != m_anchors.end()) && (iter->key == key); ++iter)
+	{
+		Pattern & pattern = m_patterns[iter->pattern];
+
+		if (pos < pattern.anchorOffset)
+			continue;
+
+		size_t start = pos - pattern.anchorOffset;
+
+		if ((pattern.len > len - start) || !matches(pattern, data + start))
+			continue;
+
+		if (!pattern.result.numMatches)
+			pattern.result.offset = base + start;
+
+		pattern.result.numMatches++;
+	}
+}
+
+bool SignatureScanner::matches(const Pattern & pattern, const u8 * src) const
+{
+	const u8 * bytes = &m_bytes[pattern.start];
+	const u8 * masks = &m_masks[pattern.start];
+
+	for (u32 i = 0; i < pattern.len; i++)
+		if ((src[i] ^ bytes[i]) & masks[i])
+			return false;
+
+	return true;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "obse64_common/Types.h"
+#include <vector>
+
+// finds byte patterns with wildcards, any number of them in one pass over the data
+//
+// patterns are hex bytes separated by spaces, ? or ?? for any byte: "48 8B 05 ?? ?? ?? ?? 48 85 C0"
+//
+// each pattern is anchored on its rarest pair of adjacent fixed bytes (or its rarest byte, if no two are
+// adjacent), rarity coming from a sample of the data being scanned. the anchors are split in to eight
+// buckets, and every 16 positions are tested against all of the buckets at once with nibble lookup tables
+// (pshufb, needs SSSE3). positions that pass are checked against a bitmap of the exact anchors, and only
+// then compared against the patterns with that anchor
+
+class SignatureScanner
+{
+public:
+	enum
+	{
+		kMaxPatternLen = 256,
+		kNumBuckets = 8,
+	};
+
+	struct Result
+	{
+		u64	offset;			// first match, plus the base passed to scan. only meaningful if numMatches isn't 0
+		u32	numMatches;
+	};
+
+	SignatureScanner();
+
+	// index of the pattern, -1 if it can't be parsed or is only wildcards
+	s32		add(const char * pattern);
+	void	clear();
+
+	u32		numPatterns() const	{ return u32(m_patterns.size()); }
+
+	// base is added to every offset, pass the RVA of the data to get RVAs
+	void	scan(const u8 * data, size_t len, u64 base = 0);
+
+	const Result &	result(u32 idx) const	{ return m_patterns[idx].result; }
+
+	// identifies a pattern independent of how it was written, for caching results
+	u64		patternHash(u32 idx) const	{ return m_patterns[idx].hash; }
+
+	// positions that passed the prefilter during the last scan, for tuning
+	u64		numCandidates() const	{ return m_numCandidates; }
+
+private:
+	struct Pattern
+	{
+		u32		start;			// in m_bytes and m_masks
+		u32		len;
+		u32		anchorOffset;
+		u32		anchorLen;		// 1 or 2
+		u64		hash;
+
+		Result	result;
+	};
+
+	struct Anchor
+	{
+		u32	key;		// first byte, second byte, length in bits 16+
+		u32	pattern;
+
+		bool operator<(const Anchor & rhs) const	{ return key < rhs.key; }
+	};
+
+	void	buildTables(const u8 * data, size_t len);
+	void	checkAnchor(const u8 * data, size_t len, size_t pos, u32 key, u64 base);
+	bool	matches(const Pattern & pattern, const u8 * src) const;
+
+	std::vector <Pattern>	m_patterns;
+	std::vector <u8>		m_bytes;
+	std::vector <u8>		m_masks;	// 0xFF for a fixed byte, 0 for a wildcard
+
+	std::vector <Anchor>	m_anchors;	// sorted
+
+	// bucket bits for each nibble of the first and second anchor byte
+	alignas(16) u8	m_lowNibble[2][16];
+	alignas(16) u8	m_highNibble[2][16];
+
+	// exact anchors, indexed by the u16 at a position or the byte
+	u64		m_pairAnchors[0x10000 / 64];
+	u64		m_byteAnchors[0x100 / 64];
+
+	u64		m_numCandidates;
+};
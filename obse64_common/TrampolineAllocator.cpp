@@ -0,0 +1,278 @@
+#include "TrampolineAllocator.h"
+#include "obse64_common/Errors.h"
+#include "obse64_common/MemoryReservation.h"
+
+enum
+{
+	kLowestAddress = 0x10000,	// never reserve anything in the null page area
+
+	kLargeAlign = 16,
+};
+
+TrampolineAllocator::TrampolineAllocator()
+:m_reservation(nullptr)
+,m_moduleBase(0)
+,m_moduleLen(0)
+,m_regionLen(0)
+,m_inUse(0)
+,m_curAlloc(nullptr)
+{
+	for (auto & list : m_freeLists)
+		list = nullptr;
+}
+
+TrampolineAllocator::~TrampolineAllocator()
+{
+	destroy();
+}
+
+bool TrampolineAllocator::create(uintptr_t moduleBase, size_t moduleLen, size_t regionLen, MemoryReservation * reservation)
+{
+	ASSERT(m_regions.empty());
+
+	m_reservation = reservation;
+	m_moduleBase = moduleBase;
+	m_moduleLen = moduleLen;
+	m_regionLen = regionLen;
+
+	return addRegion(regionLen);
+}
+
+void TrampolineAllocator::setBase(void * base, size_t len)
+{
+	ASSERT(m_regions.empty());
+
+	Region region = { (u8 *)base, len, 0, false };
+	m_regions.push_back(region);
+
+	m_reservation = nullptr;
+}
+
+void TrampolineAllocator::destroy()
+{
+	for (const Region & region : m_regions)
+		if (region.owned && m_reservation)
+			m_reservation->release(region.base, region.len);
+
+	m_regions.clear();
+	m_largeFree.clear();
+
+	for (auto & list : m_freeLists)
+		list = nullptr;
+
+	m_inUse = 0;
+	m_curAlloc = nullptr;
+}
+
+size_t TrampolineAllocator::roundSize(size_t size)
+{
+	if (size > kMaxClassSize)
+		return (size + kLargeAlign - 1) & ~size_t(kLargeAlign - 1);
+
+	size_t result = kMinClassSize;
+	while (result < size)
+		result <<= 1;
+
+	return result;
+}
+
+u32 TrampolineAllocator::sizeClass(size_t roundedSize)
+{
+	u32 result = 0;
+	while ((size_t(kMinClassSize) << result) < roundedSize)
+		result++;
+
+	return result;
+}
+
+void TrampolineAllocator::carve(u8 * ptr, size_t len)
+{
+	if (len > kMaxClassSize)
+	{
+		LargeBlock block = { ptr, len };
+		m_largeFree.push_back(block);
+
+		return;
+	}
+
+	// biggest classes first, len is always a multiple of 8
+	while (len >= kMinClassSize)
+	{
+		size_t piece = kMaxClassSize;
+		while (piece > len)
+			piece >>= 1;
+
+		u32 cls = sizeClass(piece);
+
+		*(void **)ptr = m_freeLists[cls];
+		m_freeLists[cls] = ptr;
+
+		ptr += piece;
+		len -= piece;
+	}
+}
+
+bool TrampolineAllocator::addRegion(size_t minLen)
+{
+	if (!m_reservation)
+		return false;
+
+	size_t len = m_regionLen;
+	if (len < minLen)
+		len = ((minLen + m_regionLen - 1) / m_regionLen) * m_regionLen;
+
+	// every byte of the region has to be in range of every byte of the module
+	uintptr_t moduleEnd = m_moduleBase + m_moduleLen;
+
+	uintptr_t belowLow = (moduleEnd > kMaxDisplacement + kLowestAddress) ? moduleEnd - kMaxDisplacement : kLowestAddress;
+	uintptr_t aboveHigh = m_moduleBase + kMaxDisplacement;
+
+	void * base = m_reservation->reserve(belowLow, m_moduleBase, len);
+	if (!base)
+		base = m_reservation->reserve(moduleEnd, aboveHigh, len);
+
+	if (!base)
+		return false;
+
+	if (!m_regions.empty())
+	{
+		Region & old = m_regions.back();
+
+		carve(old.base + old.allocated, old.len - old.allocated);
+		old.allocated = old.len;
+	}
+
+	Region region = { (u8 *)base, len, 0, true };
+	m_regions.push_back(region);
+
+	return true;
+}
+
+void * TrampolineAllocator::bump(size_t size)
+{
+	if (m_regions.empty() || (remain() < size))
+	{
+		if (!addRegion(size))
+			return nullptr;
+	}
+
+	Region & region = m_regions.back();
+
+	void * result = region.base + region.allocated;
+	region.allocated += size;
+
+	return result;
+}
+
+void * TrampolineAllocator::allocate(size_t size)
+{
+	ASSERT(!m_curAlloc);
+
+	size_t rounded = roundSize(size);
+	void * result = nullptr;
+
+	if (rounded <= kMaxClassSize)
+	{
+		u32 cls = sizeClass(rounded);
+
+		if (m_freeLists[cls])
+		{
+			result = m_freeLists[cls];
+			m_freeLists[cls] = *(void **)result;
+		}
+	}
+	else
+	{
+		// best fit, the rest goes back on the lists
+		size_t best = m_largeFree.size();
+
+		for (size_t i = 0; i < m_largeFree.size(); i++)
+		{
+			size_t blockSize = m_largeFree[i].size;
+
+			if ((blockSize >= rounded) && ((best == m_largeFree.size()) || (blockSize < m_largeFree[best].size)))
+				best = i;
+		}
+
+		if (best != m_largeFree.size())
+		{
+			LargeBlock block = m_largeFree[best];
+
+			m_largeFree[best] = m_largeFree.back();
+			m_largeFree.pop_back();
+
+			result = block.ptr;
+			carve((u8 *)block.ptr + rounded, block.size - rounded);
+		}
+	}
+
+	if (!result)
+		result = bump(rounded);
+
+	if (result)
+		m_inUse += rounded;
+
+	return result;
+}
+
+void TrampolineAllocator::free(void * ptr, size_t size)
+{
+	if (!ptr)
+		return;
+
+	size_t rounded = roundSize(size);
+
+	m_inUse -= rounded;
+
+	carve((u8 *)ptr, rounded);
+}
+
+void * TrampolineAllocator::startAlloc()
+{
+	ASSERT(!m_curAlloc);
+
+	if (m_regions.empty() || (remain() < kMinUnsized))
+	{
+		if (!addRegion(kMinUnsized))
+			return nullptr;
+	}
+
+	Region & region = m_regions.back();
+	m_curAlloc = region.base + region.allocated;
+
+	return m_curAlloc;
+}
+
+void TrampolineAllocator::endAlloc(const void * end)
+{
+	ASSERT(m_curAlloc);
+
+	// keep the next allocation aligned
+	size_t len = ((const u8 *)end - m_curAlloc + kMinClassSize - 1) & ~size_t(kMinClassSize - 1);
+	ASSERT(len <= remain());
+
+	m_regions.back().allocated += len;
+	m_inUse += len;
+
+	m_curAlloc = nullptr;
+}
+
+size_t TrampolineAllocator::remain() const
+{
+	if (m_regions.empty())
+		return 0;
+
+	const Region & region = m_regions.back();
+
+	return region.len - region.allocated;
+}
+
+size_t TrampolineAllocator::reserved() const
+{
+	size_t result = 0;
+
+	for (const Region & region : m_regions)
+		result += region.len;
+
+	return result;
+}
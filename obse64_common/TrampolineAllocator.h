@@ -0,0 +1,100 @@
+#pragma once
+
+#include "obse64_common/Types.h"
+#include <cstdint>
+#include <vector>
+
+class MemoryReservation;
+
+// hands out executable memory close enough to a module to reach with 32 bit displacements
+//
+// memory comes from regions reserved below the module, or above it once that's full, never further away than
+// kMaxDisplacement. a new region is reserved whenever the current one runs out, and what was left of the old one
+// is split up for the free lists
+//
+// allocations are rounded up to a power of two size class (8 to kMaxClassSize bytes), freed blocks are kept on a
+// list per class and reused first. larger blocks are rounded to 16 bytes, reused best fit first with the rest split
+// back up. everything is 8 byte aligned. not thread safe
+
+class TrampolineAllocator
+{
+public:
+	enum
+	{
+		kMinClassSize = 8,
+		kMaxClassSize = 4096,
+		kNumClasses = 10,
+
+		kMinUnsized = kMaxClassSize,	// room guaranteed by startAlloc
+	};
+
+	// largest 32 bit displacement with 128MB scratch space
+	static const uintptr_t	kMaxDisplacement = 0x80000000 - (1024 * 1024 * 128);
+
+	TrampolineAllocator();
+	~TrampolineAllocator();
+
+	TrampolineAllocator(const TrampolineAllocator &) = delete;
+	TrampolineAllocator & operator=(const TrampolineAllocator &) = delete;
+
+	// reserves the first region of regionLen bytes. later regions are the same size, or bigger for large allocations
+	bool	create(uintptr_t moduleBase, size_t moduleLen, size_t regionLen, MemoryReservation * reservation);
+
+	// memory owned by the caller, nothing else is reserved
+	void	setBase(void * base, size_t len);
+
+	void	destroy();
+
+	// null if no more memory can be reserved in range
+	void *	allocate(size_t size);
+
+	// size has to be what was passed to allocate
+	void	free(void * ptr, size_t size);
+
+	// unsized allocation from the end of the current region, at least kMinUnsized bytes are available
+	void *	startAlloc();
+	void	endAlloc(const void * end);
+
+	// left in the current region
+	size_t	remain() const;
+
+	size_t	numRegions() const	{ return m_regions.size(); }
+	size_t	reserved() const;	// bytes in every region
+	size_t	inUse() const		{ return m_inUse; }	// allocated and not freed, after rounding
+
+private:
+	struct Region
+	{
+		u8		* base;
+		size_t	len;
+		size_t	allocated;
+		bool	owned;		// released by destroy
+	};
+
+	struct LargeBlock
+	{
+		void	* ptr;
+		size_t	size;
+	};
+
+	static size_t	roundSize(size_t size);
+	static u32		sizeClass(size_t roundedSize);
+
+	bool	addRegion(size_t minLen);
+	void	carve(u8 * ptr, size_t len);	// on to the free lists
+	void *	bump(size_t size);
+
+	std::vector <Region>		m_regions;	// the last one is current
+	std::vector <LargeBlock>	m_largeFree;
+
+	void	* m_freeLists[kNumClasses];		// singly linked through the first 8 bytes of each block
+
+	MemoryReservation	* m_reservation;
+
+	uintptr_t	m_moduleBase;
+	size_t		m_moduleLen;
+	size_t		m_regionLen;
+	size_t		m_inUse;
+
+	u8		* m_curAlloc;	// active startAlloc
+};
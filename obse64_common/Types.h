@@ -1,5 +1,7 @@
 #pragma once
 
+#ifdef _MSC_VER
+
 #include <intrin.h>
 
 typedef unsigned __int8		u8;
@@ -10,9 +12,57 @@ typedef signed __int8		s8;
 typedef signed __int16		s16;
 typedef signed __int32		s32;
 typedef signed __int64		s64;
+
+#else
+
+// the offline tools and tests also build with gcc/clang
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <strings.h>
+
+typedef std::uint8_t		u8;
+typedef std::uint16_t		u16;
+typedef std::uint32_t		u32;
+typedef std::uint64_t		u64;
+typedef std::int8_t			s8;
+typedef std::int16_t		s16;
+typedef std::int32_t		s32;
+typedef std::int64_t		s64;
+
+// MSVC CRT names used throughout
+inline int _stricmp(const char * lhs, const char * rhs)					{ return strcasecmp(lhs, rhs); }
+inline int _strnicmp(const char * lhs, const char * rhs, size_t len)	{ return strncasecmp(lhs, rhs, len); }
+
+inline int fopen_s(FILE ** file, const char * path, const char * mode)
+{
+	*file = fopen(path, mode);
+
+	return *file ? 0 : errno;
+}
+
+template <typename... Args>
+int sprintf_s(char * dst, size_t len, const char * fmt, Args... args)
+{
+	return snprintf(dst, len, fmt, args...);
+}
+
+// only used with numeric conversions, which take the same arguments as sscanf
+template <typename... Args>
+int sscanf_s(const char * src, const char * fmt, Args... args)
+{
+	return sscanf(src, fmt, args...);
+}
+
+#endif
+
 typedef float				f32;
 typedef double				f64;
-typedef u64					uint;
+
+#ifdef _MSC_VER
+typedef u64					uint;	// sys/types.h already has a 32 bit one elsewhere
+#endif
 
 typedef u8	unk8;
 typedef u16	unk16;
@@ -29,6 +79,8 @@ typedef s16		SInt16;
 typedef s32		SInt32;
 typedef s64		SInt64;
 
+#ifdef _MSC_VER
+
 inline u16 swap16(u16 a)
 {
 	return _byteswap_ushort(a);
@@ -43,3 +95,22 @@ inline u64 swap64(u64 a)
 {
 	return _byteswap_uint64(a);
 }
+
+#else
+
+inline u16 swap16(u16 a)
+{
+	return __builtin_bswap16(a);
+}
+
+inline u32 swap32(u32 a)
+{
+	return __builtin_bswap32(a);
+}
+
+inline u64 swap64(u64 a)
+{
+	return __builtin_bswap64(a);
+}
+
+#endif
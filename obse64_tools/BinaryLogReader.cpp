@@ -0,0 +1,144 @@
+#include "BinaryLogReader.h"
+#include "obse64_common/FileStream.h"
+#include <cstring>
+
+BinaryLogReader::BinaryLogReader()
+	:m_offset(0)
+	,m_truncated(false)
+	,m_timerFrequency(1)
+	,m_timerStart(0)
+	,m_startTime(0)
+{
+	//
+}
+
+bool BinaryLogReader::Open(const char * path)
+{
+	FileStream	file;
+
+	if(!file.open(path))
+	{
+		fprintf(stderr, "couldn't open %s\n", path);
+		return false;
+	}
+
+	m_data.resize(size_t(file.length()));
+
+	if(file.read(m_data.data(), m_data.size()) != m_data.size())
+	{
+		fprintf(stderr, "couldn't read %s\n", path);
+		return false;
+	}
+
+	u32	magic = 0;
+	u16	version = 0;
+
+	if(m_data.size() >= BinaryLogFormat::kHeaderSize)
+	{
+		memcpy(&magic, m_data.data(), sizeof(magic));
+		memcpy(&version, m_data.data() + 4, sizeof(version));
+	}
+
+	if((magic != BinaryLogFormat::kMagic) || (version != BinaryLogFormat::kVersion))
+	{
+		fprintf(stderr, "%s is not a binary log, or is from a different version (%d)\n", path, version);
+		return false;
+	}
+
+	memcpy(&m_timerFrequency, m_data.data() + 8, sizeof(m_timerFrequency));
+	memcpy(&m_timerStart, m_data.data() + 16, sizeof(m_timerStart));
+	memcpy(&m_startTime, m_data.data() + 24, sizeof(m_startTime));
+
+	if(!m_timerFrequency)
+		m_timerFrequency = 1;
+
+	m_offset = BinaryLogFormat::kHeaderSize;
+	m_truncated = false;
+	m_formats.clear();
+
+	return true;
+}
+
+bool BinaryLogReader::Next(Record * record)
+{
+	while(m_offset + BinaryLogFormat::kRecordHeaderSize <= m_data.size())
+	{
+		const u8	* src = m_data.data() + m_offset;
+		u16			len;
+
+		memcpy(&len, src + 2, sizeof(len));
+
+		if((len < BinaryLogFormat::kRecordHeaderSize) || (m_offset + len > m_data.size()))
+			break;
+
+		record->type = src[0];
+		record->level = src[1];
+		memcpy(&record->formatID, src + 4, sizeof(record->formatID));
+		memcpy(&record->timer, src + 8, sizeof(record->timer));
+		memcpy(&record->thread, src + 16, sizeof(record->thread));
+		memcpy(&record->frame, src + 20, sizeof(record->frame));
+		record->payload = src + BinaryLogFormat::kRecordHeaderSize;
+		record->payloadLen = len - BinaryLogFormat::kRecordHeaderSize;
+
+		m_offset += len;
+
+		if(record->type == BinaryLogFormat::kRecord_Format)
+		{
+			std::string	text((const char *)record->payload, record->payloadLen);
+
+			m_formats[record->formatID] = std::make_unique <BinaryLogFormat>(text.c_str());
+			continue;
+		}
+
+		return true;
+	}
+
+	// the game was closed or crashed while a record was being written
+	m_truncated = m_offset != m_data.size();
+
+	return false;
+}
+
+bool BinaryLogReader::Render(const Record & record, std::string * out) const
+{
+	char	buf[64];
+
+	if(record.type == BinaryLogFormat::kRecord_Text)
+	{
+		out->append((const char *)record.payload, record.payloadLen);
+		return true;
+	}
+
+	if(record.type != BinaryLogFormat::kRecord_Message)
+	{
+		sprintf_s(buf, sizeof(buf), "<unknown record type %d>", record.type);
+		out->append(buf);
+		return false;
+	}
+
+	auto iter = m_formats.find(record.formatID);
+	if(iter == m_formats.end())
+	{
+		sprintf_s(buf, sizeof(buf), "<undefined format %u>", record.formatID);
+		out->append(buf);
+		return false;
+	}
+
+	size_t	start = out->size();
+
+	if(!iter->second->render(record.payload, record.payloadLen, out))
+	{
+		out->resize(start);
+		out->append("<arguments don't match format \"");
+		out->append(iter->second->source());
+		out->append("\">");
+		return false;
+	}
+
+	return true;
+}
+
+double BinaryLogReader::Seconds(u64 timer) const
+{
+	return double(s64(timer - m_timerStart)) / double(m_timerFrequency);
+}
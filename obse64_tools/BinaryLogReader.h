@@ -0,0 +1,53 @@
+#pragma once
+
+#include "obse64_common/BinaryLog.h"
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// reads a binary debug log written by DebugLog::openBinary
+class BinaryLogReader
+{
+public:
+	struct Record
+	{
+		u8			type;
+		u8			level;
+		u32			formatID;
+		u64			timer;
+		u32			thread;
+		u32			frame;
+		const u8	* payload;
+		u32			payloadLen;
+	};
+
+	BinaryLogReader();
+
+	bool	Open(const char * path);
+
+	// format definitions are consumed internally, messages and frame markers are returned
+	// returns false at the end of the file. Truncated() tells if it ended in the middle of a record
+	bool	Next(Record * record);
+
+	// renders a message record's text
+	bool	Render(const Record & record, std::string * out) const;
+
+	// seconds since the log was opened
+	double	Seconds(u64 timer) const;
+
+	bool	Truncated() const { return m_truncated; }
+	u64		StartTime() const { return m_startTime; }	// FILETIME
+	u32		NumFormats() const { return u32(m_formats.size()); }
+
+private:
+	std::vector <u8>	m_data;
+	size_t				m_offset;
+	bool				m_truncated;
+
+	u64	m_timerFrequency;
+	u64	m_timerStart;
+	u64	m_startTime;
+
+	std::unordered_map <u32, std::unique_ptr <BinaryLogFormat>>	m_formats;
+};
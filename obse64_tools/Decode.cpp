@@ -0,0 +1,105 @@
+#include "Decode.h"
+#include "BinaryLogReader.h"
+#include "obse64_common/Log.h"
+#include <cstdio>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <ctime>
+#endif
+
+static const char * kLevelNames[] =
+{
+	"FATAL",
+	"ERROR",
+	"WARN",
+	"",
+	"",
+	"",
+};
+
+int Decode(int argc, char ** argv)
+{
+	if((argc < 1) || (argc > 2))
+	{
+		fprintf(stderr, "usage: obse64_tools decode <log.bin> [output.txt]\n");
+		return 1;
+	}
+
+	BinaryLogReader	reader;
+
+	if(!reader.Open(argv[0]))
+		return 1;
+
+	FILE	* out = stdout;
+
+	if(argc == 2)
+	{
+		if(fopen_s(&out, argv[1], "w"))
+		{
+			fprintf(stderr, "couldn't create %s\n", argv[1]);
+			return 1;
+		}
+	}
+
+	u64			startTime = reader.StartTime();
+
+#ifdef _WIN32
+	FILETIME	fileTime = { DWORD(startTime), DWORD(startTime >> 32) };
+	SYSTEMTIME	sysTime = { 0 };
+
+	FileTimeToSystemTime(&fileTime, &sysTime);
+
+	fprintf(out, "log opened %04d-%02d-%02d %02d:%02d:%02d UTC\n",
+		sysTime.wYear, sysTime.wMonth, sysTime.wDay, sysTime.wHour, sysTime.wMinute, sysTime.wSecond);
+#else
+	// FILETIME counts 100ns intervals from 1601
+	time_t		unixTime = time_t(startTime / 10000000) - 11644473600LL;
+	struct tm	utc = { 0 };
+
+	gmtime_r(&unixTime, &utc);
+
+	fprintf(out, "log opened %04d-%02d-%02d %02d:%02d:%02d UTC\n",
+		utc.tm_year + 1900, utc.tm_mon + 1, utc.tm_mday, utc.tm_hour, utc.tm_min, utc.tm_sec);
+#endif
+
+	BinaryLogReader::Record	record;
+	std::string				line;
+	u32						numRecords = 0;
+	u32						numErrors = 0;
+
+	while(reader.Next(&record))
+	{
+		if(record.type == BinaryLogFormat::kRecord_Frame)
+			continue;
+
+		line.clear();
+
+		if(!reader.Render(record, &line))
+			numErrors++;
+
+		u32			levelIdx = record.level & 0x0F;
+		u32			channel = record.level >> 4;
+		const char	* level = (levelIdx <= DebugLog::kLevel_DebugMessage) ? kLevelNames[levelIdx] : "?";
+
+		fprintf(out, "[%11.6f %5u %6u] %s%s", reader.Seconds(record.timer), record.thread, record.frame, level, *level ? ": " : "");
+
+		if(channel != DebugLog::kChannel_General)
+			fprintf(out, "[%s] ", DebugLog::channelName(DebugLog::LogChannel(channel)));
+
+		fprintf(out, "%s\n", line.c_str());
+
+		numRecords++;
+	}
+
+	if(reader.Truncated())
+		fprintf(out, "<log ends with an incomplete record>\n");
+
+	if(out != stdout)
+		fclose(out);
+
+	fprintf(stderr, "%u messages, %u formats, %u errors\n", numRecords, reader.NumFormats(), numErrors);
+
+	return numErrors ? 2 : 0;
+}
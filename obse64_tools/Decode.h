@@ -0,0 +1,4 @@
+#pragma once
+
+// obse64_tools decode <log.bin> [output.txt]
+int Decode(int argc, char ** argv);
@@ -0,0 +1,123 @@
+#include "SigScan.h"
+#include "obse64_common/MappedFile.h"
+#include "obse64_common/PEImage.h"
+#include "obse64_common/SignatureScanner.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// one pattern per line, blank lines and lines starting with # are skipped
+static bool ReadPatterns(const char * path, std::vector <std::string> * patterns)
+{
+	std::ifstream	file(path);
+
+	if(!file)
+		return false;
+
+	std::string	line;
+
+	while(std::getline(file, line))
+	{
+		if(!line.empty() && (line.back() == '\r'))
+			line.pop_back();
+
+		if(line.empty() || (line[0] == '#'))
+			continue;
+
+		patterns->push_back(line);
+	}
+
+	return true;
+}
+
+int SigScan(int argc, char ** argv)
+{
+	const char	* path = nullptr;
+
+	std::vector <std::string>	patterns;
+
+	for(int i = 0; i < argc; i++)
+	{
+		if(!strcmp(argv[i], "--file") && (i + 1 < argc))
+		{
+			if(!ReadPatterns(argv[++i], &patterns))
+			{
+				fprintf(stderr, "couldn't read %s\n", argv[i]);
+				return 1;
+			}
+		}
+		else if(!path)
+		{
+			path = argv[i];
+		}
+		else
+		{
+			patterns.push_back(argv[i]);
+		}
+	}
+
+	if(!path || patterns.empty())
+	{
+		fprintf(stderr, "usage: obse64_tools sigscan <game exe> <pattern | --file patterns.txt>...\n");
+		return 1;
+	}
+
+	MappedFile	file;
+
+	if(!file.open(path))
+	{
+		fprintf(stderr, "couldn't open %s (%08X)\n", path, MappedFile::lastError());
+		return 1;
+	}
+
+	PEImage		image;
+	u32			codeRVA, codeSize, fileSize;
+	const u8	* code;
+
+	if(!image.parse(file.data(), file.size()) || !image.findCode(&codeRVA, &codeSize, &code, &fileSize) || !code)
+	{
+		fprintf(stderr, "%s doesn't have any code\n", path);
+		return 1;
+	}
+
+	SignatureScanner	scanner;
+
+	for(const std::string & pattern : patterns)
+	{
+		if(scanner.add(pattern.c_str()) < 0)
+		{
+			fprintf(stderr, "invalid pattern \"%s\"\n", pattern.c_str());
+			return 1;
+		}
+	}
+
+	auto	start = std::chrono::steady_clock::now();
+	scanner.scan(code, fileSize, codeRVA);
+	auto	end = std::chrono::steady_clock::now();
+
+	u32	numFound = 0;
+
+	for(u32 i = 0; i < scanner.numPatterns(); i++)
+	{
+		const SignatureScanner::Result & result = scanner.result(i);
+
+		if(result.numMatches)
+		{
+			printf("%08llX  %6u  %s\n", (unsigned long long)result.offset, result.numMatches, patterns[i].c_str());
+			numFound++;
+		}
+		else
+		{
+			printf("--------  %6u  %s\n", 0, patterns[i].c_str());
+		}
+	}
+
+	printf("%u of %u patterns found in %08X bytes of code (hash %016llX), %.3f ms, %llu candidate positions\n",
+		numFound, scanner.numPatterns(), fileSize, (unsigned long long)image.headerHash(),
+		std::chrono::duration <double, std::milli>(end - start).count(), (unsigned long long)scanner.numCandidates());
+
+	return numFound == scanner.numPatterns() ? 0 : 2;
+}
@@ -0,0 +1,4 @@
+#pragma once
+
+// obse64_tools sigscan <game exe> <pattern | --file patterns.txt>...
+int SigScan(int argc, char ** argv);
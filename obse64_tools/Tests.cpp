@@ -0,0 +1,180 @@
+#include "Tests.h"
+#include "obse64_common/Types.h"
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+struct TestSuite
+{
+	const char	* name;
+	void		(* run)(TestContext & ctx);
+};
+
+struct Benchmark
+{
+	const char	* name;
+	void		(* run)();
+};
+
+// names are what ctest passes, see CMakeLists.txt
+static const TestSuite kSuites[] =
+{
+	{ "peimage",	TestPEImage },
+	{ "patch",	TestPatchTransaction },
+	{ "addrlib",	TestAddressLibrary },
+	{ "trampoline",	TestTrampolineAllocator },
+	{ "messaging",	TestPluginMessaging },
+	{ "pluginstats",	TestPluginStats },
+	{ "cmdindex",	TestCommandNameIndex },
+	{ "scriptargs",	TestScriptArgs },
+	{ "compression",	TestBlockCompression },
+	{ "json",	TestJson },
+	{ "signature",	TestSignatureScanner },
+	{ "cmdtable",	TestCommandTablePatches },
+	{ "logring",	TestLogRing },
+	{ "format",	TestFormatString },
+	{ "resultcache",	TestResultCache },
+	{ "filestream",	TestFileStream },
+};
+
+static const Benchmark kBenchmarks[] =
+{
+	{ "patch",	BenchPatchTransaction },
+	{ "addrlib",	BenchAddressLibrary },
+	{ "trampoline",	BenchTrampolineAllocator },
+	{ "plugincache",	BenchPluginCache },
+	{ "messaging",	BenchPluginMessaging },
+	{ "cmdindex",	BenchCommandNameIndex },
+	{ "scriptargs",	BenchScriptArgs },
+	{ "compression",	BenchBlockCompression },
+	{ "json",	BenchJson },
+	{ "signature",	BenchSignatureScanner },
+	{ "logring",	BenchLogRing },
+	{ "logfilter",	BenchLogFiltered },
+	{ "format",	BenchFormatString },
+	{ "hooks",	BenchHookRegistry },
+	{ "resultcache",	BenchResultCache },
+};
+
+TestContext::TestContext()
+:m_numChecks(0)
+,m_numFailures(0)
+{
+	//
+}
+
+bool TestContext::check(bool passed, const char * expr, const char * file, int line)
+{
+	m_numChecks++;
+
+	if(!passed)
+	{
+		m_numFailures++;
+		fprintf(stderr, "%s(%d): failed: %s\n", file, line, expr);
+	}
+
+	return passed;
+}
+
+u8 * AllocTestPages(size_t len)
+{
+#ifdef _WIN32
+	return (u8 *)VirtualAlloc(nullptr, len, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+	void	* result = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	return (result != MAP_FAILED) ? (u8 *)result : nullptr;
+#endif
+}
+
+void FreeTestPages(u8 * mem, size_t len)
+{
+#ifdef _WIN32
+	VirtualFree(mem, 0, MEM_RELEASE);
+#else
+	munmap(mem, len);
+#endif
+}
+
+static bool IsSelected(const char * name, int argc, char ** argv)
+{
+	if(!argc)
+		return true;
+
+	for(int i = 0; i < argc; i++)
+		if(!_stricmp(argv[i], name))
+			return true;
+
+	return false;
+}
+
+// any name that isn't in the table is an error rather than a silently empty run
+template <typename T, size_t n>
+static bool CheckNames(const T (& table)[n], const char * kind, int argc, char ** argv)
+{
+	bool	result = true;
+
+	for(int i = 0; i < argc; i++)
+	{
+		bool	found = false;
+
+		for(const T & entry : table)
+			if(!_stricmp(argv[i], entry.name))
+				found = true;
+
+		if(!found)
+		{
+			fprintf(stderr, "unknown %s \"%s\"\n", kind, argv[i]);
+			result = false;
+		}
+	}
+
+	return result;
+}
+
+int Test(int argc, char ** argv)
+{
+	if(!CheckNames(kSuites, "suite", argc, argv))
+		return 1;
+
+	int	failedSuites = 0;
+
+	for(const TestSuite & suite : kSuites)
+	{
+		if(!IsSelected(suite.name, argc, argv))
+			continue;
+
+		TestContext	ctx;
+
+		suite.run(ctx);
+
+		printf("%-12s %d checks, %d failed\n", suite.name, ctx.numChecks(), ctx.numFailures());
+
+		if(ctx.numFailures())
+			failedSuites++;
+	}
+
+	return failedSuites ? 1 : 0;
+}
+
+int Bench(int argc, char ** argv)
+{
+	if(!CheckNames(kBenchmarks, "benchmark", argc, argv))
+		return 1;
+
+	for(const Benchmark & bench : kBenchmarks)
+	{
+		if(!IsSelected(bench.name, argc, argv))
+			continue;
+
+		printf("%s:\n", bench.name);
+		bench.run();
+	}
+
+	return 0;
+}
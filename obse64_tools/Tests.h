@@ -0,0 +1,101 @@
+#pragma once
+
+#include "obse64_common/Types.h"
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+// obse64_tools test [suite]...
+// unit tests for obse64_common that don't need the game, every suite if none are named
+int Test(int argc, char ** argv);
+
+// obse64_tools bench [benchmark]...
+int Bench(int argc, char ** argv);
+
+// counts checks for a suite, failures are printed as they happen
+class TestContext
+{
+public:
+	TestContext();
+
+	bool	check(bool passed, const char * expr, const char * file, int line);
+
+	int		numChecks() const	{ return m_numChecks; }
+	int		numFailures() const	{ return m_numFailures; }
+
+private:
+	int		m_numChecks;
+	int		m_numFailures;
+};
+
+#define TEST_CHECK(ctx, expr)	(ctx).check((expr) ? true : false, #expr, __FILE__, __LINE__)
+
+// wall clock milliseconds for benchmarks
+class BenchTimer
+{
+public:
+	BenchTimer()	{ restart(); }
+
+	void	restart()	{ m_start = std::chrono::steady_clock::now(); }
+	double	elapsedMS() const	{ return std::chrono::duration <double, std::milli>(std::chrono::steady_clock::now() - m_start).count(); }
+
+private:
+	std::chrono::steady_clock::time_point	m_start;
+};
+
+// read/write pages from the OS, VirtualAlloc or mmap. len is only used by munmap
+u8 *	AllocTestPages(size_t len);
+void	FreeTestPages(u8 * mem, size_t len);
+
+// a 64 bit plugin dll exporting OBSEPlugin_Version and OBSEPlugin_Load, from the PEImage fixtures
+std::vector <u8>	BuildTestPluginImage();
+
+// suites, in Tests_*.cpp
+void TestAddressLibrary(TestContext & ctx);
+void BenchAddressLibrary();
+
+void TestPEImage(TestContext & ctx);
+
+void TestPatchTransaction(TestContext & ctx);
+void BenchPatchTransaction();
+
+void TestTrampolineAllocator(TestContext & ctx);
+void BenchTrampolineAllocator();
+
+void BenchPluginCache();
+
+void TestPluginMessaging(TestContext & ctx);
+void BenchPluginMessaging();
+
+void TestPluginStats(TestContext & ctx);
+
+void TestCommandNameIndex(TestContext & ctx);
+void BenchCommandNameIndex();
+
+void TestScriptArgs(TestContext & ctx);
+void BenchScriptArgs();
+
+void TestBlockCompression(TestContext & ctx);
+void BenchBlockCompression();
+
+void TestJson(TestContext & ctx);
+void BenchJson();
+
+void TestSignatureScanner(TestContext & ctx);
+void BenchSignatureScanner();
+
+void TestCommandTablePatches(TestContext & ctx);
+
+void TestLogRing(TestContext & ctx);
+void BenchLogRing();
+void BenchLogFiltered();
+
+void TestFormatString(TestContext & ctx);
+void BenchFormatString();
+
+void BenchHookRegistry();
+
+void TestResultCache(TestContext & ctx);
+void BenchResultCache();
+
+void TestFileStream(TestContext & ctx);
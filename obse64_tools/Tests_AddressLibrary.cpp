@@ -0,0 +1,457 @@
+#include "Tests.h"
+#include "obse64_common/AddressLibrary.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <random>
+#include <vector>
+
+// writes databases in the format AddressLibrary reads, see AddressLibrary.h
+class AddressLibraryWriter
+{
+public:
+	AddressLibraryWriter(s32 pointerSize = 8, s32 format = 2)
+	:m_pointerSize(pointerSize), m_format(format), m_prevID(0), m_prevOffset(0)	{ }
+
+	// encoding types as in the file, kChoose picks the smallest that fits
+	enum
+	{
+		kChoose = 0xFF,
+		kScaled = 8,
+	};
+
+	void add(u64 id, u64 offset, u32 idType = kChoose, u32 offsetType = kChoose)
+	{
+		if(idType == kChoose)
+			idType = chooseType(id, m_prevID);
+
+		if(offsetType == kChoose)
+		{
+			if(!(offset % m_pointerSize) && !(m_prevOffset % m_pointerSize))
+				offsetType = kScaled | chooseType(offset / m_pointerSize, m_prevOffset / m_pointerSize);
+			else
+				offsetType = chooseType(offset, m_prevOffset);
+		}
+
+		m_entries.push_back(u8(idType | (offsetType << 4)));
+
+		putValue(idType, id, m_prevID);
+
+		if(offsetType & kScaled)
+			putValue(offsetType & 7, offset / m_pointerSize, m_prevOffset / m_pointerSize);
+		else
+			putValue(offsetType, offset, m_prevOffset);
+
+		m_prevID = id;
+		m_prevOffset = offset;
+		m_numEntries++;
+	}
+
+	std::vector <u8> finish() const
+	{
+		static const char	kName[] = "OblivionRemastered.exe";
+
+		std::vector <u8>	result;
+
+		put(result, m_format);
+
+		for(s32 part : { 1, 0, 1, 0 })
+			put(result, part);
+
+		put(result, s32(sizeof(kName) - 1));
+		result.insert(result.end(), kName, kName + sizeof(kName) - 1);
+
+		put(result, m_pointerSize);
+		put(result, m_numEntries);
+
+		result.insert(result.end(), m_entries.begin(), m_entries.end());
+
+		return result;
+	}
+
+private:
+	template <typename T>
+	static void put(std::vector <u8> & dst, T value)
+	{
+		const u8	* src = (const u8 *)&value;
+
+		dst.insert(dst.end(), src, src + sizeof(value));
+	}
+
+	static u32 chooseType(u64 value, u64 prev)
+	{
+		if(value == prev + 1)						return 1;
+		if((value > prev) && (value - prev <= 0xFF))	return 2;
+		if((value < prev) && (prev - value <= 0xFF))	return 3;
+		if((value > prev) && (value - prev <= 0xFFFF))	return 4;
+		if((value < prev) && (prev - value <= 0xFFFF))	return 5;
+		if(value <= 0xFFFF)							return 6;
+		if(value <= 0xFFFFFFFF)						return 7;
+		return 0;
+	}
+
+	void putValue(u32 type, u64 value, u64 prev)
+	{
+		switch(type)
+		{
+			case 0: put(m_entries, value);				break;
+			case 1:										break;
+			case 2: put(m_entries, u8(value - prev));	break;
+			case 3: put(m_entries, u8(prev - value));	break;
+			case 4: put(m_entries, u16(value - prev));	break;
+			case 5: put(m_entries, u16(prev - value));	break;
+			case 6: put(m_entries, u16(value));			break;
+			default: put(m_entries, u32(value));		break;
+		}
+	}
+
+	s32		m_pointerSize;
+	s32		m_format;
+	s32		m_numEntries = 0;
+
+	u64		m_prevID;
+	u64		m_prevOffset;
+
+	std::vector <u8>	m_entries;
+};
+
+// every id and offset encoding, each entry written with one type pair
+static void TestTypeNibbles(TestContext & ctx)
+{
+	struct Step
+	{
+		u64	id;
+		u32	idType;
+	};
+
+	// each relative to the one before
+	static const Step	kIDSteps[] =
+	{
+		{ 0x123456789A,	0 },
+		{ 0x123456789B,	1 },
+		{ 0x12345678FA,	2 },
+		{ 0x123456789B,	3 },
+		{ 0x123456889B,	4 },
+		{ 0x123456789C,	5 },
+		{ 0xBEEF,		6 },
+		{ 0xDEADBEEF,	7 },
+	};
+
+	for(u32 offsetType = 0; offsetType < 16; offsetType++)
+	{
+		AddressLibraryWriter	writer;
+		std::map <u64, u64>		expected;
+
+		u64	offset = 0x4000;
+
+		for(const Step & step : kIDSteps)
+		{
+			// an offset the type can express from the previous one
+			u64	prevScaled = (expected.empty() ? 0 : offset) / ((offsetType & 8) ? 8 : 1);
+			u64	value;
+
+			switch(offsetType & 7)
+			{
+				case 0:	value = 0x1234567890;		break;
+				case 1:	value = prevScaled + 1;		break;
+				case 2:	value = prevScaled + 0x80;	break;
+				case 3:	value = prevScaled - 0x10;	break;
+				case 4:	value = prevScaled + 0x1000;	break;
+				case 5:	value = prevScaled - 0x100;	break;
+				case 6:	value = 0x4321;				break;
+				default:	value = 0x87654321;		break;
+			}
+
+			offset = (offsetType & 8) ? value * 8 : value;
+
+			writer.add(step.id, offset, step.idType, offsetType);
+			expected[step.id] = offset;
+		}
+
+		std::vector <u8>	file = writer.finish();
+		AddressLibrary		library;
+
+		if(!TEST_CHECK(ctx, library.parse(file.data(), file.size())))
+			continue;
+
+		bool	matched = true;
+
+		for(const auto & entry : expected)
+			if(library.getOffset(entry.first) != entry.second)
+				matched = false;
+
+		TEST_CHECK(ctx, matched);
+		TEST_CHECK(ctx, library.size() == sizeof(kIDSteps) / sizeof(kIDSteps[0]));
+	}
+
+	// 8-15 aren't id types
+	std::vector <u8>	file = AddressLibraryWriter().finish();
+
+	file[file.size() - 4] = 1;
+	file.push_back(0x08);
+
+	AddressLibrary	library;
+
+	TEST_CHECK(ctx, !library.parse(file.data(), file.size()));
+}
+
+// scaled offsets are stored divided by the pointer size, and relative to the previous offset divided the same way
+static void TestPointerSize(TestContext & ctx)
+{
+	for(s32 pointerSize : { 4, 8 })
+	{
+		AddressLibraryWriter	writer(pointerSize);
+
+		writer.add(1, 0x1000, 1, AddressLibraryWriter::kScaled | 7);
+		writer.add(2, 0x1000 + 3 * pointerSize, 1, AddressLibraryWriter::kScaled | 2);
+		writer.add(3, 0x1000 + 3 * pointerSize + 3, 1, 2);	// unaligned, unscaled
+		writer.add(4, 0x1000 + 4 * pointerSize, 1, AddressLibraryWriter::kScaled | 1);	// relative to the rounded down previous one
+		writer.add(5, 0x800, 1, AddressLibraryWriter::kScaled | 5);
+
+		std::vector <u8>	file = writer.finish();
+		AddressLibrary		library;
+
+		TEST_CHECK(ctx, library.parse(file.data(), file.size()));
+		TEST_CHECK(ctx, library.getOffset(1) == 0x1000);
+		TEST_CHECK(ctx, library.getOffset(2) == u64(0x1000 + 3 * pointerSize));
+		TEST_CHECK(ctx, library.getOffset(3) == u64(0x1000 + 3 * pointerSize + 3));
+		TEST_CHECK(ctx, library.getOffset(4) == u64(0x1000 + 4 * pointerSize));
+		TEST_CHECK(ctx, library.getOffset(5) == 0x800);
+	}
+}
+
+// a realistic database: ids mostly in order with gaps, offsets mostly ascending, some shuffled entries
+static std::vector <u8> BuildGameDatabase(u32 numEntries, std::map <u64, u64> * expected, u64 * maxID)
+{
+	std::mt19937_64			rng(1);
+	std::vector <std::pair <u64, u64>>	entries;
+
+	u64	id = 1;
+	u64	offset = 0x1000;
+
+	for(u32 i = 0; i < numEntries; i++)
+	{
+		id += (rng() % 10) ? 1 : 1 + rng() % 50;
+
+		if(!(rng() % 20))
+			offset = (rng() % 0x9000000) & ~u64(7);
+		else
+			offset += (rng() % 3) ? 8 * (1 + rng() % 40) : 1 + rng() % 3000;
+
+		entries.push_back(std::make_pair(id, offset));
+	}
+
+	std::shuffle(entries.begin() + numEntries / 2, entries.begin() + numEntries / 2 + numEntries / 100, rng);
+
+	AddressLibraryWriter	writer;
+
+	for(const auto & entry : entries)
+	{
+		writer.add(entry.first, entry.second);
+
+		if(expected)
+			(*expected)[entry.first] = entry.second;
+	}
+
+	if(maxID)
+		*maxID = id;
+
+	return writer.finish();
+}
+
+static void TestDense(TestContext & ctx)
+{
+	std::map <u64, u64>	expected;
+	u64					maxID;
+
+	std::vector <u8>	file = BuildGameDatabase(100000, &expected, &maxID);
+	AddressLibrary		library;
+
+	TEST_CHECK(ctx, library.parse(file.data(), file.size()));
+	TEST_CHECK(ctx, library.size() == 100000);
+	TEST_CHECK(ctx, (library.version()[0] == 1) && (library.version()[1] == 0) && (library.version()[2] == 1));
+
+	bool	matched = true;
+
+	for(const auto & entry : expected)
+		if(library.getOffset(entry.first) != entry.second)
+			matched = false;
+
+	TEST_CHECK(ctx, matched);
+
+	// gaps, and past either end
+	u64	missing = 0;
+
+	for(u64 id = 1; (id < maxID) && !missing; id++)
+		if(!expected.count(id))
+			missing = id;
+
+	TEST_CHECK(ctx, missing && !library.getOffset(missing));
+	TEST_CHECK(ctx, !library.getOffset(0));
+	TEST_CHECK(ctx, !library.getOffset(maxID + 1));
+	TEST_CHECK(ctx, !library.getOffset(~u64(0)));
+
+	// the same through a file
+	const char	* path = "obse64_tools_test_versionlib.bin";
+
+	FILE	* dst = nullptr;
+
+	if(TEST_CHECK(ctx, !fopen_s(&dst, path, "wb") && dst))
+	{
+		fwrite(file.data(), 1, file.size(), dst);
+		fclose(dst);
+
+		AddressLibrary	loaded;
+
+		TEST_CHECK(ctx, loaded.load(path));
+		TEST_CHECK(ctx, loaded.size() == library.size());
+		TEST_CHECK(ctx, loaded.getOffset(expected.rbegin()->first) == expected.rbegin()->second);
+
+		remove(path);
+	}
+
+	TEST_CHECK(ctx, !library.load(path));
+	TEST_CHECK(ctx, library.empty() && !library.getOffset(expected.begin()->first));
+}
+
+static void TestSparse(TestContext & ctx)
+{
+	// ids too spread out for an array, offsets over 32 bits, and a repeated id
+	AddressLibraryWriter	writer(8, 1);
+
+	writer.add(5, 0x10);
+	writer.add(u64(1) << 40, 0x20);
+	writer.add(7, 0x123456789);
+	writer.add(5, 0x30);
+	writer.add(0xFFFFFFFF, 7);
+
+	std::vector <u8>	file = writer.finish();
+	AddressLibrary		library;
+
+	TEST_CHECK(ctx, library.parse(file.data(), file.size()));
+	TEST_CHECK(ctx, library.getOffset(5) == 0x30);	// the last one wins
+	TEST_CHECK(ctx, library.getOffset(u64(1) << 40) == 0x20);
+	TEST_CHECK(ctx, library.getOffset(7) == 0x123456789);
+	TEST_CHECK(ctx, library.getOffset(0xFFFFFFFF) == 7);
+	TEST_CHECK(ctx, !library.getOffset(6));
+	TEST_CHECK(ctx, !library.getOffset(u64(1) << 41));
+
+	// dense ids with one offset too big for the array
+	AddressLibraryWriter	wide;
+
+	wide.add(1, 0x100);
+	wide.add(2, 0x100000000);
+	wide.add(3, 0x200);
+
+	file = wide.finish();
+
+	TEST_CHECK(ctx, library.parse(file.data(), file.size()));
+	TEST_CHECK(ctx, library.getOffset(2) == 0x100000000);
+	TEST_CHECK(ctx, library.getOffset(3) == 0x200);
+	TEST_CHECK(ctx, !library.getOffset(4));
+}
+
+static void TestDamaged(TestContext & ctx)
+{
+	AddressLibraryWriter	writer;
+
+	writer.add(1, 8);
+	writer.add(2, 16);
+	writer.add(3, 0x100000);
+	writer.add(100, 0x20);
+
+	std::vector <u8>	file = writer.finish();
+	AddressLibrary		library;
+
+	// every truncation fails and leaves the library empty
+	bool	rejected = true;
+
+	for(size_t len = 0; len < file.size(); len++)
+	{
+		std::vector <u8>	cut(file.begin(), file.begin() + len);
+
+		if(library.parse(cut.data(), cut.size()) || !library.empty() || library.getOffset(1))
+			rejected = false;
+	}
+
+	TEST_CHECK(ctx, rejected);
+	TEST_CHECK(ctx, library.parse(file.data(), file.size()));
+
+	const size_t	kPointerSizeOffset = 6 * 4 + 22;
+
+	std::vector <u8>	bad = file;
+	bad[0] = 3;
+	TEST_CHECK(ctx, !library.parse(bad.data(), bad.size()));
+
+	bad = file;
+	bad[kPointerSizeOffset] = 0;
+	TEST_CHECK(ctx, !library.parse(bad.data(), bad.size()));
+
+	bad = file;
+	bad[5 * 4] = 0xFF;	// name length
+	TEST_CHECK(ctx, !library.parse(bad.data(), bad.size()));
+
+	bad = file;
+	bad[kPointerSizeOffset + 7] = 0x80;	// negative entry count
+	TEST_CHECK(ctx, !library.parse(bad.data(), bad.size()));
+
+	std::vector <u8>	empty = AddressLibraryWriter().finish();
+
+	TEST_CHECK(ctx, library.parse(empty.data(), empty.size()));
+	TEST_CHECK(ctx, library.empty());
+}
+
+void TestAddressLibrary(TestContext & ctx)
+{
+	TestTypeNibbles(ctx);
+	TestPointerSize(ctx);
+	TestDense(ctx);
+	TestSparse(ctx);
+	TestDamaged(ctx);
+}
+
+// parsing a database the size of the game's, and lookups against a sorted array
+void BenchAddressLibrary()
+{
+	const u32	kNumEntries = 1000000;
+	const u32	kNumParses = 20;
+	const u32	kNumLookups = 1 << 20;
+
+	std::map <u64, u64>	expected;
+
+	std::vector <u8>	file = BuildGameDatabase(kNumEntries, &expected, nullptr);
+	AddressLibrary		library;
+
+	BenchTimer	timer;
+
+	for(u32 i = 0; i < kNumParses; i++)
+		library.parse(file.data(), file.size());
+
+	printf("\tparse %u entries (%zu KB): %.2f ms\n", kNumEntries, file.size() / 1024, timer.elapsedMS() / kNumParses);
+
+	std::vector <std::pair <u64, u64>>	sorted(expected.begin(), expected.end());
+	std::vector <u64>					queries;
+	std::mt19937						rng(1);
+
+	for(u32 i = 0; i < kNumLookups; i++)
+		queries.push_back(sorted[rng() % sorted.size()].first);
+
+	volatile u64	sink = 0;
+
+	timer.restart();
+
+	for(u64 id : queries)
+		sink += library.getOffset(id);
+
+	double	lookup = timer.elapsedMS();
+
+	timer.restart();
+
+	for(u64 id : queries)
+		sink += std::lower_bound(sorted.begin(), sorted.end(), std::make_pair(id, u64(0)))->second;
+
+	double	search = timer.elapsedMS();
+
+	printf("\t%u lookups: %.2f ns each, binary search %.2f ns\n", kNumLookups, lookup * 1e6 / kNumLookups, search * 1e6 / kNumLookups);
+}
@@ -0,0 +1,435 @@
+#include "Tests.h"
+#include "obse64_common/BlockCompression.h"
+#include "obse64_common/FileStream.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+// growable DataStream over a vector, BufferStream has a fixed size
+class VectorStream : public DataStream
+{
+public:
+	virtual u64 seek(u64 offset)	{ m_offset = offset; return offset; }
+
+	virtual u64 read(void * dst, u64 len)
+	{
+		if(m_offset >= m_len)
+			return 0;
+
+		if(len > m_len - m_offset)
+			len = m_len - m_offset;
+
+		memcpy(dst, &data[size_t(m_offset)], size_t(len));
+		m_offset += len;
+
+		return len;
+	}
+
+	virtual u64 write(const void * src, u64 len)
+	{
+		if(m_offset + len > data.size())
+			data.resize(size_t(m_offset + len));
+
+		memcpy(&data[size_t(m_offset)], src, size_t(len));
+		m_offset += len;
+
+		if(m_offset > m_len)
+			m_len = m_offset;
+
+		return len;
+	}
+
+	std::vector <u8>	data;
+};
+
+// what a log looks like, lots of repeated prefixes with numbers changing
+static std::vector <u8> MakeLogText(size_t len, u32 seed)
+{
+	static const char	* kMessages[] =
+	{
+		"plugin %u loaded in %u us",
+		"script %08X called GetActorValue on %08X",
+		"cell %u attached, %u refs",
+		"array %u resized to %u elements",
+	};
+
+	std::mt19937	rng(seed);
+	std::string		text;
+
+	while(text.size() < len)
+	{
+		char	line[128];
+		u32		msg = rng() % 4;
+
+		sprintf_s(line, sizeof(line), kMessages[msg], rng() % 100000, rng() % 100000);
+
+		text += "[12:34:56.789] ";
+		text += line;
+		text += "\n";
+	}
+
+	return std::vector <u8>(text.begin(), text.begin() + len);
+}
+
+static std::vector <u8> MakeRandom(size_t len, u32 seed)
+{
+	std::mt19937	rng(seed);
+	std::vector <u8>	result(len);
+
+	for(u8 & c : result)
+		c = u8(rng());
+
+	return result;
+}
+
+static bool RoundTrip(const std::vector <u8> & src, size_t * compressedLen = nullptr)
+{
+	std::vector <u8>	compressed(lzCompressBound(src.size()));
+
+	size_t	len = lzCompress(src.data(), src.size(), compressed.data(), compressed.size());
+	if(compressedLen)
+		*compressedLen = len;
+
+	if(!len)
+		return false;
+
+	// one spare byte past the end catches overruns
+	std::vector <u8>	out(src.size() + 1, 0xEE);
+
+	if(!lzDecompress(compressed.data(), len, out.data(), src.size()))
+		return false;
+
+	return (out[src.size()] == 0xEE) && (src.empty() || !memcmp(out.data(), src.data(), src.size()));
+}
+
+static void TestCodec(TestContext & ctx)
+{
+	// empty and tiny inputs are all trailing literals
+	for(size_t len = 0; len < 40; len++)
+		TEST_CHECK(ctx, RoundTrip(MakeLogText(len, 1)));
+
+	{
+		size_t	len = 0;
+
+		TEST_CHECK(ctx, RoundTrip(std::vector <u8>(), &len));
+		TEST_CHECK(ctx, len == 1);
+	}
+
+	// incompressible data fits the bound
+	{
+		std::vector <u8>	random = MakeRandom(256 * 1024, 2);
+		size_t	len = 0;
+
+		TEST_CHECK(ctx, RoundTrip(random, &len));
+		TEST_CHECK(ctx, (len >= random.size()) && (len <= lzCompressBound(random.size())));
+	}
+
+	// long matches need the 255 length runs, overlapping ones repeat the pattern
+	{
+		size_t	len = 0;
+
+		TEST_CHECK(ctx, RoundTrip(std::vector <u8>(1024 * 1024, 'a'), &len));
+		TEST_CHECK(ctx, len < 1024 * 1024 / 200);
+
+		std::vector <u8>	period(100000);
+		for(size_t i = 0; i < period.size(); i++)
+			period[i] = u8("abcdefg"[i % 7]);
+
+		TEST_CHECK(ctx, RoundTrip(period));
+
+		// a match exactly at the 64KB offset limit and just past it
+		std::vector <u8>	far = MakeRandom(0x10000 + 64, 3);
+		memcpy(&far[0xFFFF], &far[0], 32);
+		memcpy(&far[0x10000 + 16], &far[0], 32);
+
+		TEST_CHECK(ctx, RoundTrip(far));
+	}
+
+	TEST_CHECK(ctx, RoundTrip(MakeLogText(200000, 4)));
+
+	// too small an output is a failure, not an overrun
+	{
+		std::vector <u8>	src = MakeRandom(1000, 5);
+		std::vector <u8>	dst(1100, 0xEE);
+
+		TEST_CHECK(ctx, !lzCompress(src.data(), src.size(), dst.data(), 500));
+		TEST_CHECK(ctx, dst[500] == 0xEE);
+	}
+
+	// malformed input is rejected
+	{
+		std::vector <u8>	src = MakeLogText(10000, 6);
+		std::vector <u8>	compressed(lzCompressBound(src.size()));
+		std::vector <u8>	out(src.size() + 16);
+
+		size_t	len = lzCompress(src.data(), src.size(), compressed.data(), compressed.size());
+
+		TEST_CHECK(ctx, !lzDecompress(compressed.data(), len - 1, out.data(), src.size()));
+		TEST_CHECK(ctx, !lzDecompress(compressed.data(), len, out.data(), src.size() - 1));
+		TEST_CHECK(ctx, !lzDecompress(compressed.data(), len, out.data(), src.size() + 1));
+
+		// a match pointing before the start of the output
+		const u8	badOffset[] = { 0x10, 'x', 0x02, 0x00, 0x00 };
+		TEST_CHECK(ctx, !lzDecompress(badOffset, sizeof(badOffset), out.data(), 5));
+
+		const u8	zeroOffset[] = { 0x10, 'x', 0x00, 0x00, 0x00 };
+		TEST_CHECK(ctx, !lzDecompress(zeroOffset, sizeof(zeroOffset), out.data(), 5));
+	}
+}
+
+static void TestBlocks(TestContext & ctx)
+{
+	const u32	kBlockSize = 4096;
+
+	std::vector <u8>	src = MakeLogText(50000, 7);
+
+	// a random block in the middle can't be compressed
+	std::vector <u8>	random = MakeRandom(kBlockSize, 8);
+	memcpy(&src[kBlockSize * 3], random.data(), random.size());
+
+	VectorStream	stream;
+
+	{
+		BlockCompressedWriter	writer(&stream, kBlockSize);
+
+		writer.writeHeader();
+
+		// writes that straddle block boundaries, in odd sizes
+		for(size_t offset = 0; offset < src.size(); )
+		{
+			size_t	len = std::min <size_t>(1 + (offset * 7) % 3001, src.size() - offset);
+
+			writer.write(&src[offset], len);
+			offset += len;
+		}
+	}
+
+	{
+		BlockCompressedReader	reader;
+
+		TEST_CHECK(ctx, reader.attach(&stream));
+		TEST_CHECK(ctx, reader.numBlocks() == (src.size() + kBlockSize - 1) / kBlockSize);
+		TEST_CHECK(ctx, reader.rawLength() == src.size());
+
+		std::string	all;
+		TEST_CHECK(ctx, reader.readAll(&all));
+		TEST_CHECK(ctx, (all.size() == src.size()) && !memcmp(all.data(), src.data(), src.size()));
+
+		TEST_CHECK(ctx, reader.findBlock(0) == 0);
+		TEST_CHECK(ctx, reader.findBlock(kBlockSize - 1) == 0);
+		TEST_CHECK(ctx, reader.findBlock(kBlockSize) == 1);
+		TEST_CHECK(ctx, reader.findBlock(src.size() - 1) == reader.numBlocks() - 1);
+
+		std::vector <u8>	block;
+		TEST_CHECK(ctx, reader.readBlock(3, &block));
+		TEST_CHECK(ctx, block == random);
+		TEST_CHECK(ctx, !reader.readBlock(reader.numBlocks(), &block));
+	}
+
+	// appending to an existing stream adds blocks without a second header
+	{
+		u64	oldLen = stream.length();
+
+		stream.seek(oldLen);
+
+		{
+			BlockCompressedWriter	writer(&stream, kBlockSize);
+			writer.write("appended", 8);
+		}
+
+		BlockCompressedReader	reader;
+
+		TEST_CHECK(ctx, reader.attach(&stream));
+		TEST_CHECK(ctx, reader.rawLength() == src.size() + 8);
+
+		std::string	all;
+		TEST_CHECK(ctx, reader.readAll(&all) && (all.substr(src.size()) == "appended"));
+
+		// a torn final block from a crash is dropped, the rest still reads
+		VectorStream	torn;
+		torn.write(stream.data.data(), stream.data.size() - 3);
+
+		TEST_CHECK(ctx, reader.attach(&torn));
+		TEST_CHECK(ctx, reader.rawLength() == src.size());
+	}
+
+	// corruption in stored, compressed or checksum bytes is caught by the checksum
+	{
+		BlockCompressedReader	reader;
+		reader.attach(&stream);
+
+		u64		blockOffsets[3];
+		u32		blocks[3] = { 0, 3, 5 };
+
+		// block header offsets, walking the stream the way attach does
+		{
+			u64	offset = 12;
+			u32	idx = 0;
+
+			for(u32 i = 0; i <= 5; i++)
+			{
+				if(i == blocks[idx])
+					blockOffsets[idx++] = offset;
+
+				u32	storedLen;
+				memcpy(&storedLen, &stream.data[size_t(offset + 4)], 4);
+
+				offset += 12 + storedLen;
+			}
+		}
+
+		std::vector <u8>	block;
+
+		TEST_CHECK(ctx, reader.readBlock(0, &block));
+
+		stream.data[size_t(blockOffsets[0] + 12 + 100)] ^= 0x01;	// compressed payload
+		stream.data[size_t(blockOffsets[1] + 12 + 100)] ^= 0x01;	// stored payload
+		stream.data[size_t(blockOffsets[2] + 8)] ^= 0x01;			// checksum
+
+		// the checksums are read by attach
+		TEST_CHECK(ctx, reader.attach(&stream));
+
+		TEST_CHECK(ctx, !reader.readBlock(0, &block));
+		TEST_CHECK(ctx, !reader.readBlock(3, &block));
+		TEST_CHECK(ctx, !reader.readBlock(5, &block));
+		TEST_CHECK(ctx, reader.readBlock(1, &block));
+
+		std::string	all;
+		TEST_CHECK(ctx, !reader.readAll(&all));
+	}
+
+	// not a compressed stream
+	{
+		VectorStream	plain;
+		plain.write(src.data(), 100);
+
+		BlockCompressedReader	reader;
+
+		TEST_CHECK(ctx, !BlockCompressedReader::isCompressed(&plain));
+		TEST_CHECK(ctx, !reader.attach(&plain));
+	}
+}
+
+// how compressed logs grow their last block: rewritten in place, the file cut off after it in case it shrank
+static bool RewriteLastBlock(const char * path, u64 blockOffset, const std::vector <u8> & data)
+{
+	FileStream	file;
+	if(!file.modify(path))
+		return false;
+
+	file.seek(blockOffset);
+
+	BlockCompressedWriter	writer(&file);
+	writer.writeBlock(data.data(), data.size());
+
+	return file.truncate(file.offset());
+}
+
+static void TestRewriteLastBlock(TestContext & ctx)
+{
+	const char	* kPath = "obse64_tools_rewrite.oblz";
+
+	std::vector <u8>	first = MakeLogText(1000, 9);
+	std::vector <u8>	random = MakeRandom(3000, 10);
+	std::vector <u8>	zeros(3000, 0);
+
+	u64	lastOffset;
+
+	{
+		FileStream	file;
+		TEST_CHECK(ctx, file.create(kPath));
+
+		BlockCompressedWriter	writer(&file);
+
+		writer.writeHeader();
+		writer.writeBlock(first.data(), first.size());
+
+		lastOffset = file.offset();
+		writer.writeBlock(first.data(), 10);
+	}
+
+	// growing, then shrinking to a fraction of the size on disk
+	TEST_CHECK(ctx, RewriteLastBlock(kPath, lastOffset, random));
+	TEST_CHECK(ctx, RewriteLastBlock(kPath, lastOffset, zeros));
+
+	{
+		FileStream				file;
+		BlockCompressedReader	reader;
+
+		TEST_CHECK(ctx, file.open(kPath) && reader.attach(&file));
+		TEST_CHECK(ctx, (reader.numBlocks() == 2) && (reader.rawLength() == first.size() + zeros.size()));
+		TEST_CHECK(ctx, file.length() < lastOffset + 12 + 100);
+
+		std::vector <u8>	block;
+		TEST_CHECK(ctx, reader.readBlock(0, &block) && (block == first));
+		TEST_CHECK(ctx, reader.readBlock(1, &block) && (block == zeros));
+	}
+
+	// only existing files
+	remove(kPath);
+
+	FileStream	missing;
+	TEST_CHECK(ctx, !missing.modify(kPath));
+}
+
+void TestBlockCompression(TestContext & ctx)
+{
+	TestCodec(ctx);
+	TestBlocks(ctx);
+	TestRewriteLastBlock(ctx);
+}
+
+// compression ratio and throughput over 16MB of log text, random bytes and zeros, in 64KB blocks as logs use
+void BenchBlockCompression()
+{
+	const size_t	kLen = 16 * 1024 * 1024;
+
+	struct Input
+	{
+		const char	* name;
+		std::vector <u8>	data;
+	};
+
+	Input	inputs[] =
+	{
+		{ "log text",	MakeLogText(kLen, 10) },
+		{ "random",	MakeRandom(kLen, 11) },
+		{ "zeros",	std::vector <u8>(kLen, 0) },
+	};
+
+	for(const Input & input : inputs)
+	{
+		VectorStream	stream;
+		stream.data.reserve(kLen + kLen / 64);
+
+		BenchTimer	timer;
+
+		{
+			BlockCompressedWriter	writer(&stream);
+
+			writer.writeHeader();
+			writer.write(input.data.data(), input.data.size());
+		}
+
+		double	compressTime = timer.elapsedMS();
+
+		BlockCompressedReader	reader;
+		std::string	out;
+
+		timer.restart();
+
+		bool	ok = reader.attach(&stream) && reader.readAll(&out);
+
+		double	decompressTime = timer.elapsedMS();
+
+		ok = ok && (out.size() == input.data.size()) && !memcmp(out.data(), input.data.data(), out.size());
+
+		double	mb = double(kLen) / (1024 * 1024);
+
+		printf("\t%-9s ratio %.3f, compress %.0f MB/s, decompress %.0f MB/s%s\n",
+			input.name, double(stream.length()) / kLen, mb * 1000 / compressTime, mb * 1000 / decompressTime, ok ? "" : " (round trip FAILED)");
+	}
+}
@@ -0,0 +1,226 @@
+#include "Tests.h"
+#include "obse64/CommandNameIndex.h"
+#include "obse64/GameScript.h"
+#include <cctype>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// command names shaped like the game's, most share a Get/Set/Is prefix so _stricmp gets past the first character
+struct CommandTableStandIn
+{
+	std::vector <std::string>	names;
+	std::vector <std::string>	shortNames;
+	std::vector <CommandInfo>	commands;
+
+	void	build(const char * tag, u32 count, u32 firstOpcode)
+	{
+		static const char	* kPrefixes[] = { "Get", "Set", "Is", "Mod", "Has", "Add", "Remove", "Toggle" };
+		static const char	* kWords[] = { "ActorValue", "Spell", "Item", "Quest", "Cell", "Weather", "Magic", "Effect" };
+
+		names.resize(count);
+		shortNames.resize(count);
+		commands.resize(count);
+
+		for(u32 i = 0; i < count; i++)
+		{
+			names[i] = std::string(kPrefixes[i % 8]) + kWords[(i / 8) % 8] + tag + std::to_string(i);
+
+			// about a third have a short name, padding entries have no names at all
+			if(!(i % 3))
+				shortNames[i] = std::string(tag) + std::to_string(i);
+
+			if(i % 50 == 49)
+				names[i].clear();
+
+			CommandInfo	cmd = { };
+
+			cmd.name = names[i].c_str();
+			cmd.shortName = shortNames[i].c_str();
+			cmd.opcode = firstOpcode + i;
+
+			commands[i] = cmd;
+		}
+	}
+
+	CommandNameIndex::Table	table() const	{ CommandNameIndex::Table result = { commands.data(), commands.size() }; return result; }
+};
+
+// what ImportConsoleCommand and plugins did before the index, long names then short names per table
+static const CommandInfo * LinearLookup(const CommandNameIndex::Table * tables, size_t numTables, const char * name)
+{
+	for(u32 isShortName = 0; isShortName < 2; isShortName++)
+	{
+		for(size_t i = 0; i < numTables; i++)
+		{
+			for(size_t j = 0; j < tables[i].count; j++)
+			{
+				const CommandInfo & cmd = tables[i].commands[j];
+				const char * entryName = isShortName ? cmd.shortName : cmd.name;
+
+				if(entryName && *entryName && !_stricmp(entryName, name))
+					return &cmd;
+			}
+		}
+	}
+
+	return nullptr;
+}
+
+void TestCommandNameIndex(TestContext & ctx)
+{
+	CommandTableStandIn	script, console;
+
+	script.build("Scr", 600, 0x1000);
+	console.build("Con", 0x86, 0x100);
+
+	CommandNameIndex::Table	tables[] = { script.table(), console.table() };
+	CommandNameIndex		index;
+
+	TEST_CHECK(ctx, !index.lookup("GetSpellScr8"));
+
+	index.build(tables, 2);
+
+	// every name and short name resolves the same way the linear scan does, in any case
+	bool	allMatch = true;
+
+	for(const CommandTableStandIn * stand : { &script, &console })
+	{
+		for(const CommandInfo & cmd : stand->commands)
+		{
+			for(const char * name : { cmd.name, cmd.shortName })
+			{
+				if(!*name)
+					continue;
+
+				std::string	upper(name);
+				for(char & c : upper)
+					c = toupper(u8(c));
+
+				if((index.lookup(name) != LinearLookup(tables, 2, name)) || (index.lookup(upper.c_str()) != index.lookup(name)))
+					allMatch = false;
+			}
+		}
+	}
+
+	TEST_CHECK(ctx, allMatch);
+	TEST_CHECK(ctx, index.lookup("GetSpellScr8") == &script.commands[8]);
+	TEST_CHECK(ctx, index.lookup("scr9") == &script.commands[9]);
+	TEST_CHECK(ctx, !index.lookup("GetSpellScr9"));
+	TEST_CHECK(ctx, !index.lookup(""));
+	TEST_CHECK(ctx, !index.lookup(nullptr));
+
+	// padding has no names, 12 of the script entries and 2 of the console ones
+	TEST_CHECK(ctx, index.size() == (600 - 12) + 200 + (0x86 - 2) + 45);
+
+	// a long name beats an earlier table's short name, an earlier table wins between equal kinds
+	std::string	shadowedName = script.shortNames[3];
+	std::string	sharedName = script.names[0];
+
+	CommandInfo	clash[2] = { };
+
+	clash[0].name = shadowedName.c_str();
+	clash[0].shortName = "";
+	clash[1].name = sharedName.c_str();
+	clash[1].shortName = "";
+
+	CommandNameIndex::Table	clashTables[] = { script.table(), { clash, 2 } };
+	index.build(clashTables, 2);
+
+	TEST_CHECK(ctx, index.lookup(shadowedName.c_str()) == &clash[0]);
+	TEST_CHECK(ctx, index.lookup(sharedName.c_str()) == &script.commands[0]);
+	TEST_CHECK(ctx, LinearLookup(clashTables, 2, shadowedName.c_str()) == &clash[0]);
+}
+
+// ImportConsoleCommand against the console table, and name resolution over every script and console command.
+// the script table is the game's 0x172 commands plus room for OBSE and plugins
+void BenchCommandNameIndex()
+{
+	const u32	kNumRuns = 200;
+
+	CommandTableStandIn	script, console;
+
+	script.build("Scr", kScript_NumScriptCommands + 0x100, kScript_ScriptOpBase);
+	console.build("Con", kScript_NumConsoleCommands, 0x100);
+
+	CommandNameIndex::Table	tables[] = { script.table(), console.table() };
+	CommandNameIndex		index, consoleIndex;
+
+	BenchTimer	timer;
+
+	index.build(tables, 2);
+	consoleIndex.build(&tables[1], 1);
+
+	double	buildTime = timer.elapsedMS();
+
+	// imports as scripts write them, then a mix of names and short names from both tables
+	std::vector <std::string>	imports, queries;
+
+	for(const CommandInfo & cmd : console.commands)
+	{
+		std::string	name(cmd.name);
+		for(char & c : name)
+			c = tolower(u8(c));
+
+		imports.push_back(name);
+	}
+
+	for(u32 i = 0; i < 1000; i++)
+	{
+		const CommandTableStandIn & stand = (i % 4) ? script : console;
+		const CommandInfo & cmd = stand.commands[(i * 7919) % stand.commands.size()];
+
+		queries.push_back((i % 5) ? cmd.name : cmd.shortName);
+	}
+
+	queries.push_back("NotACommand");
+
+	u32	numMismatches = 0;
+
+	for(const std::string & name : imports)
+		numMismatches += consoleIndex.lookup(name.c_str()) != LinearLookup(&tables[1], 1, name.c_str());
+
+	for(const std::string & name : queries)
+		numMismatches += index.lookup(name.c_str()) != LinearLookup(tables, 2, name.c_str());
+
+	uintptr_t	sum = 0;
+
+	timer.restart();
+
+	for(u32 run = 0; run < kNumRuns; run++)
+		for(const std::string & name : imports)
+			sum += uintptr_t(LinearLookup(&tables[1], 1, name.c_str()));
+
+	double	importLinear = timer.elapsedMS();
+
+	timer.restart();
+
+	for(u32 run = 0; run < kNumRuns; run++)
+		for(const std::string & name : imports)
+			sum -= uintptr_t(consoleIndex.lookup(name.c_str()));
+
+	double	importIndex = timer.elapsedMS();
+
+	timer.restart();
+
+	for(u32 run = 0; run < kNumRuns; run++)
+		for(const std::string & name : queries)
+			sum += uintptr_t(LinearLookup(tables, 2, name.c_str()));
+
+	double	allLinear = timer.elapsedMS();
+
+	timer.restart();
+
+	for(u32 run = 0; run < kNumRuns; run++)
+		for(const std::string & name : queries)
+			sum -= uintptr_t(index.lookup(name.c_str()));
+
+	double	allIndex = timer.elapsedMS();
+
+	double	numImports = double(kNumRuns) * imports.size();
+	double	numQueries = double(kNumRuns) * queries.size();
+
+	printf("\t%zu names indexed in %.3f ms, %u mismatches%s\n", index.size(), buildTime, numMismatches, sum ? " (checksum differs)" : "");
+	printf("\tconsole import: linear %.0f ns, index %.0f ns per lookup\n", importLinear * 1e6 / numImports, importIndex * 1e6 / numImports);
+	printf("\tall commands: linear %.0f ns, index %.0f ns per lookup\n", allLinear * 1e6 / numQueries, allIndex * 1e6 / numQueries);
+}
@@ -0,0 +1,380 @@
+#include "Tests.h"
+#include "obse64_common/CommandTablePatches.h"
+#include "obse64_common/PEImage.h"
+#include <cstring>
+#include <string>
+#include <vector>
+
+// a stand-in for the game exe: headers, then one code section covering every patch site, with the unpatched
+// instructions the verifier expects written at each site. the command table itself doesn't need to be there,
+// only the addresses pointing at it are checked
+
+enum
+{
+	kHeaderSize = 0x200,
+
+	kCodeRVA = 0x06947000,
+	kCodeEnd = 0x06A0E200,
+	kCodeSize = kCodeEnd - kCodeRVA,
+	kCodeFileOffset = kHeaderSize,
+
+	kLeaLen = 7,
+};
+
+template <typename T>
+static void Put(std::vector <u8> & dst, size_t offset, T value)
+{
+	memcpy(&dst[offset], &value, sizeof(value));
+}
+
+struct GameImage
+{
+	std::vector <u8>	file;
+
+	u8 *	site(u32 rva)	{ return &file[kCodeFileOffset + rva - kCodeRVA]; }
+
+	// virtualSize and rawSize less than kCodeSize cut the section short
+	void	build(u32 virtualSize = kCodeSize, u32 rawSize = kCodeSize)
+	{
+		file.assign(kCodeFileOffset + kCodeSize, 0xCC);
+		memset(file.data(), 0, kHeaderSize);
+
+		const u32	ntOffset = 0x40;
+		const u32	optionalOffset = ntOffset + 4 + 20;
+		const u32	sectionOffset = optionalOffset + 240;
+
+		file[0] = 'M';
+		file[1] = 'Z';
+		Put <u32>(file, 0x3C, ntOffset);
+
+		memcpy(&file[ntOffset], "PE\0\0", 4);
+		Put <u16>(file, ntOffset + 4, PEImage::kMachine_AMD64);
+		Put <u16>(file, ntOffset + 4 + 2, 1);	// sections
+		Put <u16>(file, ntOffset + 4 + 16, 240);
+
+		Put <u16>(file, optionalOffset, 0x20B);
+		Put <u32>(file, optionalOffset + 56, kCodeEnd);	// SizeOfImage
+		Put <u32>(file, optionalOffset + 60, kHeaderSize);
+		Put <u32>(file, optionalOffset + 108, 16);
+
+		memcpy(&file[sectionOffset], ".text", 5);
+		Put <u32>(file, sectionOffset + 8, virtualSize);
+		Put <u32>(file, sectionOffset + 12, kCodeRVA);
+		Put <u32>(file, sectionOffset + 16, rawSize);
+		Put <u32>(file, sectionOffset + 20, kCodeFileOffset);
+		Put <u32>(file, sectionOffset + 36, 0x60000020);	// code, execute, read
+
+		for(const CmdTablePatch * patch = kCmdTableStartPatches; patch->type != kPatchType_End; ++patch)
+			writeSite(*patch, kCmdTable_ScriptCommandsRVA + patch->offset);
+
+		for(const CmdTablePatch * patch = kCmdTableEndPatches; patch->type != kPatchType_End; ++patch)
+			writeSite(*patch, kCmdTable_ScriptCommandsRVA + (kCmdTable_NumScriptCommands - 1) * kCmdTable_EntrySize + patch->offset);
+
+		for(const CmdTablePatch * patch = kCmdTableLenPatches; patch->type != kPatchType_End; ++patch)
+			writeSite(*patch, kCmdTable_NumScriptCommands + patch->offset);
+	}
+
+	// lea rax, [rip + target], or the value for the others
+	void	writeSite(const CmdTablePatch & patch, u32 value)
+	{
+		u8	* code = site(patch.ptr);
+
+		if(patch.type == kPatchType_LeaToLoadBase)
+		{
+			code[0] = 0x48;
+			code[1] = 0x8D;
+			code[2] = 0x05;
+
+			u32	disp = value - (patch.ptr + kLeaLen);
+			memcpy(code + 3, &disp, 4);
+		}
+		else
+		{
+			memcpy(code, &value, 4);
+		}
+	}
+};
+
+static const CmdTablePatch * FindPatch(const CmdTablePatch * list, u32 type)
+{
+	for(; list->type != kPatchType_End; ++list)
+		if(list->type == type)
+			return list;
+
+	return nullptr;
+}
+
+static u32 Verify(const GameImage & game, std::vector <CmdTablePatchResult> * results, bool stopOnFailure = false)
+{
+	PEImage	image;
+
+	if(!image.parse(game.file.data(), game.file.size()))
+		return ~0u;
+
+	return verifyCmdTablePatches(image, results, stopOnFailure);
+}
+
+// the failed sites, as patch RVAs
+static std::vector <u32> FailedSites(const std::vector <CmdTablePatchResult> & results)
+{
+	std::vector <u32>	sites;
+
+	for(const CmdTablePatchResult & result : results)
+		if(!result.ok)
+			sites.push_back(result.patch->ptr);
+
+	return sites;
+}
+
+static const CmdTablePatchResult * FindResult(const std::vector <CmdTablePatchResult> & results, u32 ptr)
+{
+	for(const CmdTablePatchResult & result : results)
+		if(result.patch->ptr == ptr)
+			return &result;
+
+	return nullptr;
+}
+
+static u32 NumSites()
+{
+	u32	count = 0;
+
+	for(const CmdTablePatch * list : { kCmdTableStartPatches, kCmdTableEndPatches, kCmdTableLenPatches })
+		for(const CmdTablePatch * patch = list; patch->type != kPatchType_End; ++patch)
+			count++;
+
+	return count;
+}
+
+static void TestGood(TestContext & ctx)
+{
+	GameImage	game;
+	game.build();
+
+	std::vector <CmdTablePatchResult>	results;
+
+	TEST_CHECK(ctx, Verify(game, &results) == 0);
+	TEST_CHECK(ctx, results.size() == NumSites());
+
+	bool	allOk = true;
+	for(const CmdTablePatchResult & result : results)
+		if(!result.ok || result.detail.empty())
+			allOk = false;
+
+	TEST_CHECK(ctx, allOk);
+
+	// a start lea can load the image base instead, the table offset is then in a later instruction
+	const CmdTablePatch	* lea = FindPatch(kCmdTableStartPatches, kPatchType_LeaToLoadBase);
+
+	game.writeSite(*lea, 0);
+
+	TEST_CHECK(ctx, Verify(game, &results) == 0);
+	TEST_CHECK(ctx, results[0].detail == "lea rax, image base");
+
+	// an r8-r15 destination through REX.R
+	game.site(lea->ptr)[0] = 0x4C;
+
+	TEST_CHECK(ctx, Verify(game, &results) == 0);
+	TEST_CHECK(ctx, results[0].detail == "lea r8, image base");
+}
+
+static void TestWrongBytes(TestContext & ctx)
+{
+	const CmdTablePatch	* lea = FindPatch(kCmdTableStartPatches, kPatchType_LeaToLoadBase);
+	const CmdTablePatch	* endLea = FindPatch(kCmdTableEndPatches, kPatchType_LeaToLoadBase);
+	const CmdTablePatch	* count = FindPatch(kCmdTableLenPatches, kPatchType_Data32);
+
+	std::vector <CmdTablePatchResult>	results;
+
+	// mov instead of lea, no REX.W, and an absolute address instead of rip-relative
+	const u8	kBadLeas[][3] =
+	{
+		{ 0x48, 0x8B, 0x05 },
+		{ 0x40, 0x8D, 0x05 },
+		{ 0x48, 0x8D, 0x04 },
+		{ 0x90, 0x48, 0x8D },
+	};
+
+	for(const u8 * bytes : kBadLeas)
+	{
+		GameImage	game;
+		game.build();
+
+		memcpy(game.site(lea->ptr), bytes, 3);
+
+		TEST_CHECK(ctx, Verify(game, &results) == 1);
+		TEST_CHECK(ctx, FailedSites(results) == std::vector <u32>(1, lea->ptr));
+	}
+
+	// a different command count, as if the game added a command
+	{
+		GameImage	game;
+		game.build();
+
+		game.writeSite(*count, kCmdTable_NumScriptCommands + 1 + count->offset);
+
+		TEST_CHECK(ctx, Verify(game, &results) == 1);
+		TEST_CHECK(ctx, FailedSites(results) == std::vector <u32>(1, count->ptr));
+		TEST_CHECK(ctx, FindResult(results, count->ptr)->detail == "imm32 172, expected 171");
+	}
+
+	// the end lea pointing at the first entry, the start one at the last
+	{
+		GameImage	game;
+		game.build();
+
+		game.writeSite(*endLea, kCmdTable_ScriptCommandsRVA + endLea->offset);
+		game.writeSite(*lea, kCmdTable_ScriptCommandsRVA + (kCmdTable_NumScriptCommands - 1) * kCmdTable_EntrySize + lea->offset);
+
+		TEST_CHECK(ctx, Verify(game, &results) == 2);
+	}
+
+	// the image base is only fine for the start of the table
+	{
+		GameImage	game;
+		game.build();
+
+		game.writeSite(*endLea, 0);
+
+		TEST_CHECK(ctx, Verify(game, &results) == 1);
+		TEST_CHECK(ctx, FailedSites(results) == std::vector <u32>(1, endLea->ptr));
+	}
+}
+
+static void TestOutOfRange(TestContext & ctx)
+{
+	const CmdTablePatch	* lea = FindPatch(kCmdTableStartPatches, kPatchType_LeaToLoadBase);
+	const CmdTablePatch	* offset32 = FindPatch(kCmdTableStartPatches, kPatchType_WriteOffset32);
+
+	std::vector <CmdTablePatchResult>	results;
+
+	// a lea one entry off, and displacements just either side of the table
+	{
+		GameImage	game;
+		game.build();
+
+		game.writeSite(*lea, kCmdTable_ScriptCommandsRVA + kCmdTable_EntrySize);
+
+		TEST_CHECK(ctx, Verify(game, &results) == 1);
+		TEST_CHECK(ctx, results[0].detail.find("table entry 1 +00") != std::string::npos);
+	}
+
+	const u32	kBadOffsets[] =
+	{
+		kCmdTable_ScriptCommandsRVA - 1,
+		kCmdTable_ScriptCommandsRVA + kCmdTable_NumScriptCommands * kCmdTable_EntrySize,
+		0,
+		0xFFFFFFFF,
+	};
+
+	for(u32 value : kBadOffsets)
+	{
+		GameImage	game;
+		game.build();
+
+		game.writeSite(*offset32, value);
+
+		TEST_CHECK(ctx, Verify(game, &results) == 1);
+		TEST_CHECK(ctx, FailedSites(results) == std::vector <u32>(1, offset32->ptr));
+	}
+
+	// the last byte of the table is still in it
+	{
+		GameImage	game;
+		game.build();
+
+		game.writeSite(*offset32, kCmdTable_ScriptCommandsRVA + kCmdTable_NumScriptCommands * kCmdTable_EntrySize - 1);
+
+		TEST_CHECK(ctx, Verify(game, &results) == 0);
+	}
+
+	// string fetches aren't in the lists at the moment, check one directly
+	{
+		CmdTablePatch	fetch = { 0x1000, 0, kPatchType_FixupStringFetch };
+		std::string		detail;
+
+		u8	code[16] = { 0x48, 0x8B, 0x9C, 0xCB };
+		u32	disp = kCmdTable_ScriptCommandsRVA + kCmdTable_ShortNameOffset;
+		memcpy(code + 4, &disp, 4);
+
+		TEST_CHECK(ctx, checkCmdTablePatchSite(code, fetch, kCmdTablePatchList_Start, &detail));
+
+		disp = kCmdTable_ScriptCommandsRVA - 8;
+		memcpy(code + 4, &disp, 4);
+
+		TEST_CHECK(ctx, !checkCmdTablePatchSite(code, fetch, kCmdTablePatchList_Start, &detail));
+
+		code[1] = 0x8D;
+		TEST_CHECK(ctx, !checkCmdTablePatchSite(code, fetch, kCmdTablePatchList_Start, &detail));
+
+		// and a type the verifier doesn't know
+		fetch.type = 100;
+		TEST_CHECK(ctx, !checkCmdTablePatchSite(code, fetch, kCmdTablePatchList_Start, &detail));
+	}
+}
+
+static void TestShortSection(TestContext & ctx)
+{
+	std::vector <CmdTablePatchResult>	results;
+
+	// the section ends before the sites in functions 4 and 6, the last four
+	{
+		GameImage	game;
+		game.build(0x06A00000 - kCodeRVA);
+
+		TEST_CHECK(ctx, Verify(game, &results) == 4);
+
+		bool	allMissing = true;
+		for(const CmdTablePatchResult & result : results)
+			if(!result.ok && (result.detail != "not in the image"))
+				allMissing = false;
+
+		TEST_CHECK(ctx, allMissing);
+	}
+
+	// the data on disk stops early, the rest reads as zeros like the loader would give, which aren't instructions
+	{
+		GameImage	game;
+		game.build(kCodeSize, 0x06A00000 - kCodeRVA);
+
+		TEST_CHECK(ctx, Verify(game, &results) == 4);
+	}
+
+	// a site whose 16 bytes run off the end of the section
+	{
+		const CmdTablePatch	* last = nullptr;
+
+		for(const CmdTablePatch * patch = kCmdTableStartPatches; patch->type != kPatchType_End; ++patch)
+			if(!last || (patch->ptr > last->ptr))
+				last = patch;
+
+		GameImage	game;
+		game.build(last->ptr + 8 - kCodeRVA);
+
+		TEST_CHECK(ctx, Verify(game, &results) >= 1);
+		TEST_CHECK(ctx, !results[last - kCmdTableStartPatches].ok);
+	}
+
+	// stopping at the first failure
+	{
+		GameImage	game;
+		game.build();
+
+		game.site(kCmdTableStartPatches[1].ptr)[1] = 0x8B;
+		game.site(kCmdTableStartPatches[2].ptr)[1] = 0x8B;
+
+		TEST_CHECK(ctx, Verify(game, &results, true) == 1);
+		TEST_CHECK(ctx, (results.size() == 2) && !results.back().ok);
+
+		TEST_CHECK(ctx, Verify(game, &results) == 2);
+		TEST_CHECK(ctx, results.size() == NumSites());
+	}
+}
+
+void TestCommandTablePatches(TestContext & ctx)
+{
+	TestGood(ctx);
+	TestWrongBytes(ctx);
+	TestOutOfRange(ctx);
+	TestShortSection(ctx);
+}
@@ -0,0 +1,90 @@
+#include "Tests.h"
+#include "obse64_common/FileStream.h"
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+static std::string ReadAll(const char * path)
+{
+	FileStream	file;
+	if(!file.open(path))
+		return "(missing)";
+
+	std::string	text(size_t(file.length()), 0);
+	file.read(&text[0], text.size());
+
+	return text;
+}
+
+static u32 NumFiles(const std::filesystem::path & dir)
+{
+	u32	count = 0;
+
+	for(const auto & entry : std::filesystem::directory_iterator(dir))
+		count++;
+
+	return count;
+}
+
+// threads replacing the same file at once, each with its own temporary file, and failures leaving nothing behind
+static void TestReplaceFile(TestContext & ctx)
+{
+	const u32	kNumThreads = 4;
+	const u32	kNumPerThread = 50;
+
+	std::filesystem::path	dir = "obse64_tools_replace";
+
+	std::filesystem::remove_all(dir);
+	std::filesystem::create_directory(dir);
+
+	std::string	path = (dir / "export.txt").string();
+
+	std::vector <std::string>	payloads;
+	for(u32 i = 0; i < kNumThreads; i++)
+		payloads.push_back(std::string(1000 + i * 4000, char('a' + i)));
+
+	std::vector <u32>	numFailed(kNumThreads, 0);
+	std::vector <std::thread>	threads;
+
+	for(u32 i = 0; i < kNumThreads; i++)
+	{
+		threads.emplace_back([&, i]()
+		{
+			for(u32 j = 0; j < kNumPerThread; j++)
+				if(!FileStream::replaceFile(path.c_str(), payloads[i].data(), payloads[i].size()))
+					numFailed[i]++;
+		});
+	}
+
+	for(std::thread & thread : threads)
+		thread.join();
+
+	std::string	result = ReadAll(path.c_str());
+	bool		whole = false;
+
+	for(const std::string & payload : payloads)
+		if(result == payload)
+			whole = true;
+
+	TEST_CHECK(ctx, numFailed == std::vector <u32>(kNumThreads, 0));
+	TEST_CHECK(ctx, whole);
+	TEST_CHECK(ctx, NumFiles(dir) == 1);
+
+	// the rename fails on to a directory, the temporary file next to it is removed
+	std::filesystem::create_directory(dir / "blocked");
+
+	TEST_CHECK(ctx, !FileStream::replaceFile((dir / "blocked").string().c_str(), "data", 4));
+	TEST_CHECK(ctx, NumFiles(dir) == 2);
+
+	// nowhere to put the temporary file
+	TEST_CHECK(ctx, !FileStream::replaceFile((dir / "missing" / "export.txt").string().c_str(), "data", 4));
+	TEST_CHECK(ctx, NumFiles(dir) == 2);
+
+	std::filesystem::remove_all(dir);
+}
+
+void TestFileStream(TestContext & ctx)
+{
+	TestReplaceFile(ctx);
+}
@@ -0,0 +1,240 @@
+#include "Tests.h"
+#include "obse64/FormatString.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+// stand-ins for the game's string variables and forms, %z and %n look their IDs up here
+const char * GetStringVarText(u32 id)
+{
+	return (id == 7) ? "string seven" : "";
+}
+
+const char * GetFormNameByID(u32 id)
+{
+	return (id == 0x14) ? "Player" : "<no name>";
+}
+
+static std::string Format(const char * fmt, std::vector <float> args, u32 bufLen = 512)
+{
+	std::vector <char>	buf(bufLen + 1, '\x7F');
+
+	u32	len = FormatScriptString(fmt, args.data(), u32(args.size()), buf.data(), bufLen);
+
+	// nothing written past the buffer, the length matches the terminator
+	if(buf[bufLen] != '\x7F')
+		return "(overrun)";
+
+	if(bufLen && (strlen(buf.data()) != len))
+		return "(bad length)";
+
+	return bufLen ? std::string(buf.data(), len) : std::string();
+}
+
+// the conversions against snprintf, with the argument converted the way the compiled format does it
+static void TestConversions(TestContext & ctx)
+{
+	struct Spec
+	{
+		const char	* fmt;
+		char		kind;	// i integer, u unsigned, f double
+	};
+
+	static const Spec	kSpecs[] =
+	{
+		{ "%d", 'i' }, { "%i", 'i' }, { "%+d", 'i' }, { "%-6d|", 'i' }, { "%05d", 'i' }, { "%.3d", 'i' },
+		{ "%u", 'u' }, { "%x", 'u' }, { "%X", 'u' }, { "%#x", 'u' }, { "%o", 'u' }, { "%8u", 'u' },
+		{ "%f", 'f' }, { "%.2f", 'f' }, { "%.0f", 'f' }, { "%10.3f", 'f' }, { "%-10.1f|", 'f' }, { "%+.1f", 'f' },
+		{ "%e", 'f' }, { "%.3e", 'f' }, { "%E", 'f' }, { "%g", 'f' }, { "%.10g", 'f' }, { "%G", 'f' }, { "%#g", 'f' },
+		{ "%F", 'f' }, { "%a", 'f' },
+	};
+
+	std::mt19937	rng(5);
+	std::vector <float>	values = { 0.0f, -0.0f, 1.0f, -1.0f, 0.5f, 1.5f, 2.5f, 99.99f, -123.456f, 1e10f, 1e-7f, 3e9f, -3e9f, 16777216.0f };
+
+	for(u32 i = 0; i < 200; i++)
+		values.push_back(float(s32(rng())) / float(1 << (rng() % 24)));
+
+	bool	allMatch = true;
+
+	for(const Spec & spec : kSpecs)
+	{
+		std::string	fmt = std::string("[") + spec.fmt + "]";
+
+		for(float value : values)
+		{
+			char	expected[512];
+
+			switch(spec.kind)
+			{
+				case 'i':	sprintf_s(expected, sizeof(expected), fmt.c_str(), s32(s64(value))); break;
+				case 'u':	sprintf_s(expected, sizeof(expected), fmt.c_str(), u32(s64(value))); break;
+				default:	sprintf_s(expected, sizeof(expected), fmt.c_str(), double(value)); break;
+			}
+
+			// out of range integers saturate before the cast, so only compare those that fit
+			if((spec.kind != 'f') && ((value >= 9.2e18f) || (value <= -9.2e18f)))
+				continue;
+
+			if(Format(fmt.c_str(), { value }) != expected)
+				allMatch = false;
+		}
+	}
+
+	TEST_CHECK(ctx, allMatch);
+
+	// %z and %n, with and without a width, and what printf would do with the rest
+	TEST_CHECK(ctx, Format("%z|%n", { 7, 0x14 }) == "string seven|Player");
+	TEST_CHECK(ctx, Format("[%8n][%-8n][%.3z]", { 0x14, 0x14, 7 }) == "[  Player][Player  ][str]");
+	TEST_CHECK(ctx, Format("%z%n", { 8, 0x15 }) == "<no name>");
+	TEST_CHECK(ctx, Format("100%% %s %p %*d %c", { 65 }) == "100% %s %p %*d A");
+	TEST_CHECK(ctx, Format("%ld %lld %hu %I64d", { 1, 2, 3, 4 }) == "1 2 3 4");
+	TEST_CHECK(ctx, Format("trailing %", { 1 }) == "trailing %");
+	TEST_CHECK(ctx, Format("", { }) == "");
+	TEST_CHECK(ctx, Format("nan %d %f", { NAN, 1.0f }) == "nan 0 1.000000");
+}
+
+static void TestArguments(TestContext & ctx)
+{
+	// missing arguments print as zero, extra ones are ignored
+	TEST_CHECK(ctx, Format("%d %d %d", { 1 }) == "1 0 0");
+	TEST_CHECK(ctx, Format("%d %.1f %z|", { }) == "0 0.0 |");
+	TEST_CHECK(ctx, Format("%d", { 1, 2, 3, 4, 5, 6, 7, 8, 9 }) == "1");
+
+	// the commands always pass 9, a tenth conversion reads nothing
+	TEST_CHECK(ctx, Format("%d%d%d%d%d%d%d%d%d %d", { 1, 2, 3, 4, 5, 6, 7, 8, 9 }) == "123456789 0");
+
+	// literals and escaped percents don't use up an argument
+	TEST_CHECK(ctx, Format("a%%b %d %% %d", { 1, 2 }) == "a%b 1 % 2");
+
+	// past 255 conversions the index saturates, still only reading inside the arguments
+	std::string	many;
+	for(u32 i = 0; i < 300; i++)
+		many += "%d";
+
+	std::string	result = Format(many.c_str(), { 1, 2, 3 }, 2000);
+	TEST_CHECK(ctx, result.substr(0, 5) == "12300");
+	TEST_CHECK(ctx, result.size() == 300);
+
+	// truncation, including in the middle of a conversion and with no room at all
+	TEST_CHECK(ctx, Format("hello %d world", { 12345 }, 9) == "hello 12");
+	TEST_CHECK(ctx, Format("%10.2f", { 1.5f }, 5) == "    ");
+	TEST_CHECK(ctx, Format("%z", { 7 }, 4) == "str");
+	TEST_CHECK(ctx, Format("abc", { }, 1) == "");
+	TEST_CHECK(ctx, Format("abc", { }, 0) == "");
+}
+
+static void TestCache(TestContext & ctx)
+{
+	// the same text is compiled once, wherever it's stored
+	std::string	a = "cached %d";
+	std::string	b = "cached %d";
+
+	const CompiledFormat	* first = &GetCompiledFormat(a.c_str());
+
+	TEST_CHECK(ctx, &GetCompiledFormat(b.c_str()) == first);
+	TEST_CHECK(ctx, first->Source() == a);
+
+	// fill it to the limit with formats built on the fly, nothing is dropped until one more arrives
+	size_t	startSize = GetCompiledFormatCacheSize();
+
+	for(u32 i = u32(startSize); i < 1024; i++)
+		GetCompiledFormat(("dynamic " + std::to_string(i) + " %d").c_str());
+
+	TEST_CHECK(ctx, GetCompiledFormatCacheSize() == 1024);
+	TEST_CHECK(ctx, &GetCompiledFormat(a.c_str()) == first);
+
+	GetCompiledFormat("one more %d");
+
+	TEST_CHECK(ctx, GetCompiledFormatCacheSize() == 1);
+
+	// formats still work after the cache was emptied, and are cached again
+	float	args[] = { 42 };
+	char	buf[64];
+
+	FormatScriptString(a.c_str(), args, 1, buf, sizeof(buf));
+
+	TEST_CHECK(ctx, !strcmp(buf, "cached 42"));
+	TEST_CHECK(ctx, GetCompiledFormatCacheSize() == 2);
+}
+
+void TestFormatString(TestContext & ctx)
+{
+	TestConversions(ctx);
+	TestArguments(ctx);
+	TestCache(ctx);
+}
+
+// PrintC and PrintToConsole formats, each formatted with the 9 float arguments the commands pass: sprintf_s as
+// Console_Print did it, compiling the format every call, and through the cache
+void BenchFormatString()
+{
+	const u32	kNumCalls = 1000000;
+
+	struct Case
+	{
+		const char	* fmt;
+		bool		ints;	// sprintf_s gets the arguments as ints
+	};
+
+	static const Case	kCases[] =
+	{
+		{ "health %.2f of %.0f (%g%%)",			false },
+		{ "quest stage %d, flags %X, count %d",	true },
+		{ "pos %.1f %.1f %.1f rot %.1f",		false },
+		{ "just text, no conversions at all",	false },
+	};
+
+	const float	args[9] = { 123.456f, 250.0f, 49.3824f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f };
+
+	char	buf[512];
+	u32		sink = 0;
+
+	for(const Case & test : kCases)
+	{
+		const char	* fmt = test.fmt;
+
+		BenchTimer	timer;
+
+		for(u32 i = 0; i < kNumCalls; i++)
+		{
+			if(test.ints)
+				sprintf_s(buf, sizeof(buf), fmt, s32(args[0]), s32(args[1]), s32(args[2]));
+			else
+				sprintf_s(buf, sizeof(buf), fmt, double(args[0]), double(args[1]), double(args[2]), double(args[3]),
+					double(args[4]), double(args[5]), double(args[6]), double(args[7]), double(args[8]));
+
+			sink += u8(buf[3]);
+		}
+
+		double	sprintfTime = timer.elapsedMS();
+
+		timer.restart();
+
+		for(u32 i = 0; i < kNumCalls; i++)
+		{
+			CompiledFormat	compiled(fmt);
+
+			compiled.Format(buf, sizeof(buf), args, 9);
+			sink += u8(buf[3]);
+		}
+
+		double	uncached = timer.elapsedMS();
+
+		timer.restart();
+
+		for(u32 i = 0; i < kNumCalls; i++)
+		{
+			FormatScriptString(fmt, args, 9, buf, sizeof(buf));
+			sink += u8(buf[3]);
+		}
+
+		double	cached = timer.elapsedMS();
+
+		printf("\t%-36s sprintf_s %4.0f ns, uncached %4.0f ns, cached %4.0f ns per call%s\n", fmt,
+			sprintfTime * 1e6 / kNumCalls, uncached * 1e6 / kNumCalls, cached * 1e6 / kNumCalls, sink ? "" : " ");
+	}
+}
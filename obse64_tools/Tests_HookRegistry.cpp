@@ -0,0 +1,129 @@
+#include "Tests.h"
+#include "obse64/HookRegistry.h"
+#include "obse64_common/BranchTrampoline.h"
+#include "xbyak/xbyak.h"
+#include <cstdio>
+
+// the thunks follow the Windows calling convention
+#ifdef _MSC_VER
+#define HOOK_ABI
+#else
+#define HOOK_ABI __attribute__((ms_abi))
+#endif
+
+typedef u64 (HOOK_ABI * CallerFn)(u64 a, u64 b);
+
+static u32	s_numHandlerCalls;
+
+static HOOK_ABI u64 Original(u64 a, u64 b)
+{
+	return a + b;
+}
+
+static HOOK_ABI void Handler(u64 a, u64 b)
+{
+	s_numHandlerCalls++;
+}
+
+// stands in for a game function calling another, the call is the hook site. the original is reached through a
+// jump next to it, since a rel32 call can't reach this executable from wherever the buffer was allocated
+static CallerFn EmitCaller(Xbyak::CodeGenerator & code, uintptr_t * site)
+{
+	using namespace Xbyak::util;
+
+	Xbyak::Label	original;
+
+	code.align(16);
+
+	CallerFn	caller = (CallerFn)code.getCurr();
+
+	code.sub(rsp, 0x28);
+
+	*site = uintptr_t(code.getCurr());
+	code.call(original);
+
+	code.add(rsp, 0x28);
+	code.ret();
+
+	code.L(original);
+	code.jmp(ptr[rip]);
+	code.dq(uintptr_t(&Original));
+
+	return caller;
+}
+
+// a call with no hooks at all, a site taken over with none added, then pre and post handlers around it, from
+// one to eight, and eight all disabled
+void BenchHookRegistry()
+{
+	const u32	kNumCalls = 20000000;
+	const u32	kCallerSpace = 0x1000;
+	const u32	kTrampolineLen = 0x10000;
+
+	struct Case
+	{
+		const char	* name;
+		u32			numPre;
+		u32			numPost;
+		bool		enabled;
+	};
+
+	static const Case	kCases[] =
+	{
+		{ "direct call",				0, 0, true },
+		{ "claimed, no hooks",			0, 0, true },
+		{ "1 pre hook",					1, 0, true },
+		{ "1 post hook",				0, 1, true },
+		{ "4 pre, 4 post hooks",		4, 4, true },
+		{ "4 pre, 4 post, disabled",	4, 4, false },
+	};
+
+	// the callers and the trampoline share one buffer so the sites are in range of it
+	Xbyak::CodeGenerator	code(kCallerSpace + kTrampolineLen);
+
+	g_branchTrampoline.setBase(kTrampolineLen, (void *)(code.getCode() + kCallerSpace));
+
+	HookRegistry	registry;
+	double			directTime = 0;
+
+	for(const Case & test : kCases)
+	{
+		uintptr_t	site;
+		CallerFn	caller = EmitCaller(code, &site);
+
+		// add claims it too, claiming again does nothing
+		if(&test != &kCases[0])
+			registry.claim(site);
+
+		for(u32 i = 0; i < test.numPre + test.numPost; i++)
+		{
+			u32	type = (i < test.numPre) ? HookRegistry::kType_Pre : HookRegistry::kType_Post;
+			u32	id = registry.add(1, site, type, 0, uintptr_t(&Handler));
+
+			if(!test.enabled)
+				registry.setEnabled(1, id, false);
+		}
+
+		s_numHandlerCalls = 0;
+
+		u64			sum = 0;
+		BenchTimer	timer;
+
+		for(u32 i = 0; i < kNumCalls; i++)
+			sum += caller(i, 1);
+
+		double	elapsed = timer.elapsedMS();
+
+		if(&test == &kCases[0])
+			directTime = elapsed;
+
+		u64		expectedSum = u64(kNumCalls) * (kNumCalls + 1) / 2;
+		u32		expectedCalls = test.enabled ? (test.numPre + test.numPost) * kNumCalls : 0;
+		bool	correct = (sum == expectedSum) && (s_numHandlerCalls == expectedCalls);
+
+		printf("\t%-24s %5.2f ns per call, %+5.2f ns over the direct call%s\n", test.name, elapsed * 1e6 / kNumCalls,
+			(elapsed - directTime) * 1e6 / kNumCalls, correct ? "" : " (WRONG result or handler count)");
+	}
+
+	g_branchTrampoline.destroy();
+}
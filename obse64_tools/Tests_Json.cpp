@@ -0,0 +1,350 @@
+#include "Tests.h"
+#include "obse64_common/Json.h"
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+
+// flattens the handler calls in to one string, so two parses can be compared and expected results written inline
+class RecordingHandler : public JsonHandler
+{
+public:
+	virtual bool	onNull()						{ events += "null "; return true; }
+	virtual bool	onBool(bool value)				{ events += value ? "true " : "false "; return true; }
+	virtual bool	onNumber(const char * text, size_t len, double value)	{ events += "n:"; events.append(text, len); events += " "; lastNumber = value; return true; }
+	virtual bool	onString(const char * str, size_t len)	{ events += "s:"; events.append(str, len); events += " "; return true; }
+	virtual bool	onKey(const char * str, size_t len)		{ events += "k:"; events.append(str, len); events += " "; return true; }
+	virtual bool	onBeginObject()					{ events += "{ "; return true; }
+	virtual bool	onEndObject()					{ events += "} "; return true; }
+	virtual bool	onBeginArray()					{ events += "[ "; return true; }
+	virtual bool	onEndArray()					{ events += "] "; return true; }
+
+	std::string	events;
+	double		lastNumber = 0;
+};
+
+// doesn't record anything, for the benchmark
+class CountingHandler : public JsonHandler
+{
+public:
+	virtual bool	onNull()						{ numValues++; return true; }
+	virtual bool	onBool(bool value)				{ numValues++; return true; }
+	virtual bool	onNumber(const char * text, size_t len, double value)	{ numValues++; return true; }
+	virtual bool	onString(const char * str, size_t len)	{ numValues++; numBytes += len; return true; }
+	virtual bool	onKey(const char * str, size_t len)		{ numBytes += len; return true; }
+	virtual bool	onBeginObject()					{ return true; }
+	virtual bool	onEndObject()					{ numValues++; return true; }
+	virtual bool	onBeginArray()					{ return true; }
+	virtual bool	onEndArray()					{ numValues++; return true; }
+
+	u64		numValues = 0;
+	u64		numBytes = 0;
+};
+
+struct ParseResult
+{
+	bool		ok;
+	std::string	events;
+	std::string	error;
+	size_t		errorOffset;
+};
+
+static ParseResult Parse(const std::string & text, bool simd)
+{
+	JsonReader			reader;
+	RecordingHandler	handler;
+
+	reader.setSimd(simd);
+
+	// a heap copy of exactly the right size, so ASan sees any read past the end
+	char	* copy = new char[text.size() ? text.size() : 1];
+	memcpy(copy, text.data(), text.size());
+
+	ParseResult	result;
+
+	result.ok = reader.parse(copy, text.size(), &handler);
+	result.events = handler.events;
+	result.error = result.ok ? "" : reader.errorMessage();
+	result.errorOffset = result.ok ? 0 : reader.errorOffset();
+
+	delete [] copy;
+
+	return result;
+}
+
+// both paths agree on everything, including where an error was found
+static bool ParseBoth(const std::string & text, ParseResult * out)
+{
+	ParseResult	simd = Parse(text, true);
+	ParseResult	scalar = Parse(text, false);
+
+	*out = simd;
+
+	return (simd.ok == scalar.ok) && (simd.events == scalar.events) && (simd.error == scalar.error) && (simd.errorOffset == scalar.errorOffset);
+}
+
+static bool ParsesTo(const std::string & text, const std::string & events)
+{
+	ParseResult	result;
+
+	return ParseBoth(text, &result) && result.ok && (result.events == events);
+}
+
+static bool FailsWith(const std::string & text, const char * error)
+{
+	ParseResult	result;
+
+	return ParseBoth(text, &result) && !result.ok && (result.error == error);
+}
+
+static void TestEscapes(TestContext & ctx)
+{
+	TEST_CHECK(ctx, ParsesTo("\"\\\"\\\\\\/\\b\\f\\n\\r\\t\"", "s:\"\\/\b\f\n\r\t "));
+	TEST_CHECK(ctx, ParsesTo("{\"a\\nb\":\"c\\td\"}", "{ k:a\nb s:c\td } "));
+	TEST_CHECK(ctx, ParsesTo("\"\"", "s: "));
+
+	// \u in one, two and three byte UTF-8, and surrogate pairs in four
+	TEST_CHECK(ctx, ParsesTo("\"\\u0041\\u00e9\\u20AC\"", "s:A\xC3\xA9\xE2\x82\xAC "));
+	TEST_CHECK(ctx, ParsesTo("\"\\uD83D\\uDE00\"", "s:\xF0\x9F\x98\x80 "));
+	TEST_CHECK(ctx, ParsesTo("\"\\uDBFF\\uDFFF\"", "s:\xF4\x8F\xBF\xBF "));
+	TEST_CHECK(ctx, ParsesTo("\"x\\uD800\\uDC00y\"", "s:x\xF0\x90\x80\x80y "));
+
+	TEST_CHECK(ctx, FailsWith("\"\\uD83D\"", "unpaired surrogate"));
+	TEST_CHECK(ctx, FailsWith("\"\\uD83Dx\"", "unpaired surrogate"));
+	TEST_CHECK(ctx, FailsWith("\"\\uD83D\\u0041\"", "unpaired surrogate"));
+	TEST_CHECK(ctx, FailsWith("\"\\uDE00\"", "unpaired surrogate"));
+	TEST_CHECK(ctx, FailsWith("\"\\u12G4\"", "invalid unicode escape"));
+	TEST_CHECK(ctx, FailsWith("\"\\u12\"", "invalid unicode escape"));
+	TEST_CHECK(ctx, FailsWith("\"\\x\"", "invalid escape"));
+	TEST_CHECK(ctx, FailsWith("\"a\nb\"", "control character in string"));
+	TEST_CHECK(ctx, FailsWith("\"abc", "unterminated string"));
+
+	// UTF-8 passes through untouched
+	TEST_CHECK(ctx, ParsesTo("\"\xE6\x97\xA5\xE6\x9C\xAC\"", "s:\xE6\x97\xA5\xE6\x9C\xAC "));
+}
+
+// the SSE2 loops take 16 bytes at a time, so put every kind of character that ends a run at every
+// offset around the first two boundaries, after every length of leading whitespace
+static void TestBoundaries(TestContext & ctx)
+{
+	bool	allMatch = true;
+
+	for(u32 lead = 0; lead < 20; lead++)
+	{
+		for(u32 len = 0; len < 40; len++)
+		{
+			std::string	body;
+			for(u32 i = 0; i < len; i++)
+				body += char('a' + (i % 26));
+
+			std::string	prefix = std::string(lead, (lead & 1) ? ' ' : '\n');
+
+			// a plain string ending at each offset, its closing quote is the special character
+			if(!ParsesTo(prefix + "\"" + body + "\"", "s:" + body + " "))
+				allMatch = false;
+
+			// an escape, a control character and a missing quote at each offset
+			if(!ParsesTo(prefix + "\"" + body + "\\n" + body + "\"", "s:" + body + "\n" + body + " "))
+				allMatch = false;
+
+			if(!FailsWith(prefix + "\"" + body + "\x01" + "\"", "control character in string"))
+				allMatch = false;
+
+			if(!FailsWith(prefix + "\"" + body, "unterminated string"))
+				allMatch = false;
+
+			// bytes over 0x7F are signed in an epi8 compare, they mustn't look like control characters
+			if(!ParsesTo(prefix + "\"" + body + "\xC3\xA9\"", "s:" + body + "\xC3\xA9 "))
+				allMatch = false;
+
+			// whitespace runs of every length between values, with each kind ending the run
+			std::string	ws;
+			for(u32 i = 0; i < len; i++)
+				ws += " \t\r\n"[i % 4];
+
+			if(!ParsesTo(prefix + "[1," + ws + "2" + ws + "]" + ws, "[ n:1 n:2 ] "))
+				allMatch = false;
+		}
+	}
+
+	TEST_CHECK(ctx, allMatch);
+}
+
+static const char	kDocument[] =
+	"{\n"
+	"\t\"name\": \"Oblivion \\\"Remastered\\\"\",\n"
+	"\t\"version\": [1, 2.5, -3e2, 0],\n"
+	"\t\"flags\": {\"a\": true, \"b\": false, \"c\": null},\n"
+	"\t\"path\": \"C:\\\\Games\\\\Oblivion\\\\Data\\\\OBSE\\\\Plugins\\\\long_enough_to_take_two_blocks.dll\",\n"
+	"\t\"unicode\": \"\\u00e9\\uD83D\\uDE00\",\n"
+	"\t\"empty\": [{}, [], \"\"]\n"
+	"}\n";
+
+static void TestTruncated(TestContext & ctx)
+{
+	std::string	document(kDocument);
+
+	ParseResult	full;
+	TEST_CHECK(ctx, ParseBoth(document, &full) && full.ok);
+	TEST_CHECK(ctx, full.events ==
+		"{ k:name s:Oblivion \"Remastered\" k:version [ n:1 n:2.5 n:-3e2 n:0 ] k:flags { k:a true k:b false k:c null } "
+		"k:path s:C:\\Games\\Oblivion\\Data\\OBSE\\Plugins\\long_enough_to_take_two_blocks.dll k:unicode s:\xC3\xA9\xF0\x9F\x98\x80 "
+		"k:empty [ { } [ ] s: ] } ");
+
+	// every prefix fails cleanly, at or before the end, and both paths agree on where. the last prefix
+	// is everything but the trailing newline, which is still a whole document
+	bool	allFail = true;
+
+	for(size_t len = 0; len < document.size() - 1; len++)
+	{
+		ParseResult	result;
+
+		if(!ParseBoth(document.substr(0, len), &result) || result.ok || (result.errorOffset > len))
+			allFail = false;
+	}
+
+	TEST_CHECK(ctx, allFail);
+	TEST_CHECK(ctx, ParsesTo(document.substr(0, document.size() - 1), full.events));
+
+	TEST_CHECK(ctx, FailsWith("", "unexpected end of input"));
+	TEST_CHECK(ctx, FailsWith("[1, 2", "unexpected end of input"));
+	TEST_CHECK(ctx, FailsWith("[1] 2", "unexpected data after the end of the document"));
+
+	// line and column of an error are 1-based
+	{
+		JsonReader			reader;
+		RecordingHandler	handler;
+
+		const char	text[] = "{\n  \"a\": tru\n}";
+
+		TEST_CHECK(ctx, !reader.parse(text, sizeof(text) - 1, &handler));
+		TEST_CHECK(ctx, (reader.errorLine() == 2) && (reader.errorColumn() == 8));
+	}
+}
+
+static void TestDepth(TestContext & ctx)
+{
+	std::string	deepest = std::string(JsonReader::kMaxDepth, '[') + std::string(JsonReader::kMaxDepth, ']');
+	std::string	tooDeep = std::string(JsonReader::kMaxDepth + 1, '[') + std::string(JsonReader::kMaxDepth + 1, ']');
+
+	ParseResult	result;
+
+	TEST_CHECK(ctx, ParseBoth(deepest, &result) && result.ok);
+	TEST_CHECK(ctx, FailsWith(tooDeep, "nesting too deep"));
+
+	// objects count too, and mismatched closers are caught at any depth
+	std::string	objects;
+	for(u32 i = 0; i < JsonReader::kMaxDepth; i++)
+		objects += "{\"k\":";
+
+	TEST_CHECK(ctx, FailsWith(objects + "[]", "nesting too deep"));
+	TEST_CHECK(ctx, !Parse("[[[}]]", true).ok);
+	TEST_CHECK(ctx, !Parse("{\"a\":[}", true).ok);
+}
+
+// what the writer escapes the reader reads back, every byte value included
+static void TestWriter(TestContext & ctx)
+{
+	std::string	allBytes;
+	for(u32 i = 1; i < 0x80; i++)
+		allBytes += char(i);
+
+	allBytes += "\xC3\xA9";
+
+	std::string	out;
+
+	{
+		JsonWriter	writer(&out, true);
+
+		writer.beginObject();
+		writer.key(allBytes);
+		writer.string(allBytes);
+		writer.key("list");
+		writer.beginArray();
+		writer.number(1.5);
+		writer.boolean(true);
+		writer.null();
+		writer.numberText("12345678901234567890", 20);
+		writer.endArray();
+		writer.endObject();
+	}
+
+	TEST_CHECK(ctx, ParsesTo(out, "{ k:" + allBytes + " s:" + allBytes + " k:list [ n:1.5 true null n:12345678901234567890 ] } "));
+}
+
+void TestJson(TestContext & ctx)
+{
+	TestEscapes(ctx);
+	TestBoundaries(ctx);
+	TestTruncated(ctx);
+	TestDepth(ctx);
+	TestWriter(ctx);
+}
+
+// a 10MB pretty printed document shaped like a plugin's saved data, records of short keys, numbers and
+// strings of mixed length with the odd escape, parsed with the SSE2 loops and a byte at a time
+void BenchJson()
+{
+	const size_t	kLen = 10 * 1024 * 1024;
+	const u32		kNumRuns = 10;
+
+	std::mt19937	rng(1);
+	std::string		document;
+
+	{
+		JsonWriter	writer(&document, true);
+
+		writer.beginArray();
+
+		for(u32 i = 0; document.size() < kLen; i++)
+		{
+			std::string	text;
+			u32			textLen = rng() % 200;
+
+			for(u32 j = 0; j < textLen; j++)
+				text += (rng() % 50) ? char('a' + rng() % 26) : "\"\\\n"[rng() % 3];
+
+			writer.beginObject();
+			writer.key("id");
+			writer.number(i);
+			writer.key("formID");
+			writer.number(double(rng()));
+			writer.key("name");
+			writer.string("Record " + std::to_string(i));
+			writer.key("text");
+			writer.string(text);
+			writer.key("position");
+			writer.beginArray();
+			writer.number((rng() % 100000) / 8.0);
+			writer.number((rng() % 100000) / 8.0);
+			writer.number((rng() % 100000) / 8.0);
+			writer.endArray();
+			writer.key("enabled");
+			writer.boolean(i & 1);
+			writer.endObject();
+		}
+
+		writer.endArray();
+	}
+
+	for(u32 simd = 0; simd < 2; simd++)
+	{
+		JsonReader		reader;
+		CountingHandler	handler;
+
+		reader.setSimd(simd != 0);
+
+		BenchTimer	timer;
+		bool		ok = true;
+
+		for(u32 run = 0; run < kNumRuns; run++)
+			ok = reader.parse(document.data(), document.size(), &handler) && ok;
+
+		double	elapsed = timer.elapsedMS();
+		double	mb = double(document.size()) * kNumRuns / (1024 * 1024);
+
+		printf("\t%-6s %.1f MB in %.3f ms per parse, %.0f MB/s, %llu values%s\n", simd ? "SSE2" : "scalar",
+			double(document.size()) / (1024 * 1024), elapsed / kNumRuns, mb * 1000 / elapsed,
+			(unsigned long long)(handler.numValues / kNumRuns), ok ? "" : " (parse FAILED)");
+	}
+}
@@ -0,0 +1,342 @@
+#include "Tests.h"
+#include "obse64_common/Log.h"
+#include "obse64_common/LogRing.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// what a drain wrote, appended to by whoever holds the drain lock
+struct DrainOutput
+{
+	std::string	file;
+	std::string	console;
+	u32			numDrains = 0;
+
+	void	operator()(const std::string & fileBatch, const std::string & consoleBatch, const std::string & binaryBatch)
+	{
+		file += fileBatch;
+		console += consoleBatch;
+		numDrains++;
+	}
+};
+
+static bool Drain(LogRing & ring, LogRing::DrainMode mode, DrainOutput & output)
+{
+	return ring.drain(mode, [&output](const std::string & file, const std::string & console, const std::string & binary)
+	{
+		output(file, console, binary);
+	});
+}
+
+// "producer seq len payload\n", the payload derived from the rest so a torn or mixed up record can't check out
+static u32 PayloadLen(u32 producer, u32 seq)
+{
+	// mostly one or two slots, now and then one near the limit
+	if(!(seq % 997))
+		return LogRing::kMaxMessageLen - 64;
+
+	return (seq * 37 + producer * 11) % 600;
+}
+
+static std::string MakeRecord(u32 producer, u32 seq)
+{
+	char	header[64];
+	u32		len = PayloadLen(producer, seq);
+
+	sprintf_s(header, sizeof(header), "%u %u %u ", producer, seq, len);
+
+	std::string	record(header);
+
+	for(u32 i = 0; i < len; i++)
+		record += char('a' + (producer + seq + i) % 26);
+
+	record += '\n';
+
+	return record;
+}
+
+// every record whole, each producer's in order with none missing. console records are every third one
+static bool CheckRecords(const std::string & text, u32 numProducers, u32 numPerProducer, u32 step)
+{
+	std::vector <u32>	next(numProducers, 0);
+
+	size_t	pos = 0;
+
+	while(pos < text.size())
+	{
+		size_t	end = text.find('\n', pos);
+		if(end == std::string::npos)
+			return false;
+
+		// not sscanf, which takes the length of the whole rest of the text every time
+		char	* field = nullptr;
+
+		u32	producer = strtoul(&text[pos], &field, 10);
+		u32	seq = strtoul(field, &field, 10);
+
+		if((*field != ' ') || (producer >= numProducers))
+			return false;
+
+		if((seq != next[producer]) || (text.compare(pos, end + 1 - pos, MakeRecord(producer, seq)) != 0))
+			return false;
+
+		next[producer] += step;
+		pos = end + 1;
+	}
+
+	for(u32 count : next)
+		if(count < numPerProducer)
+			return false;
+
+	return true;
+}
+
+// producers on every core pushing records of all sizes, a consumer thread draining like DebugLog's, and
+// producers draining too when the ring fills up
+static void TestProducers(TestContext & ctx, bool consumerThread)
+{
+	const u32	kNumProducers = 8;
+	const u32	kNumPerProducer = consumerThread ? 20000 : 5000;
+
+	std::unique_ptr <LogRing>	ring(new LogRing);
+	DrainOutput			output;
+	std::atomic <bool>	done { false };
+
+	std::thread	consumer;
+
+	if(consumerThread)
+	{
+		consumer = std::thread([&]()
+		{
+			while(!done.load())
+			{
+				Drain(*ring, LogRing::kDrain_Wait, output);
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		});
+	}
+
+	std::vector <std::thread>	producers;
+
+	for(u32 producer = 0; producer < kNumProducers; producer++)
+	{
+		producers.emplace_back([&, producer]()
+		{
+			for(u32 seq = 0; seq < kNumPerProducer; seq++)
+			{
+				std::string	record = MakeRecord(producer, seq);
+				u8			flags = LogRing::kFlag_File | ((seq % 3) ? 0 : LogRing::kFlag_Console);
+
+				ring->push(record.data(), u32(record.size()), flags, [&]() { return Drain(*ring, LogRing::kDrain_Try, output); });
+			}
+		});
+	}
+
+	for(std::thread & producer : producers)
+		producer.join();
+
+	done.store(true);
+
+	if(consumer.joinable())
+		consumer.join();
+
+	Drain(*ring, LogRing::kDrain_Wait, output);
+
+	TEST_CHECK(ctx, ring->backlog() == 0);
+	TEST_CHECK(ctx, CheckRecords(output.file, kNumProducers, kNumPerProducer, 1));
+	TEST_CHECK(ctx, CheckRecords(output.console, kNumProducers, kNumPerProducer, 3));
+	TEST_CHECK(ctx, output.numDrains > 1);
+}
+
+static void TestDrainModes(TestContext & ctx)
+{
+	std::unique_ptr <LogRing>	ring(new LogRing);
+	DrainOutput	output;
+
+	// flags pick the batches, an empty drain still succeeds
+	ring->push("file\n", 5, LogRing::kFlag_File, []() { return false; });
+	ring->push("both\n", 5, LogRing::kFlag_File | LogRing::kFlag_Console, []() { return false; });
+	ring->push("binary", 6, LogRing::kFlag_Binary, []() { return false; });
+
+	std::string	binary;
+
+	TEST_CHECK(ctx, ring->backlog() == 3);
+	TEST_CHECK(ctx, ring->drain(LogRing::kDrain_Try, [&](const std::string & file, const std::string & console, const std::string & bin)
+	{
+		output(file, console, bin);
+		binary = bin;
+	}));
+
+	TEST_CHECK(ctx, (output.file == "file\nboth\n") && (output.console == "both\n") && (binary == "binary"));
+	TEST_CHECK(ctx, Drain(*ring, LogRing::kDrain_Wait, output) && (output.numDrains == 2));
+
+	// while one thread drains, a try gives up, a wait blocks until it's done, and an exit drain goes ahead after the timeout
+	std::atomic <bool>	holding { false };
+	std::atomic <bool>	release { false };
+
+	std::thread	holder([&]()
+	{
+		ring->drain(LogRing::kDrain_Wait, [&](const std::string &, const std::string &, const std::string &)
+		{
+			holding.store(true);
+
+			while(!release.load())
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		});
+	});
+
+	while(!holding.load())
+		std::this_thread::yield();
+
+	ring->push("late\n", 5, LogRing::kFlag_File, []() { return false; });
+
+	TEST_CHECK(ctx, !Drain(*ring, LogRing::kDrain_Try, output));
+
+	BenchTimer	timer;
+
+	TEST_CHECK(ctx, Drain(*ring, LogRing::kDrain_Exit, output));
+	TEST_CHECK(ctx, timer.elapsedMS() >= LogRing::kForceDrainTimeoutMS * 0.9);
+	TEST_CHECK(ctx, output.file == "file\nboth\nlate\n");
+
+	std::atomic <bool>	waited { false };
+
+	std::thread	waiter([&]()
+	{
+		Drain(*ring, LogRing::kDrain_Wait, output);
+		waited.store(true);
+	});
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	TEST_CHECK(ctx, !waited.load());
+
+	release.store(true);
+
+	holder.join();
+	waiter.join();
+
+	TEST_CHECK(ctx, waited.load());
+}
+
+void TestLogRing(TestContext & ctx)
+{
+	TestDrainModes(ctx);
+	TestProducers(ctx, true);
+
+	// nothing draining in the background, producers have to empty the ring themselves
+	TestProducers(ctx, false);
+}
+
+// 1 to 8 threads logging 100 byte messages, written out by a consumer thread that wakes every 10ms or when
+// the ring is a quarter full, like DebugLog's
+void BenchLogRing()
+{
+	const u32	kNumPerThread = 200000;
+	const u32	kThreadCounts[] = { 1, 2, 4, 8 };
+
+	std::string	message(99, 'x');
+	message += '\n';
+
+	for(u32 numThreads : kThreadCounts)
+	{
+		std::unique_ptr <LogRing>	ring(new LogRing);
+		std::atomic <bool>	done { false };
+		std::atomic <u64>	written { 0 };
+
+		auto	write = [&](const std::string & file, const std::string &, const std::string &) { written += file.size(); };
+
+		std::thread	consumer([&]()
+		{
+			while(!done.load())
+			{
+				ring->drain(LogRing::kDrain_Wait, write);
+
+				for(u32 i = 0; (i < 100) && !done.load() && (ring->backlog() < LogRing::kNumSlots / 4); i++)
+					std::this_thread::sleep_for(std::chrono::microseconds(100));
+			}
+		});
+
+		BenchTimer	timer;
+
+		std::vector <std::thread>	producers;
+
+		for(u32 i = 0; i < numThreads; i++)
+		{
+			producers.emplace_back([&]()
+			{
+				for(u32 j = 0; j < kNumPerThread; j++)
+					ring->push(message.data(), u32(message.size()), LogRing::kFlag_File, [&]() { return ring->drain(LogRing::kDrain_Try, write); });
+			});
+		}
+
+		for(std::thread & producer : producers)
+			producer.join();
+
+		double	pushTime = timer.elapsedMS();
+
+		done.store(true);
+		consumer.join();
+
+		ring->drain(LogRing::kDrain_Wait, write);
+
+		double	total = double(kNumPerThread) * numThreads;
+
+		printf("\t%u thread%s: %.0f ns per message per thread, %.1f M messages/s%s\n", numThreads, (numThreads > 1) ? "s" : " ",
+			pushTime * 1e6 * numThreads / total, total / (pushTime * 1000), (written.load() == total * message.size()) ? "" : " (messages LOST)");
+	}
+}
+
+static u32	s_numArgsEvaluated;
+
+static int CountedArg(int i)
+{
+	s_numArgsEvaluated++;
+	return i;
+}
+
+// what a debug message costs in a release build when its channel is set to a lower level: the macro's level
+// check, against calling in to DebugLog to find out, and against not logging at all. the arguments mustn't be evaluated
+void BenchLogFiltered()
+{
+	const u32	kNumCalls = 100000000;
+
+	bool	filtered = !DebugLog::isEnabled(DebugLog::kChannel_Script, DebugLog::kLevel_DebugMessage);
+
+	volatile u32	sink = 0;
+	BenchTimer		timer;
+
+	for(u32 i = 0; i < kNumCalls; i++)
+		sink = i;
+
+	double	baseline = timer.elapsedMS();
+
+	s_numArgsEvaluated = 0;
+	timer.restart();
+
+	for(u32 i = 0; i < kNumCalls; i++)
+	{
+		sink = i;
+		_DMESSAGE_C(Script, "value %d", CountedArg(i));
+	}
+
+	double	macro = timer.elapsedMS();
+	u32		macroArgs = s_numArgsEvaluated;
+
+	timer.restart();
+
+	for(u32 i = 0; i < kNumCalls / 10; i++)
+	{
+		sink = i;
+		DebugLog::message(DebugLog::kChannel_Script, DebugLog::kLevel_DebugMessage, "value %d", i);
+	}
+
+	double	call = timer.elapsedMS() * 10;
+
+	printf("\tfiltered LOG_CHANNEL: %.2f ns per message over the loop's %.2f ns, %u arguments evaluated%s\n",
+		(macro - baseline) * 1e6 / kNumCalls, baseline * 1e6 / kNumCalls, macroArgs, filtered ? "" : " (channel NOT filtered)");
+	printf("\tDebugLog::message filtering it instead: %.2f ns per message\n", (call - baseline) * 1e6 / kNumCalls);
+}
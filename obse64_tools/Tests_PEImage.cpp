@@ -0,0 +1,433 @@
+#include "Tests.h"
+#include "obse64_common/PEImage.h"
+#include <cstring>
+#include <string>
+#include <vector>
+
+// fixtures are built here rather than checked in, so each test says exactly what's in its file
+//
+// headers in the first 0x200 bytes, then an export section (RVA 0x1000) and a code section (RVA 0x2000) whose
+// virtual size is bigger than its data on disk. the exports point at version data or a stub in the export section
+
+enum
+{
+	kFileAlign = 0x200,
+
+	kExportRVA = 0x1000,
+	kExportFileOffset = 0x200,
+	kExportDirectorySize = 0x100,	// the directory, its arrays and names
+
+	kVersionOffset = 0x100,	// in the export section
+	kStubOffset = 0x180,
+	kForwarderOffset = 0xC0,	// inside the directory
+
+	kCodeRVA = 0x2000,
+	kCodeFileOffset = 0x400,
+	kCodeVirtualSize = 0x300,
+	kCodeRawSize = 0x200,
+
+	kFixtureSize = kCodeFileOffset + kCodeRawSize,
+};
+
+static const u8		kVersionData[] = { 1, 0, 0, 0, 0x34, 0x12, 0, 0, 't', 'e', 's', 't' };
+static const char	kForwarder[] = "other.OBSEPlugin_Load";
+
+struct FixtureExport
+{
+	const char	* name;
+	u32			rva;
+};
+
+struct Fixture
+{
+	bool	plus = true;	// PE32+
+	u16		machine = PEImage::kMachine_AMD64;
+	bool	exportDirectory = true;
+
+	std::vector <FixtureExport>	exports;
+
+	u16		badOrdinal = 0;	// replaces the first ordinal if set
+	u32		exportRawSize = 0x200;	// less cuts the section's data on disk short
+};
+
+template <typename T>
+static void Put(std::vector <u8> & dst, size_t offset, T value)
+{
+	memcpy(&dst[offset], &value, sizeof(value));
+}
+
+static std::vector <u8> BuildImage(const Fixture & fixture)
+{
+	std::vector <u8>	file(kFixtureSize, 0);
+
+	const u32	ntOffset = 0x40;
+	const u16	optionalSize = fixture.plus ? 240 : 224;
+	const u32	numDirectoriesOffset = fixture.plus ? 108 : 92;
+	const u32	optionalOffset = ntOffset + 4 + 20;
+
+	file[0] = 'M';
+	file[1] = 'Z';
+	Put <u32>(file, 0x3C, ntOffset);
+
+	memcpy(&file[ntOffset], "PE\0\0", 4);
+
+	// file header
+	Put <u16>(file, ntOffset + 4, fixture.machine);
+	Put <u16>(file, ntOffset + 4 + 2, 2);	// sections
+	Put <u16>(file, ntOffset + 4 + 16, optionalSize);
+
+	// optional header, just what PEImage looks at
+	Put <u16>(file, optionalOffset, fixture.plus ? 0x20B : 0x10B);
+	Put <u32>(file, optionalOffset + 56, 0x3000);	// SizeOfImage
+	Put <u32>(file, optionalOffset + 60, kFileAlign);	// SizeOfHeaders
+	Put <u32>(file, optionalOffset + numDirectoriesOffset, 16);
+
+	if(fixture.exportDirectory)
+	{
+		Put <u32>(file, optionalOffset + numDirectoriesOffset + 4, kExportRVA);
+		Put <u32>(file, optionalOffset + numDirectoriesOffset + 8, kExportDirectorySize);
+	}
+
+	// section headers
+	u32	sectionOffset = optionalOffset + optionalSize;
+
+	memcpy(&file[sectionOffset], ".edata", 6);
+	Put <u32>(file, sectionOffset + 8, 0x1000);
+	Put <u32>(file, sectionOffset + 12, kExportRVA);
+	Put <u32>(file, sectionOffset + 16, fixture.exportRawSize);
+	Put <u32>(file, sectionOffset + 20, kExportFileOffset);
+	Put <u32>(file, sectionOffset + 36, 0x40000040);	// initialized data, read
+
+	sectionOffset += 40;
+
+	memcpy(&file[sectionOffset], ".text", 5);
+	Put <u32>(file, sectionOffset + 8, kCodeVirtualSize);
+	Put <u32>(file, sectionOffset + 12, kCodeRVA);
+	Put <u32>(file, sectionOffset + 16, kCodeRawSize);
+	Put <u32>(file, sectionOffset + 20, kCodeFileOffset);
+	Put <u32>(file, sectionOffset + 36, 0x60000020);	// code, execute, read
+
+	// export directory, then functions, names and ordinals, then the name strings
+	u32	numExports = u32(fixture.exports.size());
+	u32	functions = 40;
+	u32	names = functions + numExports * 4;
+	u32	ordinals = names + numExports * 4;
+	u32	strings = ordinals + numExports * 2;
+
+	Put <u32>(file, kExportFileOffset + 20, numExports);
+	Put <u32>(file, kExportFileOffset + 24, numExports);
+	Put <u32>(file, kExportFileOffset + 28, kExportRVA + functions);
+	Put <u32>(file, kExportFileOffset + 32, kExportRVA + names);
+	Put <u32>(file, kExportFileOffset + 36, kExportRVA + ordinals);
+
+	for(u32 i = 0; i < numExports; i++)
+	{
+		const FixtureExport	& entry = fixture.exports[i];
+
+		Put <u32>(file, kExportFileOffset + functions + i * 4, entry.rva);
+		Put <u32>(file, kExportFileOffset + names + i * 4, kExportRVA + strings);
+		Put <u16>(file, kExportFileOffset + ordinals + i * 2, u16(i));
+
+		size_t	len = strlen(entry.name) + 1;
+
+		memcpy(&file[kExportFileOffset + strings], entry.name, len);
+		strings += u32(len);
+	}
+
+	if(fixture.badOrdinal)
+		Put <u16>(file, kExportFileOffset + ordinals, fixture.badOrdinal);
+
+	memcpy(&file[kExportFileOffset + kForwarderOffset], kForwarder, sizeof(kForwarder));
+	memcpy(&file[kExportFileOffset + kVersionOffset], kVersionData, sizeof(kVersionData));
+	file[kExportFileOffset + kStubOffset] = 0xC3;
+
+	for(u32 i = 0; i < kCodeRawSize; i++)
+		file[kCodeFileOffset + i] = u8(i | 1);
+
+	return file;
+}
+
+static Fixture PluginFixture()
+{
+	Fixture	result;
+
+	result.exports.push_back({ "OBSEPlugin_Version", kExportRVA + kVersionOffset });
+	result.exports.push_back({ "OBSEPlugin_Load", kExportRVA + kStubOffset });
+
+	return result;
+}
+
+std::vector <u8> BuildTestPluginImage()
+{
+	return BuildImage(PluginFixture());
+}
+
+static void TestPluginExports(TestContext & ctx, const Fixture & fixture)
+{
+	std::vector <u8>	file = BuildImage(fixture);
+	PEImage				image;
+
+	if(!TEST_CHECK(ctx, image.parse(file.data(), file.size())))
+		return;
+
+	TEST_CHECK(ctx, image.machine() == fixture.machine);
+	TEST_CHECK(ctx, image.is64() == (fixture.machine == PEImage::kMachine_AMD64));
+
+	u32	versionRVA = image.findExport("OBSEPlugin_Version");
+
+	TEST_CHECK(ctx, versionRVA == kExportRVA + kVersionOffset);
+	TEST_CHECK(ctx, !image.isForwarded(versionRVA));
+	TEST_CHECK(ctx, image.findExport("OBSEPlugin_Load") == kExportRVA + kStubOffset);
+
+	u8	version[sizeof(kVersionData)];
+
+	TEST_CHECK(ctx, image.read(versionRVA, version, sizeof(version)));
+	TEST_CHECK(ctx, !memcmp(version, kVersionData, sizeof(version)));
+
+	// missing, and names that only share a prefix
+	TEST_CHECK(ctx, !image.findExport("OBSEPlugin_Preload"));
+	TEST_CHECK(ctx, !image.findExport("OBSEPlugin_Versio"));
+	TEST_CHECK(ctx, !image.findExport("OBSEPlugin_Version2"));
+	TEST_CHECK(ctx, !image.findExport(""));
+}
+
+static void TestPE32Plus(TestContext & ctx)
+{
+	TestPluginExports(ctx, PluginFixture());
+
+	std::vector <u8>	file = BuildImage(PluginFixture());
+	PEImage				image;
+
+	TEST_CHECK(ctx, image.parse(file.data(), file.size()));
+
+	// the code section, with the part past its data on disk reading as zero
+	u32			rva, size, fileSize;
+	const u8	* fileData;
+
+	TEST_CHECK(ctx, image.findCode(&rva, &size, &fileData, &fileSize));
+	TEST_CHECK(ctx, rva == kCodeRVA);
+	TEST_CHECK(ctx, size == kCodeVirtualSize);
+	TEST_CHECK(ctx, fileData == file.data() + kCodeFileOffset);
+	TEST_CHECK(ctx, fileSize == kCodeRawSize);
+
+	u8	code[8];
+
+	TEST_CHECK(ctx, image.read(kCodeRVA + kCodeRawSize - 4, code, sizeof(code)));
+	TEST_CHECK(ctx, (code[0] == u8((kCodeRawSize - 4) | 1)) && (code[3] == u8((kCodeRawSize - 1) | 1)));
+	TEST_CHECK(ctx, !code[4] && !code[7]);
+
+	// past the end of the section, and in no section at all
+	TEST_CHECK(ctx, !image.read(kCodeRVA + kCodeVirtualSize - 4, code, sizeof(code)));
+	TEST_CHECK(ctx, !image.read(0x5000, code, sizeof(code)));
+
+	// headers read at their file offsets
+	TEST_CHECK(ctx, image.read(0, code, 2) && (code[0] == 'M') && (code[1] == 'Z'));
+
+	// the hash only changes with the build
+	PEImage	same;
+
+	TEST_CHECK(ctx, same.parse(file.data(), file.size()));
+	TEST_CHECK(ctx, image.headerHash() && (image.headerHash() == same.headerHash()));
+
+	std::vector <u8>	otherBuild = file;
+	otherBuild[0x40 + 4 + 4] ^= 1;	// TimeDateStamp
+
+	PEImage	other;
+
+	TEST_CHECK(ctx, other.parse(otherBuild.data(), otherBuild.size()));
+	TEST_CHECK(ctx, other.headerHash() != image.headerHash());
+}
+
+static void TestPE32(TestContext & ctx)
+{
+	Fixture	fixture = PluginFixture();
+
+	fixture.plus = false;
+	fixture.machine = PEImage::kMachine_I386;
+
+	TestPluginExports(ctx, fixture);
+
+	// a 32 bit optional header with a 64 bit machine is still read by its magic
+	fixture.machine = PEImage::kMachine_AMD64;
+
+	TestPluginExports(ctx, fixture);
+}
+
+static void TestMissingExports(TestContext & ctx)
+{
+	PEImage	image;
+
+	// no export directory at all
+	Fixture	fixture = PluginFixture();
+	fixture.exportDirectory = false;
+
+	std::vector <u8>	file = BuildImage(fixture);
+
+	TEST_CHECK(ctx, image.parse(file.data(), file.size()));
+	TEST_CHECK(ctx, !image.findExport("OBSEPlugin_Version"));
+
+	// a directory with nothing in it
+	fixture = Fixture();
+	file = BuildImage(fixture);
+
+	TEST_CHECK(ctx, image.parse(file.data(), file.size()));
+	TEST_CHECK(ctx, !image.findExport("OBSEPlugin_Version"));
+
+	// other exports only
+	fixture.exports.push_back({ "DllMain", kExportRVA + kStubOffset });
+	file = BuildImage(fixture);
+
+	TEST_CHECK(ctx, image.parse(file.data(), file.size()));
+	TEST_CHECK(ctx, image.findExport("DllMain") == kExportRVA + kStubOffset);
+	TEST_CHECK(ctx, !image.findExport("OBSEPlugin_Version"));
+
+	// an ordinal past the function table
+	fixture = PluginFixture();
+	fixture.badOrdinal = 2;
+	file = BuildImage(fixture);
+
+	TEST_CHECK(ctx, image.parse(file.data(), file.size()));
+	TEST_CHECK(ctx, !image.findExport("OBSEPlugin_Version"));
+	TEST_CHECK(ctx, image.findExport("OBSEPlugin_Load") == kExportRVA + kStubOffset);
+}
+
+static void TestForwardedExports(TestContext & ctx)
+{
+	Fixture	fixture = PluginFixture();
+	fixture.exports[1].rva = kExportRVA + kForwarderOffset;
+
+	std::vector <u8>	file = BuildImage(fixture);
+	PEImage				image;
+
+	TEST_CHECK(ctx, image.parse(file.data(), file.size()));
+
+	u32	loadRVA = image.findExport("OBSEPlugin_Load");
+
+	TEST_CHECK(ctx, loadRVA == kExportRVA + kForwarderOffset);
+	TEST_CHECK(ctx, image.isForwarded(loadRVA));
+	TEST_CHECK(ctx, !image.isForwarded(image.findExport("OBSEPlugin_Version")));
+	TEST_CHECK(ctx, !image.isForwarded(0));
+
+	char	forwarder[sizeof(kForwarder)];
+
+	TEST_CHECK(ctx, image.read(loadRVA, forwarder, sizeof(forwarder)));
+	TEST_CHECK(ctx, !strcmp(forwarder, kForwarder));
+
+	// nothing is forwarded without an export directory
+	fixture.exportDirectory = false;
+	file = BuildImage(fixture);
+
+	TEST_CHECK(ctx, image.parse(file.data(), file.size()));
+	TEST_CHECK(ctx, !image.isForwarded(kExportRVA + kForwarderOffset));
+}
+
+static void TestTruncated(TestContext & ctx)
+{
+	std::vector <u8>	file = BuildImage(PluginFixture());
+	PEImage				image;
+
+	// anything short of the section table fails. each length is its own copy, so an ASan build catches reads past the end
+	const size_t	sectionTableEnd = 0x40 + 4 + 20 + 240 + 2 * 40;
+
+	bool	rejected = true;
+
+	for(size_t len = 0; len < sectionTableEnd; len++)
+	{
+		std::vector <u8>	cut(file.begin(), file.begin() + len);
+
+		if(image.parse(cut.data(), cut.size()))
+			rejected = false;
+	}
+
+	TEST_CHECK(ctx, rejected);
+
+	// past that the headers parse, lookups give the right answer or nothing
+	bool	consistent = true;
+
+	for(size_t len = sectionTableEnd; len <= file.size(); len++)
+	{
+		std::vector <u8>	cut(file.begin(), file.begin() + len);
+
+		if(!image.parse(cut.data(), cut.size()))
+		{
+			consistent = false;
+			continue;
+		}
+
+		u32	versionRVA = image.findExport("OBSEPlugin_Version");
+		u8	version[sizeof(kVersionData)];
+
+		if(versionRVA && (versionRVA != kExportRVA + kVersionOffset))
+			consistent = false;
+
+		if(versionRVA && image.read(versionRVA, version, sizeof(version)) && memcmp(version, kVersionData, sizeof(version)))
+			consistent = false;
+
+		u32			rva, size, fileSize;
+		const u8	* fileData;
+
+		if(image.findCode(&rva, &size, &fileData, &fileSize) && fileData && (fileData + fileSize > cut.data() + cut.size()))
+			consistent = false;
+	}
+
+	TEST_CHECK(ctx, consistent);
+
+	// the whole directory present but the version data cut off on disk
+	Fixture	fixture = PluginFixture();
+	fixture.exportRawSize = kVersionOffset + 4;
+
+	file = BuildImage(fixture);
+
+	TEST_CHECK(ctx, image.parse(file.data(), file.size()));
+	TEST_CHECK(ctx, image.findExport("OBSEPlugin_Version") == kExportRVA + kVersionOffset);
+
+	// the rest of the section reads as zero, like it would once loaded
+	u8	version[sizeof(kVersionData)];
+
+	TEST_CHECK(ctx, image.read(kExportRVA + kVersionOffset, version, sizeof(version)));
+	TEST_CHECK(ctx, !memcmp(version, kVersionData, 4) && !version[4]);
+
+	// a section table claiming more sections than the loader allows
+	file = BuildImage(PluginFixture());
+	file[0x40 + 4 + 2] = 97;
+
+	TEST_CHECK(ctx, !image.parse(file.data(), file.size()));
+}
+
+static void TestNotPE(TestContext & ctx)
+{
+	PEImage	image;
+
+	std::vector <u8>	file = BuildImage(PluginFixture());
+
+	std::vector <u8>	badDOS = file;
+	badDOS[0] = 'X';
+	TEST_CHECK(ctx, !image.parse(badDOS.data(), badDOS.size()));
+
+	std::vector <u8>	badSignature = file;
+	badSignature[0x41] = 'X';
+	TEST_CHECK(ctx, !image.parse(badSignature.data(), badSignature.size()));
+
+	std::vector <u8>	badOffset = file;
+	Put <u32>(badOffset, 0x3C, 0xFFFFFFF0);
+	TEST_CHECK(ctx, !image.parse(badOffset.data(), badOffset.size()));
+
+	std::vector <u8>	badMagic = file;
+	Put <u16>(badMagic, 0x40 + 4 + 20, 0x107);	// ROM image
+	TEST_CHECK(ctx, !image.parse(badMagic.data(), badMagic.size()));
+
+	// an optional header too small for its data directories
+	std::vector <u8>	shortOptional = file;
+	Put <u16>(shortOptional, 0x40 + 4 + 16, 100);
+	TEST_CHECK(ctx, !image.parse(shortOptional.data(), shortOptional.size()));
+}
+
+void TestPEImage(TestContext & ctx)
+{
+	TestPE32Plus(ctx);
+	TestPE32(ctx);
+	TestMissingExports(ctx);
+	TestForwardedExports(ctx);
+	TestTruncated(ctx);
+	TestNotPE(ctx);
+}
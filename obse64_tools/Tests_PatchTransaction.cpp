@@ -0,0 +1,310 @@
+#include "Tests.h"
+#include "obse64_common/MemoryProtect.h"
+#include "obse64_common/PatchTransaction.h"
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#ifdef _WIN32
+#include <Windows.h>
+
+enum
+{
+	kProtect_Read = PAGE_READONLY,
+	kProtect_ReadExec = PAGE_EXECUTE_READ,
+};
+
+// leaves a hole the transaction can't make writable
+static void DecommitPage(u8 * page)
+{
+	VirtualFree(page, memoryPageSize(), MEM_DECOMMIT);
+}
+#else
+#include <sys/mman.h>
+
+enum
+{
+	kProtect_Read = PROT_READ,
+	kProtect_ReadExec = PROT_READ | PROT_EXEC,
+};
+
+static void DecommitPage(u8 * page)
+{
+	munmap(page, memoryPageSize());
+}
+#endif
+
+// the protection is only observable by changing it, so it's put straight back
+static u32 GetProtection(const u8 * addr)
+{
+	u32	old = 0;
+
+	if(memoryUnprotect(uintptr_t(addr), 1, &old))
+		memoryProtect(uintptr_t(addr), 1, old);
+
+	return old;
+}
+
+// even pages read+execute like code, odd ones read only like data
+static u32 MixedProtection(size_t page)
+{
+	return (page & 1) ? kProtect_Read : kProtect_ReadExec;
+}
+
+static void SetMixedProtection(u8 * mem, size_t numPages)
+{
+	size_t	pageSize = memoryPageSize();
+
+	for(size_t i = 0; i < numPages; i++)
+		memoryProtect(uintptr_t(mem + i * pageSize), pageSize, MixedProtection(i));
+}
+
+struct RandomWrite
+{
+	size_t	offset;
+	u64		value;
+	u32		len;	// 1, 2, 4 or 8
+};
+
+static std::vector <RandomWrite> MakeRandomWrites(size_t count, size_t range, u32 seed)
+{
+	std::mt19937	rng(seed);
+
+	std::vector <RandomWrite>	result(count);
+
+	for(RandomWrite & write : result)
+	{
+		write.len = 1 << (rng() % 4);
+		write.offset = rng() % (range - sizeof(u64));
+		write.value = (u64(rng()) << 32) | rng();
+	}
+
+	return result;
+}
+
+static void AddWrite(PatchTransaction & patches, u8 * mem, const RandomWrite & write)
+{
+	uintptr_t	addr = uintptr_t(mem + write.offset);
+
+	switch(write.len)
+	{
+		case 1:	patches.write8(addr, u8(write.value));		break;
+		case 2:	patches.write16(addr, u16(write.value));	break;
+		case 4:	patches.write32(addr, u32(write.value));	break;
+		default:	patches.write64(addr, write.value);		break;
+	}
+}
+
+// what SafeWrite does, two protection changes per write
+static void UnbatchedWrite(uintptr_t addr, const void * data, size_t len)
+{
+	u32	old;
+
+	if(memoryUnprotect(addr, len, &old))
+	{
+		memcpy((void *)addr, data, len);
+		memoryProtect(addr, len, old);
+	}
+}
+
+static void TestRandomWrites(TestContext & ctx)
+{
+	const size_t	kNumPages = 64;
+
+	size_t	pageSize = memoryPageSize();
+	size_t	len = kNumPages * pageSize;
+
+	u8	* mem = AllocTestPages(len);
+	if(!TEST_CHECK(ctx, mem))
+		return;
+
+	SetMixedProtection(mem, kNumPages);
+
+	std::vector <RandomWrite>	writes = MakeRandomWrites(2000, len, 1);
+	std::vector <u8>			expected(len, 0);
+
+	PatchTransaction	patches;
+
+	for(const RandomWrite & write : writes)
+	{
+		AddWrite(patches, mem, write);
+		memcpy(&expected[write.offset], &write.value, write.len);
+	}
+
+	TEST_CHECK(ctx, patches.numPending() == writes.size());
+
+	// nothing is written before commit
+	bool	untouched = true;
+	for(size_t i = 0; i < len; i++)
+		if(mem[i])
+			untouched = false;
+
+	TEST_CHECK(ctx, untouched);
+
+	TEST_CHECK(ctx, patches.commit());
+	TEST_CHECK(ctx, !patches.numPending());
+	TEST_CHECK(ctx, patches.numPages() <= kNumPages);
+	TEST_CHECK(ctx, !memcmp(mem, expected.data(), len));
+
+	bool	restored = true;
+	for(size_t i = 0; i < kNumPages; i++)
+		if(GetProtection(mem + i * pageSize) != MixedProtection(i))
+			restored = false;
+
+	TEST_CHECK(ctx, restored);
+
+	FreeTestPages(mem, len);
+}
+
+static void TestOrderAndBranches(TestContext & ctx)
+{
+	size_t	pageSize = memoryPageSize();
+	size_t	len = 2 * pageSize;
+
+	u8	* mem = AllocTestPages(len);
+	if(!TEST_CHECK(ctx, mem))
+		return;
+
+	memoryProtect(uintptr_t(mem), len, kProtect_ReadExec);
+
+	{
+		PatchTransaction	patches;
+
+		// straddles the page boundary, then is partly overwritten by a later write
+		patches.write64(uintptr_t(mem + pageSize - 4), 0x0807060504030201);
+		patches.write8(uintptr_t(mem + pageSize - 4), 0xEE);
+
+		TEST_CHECK(ctx, patches.writeJump(uintptr_t(mem + 16), uintptr_t(mem + 0x100)));
+		TEST_CHECK(ctx, patches.writeCall(uintptr_t(mem + 32), uintptr_t(mem)));
+
+		// out of rel32 range, nothing is queued
+		TEST_CHECK(ctx, !patches.writeJump(uintptr_t(mem), uintptr_t(mem) + 0x100000000));
+		TEST_CHECK(ctx, patches.numPending() == 4);
+
+		TEST_CHECK(ctx, patches.commit());
+		TEST_CHECK(ctx, patches.numPages() == 2);
+	}
+
+	TEST_CHECK(ctx, mem[pageSize - 4] == 0xEE);
+	TEST_CHECK(ctx, mem[pageSize - 3] == 0x02);
+	TEST_CHECK(ctx, mem[pageSize + 3] == 0x08);
+
+	s32	displ;
+
+	TEST_CHECK(ctx, mem[16] == 0xE9);
+	memcpy(&displ, mem + 17, sizeof(displ));
+	TEST_CHECK(ctx, displ == 0x100 - (16 + 5));
+
+	TEST_CHECK(ctx, mem[32] == 0xE8);
+	memcpy(&displ, mem + 33, sizeof(displ));
+	TEST_CHECK(ctx, displ == -(32 + 5));
+
+	TEST_CHECK(ctx, GetProtection(mem) == kProtect_ReadExec);
+	TEST_CHECK(ctx, GetProtection(mem + pageSize) == kProtect_ReadExec);
+
+	// pending writes are committed by the destructor
+	{
+		PatchTransaction	patches;
+
+		patches.write8(uintptr_t(mem), 0x77);
+	}
+
+	TEST_CHECK(ctx, mem[0] == 0x77);
+
+	FreeTestPages(mem, len);
+}
+
+static void TestUnwritablePage(TestContext & ctx)
+{
+	size_t	pageSize = memoryPageSize();
+	size_t	len = 3 * pageSize;
+
+	u8	* mem = AllocTestPages(len);
+	if(!TEST_CHECK(ctx, mem))
+		return;
+
+	memoryProtect(uintptr_t(mem), len, kProtect_Read);
+	DecommitPage(mem + pageSize);
+
+	PatchTransaction	patches;
+
+	patches.write32(uintptr_t(mem + 4), 0x11223344);
+	patches.write32(uintptr_t(mem + pageSize + 4), 1);
+	patches.write16(uintptr_t(mem + pageSize - 1), 0xBBAA);	// reaches into the hole
+	patches.write8(uintptr_t(mem + 2 * pageSize), 0x55);
+
+	// the writes touching the hole are skipped, the rest still land
+	TEST_CHECK(ctx, !patches.commit());
+
+	u32	value;
+	memcpy(&value, mem + 4, sizeof(value));
+
+	TEST_CHECK(ctx, value == 0x11223344);
+	TEST_CHECK(ctx, mem[pageSize - 1] == 0);
+	TEST_CHECK(ctx, mem[2 * pageSize] == 0x55);
+	TEST_CHECK(ctx, GetProtection(mem) == kProtect_Read);
+	TEST_CHECK(ctx, GetProtection(mem + 2 * pageSize) == kProtect_Read);
+
+#ifdef _WIN32
+	FreeTestPages(mem, len);
+#else
+	FreeTestPages(mem, pageSize);
+	FreeTestPages(mem + 2 * pageSize, pageSize);
+#endif
+}
+
+void TestPatchTransaction(TestContext & ctx)
+{
+	TestRandomWrites(ctx);
+	TestOrderAndBranches(ctx);
+	TestUnwritablePage(ctx);
+}
+
+// 10k writes of 1-8 bytes, batched against one unprotect/protect pair per write
+void BenchPatchTransaction()
+{
+	const size_t	kNumPages = 256;
+	const size_t	kNumWrites = 10000;
+
+	size_t	pageSize = memoryPageSize();
+	size_t	len = kNumPages * pageSize;
+
+	u8	* mem = AllocTestPages(len);
+	if(!mem)
+	{
+		fprintf(stderr, "couldn't allocate %zu bytes\n", len);
+		return;
+	}
+
+	SetMixedProtection(mem, kNumPages);
+
+	// spread over every page, then packed in to a few the way a hook block is
+	for(size_t spread : { kNumPages, size_t(16) })
+	{
+		std::vector <RandomWrite>	writes = MakeRandomWrites(kNumWrites, spread * pageSize, 2);
+
+		PatchTransaction	patches;
+
+		for(const RandomWrite & write : writes)
+			AddWrite(patches, mem, write);
+
+		BenchTimer	timer;
+
+		patches.commit();
+
+		double	batched = timer.elapsedMS();
+
+		timer.restart();
+
+		for(const RandomWrite & write : writes)
+			UnbatchedWrite(uintptr_t(mem + write.offset), &write.value, write.len);
+
+		double	unbatched = timer.elapsedMS();
+
+		printf("\t%zu writes over %zu pages: batched %.2f ms (%zu protection changes), unbatched %.2f ms (%zu)\n",
+			kNumWrites, spread, batched, patches.numPages() * 2, unbatched, kNumWrites * 2);
+	}
+
+	FreeTestPages(mem, len);
+}
@@ -0,0 +1,146 @@
+#include "Tests.h"
+#include "obse64/PluginCache.h"
+#include "obse64_common/MappedFile.h"
+#include "obse64_common/Parallel.h"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+struct PluginFile
+{
+	std::string	name;
+	u64			size;
+	u64			writeTime;
+	bool		cached;
+};
+
+// what PluginManager::scanPlugins does before the results are checked, with the cache or without it
+static std::vector <PluginScanResult> ScanDirectory(const fs::path & dir, PluginCache * cache, const char * cachePath)
+{
+	std::vector <PluginFile>	files;
+
+	for(const fs::directory_entry & entry : fs::directory_iterator(dir))
+	{
+		if(entry.path().extension() != ".dll")
+			continue;
+
+		PluginFile	file;
+
+		file.name = entry.path().filename().string();
+		file.size = entry.file_size();
+		file.writeTime = u64(entry.last_write_time().time_since_epoch().count());
+		file.cached = false;
+
+		files.push_back(file);
+	}
+
+	std::vector <PluginScanResult>	results(files.size());
+
+	if(cache)
+	{
+		cache->load(cachePath);
+
+		for(size_t i = 0; i < files.size(); i++)
+			files[i].cached = cache->lookup(files[i].name, files[i].size, files[i].writeTime, &results[i]);
+	}
+
+	std::vector <size_t>	toScan;
+
+	for(size_t i = 0; i < files.size(); i++)
+		if(!files[i].cached)
+			toScan.push_back(i);
+
+	parallelFor(toScan.size(), [&](size_t i)
+	{
+		size_t		idx = toScan[i];
+		MappedFile	file;
+
+		if(file.open((dir / files[idx].name).string().c_str()))
+			ScanPluginImage(file.data(), file.size(), &results[idx]);
+		else
+			results[idx].status = PluginCache::kStatus_ReadError;
+	});
+
+	if(cache)
+	{
+		for(size_t idx : toScan)
+			cache->update(files[idx].name, files[idx].size, files[idx].writeTime, results[idx]);
+
+		cache->save(cachePath);
+	}
+
+	return results;
+}
+
+// startup with 200 plugins, scanning every dll against a warm cache. the files are in the OS file cache either way,
+// so this is the parse cost, the cold disk reads a real launch saves come on top
+void BenchPluginCache()
+{
+	const u32	kNumPlugins = 200;
+	const u32	kNumRuns = 20;
+
+	fs::path	dir = "obse64_tools_bench_plugins";
+	std::string	cachePath = (dir / "PluginCache.bin").string();
+
+	std::error_code	err;
+	fs::remove_all(dir, err);
+	fs::create_directory(dir, err);
+
+	std::vector <u8>	image = BuildTestPluginImage();
+
+	for(u32 i = 0; i < kNumPlugins; i++)
+	{
+		char	name[32];
+		sprintf_s(name, sizeof(name), "plugin%03u.dll", i);
+
+		FILE	* dst = nullptr;
+		if(fopen_s(&dst, (dir / name).string().c_str(), "wb") || !dst)
+		{
+			fprintf(stderr, "couldn't write %s\n", name);
+			return;
+		}
+
+		fwrite(image.data(), 1, image.size(), dst);
+		fclose(dst);
+	}
+
+	BenchTimer	timer;
+	u32			numOK = 0;
+
+	for(u32 i = 0; i < kNumRuns; i++)
+		for(const PluginScanResult & result : ScanDirectory(dir, nullptr, nullptr))
+			numOK += (result.status == PluginCache::kStatus_OK) && result.hasLoad;
+
+	double	uncached = timer.elapsedMS() / kNumRuns;
+
+	// the first launch fills the cache
+	{
+		PluginCache	cache;
+		ScanDirectory(dir, &cache, cachePath.c_str());
+	}
+
+	timer.restart();
+
+	u32	numHits = 0;
+
+	for(u32 i = 0; i < kNumRuns; i++)
+	{
+		PluginCache	cache;
+
+		for(const PluginScanResult & result : ScanDirectory(dir, &cache, cachePath.c_str()))
+			numOK += (result.status == PluginCache::kStatus_OK) && result.hasLoad;
+
+		numHits += cache.hits();
+	}
+
+	double	cached = timer.elapsedMS() / kNumRuns;
+
+	printf("\t%u plugins: scanned %.3f ms, cached %.3f ms (%u of %u hits, %u of %u usable)\n",
+		kNumPlugins, uncached, cached, numHits / kNumRuns, kNumPlugins, numOK / (2 * kNumRuns), kNumPlugins);
+
+	fs::remove_all(dir, err);
+}
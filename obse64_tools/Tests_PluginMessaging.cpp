@@ -0,0 +1,287 @@
+#include "Tests.h"
+#include "obse64/PluginMessaging.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// handlers only get a Message, so the stand-in plugins count through globals
+static u32	s_numReceived;
+static u32	s_lastType;
+static u32	s_sumData;
+static const char	* s_lastSender;
+
+static void CountMessage(OBSEMessagingInterface::Message * msg)
+{
+	s_numReceived++;
+	s_lastType = msg->type;
+	s_lastSender = msg->sender;
+	s_sumData += msg->dataLen;
+}
+
+static void CountMessageTwice(OBSEMessagingInterface::Message * msg)
+{
+	s_numReceived += 2;
+}
+
+static void ResetCounts()
+{
+	s_numReceived = 0;
+	s_lastType = 0;
+	s_sumData = 0;
+	s_lastSender = nullptr;
+}
+
+// plugin n listens to n + 1, handles are 1-based like PluginManager's
+static PluginListeners	* s_growListeners;
+
+static void RegisterWhileDelivering(OBSEMessagingInterface::Message * msg)
+{
+	s_numReceived++;
+
+	for(PluginHandle i = 10; i < 40; i++)
+		s_growListeners->add(1, i, CountMessage, nullptr, 0, false);
+}
+
+static void TestRegistration(TestContext & ctx)
+{
+	PluginListeners	listeners;
+
+	listeners.reserve(4);
+	TEST_CHECK(ctx, listeners.numSenders() >= 4);
+
+	TEST_CHECK(ctx, !listeners.deliver(1, "one", kPluginHandle_Invalid, 0, nullptr, 0));
+	TEST_CHECK(ctx, !listeners.deliver(100, "hundred", kPluginHandle_Invalid, 0, nullptr, 0));
+
+	listeners.add(1, 2, CountMessage, nullptr, 0, false);
+	listeners.add(1, 3, CountMessage, nullptr, 0, false);
+	listeners.add(1, 2, CountMessageTwice, nullptr, 0, false);	// kept the first
+
+	TEST_CHECK(ctx, listeners.isListening(1, 2));
+	TEST_CHECK(ctx, listeners.isListening(1, 3));
+	TEST_CHECK(ctx, !listeners.isListening(1, 1));
+	TEST_CHECK(ctx, !listeners.isListening(2, 1));
+	TEST_CHECK(ctx, !listeners.isListening(50, 1));
+	TEST_CHECK(ctx, listeners.numListeners(1) == 2);
+	TEST_CHECK(ctx, listeners.numListeners(50) == 0);
+
+	ResetCounts();
+	TEST_CHECK(ctx, listeners.deliver(1, "one", kPluginHandle_Invalid, 7, nullptr, 4));
+	TEST_CHECK(ctx, s_numReceived == 2);
+	TEST_CHECK(ctx, s_lastType == 7);
+	TEST_CHECK(ctx, s_sumData == 8);
+	TEST_CHECK(ctx, s_lastSender && (std::string(s_lastSender) == "one"));
+
+	listeners.add(1, 2, CountMessageTwice, nullptr, 0, true);
+	TEST_CHECK(ctx, listeners.numListeners(1) == 2);
+
+	ResetCounts();
+	listeners.deliver(1, "one", kPluginHandle_Invalid, 7, nullptr, 0);
+	TEST_CHECK(ctx, s_numReceived == 3);
+
+	// senders past the reserved range grow the table
+	listeners.add(20, 1, CountMessage, nullptr, 0, false);
+	TEST_CHECK(ctx, listeners.numSenders() > 20);
+	TEST_CHECK(ctx, listeners.isListening(20, 1));
+}
+
+static void TestTargeted(TestContext & ctx)
+{
+	PluginListeners	listeners;
+
+	listeners.add(0, 1, CountMessage, nullptr, 0, false);
+	listeners.add(0, 5, CountMessageTwice, nullptr, 0, false);
+
+	ResetCounts();
+	TEST_CHECK(ctx, listeners.deliver(0, "OBSE", 5, 1, nullptr, 0));
+	TEST_CHECK(ctx, s_numReceived == 2);
+
+	ResetCounts();
+	TEST_CHECK(ctx, listeners.deliver(0, "OBSE", 1, 1, nullptr, 0));
+	TEST_CHECK(ctx, s_numReceived == 1);
+
+	// not registered, or past the end of the slots
+	TEST_CHECK(ctx, !listeners.deliver(0, "OBSE", 3, 1, nullptr, 0));
+	TEST_CHECK(ctx, !listeners.deliver(0, "OBSE", 500, 1, nullptr, 0));
+}
+
+static void TestFilter(TestContext & ctx)
+{
+	PluginListeners	listeners;
+
+	const u32	kTypes[] = { 3, 9 };
+
+	listeners.add(1, 2, CountMessage, kTypes, 2, false);
+	listeners.add(1, 3, CountMessageTwice, kTypes + 1, 1, false);
+
+	ResetCounts();
+	TEST_CHECK(ctx, listeners.deliver(1, "one", kPluginHandle_Invalid, 3, nullptr, 0));
+	TEST_CHECK(ctx, s_numReceived == 1);
+
+	ResetCounts();
+	TEST_CHECK(ctx, listeners.deliver(1, "one", kPluginHandle_Invalid, 9, nullptr, 0));
+	TEST_CHECK(ctx, s_numReceived == 3);
+
+	ResetCounts();
+	TEST_CHECK(ctx, !listeners.deliver(1, "one", kPluginHandle_Invalid, 4, nullptr, 0));
+	TEST_CHECK(ctx, !s_numReceived);
+
+	TEST_CHECK(ctx, !listeners.deliver(1, "one", 3, 3, nullptr, 0));
+	TEST_CHECK(ctx, listeners.deliver(1, "one", 3, 9, nullptr, 0));
+
+	// replacing drops the filter
+	listeners.add(1, 3, CountMessage, nullptr, 0, true);
+
+	ResetCounts();
+	TEST_CHECK(ctx, listeners.deliver(1, "one", kPluginHandle_Invalid, 4, nullptr, 0));
+	TEST_CHECK(ctx, s_numReceived == 1);
+}
+
+static void TestReentrant(TestContext & ctx)
+{
+	PluginListeners	listeners;
+
+	s_growListeners = &listeners;
+
+	listeners.add(1, 2, RegisterWhileDelivering, nullptr, 0, false);
+
+	// the listeners added by the handler reallocate the list, they're reached in the same broadcast
+	ResetCounts();
+	TEST_CHECK(ctx, listeners.deliver(1, "one", kPluginHandle_Invalid, 0, nullptr, 0));
+	TEST_CHECK(ctx, s_numReceived == 31);
+	TEST_CHECK(ctx, listeners.numListeners(1) == 31);
+
+	s_growListeners = nullptr;
+}
+
+static void TestNameIndex(TestContext & ctx)
+{
+	PluginNameIndex	index;
+
+	TEST_CHECK(ctx, index.lookup("anything") == kPluginHandle_Invalid);
+
+	std::vector <std::string>	storage;
+
+	for(u32 i = 0; i < 100; i++)
+		storage.push_back("Plugin Number " + std::to_string(i));
+
+	storage.push_back("plugin number 7");	// duplicate by case, goes to the first
+
+	std::vector <const char *>	names;
+
+	for(const std::string & name : storage)
+		names.push_back(name.c_str());
+
+	index.build(names);
+
+	bool	allFound = true;
+
+	for(u32 i = 0; i < 100; i++)
+		if(index.lookup(names[i]) != PluginHandle(i + 1))
+			allFound = false;
+
+	TEST_CHECK(ctx, allFound);
+	TEST_CHECK(ctx, index.lookup("PLUGIN NUMBER 42") == 43);
+	TEST_CHECK(ctx, index.lookup("plugin number 7") == 8);
+	TEST_CHECK(ctx, index.lookup("Plugin Number 100") == kPluginHandle_Invalid);
+	TEST_CHECK(ctx, index.lookup("") == kPluginHandle_Invalid);
+
+	// rebuilding drops the old names
+	names.resize(2);
+	index.build(names);
+
+	TEST_CHECK(ctx, index.lookup("Plugin Number 1") == 2);
+	TEST_CHECK(ctx, index.lookup("Plugin Number 42") == kPluginHandle_Invalid);
+}
+
+void TestPluginMessaging(TestContext & ctx)
+{
+	TestRegistration(ctx);
+	TestTargeted(ctx);
+	TestFilter(ctx);
+	TestReentrant(ctx);
+	TestNameIndex(ctx);
+}
+
+// 50 plugins all listening to each other, 1M messages each way: broadcast, targeted by name like
+// OBSEMessagingInterface::Dispatch does, and broadcast where only half the listeners want the type
+void BenchPluginMessaging()
+{
+	const u32	kNumPlugins = 50;
+	const u32	kNumMessages = 1000000;
+
+	std::vector <std::string>	storage;
+	std::vector <const char *>	names;
+
+	for(u32 i = 0; i < kNumPlugins; i++)
+		storage.push_back("Plugin Number " + std::to_string(i));
+
+	for(const std::string & name : storage)
+		names.push_back(name.c_str());
+
+	PluginNameIndex	index;
+	index.build(names);
+
+	PluginListeners	everything;
+	PluginListeners	filtered;
+
+	const u32	kWanted[] = { 3 };
+
+	everything.reserve(kNumPlugins + 1);
+	filtered.reserve(kNumPlugins + 1);
+
+	for(PluginHandle sender = 1; sender <= kNumPlugins; sender++)
+	{
+		for(PluginHandle listener = 1; listener <= kNumPlugins; listener++)
+		{
+			if(listener == sender)
+				continue;
+
+			everything.add(sender, listener, CountMessage, nullptr, 0, false);
+			filtered.add(sender, listener, CountMessage, (listener & 1) ? kWanted : nullptr, (listener & 1) ? 1 : 0, false);
+		}
+	}
+
+	ResetCounts();
+
+	BenchTimer	timer;
+
+	for(u32 i = 0; i < kNumMessages; i++)
+	{
+		PluginHandle	sender = PluginHandle(1 + (i % kNumPlugins));
+
+		everything.deliver(sender, names[sender - 1], kPluginHandle_Invalid, 1, nullptr, 0);
+	}
+
+	double	broadcast = timer.elapsedMS();
+	u32		numBroadcast = s_numReceived;
+
+	ResetCounts();
+	timer.restart();
+
+	for(u32 i = 0; i < kNumMessages; i++)
+	{
+		PluginHandle	sender = PluginHandle(1 + (i % kNumPlugins));
+		PluginHandle	target = index.lookup(names[(i * 7 + 1) % kNumPlugins]);
+
+		everything.deliver(sender, names[sender - 1], target, 1, nullptr, 0);
+	}
+
+	double	targeted = timer.elapsedMS();
+	u32		numTargeted = s_numReceived;
+
+	ResetCounts();
+	timer.restart();
+
+	for(u32 i = 0; i < kNumMessages; i++)
+	{
+		PluginHandle	sender = PluginHandle(1 + (i % kNumPlugins));
+
+		filtered.deliver(sender, names[sender - 1], kPluginHandle_Invalid, 1, nullptr, 0);
+	}
+
+	double	filter = timer.elapsedMS();
+	u32		numFiltered = s_numReceived;
+
+	printf("\t%u plugins, %u messages: broadcast %.3f ms (%u handled), targeted by name %.3f ms (%u handled), filtered %.3f ms (%u handled)\n",
+		kNumPlugins, kNumMessages, broadcast, numBroadcast, targeted, numTargeted, filter, numFiltered);
+}
@@ -0,0 +1,161 @@
+#include "Tests.h"
+#include "obse64/PluginMessaging.h"
+#include "obse64/PluginStats.h"
+#include <cstring>
+#include <string>
+#include <vector>
+
+// a loaded plugin as far as the stats can tell, what PluginManager would have measured for it
+struct StandInPlugin
+{
+	const char	* name;
+	PluginHandle	handle;	// given out by the loader, not always the load order
+	u64			scan, preload, load;	// microseconds
+	u64			branchBytes, localBytes;
+	std::vector <u32>	listensTo;	// load order indices
+};
+
+static void Ignore(OBSEMessagingInterface::Message * msg)
+{
+	//
+}
+
+// getPluginStats for the stand-ins, the trampoline managers and timers replaced by the numbers in the table
+static std::vector <PluginStats> CollectStats(const std::vector <StandInPlugin> & plugins, bool listenToOBSE)
+{
+	PluginListeners	listeners;
+
+	listeners.reserve(u32(plugins.size()) + 1);
+
+	for(const StandInPlugin & plugin : plugins)
+	{
+		for(u32 idx : plugin.listensTo)
+			listeners.add(idx + 1, plugin.handle, Ignore, nullptr, 0, false);
+
+		if(listenToOBSE)
+			listeners.add(0, plugin.handle, Ignore, nullptr, 0, false);
+	}
+
+	std::vector <PluginStats>	stats(plugins.size());
+
+	for(u32 i = 0; i < plugins.size(); i++)
+	{
+		const StandInPlugin & plugin = plugins[i];
+		PluginStats & out = stats[i];
+
+		out.handle = plugin.handle;
+		out.name = plugin.name;
+
+		out.phaseMicroseconds[OBSEPluginStatsInterface::kPhase_Scan] = plugin.scan;
+		out.phaseMicroseconds[OBSEPluginStatsInterface::kPhase_Preload] = plugin.preload;
+		out.phaseMicroseconds[OBSEPluginStatsInterface::kPhase_Load] = plugin.load;
+
+		out.branchPoolBytes = plugin.branchBytes;
+		out.localPoolBytes = plugin.localBytes;
+
+		CountPluginMessaging(listeners, u32(plugins.size()), plugin.handle, i + 1, &out);
+	}
+
+	return stats;
+}
+
+static std::vector <StandInPlugin> MakeStandIns()
+{
+	std::vector <StandInPlugin>	plugins(5);
+
+	// handles skip some numbers, like they do when a plugin fails to load
+	plugins[0] = { "Fast Plugin",		2,	10,	0,		40,		0,		0,	{ 1, 2 } };
+	plugins[1] = { "Slow Loader",		3,	0,	500,	25000,	64,		16,	{ 0 } };
+	plugins[2] = { "Preload Heavy",		5,	120,	9000,	1000,	14,		0,	{ } };
+	plugins[3] = { "Tied With Fast",	6,	30,	0,		20,		0,		8,	{ 0, 1, 2, 4 } };
+	plugins[4] = { "Quiet",				7,	0,	0,		0,		0,		0,	{ } };
+
+	return plugins;
+}
+
+static void TestCounts(TestContext & ctx)
+{
+	std::vector <StandInPlugin>	plugins = MakeStandIns();
+	std::vector <PluginStats>	stats = CollectStats(plugins, false);
+
+	// senders: how many plugins this one listens to. listeners: how many listen to it
+	TEST_CHECK(ctx, stats[0].numSenders == 2);
+	TEST_CHECK(ctx, stats[0].numListeners == 2);
+	TEST_CHECK(ctx, stats[1].numSenders == 1);
+	TEST_CHECK(ctx, stats[1].numListeners == 2);
+	TEST_CHECK(ctx, stats[2].numSenders == 0);
+	TEST_CHECK(ctx, stats[2].numListeners == 2);
+	TEST_CHECK(ctx, stats[3].numSenders == 4);
+	TEST_CHECK(ctx, stats[3].numListeners == 0);
+	TEST_CHECK(ctx, stats[4].numSenders == 0);
+	TEST_CHECK(ctx, stats[4].numListeners == 1);
+
+	// OBSE's own messages count as a sender
+	stats = CollectStats(plugins, true);
+
+	TEST_CHECK(ctx, stats[0].numSenders == 3);
+	TEST_CHECK(ctx, stats[4].numSenders == 1);
+	TEST_CHECK(ctx, stats[4].numListeners == 1);
+
+	// a plugin handle past the end of the table
+	PluginListeners	empty;
+	PluginStats		entry;
+
+	CountPluginMessaging(empty, 5, 200, 6, &entry);
+
+	TEST_CHECK(ctx, !entry.numSenders);
+	TEST_CHECK(ctx, !entry.numListeners);
+}
+
+static void TestOrder(TestContext & ctx)
+{
+	std::vector <PluginStats>	stats = CollectStats(MakeStandIns(), false);
+
+	SortPluginStats(stats);
+
+	TEST_CHECK(ctx, stats[0].handle == 3);	// 25.5 ms
+	TEST_CHECK(ctx, stats[1].handle == 5);	// 10.12 ms
+	TEST_CHECK(ctx, stats[2].handle == 2);	// 50 us, before the tie that loaded after it
+	TEST_CHECK(ctx, stats[3].handle == 6);
+	TEST_CHECK(ctx, stats[4].handle == 7);
+
+	std::vector <PluginStats>	none;
+	SortPluginStats(none);
+
+	TEST_CHECK(ctx, none.empty());
+}
+
+static void TestFormat(TestContext & ctx)
+{
+	std::vector <PluginStats>	stats = CollectStats(MakeStandIns(), false);
+
+	char	row[512];
+
+	FormatPluginStats(stats[1], row, sizeof(row));
+
+	TEST_CHECK(ctx, !strcmp(row, "     3    0.000       0.500     25.000      64     16        1          2  Slow Loader"));
+
+	// the columns line up with the header
+	const char	* nameColumn = strstr(kPluginStatsHeader, "name");
+	TEST_CHECK(ctx, nameColumn && !strcmp(row + (nameColumn - kPluginStatsHeader), "Slow Loader"));
+
+	// names longer than the row are cut off, not overrun
+	std::string	longName(1000, 'x');
+
+	stats[0].name = longName.c_str();
+	FormatPluginStats(stats[0], row, sizeof(row));
+
+	TEST_CHECK(ctx, strlen(row) == sizeof(row) - 1);
+
+	stats[0].name = nullptr;
+	FormatPluginStats(stats[0], row, sizeof(row));
+
+	TEST_CHECK(ctx, row[strlen(row) - 1] == ' ');
+}
+
+void TestPluginStats(TestContext & ctx)
+{
+	TestCounts(ctx);
+	TestOrder(ctx);
+	TestFormat(ctx);
+}
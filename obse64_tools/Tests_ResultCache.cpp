@@ -0,0 +1,243 @@
+#include "Tests.h"
+#include "obse64/ResultCache.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+// the keys Commands_Math builds, the raw bits of the arguments
+static u64 ArgBits(float arg)
+{
+	u32	bits;
+	memcpy(&bits, &arg, sizeof(bits));
+
+	return bits;
+}
+
+static u64 ArgBits(float arg1, float arg2)
+{
+	return (ArgBits(arg1) << 32) | ArgBits(arg2);
+}
+
+// another key using the same entry as key, found by storing both and seeing if the first is gone
+static u64 FindCollision(u64 key)
+{
+	ResultCache	cache;
+	double		value;
+
+	for(u64 other = key + 1; ; other++)
+	{
+		cache.clear();
+		cache.store(key, 1);
+		cache.store(other, 2);
+
+		if(!cache.lookup(key, &value))
+			return other;
+	}
+}
+
+static void TestCollisions(TestContext & ctx)
+{
+	ResultCache	cache;
+	double		value = 0;
+
+	u64	a = ArgBits(1.0f, 2.0f);
+	u64	b = FindCollision(a);
+
+	// only one of the two is kept, the last stored, and each only ever gets its own value back
+	cache.store(a, 10);
+	TEST_CHECK(ctx, cache.lookup(a, &value) && (value == 10));
+
+	cache.store(b, 20);
+	TEST_CHECK(ctx, cache.lookup(b, &value) && (value == 20));
+	TEST_CHECK(ctx, !cache.lookup(a, &value));
+
+	cache.store(a, 30);
+	TEST_CHECK(ctx, cache.lookup(a, &value) && (value == 30));
+	TEST_CHECK(ctx, !cache.lookup(b, &value));
+
+	// keys elsewhere aren't disturbed
+	u64	c = a;
+	while((c == a) || (FindCollision(a) == c))
+		c++;
+
+	cache.store(c, 40);
+	TEST_CHECK(ctx, cache.lookup(a, &value) && (value == 30));
+	TEST_CHECK(ctx, cache.lookup(c, &value) && (value == 40));
+
+	// a key of all zeroes isn't mistaken for an empty entry, and -0 isn't 0
+	ResultCache	fresh;
+
+	TEST_CHECK(ctx, !fresh.lookup(0, &value));
+
+	fresh.store(ArgBits(0.0f), 50);
+	TEST_CHECK(ctx, fresh.lookup(ArgBits(0.0f), &value) && (value == 50));
+	TEST_CHECK(ctx, !fresh.lookup(ArgBits(-0.0f), &value));
+
+	// random keys from a small set against a map of what was stored last, a hit always has the right value
+	std::mt19937_64	rng(45);
+	std::unordered_map <u64, double>	stored;
+	std::vector <u64>	keys;
+
+	for(u32 i = 0; i < 200; i++)
+		keys.push_back(rng());
+
+	bool	allRight = true;
+	u64		numHits = 0;
+
+	for(u32 i = 0; i < 100000; i++)
+	{
+		u64	key = keys[rng() % keys.size()];
+
+		if(cache.lookup(key, &value))
+		{
+			numHits++;
+
+			if(!stored.count(key) || (stored[key] != value))
+				allRight = false;
+		}
+		else
+		{
+			double	newValue = double(rng() % 1000);
+
+			cache.store(key, newValue);
+			stored[key] = newValue;
+		}
+	}
+
+	TEST_CHECK(ctx, allRight);
+	TEST_CHECK(ctx, numHits > 0);
+}
+
+static void TestInvalidation(TestContext & ctx)
+{
+	ResultCache	cache;
+	double		value;
+
+	for(u32 i = 0; i < ResultCache::kNumEntries; i++)
+		cache.store(ArgBits(float(i)), i);
+
+	u32	numKept = 0;
+
+	for(u32 i = 0; i < ResultCache::kNumEntries; i++)
+		if(cache.lookup(ArgBits(float(i)), &value) && (value == i))
+			numKept++;
+
+	// small whole numbers should spread over most of the entries
+	TEST_CHECK(ctx, numKept >= ResultCache::kNumEntries / 2);
+	TEST_CHECK(ctx, (cache.hits() == numKept) && (cache.misses() == ResultCache::kNumEntries - numKept));
+
+	// the profile reset only clears the counts, the last one stored is still there
+	cache.resetStats();
+
+	TEST_CHECK(ctx, (cache.hits() == 0) && (cache.misses() == 0));
+	TEST_CHECK(ctx, cache.lookup(ArgBits(float(ResultCache::kNumEntries - 1)), &value));
+
+	// clearing drops every entry and the counts
+	cache.clear();
+
+	TEST_CHECK(ctx, (cache.hits() == 0) && (cache.misses() == 0));
+
+	u32	numHits = 0;
+
+	for(u32 i = 0; i < ResultCache::kNumEntries; i++)
+		if(cache.lookup(ArgBits(float(i)), &value))
+			numHits++;
+
+	TEST_CHECK(ctx, numHits == 0);
+	TEST_CHECK(ctx, cache.misses() == ResultCache::kNumEntries);
+}
+
+void TestResultCache(TestContext & ctx)
+{
+	TestCollisions(ctx);
+	TestInvalidation(ctx);
+}
+
+// CachedResult from Commands_Math
+template <typename Compute>
+static double CachedResult(ResultCache * cache, u64 key, Compute compute)
+{
+	double	value;
+
+	if(cache && cache->lookup(key, &value))
+		return value;
+
+	value = compute();
+
+	if(cache)
+		cache->store(key, value);
+
+	return value;
+}
+
+static volatile double	s_sink;
+
+// sin and atan2 called the way scripts tend to call them: the same argument every frame, a handful of
+// angles, more arguments than entries, and every call different. hit rate and cost against computing every time
+void BenchResultCache()
+{
+	const u32	kNumCalls = 10000000;
+
+	struct Workload
+	{
+		const char	* name;
+		u32			numDistinct;	// 0 for all different
+	};
+
+	static const Workload	kWorkloads[] =
+	{
+		{ "one argument",		1 },
+		{ "8 arguments",		8 },
+		{ "48 arguments",		48 },
+		{ "256 arguments",		256 },
+		{ "all different",		0 },
+	};
+
+	for(const Workload & workload : kWorkloads)
+	{
+		std::vector <float>	args(kNumCalls);
+
+		for(u32 i = 0; i < kNumCalls; i++)
+		{
+			u32	n = workload.numDistinct ? (i % workload.numDistinct) : i;
+			args[i] = float(n) * 0.25f;
+		}
+
+		for(u32 binary = 0; binary < 2; binary++)
+		{
+			ResultCache	cache;
+			double		sum = 0;
+			BenchTimer	timer;
+
+			for(float arg : args)
+			{
+				if(binary)
+					sum += atan2f(arg, 1.5f);
+				else
+					sum += sinf(arg);
+			}
+
+			double	uncached = timer.elapsedMS();
+
+			timer.restart();
+
+			for(float arg : args)
+			{
+				if(binary)
+					sum += CachedResult(&cache, ArgBits(arg, 1.5f), [arg] { return atan2f(arg, 1.5f); });
+				else
+					sum += CachedResult(&cache, ArgBits(arg), [arg] { return sinf(arg); });
+			}
+
+			double	cached = timer.elapsedMS();
+
+			s_sink = sum;
+
+			printf("\t%-5s %-14s %5.1f%% hits, %5.2f ns per call uncached, %5.2f ns cached\n", binary ? "atan2" : "sin",
+				workload.name, cache.hits() * 100.0 / kNumCalls, uncached * 1e6 / kNumCalls, cached * 1e6 / kNumCalls);
+		}
+	}
+}
@@ -0,0 +1,321 @@
+#include "Tests.h"
+#include "obse64/ScriptArgs.h"
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// local variables for the stand-in, indexed by the u16 after a 'f' argument
+static const float	kLocals[] = { 1.5f, 2.5f, 3.5f, -4.0f };
+
+static u32	s_numFallbacks;
+
+// stand-in for the game's ExtractArgs, the fast path's fallback. same encoding, but only literals, float locals
+// and strings. it walks the parameters with a switch over the va_list like the game does
+static bool GenericExtractArgs(const ParamInfo * paramInfo, const char * scriptData, u32 * opcodeOffsetPtr,
+	TESObjectREFR * thisObj, TESObjectREFR * containingObj, Script * script, ScriptLocals * locals, ...)
+{
+	s_numFallbacks++;
+
+	const u8	* start = (const u8 *)scriptData + *opcodeOffsetPtr;
+	const u8	* data = start + 2;
+
+	u16	numArgs = ScriptArgs::read <u16>(start);
+
+	va_list	args;
+	va_start(args, locals);
+
+	bool	result = true;
+
+	for(u32 i = 0; result && (i < numArgs); i++)
+	{
+		const ParamInfo & info = paramInfo[i];
+
+		switch(info.typeID)
+		{
+			case kParamType_String:
+			{
+				char	* out = va_arg(args, char *);
+				u16		len = ScriptArgs::read <u16>(data);
+
+				memcpy(out, data + 2, len);
+				out[len] = 0;
+
+				data += 2 + len;
+			}
+			break;
+
+			case kParamType_Integer:
+			case kParamType_Float:
+			{
+				double	value;
+
+				if(data[0] == ScriptArgs::kArg_Int)
+				{
+					value = s32(ScriptArgs::read <u32>(data + 1));
+					data += 1 + 4;
+				}
+				else if(data[0] == ScriptArgs::kArg_Double)
+				{
+					value = ScriptArgs::read <double>(data + 1);
+					data += 1 + 8;
+				}
+				else if(data[0] == 'f')
+				{
+					value = kLocals[ScriptArgs::read <u16>(data + 1)];
+					data += 1 + 2;
+				}
+				else
+				{
+					result = false;
+					break;
+				}
+
+				if(info.typeID == kParamType_Integer)
+					*va_arg(args, u32 *) = u32(s64(value));
+				else
+					*va_arg(args, float *) = float(value);
+			}
+			break;
+
+			default:
+				result = false;
+				break;
+		}
+	}
+
+	// missing arguments have to be optional, the parameter list ends with an empty entry
+	for(u32 i = numArgs; result && paramInfo[i].typeStr; i++)
+		if(!paramInfo[i].isOptional)
+			result = false;
+
+	va_end(args);
+
+	if(result)
+		*opcodeOffsetPtr += u32(data - start);
+
+	return result;
+}
+
+RelocAddr <_ExtractArgs> ExtractArgs((uintptr_t)&GenericExtractArgs);
+
+// argument data as the script compiler writes it, after two bytes of the command before it
+struct ArgData
+{
+	std::vector <u8>	data;
+
+	explicit ArgData(u16 numArgs)
+	{
+		data.push_back(0xCC);
+		data.push_back(0xCC);
+
+		put(numArgs);
+	}
+
+	template <typename T>
+	void	put(T value)	{ u8 buf[sizeof(T)]; memcpy(buf, &value, sizeof(T)); data.insert(data.end(), buf, buf + sizeof(T)); }
+
+	ArgData &	intLiteral(u32 value)		{ data.push_back(ScriptArgs::kArg_Int); put(value); return *this; }
+	ArgData &	doubleLiteral(double value)	{ data.push_back(ScriptArgs::kArg_Double); put(value); return *this; }
+	ArgData &	local(u16 idx)				{ data.push_back('f'); put(idx); return *this; }
+	ArgData &	string(const char * str)	{ u16 len = u16(strlen(str)); put(len); data.insert(data.end(), str, str + len); return *this; }
+
+	const char *	script() const	{ return (const char *)data.data(); }
+	u32				size() const	{ return u32(data.size()); }
+};
+
+enum
+{
+	kArgOffset = 2,
+};
+
+static const ParamInfo	kParams_OneFloat[] = { { "float", kParamType_Float, 0 }, { } };
+static const ParamInfo	kParams_TwoFloats[] = { { "float", kParamType_Float, 0 }, { "float", kParamType_Float, 0 }, { } };
+static const ParamInfo	kParams_OneInt[] = { { "int", kParamType_Integer, 0 }, { } };
+static const ParamInfo	kParams_OneOptionalInt[] = { { "int", kParamType_Integer, 1 }, { } };
+static const ParamInfo	kParams_OneString[] = { { "string", kParamType_String, 0 }, { } };
+static const ParamInfo	kParams_OneRef[] = { { "ref", kParamType_ObjectRef, 0 }, { } };
+
+// both ways agree on the result, the offset and the value, and the fast path only fell back when expected
+template <typename T>
+static void CheckOne(TestContext & ctx, const ParamInfo * params, const ArgData & args, bool expectFast)
+{
+	T		fast = { }, generic = { };
+	u32		fastOffset = kArgOffset, genericOffset = kArgOffset;
+
+	s_numFallbacks = 0;
+	bool	fastResult = ExtractArgsFast(params, args.script(), &fastOffset, nullptr, nullptr, nullptr, nullptr, &fast);
+	bool	fellBack = s_numFallbacks != 0;
+
+	bool	genericResult = GenericExtractArgs(params, args.script(), &genericOffset, nullptr, nullptr, nullptr, nullptr, &generic);
+
+	TEST_CHECK(ctx, fastResult == genericResult);
+	TEST_CHECK(ctx, fastOffset == genericOffset);
+	TEST_CHECK(ctx, !memcmp(&fast, &generic, sizeof(T)));
+	TEST_CHECK(ctx, fellBack == !expectFast);
+}
+
+void TestScriptArgs(TestContext & ctx)
+{
+	CheckOne <float>(ctx, kParams_OneFloat, ArgData(1).doubleLiteral(2.25), true);
+	CheckOne <float>(ctx, kParams_OneFloat, ArgData(1).intLiteral(7), true);
+	CheckOne <float>(ctx, kParams_OneFloat, ArgData(1).intLiteral(u32(-7)), false);	// signed and unsigned disagree
+	CheckOne <float>(ctx, kParams_OneFloat, ArgData(1).local(1), false);
+
+	CheckOne <u32>(ctx, kParams_OneInt, ArgData(1).intLiteral(42), true);
+	CheckOne <u32>(ctx, kParams_OneInt, ArgData(1).intLiteral(0xFFFFFFF0), true);
+	CheckOne <u32>(ctx, kParams_OneInt, ArgData(1).doubleLiteral(3.75), true);
+	CheckOne <u32>(ctx, kParams_OneInt, ArgData(1).doubleLiteral(-3.0), false);
+	CheckOne <u32>(ctx, kParams_OneInt, ArgData(1).doubleLiteral(3e9), false);
+	CheckOne <u32>(ctx, kParams_OneInt, ArgData(1).local(3), false);
+
+	CheckOne <u32>(ctx, kParams_OneOptionalInt, ArgData(0), true);
+	CheckOne <u32>(ctx, kParams_OneInt, ArgData(0), false);	// the game reports the missing argument
+
+	CheckOne <char[64]>(ctx, kParams_OneString, ArgData(1).string("hello"), true);
+	CheckOne <char[64]>(ctx, kParams_OneString, ArgData(1).string(""), true);
+
+	// parameter types the fast path doesn't decode
+	CheckOne <u32>(ctx, kParams_OneRef, ArgData(1).intLiteral(1), false);
+
+	// a string that doesn't fit goes to the game, which has its own limits
+	{
+		ArgData	args(1);
+		args.string("a string too long for 8");
+
+		struct
+		{
+			char	str[8];
+			char	overflow[64];
+		} out;
+
+		u32		offset = kArgOffset;
+
+		s_numFallbacks = 0;
+		ExtractArgsFast(kParams_OneString, args.script(), &offset, nullptr, nullptr, nullptr, nullptr, &out.str);
+
+		TEST_CHECK(ctx, s_numFallbacks == 1);
+		TEST_CHECK(ctx, offset == args.size());
+	}
+
+	// two floats, literals only, then a local in the second
+	{
+		float	a = 0, b = 0;
+		u32		offset = kArgOffset;
+
+		ArgData	literals(2);
+		literals.doubleLiteral(1.0).intLiteral(3);
+
+		s_numFallbacks = 0;
+		TEST_CHECK(ctx, ExtractArgsFast(kParams_TwoFloats, literals.script(), &offset, nullptr, nullptr, nullptr, nullptr, &a, &b));
+		TEST_CHECK(ctx, !s_numFallbacks && (a == 1.0f) && (b == 3.0f) && (offset == literals.size()));
+
+		ArgData	mixed(2);
+		mixed.doubleLiteral(1.0).local(2);
+
+		offset = kArgOffset;
+		s_numFallbacks = 0;
+		TEST_CHECK(ctx, ExtractArgsFast(kParams_TwoFloats, mixed.script(), &offset, nullptr, nullptr, nullptr, nullptr, &a, &b));
+		TEST_CHECK(ctx, (s_numFallbacks == 1) && (a == 1.0f) && (b == 3.5f) && (offset == mixed.size()));
+	}
+}
+
+// the signatures UnaryMathFn, the two float math commands, ar_Size and the log commands use, literal arguments
+// decoded by the fast path and by the variadic stand-in for the game's ExtractArgs
+// only meaningful in an optimized build, the fast path depends on being inlined in to the command
+void BenchScriptArgs()
+{
+	const u32	kNumCalls = 10000000;
+
+	ArgData	oneFloat(1), twoFloats(2), oneInt(1), oneString(1);
+
+	oneFloat.doubleLiteral(0.5);
+	twoFloats.doubleLiteral(0.5).doubleLiteral(1.5);
+	oneInt.intLiteral(0x1C);
+	oneString.string("SomeLogName");
+
+	volatile float	floatSink = 0;
+	volatile u32	intSink = 0;
+
+	struct Result
+	{
+		const char	* name;
+		double		generic, fast;
+	};
+
+	Result	results[4] = { { "one float" }, { "two floats" }, { "one int" }, { "one string" } };
+	BenchTimer	timer;
+
+	for(u32 fast = 0; fast < 2; fast++)
+	{
+		_ExtractArgs	extract = fast ? nullptr : GenericExtractArgs;
+
+		timer.restart();
+
+		for(u32 i = 0; i < kNumCalls; i++)
+		{
+			float	a = 0;
+			u32		offset = kArgOffset;
+
+			if(extract)
+				extract(kParams_OneFloat, oneFloat.script(), &offset, nullptr, nullptr, nullptr, nullptr, &a);
+			else
+				ExtractArgsFast(kParams_OneFloat, oneFloat.script(), &offset, nullptr, nullptr, nullptr, nullptr, &a);
+
+			floatSink = a;
+		}
+
+		(fast ? results[0].fast : results[0].generic) = timer.elapsedMS();
+		timer.restart();
+
+		for(u32 i = 0; i < kNumCalls; i++)
+		{
+			float	a = 0, b = 0;
+			u32		offset = kArgOffset;
+
+			if(extract)
+				extract(kParams_TwoFloats, twoFloats.script(), &offset, nullptr, nullptr, nullptr, nullptr, &a, &b);
+			else
+				ExtractArgsFast(kParams_TwoFloats, twoFloats.script(), &offset, nullptr, nullptr, nullptr, nullptr, &a, &b);
+
+			floatSink = a + b;
+		}
+
+		(fast ? results[1].fast : results[1].generic) = timer.elapsedMS();
+		timer.restart();
+
+		for(u32 i = 0; i < kNumCalls; i++)
+		{
+			u32		a = 0;
+			u32		offset = kArgOffset;
+
+			if(extract)
+				extract(kParams_OneInt, oneInt.script(), &offset, nullptr, nullptr, nullptr, nullptr, &a);
+			else
+				ExtractArgsFast(kParams_OneInt, oneInt.script(), &offset, nullptr, nullptr, nullptr, nullptr, &a);
+
+			intSink = a;
+		}
+
+		(fast ? results[2].fast : results[2].generic) = timer.elapsedMS();
+		timer.restart();
+
+		for(u32 i = 0; i < kNumCalls; i++)
+		{
+			char	a[512];
+			u32		offset = kArgOffset;
+
+			if(extract)
+				extract(kParams_OneString, oneString.script(), &offset, nullptr, nullptr, nullptr, nullptr, &a);
+			else
+				ExtractArgsFast(kParams_OneString, oneString.script(), &offset, nullptr, nullptr, nullptr, nullptr, &a);
+
+			intSink = a[3];
+		}
+
+		(fast ? results[3].fast : results[3].generic) = timer.elapsedMS();
+	}
+
+	for(const Result & result : results)
+		printf("\t%-12s generic %.2f ns, fast %.2f ns per call\n", result.name, result.generic * 1e6 / kNumCalls, result.fast * 1e6 / kNumCalls);
+}
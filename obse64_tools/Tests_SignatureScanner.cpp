@@ -0,0 +1,262 @@
+#include "Tests.h"
+#include "obse64_common/SignatureScanner.h"
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+// bytes skewed the way code is, so the rarity estimate has something to work with and short patterns match often
+static std::vector <u8> MakeCode(size_t len, u32 seed)
+{
+	static const u8	kCommon[] = { 0x00, 0x48, 0x8B, 0x89, 0xCC, 0xFF, 0xE8, 0x0F, 0x85, 0xC0, 0x4C, 0x24 };
+
+	std::mt19937	rng(seed);
+	std::vector <u8>	result(len);
+
+	for(u8 & c : result)
+		c = (rng() & 1) ? kCommon[rng() % sizeof(kCommon)] : u8(rng());
+
+	return result;
+}
+
+struct TestPattern
+{
+	std::vector <u8>	bytes;
+	std::vector <u8>	masks;	// 0xFF fixed, 0 wildcard
+
+	std::string	text() const
+	{
+		std::string	result;
+
+		for(size_t i = 0; i < bytes.size(); i++)
+		{
+			char	token[4];
+
+			if(masks[i])
+				sprintf_s(token, sizeof(token), "%02X", bytes[i]);
+			else
+				sprintf_s(token, sizeof(token), "%s", (i & 1) ? "?" : "??");
+
+			if(i)
+				result += ' ';
+
+			result += token;
+		}
+
+		return result;
+	}
+};
+
+// a slice of the data with some bytes wildcarded, at least one left fixed
+static TestPattern SlicePattern(const std::vector <u8> & data, size_t start, size_t len, std::mt19937 & rng)
+{
+	TestPattern	result;
+
+	result.bytes.assign(data.begin() + start, data.begin() + start + len);
+	result.masks.assign(len, 0xFF);
+
+	for(size_t i = 0; i < len; i++)
+		if(!(rng() % 4))
+			result.masks[i] = 0;
+
+	result.masks[rng() % len] = 0xFF;
+
+	return result;
+}
+
+// first match and count, a position at a time
+static SignatureScanner::Result NaiveScan(const TestPattern & pattern, const std::vector <u8> & data, u64 base)
+{
+	SignatureScanner::Result	result = { 0, 0 };
+
+	size_t	len = pattern.bytes.size();
+
+	for(size_t pos = 0; pos + len <= data.size(); pos++)
+	{
+		size_t	i = 0;
+
+		while((i < len) && !((data[pos + i] ^ pattern.bytes[i]) & pattern.masks[i]))
+			i++;
+
+		if(i < len)
+			continue;
+
+		if(!result.numMatches)
+			result.offset = base + pos;
+
+		result.numMatches++;
+	}
+
+	return result;
+}
+
+static void TestParse(TestContext & ctx)
+{
+	SignatureScanner	scanner;
+
+	TEST_CHECK(ctx, scanner.add("48 8B 05 ?? ?? ?? ?? 48 85 C0") == 0);
+	TEST_CHECK(ctx, scanner.add("  48\t8b 05 ? ? ? ? 48 85 c0  ") == 1);
+	TEST_CHECK(ctx, scanner.patternHash(0) == scanner.patternHash(1));
+
+	TEST_CHECK(ctx, scanner.add("") < 0);
+	TEST_CHECK(ctx, scanner.add("?? ?? ??") < 0);
+	TEST_CHECK(ctx, scanner.add("4") < 0);
+	TEST_CHECK(ctx, scanner.add("488B") < 0);
+	TEST_CHECK(ctx, scanner.add("48 GG") < 0);
+	TEST_CHECK(ctx, scanner.numPatterns() == 2);
+
+	std::string	longest;
+	for(u32 i = 0; i < SignatureScanner::kMaxPatternLen; i++)
+		longest += "AB ";
+
+	TEST_CHECK(ctx, scanner.add(longest.c_str()) >= 0);
+	TEST_CHECK(ctx, scanner.add((longest + "CD").c_str()) < 0);
+}
+
+// the scanner against the naive matcher, over buffer lengths that leave every size of tail block and
+// patterns from one byte to well past 16, with matches forced at the start and the very end
+static void TestRandomized(TestContext & ctx)
+{
+	std::mt19937	rng(1234);
+
+	bool	allMatch = true;
+	u32		numFound = 0;
+
+	for(u32 round = 0; round < 300; round++)
+	{
+		size_t	dataLen = (round < 100) ? (1 + round) : (rng() % 20000);
+		u64		base = (rng() & 1) ? 0x1000 : 0;
+
+		std::vector <u8>	data = MakeCode(dataLen, round);
+		std::vector <TestPattern>	patterns;
+
+		for(u32 i = 0; i < 20; i++)
+		{
+			if(!dataLen)
+				break;
+
+			size_t	len = 1 + rng() % ((i & 1) ? 40 : 6);
+			if(len > dataLen)
+				len = dataLen;
+
+			size_t	start;
+
+			switch(i % 4)
+			{
+				case 0:		start = dataLen - len; break;	// ends on the last byte
+				case 1:		start = 0; break;
+				default:	start = rng() % (dataLen - len + 1); break;
+			}
+
+			patterns.push_back(SlicePattern(data, start, len, rng));
+		}
+
+		// random ones that probably aren't there, and one hanging off the end
+		for(u32 i = 0; i < 5; i++)
+		{
+			TestPattern	pattern;
+
+			pattern.bytes = MakeCode(1 + rng() % 24, rng());
+			pattern.masks.assign(pattern.bytes.size(), 0xFF);
+
+			patterns.push_back(pattern);
+		}
+
+		if(dataLen > 4)
+		{
+			TestPattern	pattern = SlicePattern(data, dataLen - 4, 4, rng);
+
+			pattern.bytes.push_back(0x90);
+			pattern.masks.push_back(0);
+
+			patterns.push_back(pattern);
+		}
+
+		SignatureScanner	scanner;
+
+		for(const TestPattern & pattern : patterns)
+			if(scanner.add(pattern.text().c_str()) < 0)
+				allMatch = false;
+
+		scanner.scan(data.data(), data.size(), base);
+
+		for(u32 i = 0; i < patterns.size(); i++)
+		{
+			SignatureScanner::Result	expected = NaiveScan(patterns[i], data, base);
+			const SignatureScanner::Result & result = scanner.result(i);
+
+			if((result.numMatches != expected.numMatches) || (expected.numMatches && (result.offset != expected.offset)))
+				allMatch = false;
+
+			numFound += expected.numMatches != 0;
+		}
+	}
+
+	TEST_CHECK(ctx, allMatch);
+	TEST_CHECK(ctx, numFound > 300 * 20 / 2);
+
+	// scanning nothing clears the previous results
+	{
+		SignatureScanner	scanner;
+		const u8	data[] = { 0x48, 0x8B };
+
+		scanner.add("48 8B");
+		scanner.scan(data, sizeof(data));
+		TEST_CHECK(ctx, scanner.result(0).numMatches == 1);
+
+		scanner.scan(data, 0);
+		TEST_CHECK(ctx, scanner.result(0).numMatches == 0);
+	}
+}
+
+void TestSignatureScanner(TestContext & ctx)
+{
+	TestParse(ctx);
+	TestRandomized(ctx);
+}
+
+// 100 patterns the size plugins use, over 8MB of code-like bytes, against checking each pattern at each position
+void BenchSignatureScanner()
+{
+	const size_t	kLen = 8 * 1024 * 1024;
+	const u32		kNumPatterns = 100;
+
+	std::vector <u8>	data = MakeCode(kLen, 99);
+	std::mt19937		rng(100);
+
+	std::vector <TestPattern>	patterns;
+	SignatureScanner			scanner;
+
+	for(u32 i = 0; i < kNumPatterns; i++)
+	{
+		size_t	len = 8 + rng() % 24;
+
+		patterns.push_back(SlicePattern(data, rng() % (kLen - len), len, rng));
+		scanner.add(patterns.back().text().c_str());
+	}
+
+	BenchTimer	timer;
+
+	scanner.scan(data.data(), data.size());
+
+	double	scanTime = timer.elapsedMS();
+
+	timer.restart();
+
+	u32	numMismatches = 0;
+
+	for(u32 i = 0; i < kNumPatterns; i++)
+	{
+		SignatureScanner::Result	expected = NaiveScan(patterns[i], data, 0);
+
+		if((expected.numMatches != scanner.result(i).numMatches) || (expected.offset != scanner.result(i).offset))
+			numMismatches++;
+	}
+
+	double	naiveTime = timer.elapsedMS();
+	double	mb = double(kLen) / (1024 * 1024);
+
+	printf("\t%u patterns over %.0f MB: scanner %.1f ms (%.0f MB/s, %llu candidates), naive %.1f ms (%.0f MB/s), %u mismatches\n",
+		kNumPatterns, mb, scanTime, mb * 1000 / scanTime, (unsigned long long)scanner.numCandidates(),
+		naiveTime, mb * 1000 / naiveTime, numMismatches);
+}
@@ -0,0 +1,347 @@
+#include "Tests.h"
+#include "obse64_common/MemoryReservation.h"
+#include "obse64_common/TrampolineAllocator.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+// heap memory standing in for reserved regions, recording the ranges asked for
+class FakeReservation : public MemoryReservation
+{
+public:
+	struct Range
+	{
+		uintptr_t	low;
+		uintptr_t	high;
+	};
+
+	FakeReservation(u32 maxRegions)
+	:m_maxRegions(maxRegions), m_numReleases(0)	{ }
+
+	void * reserve(uintptr_t low, uintptr_t high, size_t len) override
+	{
+		Range	range = { low, high };
+		m_ranges.push_back(range);
+
+		if(!m_maxRegions)
+			return nullptr;
+
+		m_maxRegions--;
+
+		return malloc(len);
+	}
+
+	void release(void * base, size_t len) override
+	{
+		m_numReleases++;
+		::free(base);
+	}
+
+	std::vector <Range>	m_ranges;
+	u32		m_maxRegions;
+	u32		m_numReleases;
+};
+
+// somewhere a game exe could be loaded
+static const uintptr_t	kModuleBase = 0x7FF600000000;
+static const size_t		kModuleLen = 0x3000000;
+
+static void TestRegionGrowth(TestContext & ctx)
+{
+	const uintptr_t	kMaxDisplacement = TrampolineAllocator::kMaxDisplacement;
+	const size_t	kRegionLen = 0x10000;
+
+	FakeReservation		reservation(3);
+	TrampolineAllocator	alloc;
+
+	TEST_CHECK(ctx, alloc.create(kModuleBase, kModuleLen, kRegionLen, &reservation));
+
+	// below the module first, far enough down that the whole module stays in range
+	TEST_CHECK(ctx, reservation.m_ranges[0].low == kModuleBase + kModuleLen - kMaxDisplacement);
+	TEST_CHECK(ctx, reservation.m_ranges[0].high == kModuleBase);
+
+	std::vector <void *>	blocks;
+
+	while(void * block = alloc.allocate(8))
+		blocks.push_back(block);
+
+	TEST_CHECK(ctx, alloc.numRegions() == 3);
+	TEST_CHECK(ctx, blocks.size() == 3 * kRegionLen / 8);
+	TEST_CHECK(ctx, alloc.inUse() == 3 * kRegionLen);
+	TEST_CHECK(ctx, alloc.reserved() == 3 * kRegionLen);
+
+	// once nothing's left below it tries above, again without leaving range
+	TEST_CHECK(ctx, reservation.m_ranges.size() == 5);
+	TEST_CHECK(ctx, reservation.m_ranges[4].low == kModuleBase + kModuleLen);
+	TEST_CHECK(ctx, reservation.m_ranges[4].high == kModuleBase + kMaxDisplacement);
+
+	// full, but a freed block still comes back
+	alloc.free(blocks[100], 8);
+	TEST_CHECK(ctx, alloc.allocate(3) == blocks[100]);
+	TEST_CHECK(ctx, !alloc.allocate(8));
+
+	alloc.destroy();
+	TEST_CHECK(ctx, reservation.m_numReleases == 3);
+
+	// a module low in the address space doesn't reserve in the null page area
+	FakeReservation		lowReservation(1);
+	TrampolineAllocator	lowAlloc;
+
+	TEST_CHECK(ctx, lowAlloc.create(0x400000, 0x1000, kRegionLen, &lowReservation));
+	TEST_CHECK(ctx, lowReservation.m_ranges[0].low == 0x10000);
+}
+
+static void TestSizeClasses(TestContext & ctx)
+{
+	FakeReservation		reservation(10);
+	TrampolineAllocator	alloc;
+
+	TEST_CHECK(ctx, alloc.create(kModuleBase, kModuleLen, 0x10000, &reservation));
+
+	// 14 and 9 are both in the 16 byte class
+	void	* small = alloc.allocate(14);
+	TEST_CHECK(ctx, alloc.inUse() == 16);
+
+	alloc.free(small, 14);
+	TEST_CHECK(ctx, !alloc.inUse());
+	TEST_CHECK(ctx, alloc.allocate(9) == small);
+
+	// a different class doesn't take it
+	void	* other = alloc.allocate(20);
+	alloc.free(other, 20);
+	TEST_CHECK(ctx, alloc.allocate(16) != other);
+	TEST_CHECK(ctx, alloc.allocate(32) == other);
+
+	// what's left of a region goes on the free lists when the next one is reserved
+	u8		* tail = (u8 *)alloc.allocate(64);
+	size_t	left = alloc.remain();
+
+	TEST_CHECK(ctx, alloc.allocate(left + 8) != nullptr);
+	TEST_CHECK(ctx, alloc.numRegions() == 2);
+	TEST_CHECK(ctx, alloc.allocate(left - 16) == tail + 64);
+
+	// unsized allocations leave the next one 8 byte aligned
+	u8	* start = (u8 *)alloc.startAlloc();
+
+	TEST_CHECK(ctx, start && (alloc.remain() >= TrampolineAllocator::kMinUnsized));
+	alloc.endAlloc(start + 13);
+	TEST_CHECK(ctx, !(uintptr_t(alloc.allocate(8)) & 7));
+}
+
+static void TestLargeBlocks(TestContext & ctx)
+{
+	FakeReservation		reservation(10);
+	TrampolineAllocator	alloc;
+
+	TEST_CHECK(ctx, alloc.create(kModuleBase, kModuleLen, 0x10000, &reservation));
+
+	// rounded to 16 bytes, 5008 here
+	u8	* large = (u8 *)alloc.allocate(5000);
+	TEST_CHECK(ctx, alloc.inUse() == 5008);
+
+	alloc.free(large, 5000);
+
+	// reused, with the 496 byte rest split in to 256/128/64/32/16 blocks
+	TEST_CHECK(ctx, alloc.allocate(4500) == large);
+	TEST_CHECK(ctx, alloc.allocate(256) == large + 4512);
+	TEST_CHECK(ctx, alloc.allocate(128) == large + 4512 + 256);
+	TEST_CHECK(ctx, alloc.allocate(16) == large + 4512 + 256 + 128 + 64 + 32);
+
+	// best fit, the smaller of two freed blocks that are big enough
+	u8	* big = (u8 *)alloc.allocate(12000);
+	u8	* medium = (u8 *)alloc.allocate(6000);
+
+	alloc.free(big, 12000);
+	alloc.free(medium, 6000);
+
+	TEST_CHECK(ctx, alloc.allocate(5000) == medium);
+	TEST_CHECK(ctx, alloc.allocate(5000) == big);
+
+	// bigger than a whole region, the new one grows to fit
+	TEST_CHECK(ctx, alloc.allocate(0x18000) != nullptr);
+	TEST_CHECK(ctx, reservation.m_ranges.size() == 2);
+	TEST_CHECK(ctx, alloc.reserved() == 0x10000 + 0x20000);
+}
+
+// random sized blocks allocated and freed, checking none of them overlap
+static void TestChurn(TestContext & ctx)
+{
+	FakeReservation		reservation(100000);
+	TrampolineAllocator	alloc;
+
+	TEST_CHECK(ctx, alloc.create(kModuleBase, kModuleLen, 0x10000, &reservation));
+
+	struct Block
+	{
+		u8		* ptr;
+		size_t	len;
+		u8		tag;
+	};
+
+	std::mt19937			rng(7);
+	std::vector <Block>		live;
+	u8						tag = 1;
+	bool					aligned = true;
+	bool					intact = true;
+
+	for(u32 i = 0; i < 50000; i++)
+	{
+		if(live.empty() || (rng() % 3))
+		{
+			size_t	len = (rng() % 10) ? (1 + rng() % 600) : (4097 + rng() % 20000);
+			u8		* ptr = (u8 *)alloc.allocate(len);
+
+			if(!TEST_CHECK(ctx, ptr))
+				return;
+
+			if(uintptr_t(ptr) & 7)
+				aligned = false;
+
+			memset(ptr, tag, len);
+
+			Block	block = { ptr, len, tag };
+			live.push_back(block);
+
+			tag = tag % 250 + 1;
+		}
+		else
+		{
+			size_t	idx = rng() % live.size();
+			Block	block = live[idx];
+
+			for(size_t j = 0; j < block.len; j++)
+				if(block.ptr[j] != block.tag)
+					intact = false;
+
+			alloc.free(block.ptr, block.len);
+
+			live[idx] = live.back();
+			live.pop_back();
+		}
+	}
+
+	for(const Block & block : live)
+		for(size_t j = 0; j < block.len; j++)
+			if(block.ptr[j] != block.tag)
+				intact = false;
+
+	TEST_CHECK(ctx, aligned);
+	TEST_CHECK(ctx, intact);
+}
+
+// real reservations around a stand-in module, every byte has to be reachable from every byte of it
+static void TestPlatformReservation(TestContext & ctx)
+{
+	const uintptr_t	kMaxDisplacement = TrampolineAllocator::kMaxDisplacement;
+	const size_t	kLen = 64;
+	const size_t	kModuleSize = 0x1000000;
+
+	u8	* module = AllocTestPages(kModuleSize);
+	if(!TEST_CHECK(ctx, module))
+		return;
+
+	TrampolineAllocator	alloc;
+
+	TEST_CHECK(ctx, alloc.create(uintptr_t(module), kModuleSize, 0x10000, MemoryReservation::platform()));
+
+	std::vector <u8 *>	blocks;
+
+	// over a megabyte, so several regions
+	for(u32 i = 0; i < 20000; i++)
+	{
+		u8	* block = (u8 *)alloc.allocate(kLen);
+		if(!TEST_CHECK(ctx, block))
+			break;
+
+		memset(block, 0xC3, kLen);	// ret
+		blocks.push_back(block);
+	}
+
+	TEST_CHECK(ctx, alloc.numRegions() > 1);
+
+	bool	inRange = true;
+
+	for(u8 * block : blocks)
+	{
+		for(uintptr_t addr : { uintptr_t(module), uintptr_t(module) + kModuleSize })
+		{
+			ptrdiff_t	low = ptrdiff_t(uintptr_t(block) - addr);
+			ptrdiff_t	high = ptrdiff_t(uintptr_t(block) + kLen - addr);
+
+			if((low <= -ptrdiff_t(kMaxDisplacement)) || (high >= ptrdiff_t(kMaxDisplacement)))
+				inRange = false;
+		}
+	}
+
+	TEST_CHECK(ctx, inRange);
+
+	// and executable
+	if(!blocks.empty())
+		((void (*)())blocks[5])();
+
+	alloc.destroy();
+
+	FreeTestPages(module, kModuleSize);
+}
+
+void TestTrampolineAllocator(TestContext & ctx)
+{
+	TestRegionGrowth(ctx);
+	TestSizeClasses(ctx);
+	TestLargeBlocks(ctx);
+	TestChurn(ctx);
+	TestPlatformReservation(ctx);
+}
+
+// 1M allocations of one hook's worth, then 1M frees and allocations over a fixed set of live blocks
+void BenchTrampolineAllocator()
+{
+	const u32		kNumAllocs = 1000000;
+	const size_t	kLen = 14;
+
+	volatile uintptr_t	sink = 0;
+
+	{
+		FakeReservation		reservation(1000);
+		TrampolineAllocator	alloc;
+
+		alloc.create(kModuleBase, kModuleLen, kNumAllocs * 16, &reservation);
+
+		BenchTimer	timer;
+
+		for(u32 i = 0; i < kNumAllocs; i++)
+			sink += uintptr_t(alloc.allocate(kLen));
+
+		printf("\t%u allocations: %.2f ms\n", kNumAllocs, timer.elapsedMS());
+	}
+
+	{
+		FakeReservation		reservation(1000);
+		TrampolineAllocator	alloc;
+
+		alloc.create(kModuleBase, kModuleLen, 0x10000, &reservation);
+
+		std::vector <void *>	live(1024, nullptr);
+		std::mt19937			rng(1);
+
+		BenchTimer	timer;
+
+		for(u32 i = 0; i < kNumAllocs; i++)
+		{
+			size_t	idx = rng() & 1023;
+
+			if(live[idx])
+				alloc.free(live[idx], kLen);
+
+			live[idx] = alloc.allocate(kLen);
+		}
+
+		double	elapsed = timer.elapsedMS();
+
+		// a bump allocator would have needed room for every allocation
+		printf("\t%u frees and allocations: %.2f ms, %zu KB reserved (%zu KB without reuse)\n",
+			kNumAllocs, elapsed, alloc.reserved() / 1024, size_t(kNumAllocs) * kLen / 1024);
+	}
+}
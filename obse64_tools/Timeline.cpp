@@ -0,0 +1,231 @@
+#include "Timeline.h"
+#include "BinaryLogReader.h"
+#include "obse64_common/FileStream.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+// groups log messages by the game frame they were written in
+// binary logs have frame markers, so frame times are exact. text logs need [Log] Timestamps=1 in obse.ini,
+// and a frame's start is taken from its first message
+
+namespace
+{
+	enum
+	{
+		kNumSlowestFrames = 10,
+	};
+
+	struct Event
+	{
+		double		seconds;
+		u32			thread;
+		std::string	text;
+	};
+
+	struct Frame
+	{
+		double	start = -1;
+		bool	exactStart = false;
+
+		std::vector <Event>	events;
+	};
+
+	typedef std::map <u32, Frame>	FrameMap;
+
+	void AddEvent(FrameMap * frames, u32 frameIdx, double seconds, u32 thread, std::string && text)
+	{
+		Frame & frame = (*frames)[frameIdx];
+
+		if(!frame.exactStart && ((frame.start < 0) || (seconds < frame.start)))
+			frame.start = seconds;
+
+		frame.events.push_back({ seconds, thread, std::move(text) });
+	}
+
+	bool ReadBinary(const char * path, FrameMap * frames)
+	{
+		BinaryLogReader	reader;
+
+		if(!reader.Open(path))
+			return false;
+
+		BinaryLogReader::Record	record;
+
+		while(reader.Next(&record))
+		{
+			double seconds = reader.Seconds(record.timer);
+
+			if(record.type == BinaryLogFormat::kRecord_Frame)
+			{
+				Frame & frame = (*frames)[record.frame];
+
+				frame.start = seconds;
+				frame.exactStart = true;
+				continue;
+			}
+
+			std::string	text;
+			reader.Render(record, &text);
+
+			AddEvent(frames, record.frame, seconds, record.thread, std::move(text));
+		}
+
+		return true;
+	}
+
+	bool ReadText(const char * path, FrameMap * frames)
+	{
+		FileStream	file;
+
+		if(!file.open(path))
+		{
+			fprintf(stderr, "couldn't open %s\n", path);
+			return false;
+		}
+
+		std::string	data(size_t(file.length()), '\0');
+
+		if(file.read(&data[0], data.size()) != data.size())
+		{
+			fprintf(stderr, "couldn't read %s\n", path);
+			return false;
+		}
+
+		u32		numTimestamped = 0;
+		size_t	lineStart = 0;
+
+		while(lineStart < data.size())
+		{
+			size_t lineEnd = data.find('\n', lineStart);
+			if(lineEnd == std::string::npos)
+				lineEnd = data.size();
+
+			std::string	line = data.substr(lineStart, lineEnd - lineStart);
+			lineStart = lineEnd + 1;
+
+			if(!line.empty() && (line.back() == '\r'))
+				line.pop_back();
+
+			double	seconds;
+			u32		thread, frame;
+			int		textStart = 0;
+
+			// lines written before timestamps were turned on have no prefix
+			if((sscanf_s(line.c_str(), "[%lf %u %u] %n", &seconds, &thread, &frame, &textStart) != 3) || !textStart)
+				continue;
+
+			AddEvent(frames, frame, seconds, thread, line.substr(textStart));
+
+			numTimestamped++;
+		}
+
+		if(!numTimestamped)
+		{
+			fprintf(stderr, "%s has no timestamped lines, set Timestamps=1 in the [Log] section of obse.ini\n", path);
+			return false;
+		}
+
+		return true;
+	}
+
+	bool IsBinaryLog(const char * path)
+	{
+		FileStream	file;
+		u32			magic = 0;
+
+		return file.open(path) && (file.read(&magic, sizeof(magic)) == sizeof(magic)) && (magic == BinaryLogFormat::kMagic);
+	}
+}
+
+int Timeline(int argc, char ** argv)
+{
+	if((argc < 1) || (argc > 2))
+	{
+		fprintf(stderr, "usage: obse64_tools timeline <obse64.bin | obse64.txt> [output.txt]\n");
+		return 1;
+	}
+
+	FrameMap	frames;
+
+	if(!(IsBinaryLog(argv[0]) ? ReadBinary(argv[0], &frames) : ReadText(argv[0], &frames)))
+		return 1;
+
+	FILE	* out = stdout;
+
+	if(argc == 2)
+	{
+		if(fopen_s(&out, argv[1], "w"))
+		{
+			fprintf(stderr, "couldn't create %s\n", argv[1]);
+			return 1;
+		}
+	}
+
+	// a frame lasts until the next one starts. frames nothing was logged in don't show up in a text log,
+	// so there the time is until the next frame that did log something
+	struct FrameTime
+	{
+		u32		frame;
+		double	duration;
+	};
+
+	std::vector <FrameTime>	durations;
+
+	for(auto iter = frames.begin(); iter != frames.end(); ++iter)
+	{
+		auto next = std::next(iter);
+
+		if(iter->first && (next != frames.end()))
+			durations.push_back({ iter->first, next->second.start - iter->second.start });
+	}
+
+	fprintf(out, "%u frames\n", u32(frames.size()));
+
+	if(!durations.empty())
+	{
+		std::vector <FrameTime>	sorted = durations;
+
+		std::sort(sorted.begin(), sorted.end(), [](const FrameTime & a, const FrameTime & b) { return a.duration > b.duration; });
+
+		double total = 0;
+		for(auto & iter : durations)
+			total += iter.duration;
+
+		fprintf(out, "frame time: mean %.3f ms, median %.3f ms, max %.3f ms\n\nslowest frames:\n",
+			total * 1000 / durations.size(), sorted[sorted.size() / 2].duration * 1000, sorted[0].duration * 1000);
+
+		for(size_t i = 0; (i < kNumSlowestFrames) && (i < sorted.size()); i++)
+			fprintf(out, "\tframe %u: %.3f ms, %u messages\n",
+				sorted[i].frame, sorted[i].duration * 1000, u32(frames[sorted[i].frame].events.size()));
+	}
+
+	for(auto iter = frames.begin(); iter != frames.end(); ++iter)
+	{
+		Frame & frame = iter->second;
+		auto next = std::next(iter);
+
+		if(iter->first)
+			fprintf(out, "\nframe %u at %.6f", iter->first, frame.start);
+		else
+			fprintf(out, "\nstartup (before the first frame)");
+
+		if(iter->first && (next != frames.end()))
+			fprintf(out, ", %.3f ms", (next->second.start - frame.start) * 1000);
+
+		fprintf(out, ", %u messages\n", u32(frame.events.size()));
+
+		std::stable_sort(frame.events.begin(), frame.events.end(), [](const Event & a, const Event & b) { return a.seconds < b.seconds; });
+
+		for(auto & event : frame.events)
+			fprintf(out, "\t%+10.3f ms %5u  %s\n", (event.seconds - frame.start) * 1000, event.thread, event.text.c_str());
+	}
+
+	if(out != stdout)
+		fclose(out);
+
+	return 0;
+}
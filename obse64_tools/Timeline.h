@@ -0,0 +1,4 @@
+#pragma once
+
+// obse64_tools timeline <obse64.bin | obse64.txt> [output.txt]
+int Timeline(int argc, char ** argv);
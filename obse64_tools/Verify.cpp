@@ -0,0 +1,81 @@
+#include "Verify.h"
+#include "obse64_common/CommandTablePatches.h"
+#include "obse64_common/MappedFile.h"
+#include "obse64_common/PEImage.h"
+#include <cstdio>
+#include <cstring>
+
+static const char * kListNames[kCmdTablePatchList_Num] =
+{
+	"start",
+	"end",
+	"len",
+};
+
+static const char * kPatchTypeNames[] =
+{
+	"end",
+	"data16",
+	"data32",
+	"lea",
+	"offset32",
+	"string fetch",
+};
+
+int Verify(int argc, char ** argv)
+{
+	const char	* path = nullptr;
+	bool		failFast = false;
+	int			numPaths = 0;
+
+	for(int i = 0; i < argc; i++)
+	{
+		if(!strcmp(argv[i], "--fail-fast"))
+		{
+			failFast = true;
+		}
+		else
+		{
+			path = argv[i];
+			numPaths++;
+		}
+	}
+
+	if(numPaths != 1)
+	{
+		fprintf(stderr, "usage: obse64_tools verify <game exe> [--fail-fast]\n");
+		return 1;
+	}
+
+	MappedFile	file;
+
+	if(!file.open(path))
+	{
+		fprintf(stderr, "couldn't open %s (%08X)\n", path, MappedFile::lastError());
+		return 1;
+	}
+
+	PEImage	image;
+
+	if(!image.parse(file.data(), file.size()) || !image.is64())
+	{
+		fprintf(stderr, "%s isn't a 64 bit executable\n", path);
+		return 1;
+	}
+
+	std::vector <CmdTablePatchResult>	results;
+
+	u32	numFailed = verifyCmdTablePatches(image, &results, failFast);
+
+	for(const CmdTablePatchResult & result : results)
+	{
+		const CmdTablePatch	* patch = result.patch;
+		const char			* typeName = (patch->type < sizeof(kPatchTypeNames) / sizeof(kPatchTypeNames[0])) ? kPatchTypeNames[patch->type] : "?";
+
+		printf("%s  %-5s %08X  %-12s %s\n", result.ok ? "ok  " : "FAIL", kListNames[result.list], patch->ptr, typeName, result.detail.c_str());
+	}
+
+	printf("%u patch sites checked, %u failed\n", u32(results.size()), numFailed);
+
+	return numFailed ? 2 : 0;
+}
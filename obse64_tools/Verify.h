@@ -0,0 +1,4 @@
+#pragma once
+
+// obse64_tools verify <game exe> [--fail-fast]
+int Verify(int argc, char ** argv);
@@ -0,0 +1,62 @@
+#include "Decode.h"
+#include "SigScan.h"
+#include "Tests.h"
+#include "Timeline.h"
+#include "Verify.h"
+#include "obse64_common/Types.h"
+#include <cstdio>
+#include <cstring>
+
+// offline tools for files written by obse64
+//
+//	decode		renders a binary debug log (obse64.bin, [Debug] BinaryLog=1 in obse.ini) as text
+//	timeline	groups a binary log, or a text log with [Log] Timestamps=1, by game frame
+//	verify		checks the command table patch sites against an unpatched game exe, before trying a new game build
+//	sigscan		finds byte patterns in a game exe the way OBSESignatureInterface does, for testing plugin signatures
+//	test		unit tests for obse64_common that don't need the game, run by ctest
+//	bench		timings for the same code
+
+struct Tool
+{
+	const char	* name;
+	int			(* run)(int argc, char ** argv);
+	const char	* help;
+};
+
+static const Tool kTools[] =
+{
+	{ "decode",		Decode,		"decode <log.bin> [output.txt]                  render a binary debug log as text" },
+	{ "timeline",	Timeline,	"timeline <log.bin | log.txt> [output.txt]      per-frame timeline of a log" },
+	{ "verify",		Verify,		"verify <game exe> [--fail-fast]                check obse64's code patch sites" },
+	{ "sigscan",	SigScan,	"sigscan <game exe> <pattern | --file list>...  find code signatures" },
+	{ "test",		Test,		"test [suite]...                                run unit tests" },
+	{ "bench",		Bench,		"bench [benchmark]...                           run benchmarks" },
+};
+
+static void PrintUsage(void)
+{
+	fprintf(stderr, "usage: obse64_tools <command> [arguments]\n\n");
+
+	for(const Tool & tool : kTools)
+		fprintf(stderr, "\t%s\n", tool.help);
+}
+
+int main(int argc, char ** argv)
+{
+	if(argc < 2)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	for(const Tool & tool : kTools)
+	{
+		if(!_stricmp(argv[1], tool.name))
+			return tool.run(argc - 2, argv + 2);
+	}
+
+	fprintf(stderr, "unknown command \"%s\"\n\n", argv[1]);
+	PrintUsage();
+
+	return 1;
+}